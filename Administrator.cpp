@@ -7,19 +7,22 @@
  */
 
 #include "Administrator.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
+#include "Repository.h"
 #include <algorithm> 
 #include <map>
 
 using namespace crow;
 
-extern std::map<std::string, Lab> labsMap;
+extern Repository<Lab> labsRepository;
 
 /**
  * @brief Constructs an Administrator object from JSON data.
  * 
  * @param readValueJson JSON object containing administrator details.
  */
-Administrator::Administrator(crow::json::rvalue& readValueJson) : User(readValueJson), labManaged(nullptr)
+Administrator::Administrator(crow::json::rvalue& readValueJson) : User(readValueJson)
 {
     updateFromJson(readValueJson);
 }
@@ -27,21 +30,67 @@ Administrator::Administrator(crow::json::rvalue& readValueJson) : User(readValue
 /**
  * @brief Converts the Administrator object to a JSON representation.
  * 
- * @return A JSON object containing administrator details and the lab they manage.
+ * @return A JSON object containing administrator details and the lab they manage, or only
+ * the lab's id when it isn't stored.
  */
-crow::json::wvalue Administrator::convertToJson()
+crow::json::wvalue Administrator::convertToJson() const
 {
     crow::json::wvalue writeJson = User::convertToJson();
 
-    // Serialize the managed lab
-    writeJson["labManaged"] = labManaged->convertToJson();
+    // Serialize the managed lab, or only its id when the lab isn't stored, so the JSON can
+    // always be read back
+    Lab labManaged;
+    if (labsRepository.get(labManagedId, labManaged))
+    {
+        writeJson["labManaged"] = labManaged.convertToJson();
+    }
+    else
+    {
+        writeJson["labManaged"]["labId"] = labManagedId;
+    }
 
     return writeJson;
 }
 
+/**
+ * @brief Writes the Administrator object as JSON, the same text convertToJson().dump() gives.
+ * 
+ * Members are written in the order crow dumps them in, so both paths give the same bytes.
+ * 
+ * @param writer Receives the administrator's details.
+ */
+void Administrator::writeJson(JsonWriter& writer) const
+{
+    writer.beginObject();
+    writer.member("userName", getName());
+
+    // Write the managed lab, looked up only when the field mask selects it, or only its id
+    // when the lab isn't stored
+    Lab labManaged;
+    if (writer.key("labManaged"))
+    {
+        if (labsRepository.get(labManagedId, labManaged))
+        {
+            labManaged.writeJson(writer);
+        }
+        else
+        {
+            writer.beginObject();
+            writer.member("labId", labManagedId);
+            writer.endObject();
+        }
+    }
+
+    writer.member("userId", getId());
+    writer.endObject();
+}
+
 /**
  * @brief Updates the Administrator object from a JSON representation.
  * 
+ * Only the id of the managed lab is kept. The lab details in the JSON are applied by
+ * RelatedChanges<Administrator>, under the lab's lock.
+ * 
  * @param readValueJson JSON object containing updated administrator and lab details.
  */
 void Administrator::updateFromJson(crow::json::rvalue readValueJson)
@@ -49,12 +98,102 @@ void Administrator::updateFromJson(crow::json::rvalue readValueJson)
     User::updateFromJson(readValueJson);
     
     // Directly access labManaged from JSON
-    const crow::json::rvalue& labJson = readValueJson["labManaged"];
-    std::string labId = labJson["labId"].s();
+    labManagedId = readValueJson["labManaged"]["labId"].s();
+}
+
+/**
+ * @brief Reads the lab details in the JSON of an administrator.
+ * 
+ * @param readValueJson JSON object containing administrator and lab details.
+ * @throws std::runtime_error If labManaged is missing or isn't a whole lab.
+ */
+void RelatedChanges<Administrator>::add(const crow::json::rvalue& readValueJson)
+{
+    // Read the lab now, so details that aren't a lab fail before anything is locked or logged.
+    crow::json::rvalue labJson = readValueJson["labManaged"];
+    Lab lab{labJson};
+    labDetails.push_back(labJson);
+}
+
+/**
+ * @brief Locks the labs the added administrators manage.
+ * 
+ * @return The locks, taken in the order lockObjects takes them.
+ */
+std::vector<std::unique_lock<std::mutex>> RelatedChanges<Administrator>::lock() const
+{
+    std::vector<std::string> labIds;
+    labIds.reserve(labDetails.size());
+    for (const crow::json::rvalue& labJson : labDetails)
+        labIds.push_back(labJson["labId"].s());
+    return labsRepository.lockObjects(labIds);
+}
+
+/**
+ * @brief Applies the lab details of the added administrators, in order, to the stored labs.
+ * 
+ * A lab named by several administrators is changed once, by each of their details in turn.
+ * 
+ * @param records Receives one record per changed lab.
+ */
+void RelatedChanges<Administrator>::collect(std::vector<LogRecord>& records)
+{
+    std::map<std::string, size_t> changed;
+    for (const crow::json::rvalue& labJson : labDetails)
+    {
+        std::string labId = labJson["labId"].s();
+        std::map<std::string, size_t>::iterator found = changed.find(labId);
+        if (found == changed.end())
+        {
+            found = changed.emplace(labId, labs.size()).first;
+            labs.emplace_back();
+            labsRepository.get(labId, labs.back());
+        }
+        labs[found->second].updateFromJson(labJson);
+    }
+
+    for (const Lab& lab : labs)
+        records.push_back({"labs", LogOperation::Put, lab.getId(), toJsonString(lab)});
+}
+
+/**
+ * @brief Stores and tracks the changed labs, once they are logged.
+ * 
+ * @param tracker Tracks the changed ids for the next delta snapshot.
+ */
+void RelatedChanges<Administrator>::store(ChangeTracker& tracker)
+{
+    for (const Lab& lab : labs)
+    {
+        labsRepository.put(lab.getId(), lab);
+        tracker.markChanged("labs", lab.getId());
+    }
+    labDetails.clear();
+    labs.clear();
+}
 
-    // Set labManaged to point to the Lab in labsMap
-    labManaged = &(labsMap[labId]);
+/**
+ * @brief Writes the Administrator object as a binary snapshot record.
+ * 
+ * Only the id of the managed lab is written; the lab itself is in the labs snapshot.
+ * 
+ * @param writer The writer for the record. Fields are written in a fixed order.
+ */
+void Administrator::writeBinaryRecord(BinaryRecordWriter& writer) const
+{
+    User::writeBinaryRecord(writer);
+    writer.writeString(labManagedId);
+}
 
-    // Update the Lab details
-    labManaged->updateFromJson(labJson);
+/**
+ * @brief Reads the Administrator object from a binary snapshot record.
+ * 
+ * Only the id of the managed lab is read; the lab itself is in the labs repository.
+ * 
+ * @param reader The reader for the record. Fields are read in the order they were written.
+ */
+void Administrator::readBinaryRecord(BinaryRecordReader& reader)
+{
+    User::readBinaryRecord(reader);
+    labManagedId = reader.readString();
 }
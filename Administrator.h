@@ -4,27 +4,50 @@
 #include <crow.h>
 #include "User.h"
 #include "Lab.h"
+#include "RelatedChanges.h"
 #include <string>
 #include <vector>
 
 class Administrator : public User
 {
 public:
-    Administrator() : User(), labManaged(nullptr) {}
+    Administrator() : User() {}
     Administrator(crow::json::rvalue& readValueJson);
 
     // Getter
-    Lab* getLabManaged() const { return labManaged; }
+    std::string getLabManagedId() const { return labManagedId; }
 
     // Setter
-    void setLabManaged(Lab* labInput) { labManaged = labInput; }
+    void setLabManagedId(std::string labIdInput) { labManagedId = labIdInput; }
 
     // Override JSON methods
-    crow::json::wvalue convertToJson() override;
+    crow::json::wvalue convertToJson() const override;
+    void writeJson(JsonWriter& writer) const override;
     void updateFromJson(crow::json::rvalue readValueJson) override;
 
+    // Override binary snapshot methods
+    void writeBinaryRecord(BinaryRecordWriter& writer) const override;
+    void readBinaryRecord(BinaryRecordReader& reader) override;
+
+private:
+    std::string labManagedId;
+};
+
+// Creating, updating or importing an administrator applies the lab details under labManaged
+// to the lab with their labId, or adds that lab. Parsing an administrator only reads the
+// labId, so replaying and loading administrators leave the labs to their own records.
+template <>
+class RelatedChanges<Administrator>
+{
+public:
+    void add(const crow::json::rvalue& readValueJson);
+    std::vector<std::unique_lock<std::mutex>> lock() const;
+    void collect(std::vector<LogRecord>& records);
+    void store(ChangeTracker& tracker);
+
 private:
-    Lab* labManaged;
+    std::vector<crow::json::rvalue> labDetails; // labManaged of each added administrator, in order.
+    std::vector<Lab> labs;                      // The changed labs, once collected.
 };
 
 #endif // ADMINISTRATOR_H
\ No newline at end of file
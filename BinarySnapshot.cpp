@@ -0,0 +1,492 @@
+/**
+ * @file BinarySnapshot.cpp
+ * @brief Implementation of the binary snapshot file format.
+ *
+ * A binary snapshot holds one resource collection as a header, an offset table, fixed-layout
+ * records, a list area and a string pool. Every record of a collection is the same number of
+ * 8 byte slots, written in the order the entity's writeBinaryRecord() writes its fields, and
+ * the first slot is always the id. Records are stored in id order, so a mapped file can be
+ * searched by id without building any objects. Strings are read straight out of the mapping.
+ */
+
+#include "BinarySnapshot.h"
+#include "DurableFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    const char snapshotMagic[8] = {'L', 'F', 'S', 'N', 'A', 'P', 0, 0};
+    const uint32_t snapshotByteOrder = 0x01020304;
+    const uint64_t maximumSlotsPerRecord = 1024;
+
+    /**
+     * @brief Rounds an offset up to the next multiple of 8 so slots are aligned in the mapping.
+     *
+     * @param offset The offset to round.
+     * @return The aligned offset.
+     */
+    uint64_t alignSlot(uint64_t offset)
+    {
+        return (offset + 7) & ~uint64_t(7);
+    }
+}
+
+/**
+ * @brief Constructs a BinaryRecordWriter that appends to a snapshot being built.
+ *
+ * @param slotsInput The record slots of the snapshot.
+ * @param listsInput The list area of the snapshot.
+ * @param stringPoolInput The string pool of the snapshot.
+ */
+BinaryRecordWriter::BinaryRecordWriter(vector<BinarySlot>& slotsInput, vector<BinarySlot>& listsInput, string& stringPoolInput)
+    : slots(slotsInput), lists(listsInput), stringPool(stringPoolInput)
+{
+}
+
+/**
+ * @brief Writes a string field.
+ *
+ * @param value The string to write.
+ */
+void BinaryRecordWriter::writeString(const string& value)
+{
+    slots.push_back(textSlot(value));
+}
+
+/**
+ * @brief Writes a list of strings field.
+ *
+ * @param values The strings to write.
+ */
+void BinaryRecordWriter::writeStringList(const vector<string>& values)
+{
+    BinarySlot slot;
+    slot.list.first = lists.size();
+    slot.list.count = values.size();
+    for (const string& value : values)
+        lists.push_back(textSlot(value));
+    slots.push_back(slot);
+}
+
+/**
+ * @brief Writes a number field.
+ *
+ * @param value The number to write.
+ */
+void BinaryRecordWriter::writeNumber(double value)
+{
+    BinarySlot slot;
+    slot.number = value;
+    slots.push_back(slot);
+}
+
+/**
+ * @brief Writes a true/false field.
+ *
+ * @param value The value to write.
+ */
+void BinaryRecordWriter::writeBool(bool value)
+{
+    BinarySlot slot;
+    slot.flag = value ? 1 : 0;
+    slots.push_back(slot);
+}
+
+/**
+ * @brief Adds a string to the string pool.
+ *
+ * @param value The string to add.
+ * @return A slot referring to the string in the pool.
+ * @throws length_error if the pool would outgrow 32 bit offsets.
+ */
+BinarySlot BinaryRecordWriter::textSlot(const string& value)
+{
+    if (stringPool.size() + value.size() > UINT32_MAX)
+        throw length_error("Binary snapshot string pool is full");
+
+    BinarySlot slot;
+    slot.text.offset = stringPool.size();
+    slot.text.length = value.size();
+    stringPool += value;
+    return slot;
+}
+
+/**
+ * @brief Constructs a BinaryRecordReader over one mapped record.
+ *
+ * @param slotsInput The first slot of the record.
+ * @param slotCountInput The number of slots in the record.
+ * @param listsInput The list area of the snapshot.
+ * @param listsCountInput The number of entries in the list area.
+ * @param stringPoolInput The string pool of the snapshot.
+ * @param stringPoolSizeInput The size of the string pool in bytes.
+ */
+BinaryRecordReader::BinaryRecordReader(const BinarySlot* slotsInput, uint64_t slotCountInput, const BinarySlot* listsInput, uint64_t listsCountInput, const char* stringPoolInput, uint64_t stringPoolSizeInput)
+    : slots(slotsInput), slotCount(slotCountInput), lists(listsInput), listsCount(listsCountInput), stringPool(stringPoolInput), stringPoolSize(stringPoolSizeInput)
+{
+}
+
+/**
+ * @brief Reads the next field as a string.
+ *
+ * @return The string.
+ */
+string BinaryRecordReader::readString()
+{
+    return text(nextSlot());
+}
+
+/**
+ * @brief Reads the next field as a list of strings.
+ *
+ * @return The strings.
+ * @throws runtime_error if the list lies outside the list area.
+ */
+vector<string> BinaryRecordReader::readStringList()
+{
+    const BinarySlot& slot = nextSlot();
+    if (uint64_t(slot.list.first) + slot.list.count > listsCount)
+        throw runtime_error("Corrupt binary snapshot list");
+
+    vector<string> values;
+    values.reserve(slot.list.count);
+    for (uint32_t i = 0; i < slot.list.count; i++)
+        values.push_back(text(lists[slot.list.first + i]));
+    return values;
+}
+
+/**
+ * @brief Reads the next field as a number.
+ *
+ * @return The number.
+ */
+double BinaryRecordReader::readNumber()
+{
+    return nextSlot().number;
+}
+
+/**
+ * @brief Reads the next field as a true/false value.
+ *
+ * @return The value.
+ */
+bool BinaryRecordReader::readBool()
+{
+    return nextSlot().flag != 0;
+}
+
+/**
+ * @brief Moves to the next slot of the record.
+ *
+ * @return The slot.
+ * @throws runtime_error if the record has no more slots.
+ */
+const BinarySlot& BinaryRecordReader::nextSlot()
+{
+    if (position >= slotCount)
+        throw runtime_error("Binary snapshot record is shorter than its layout");
+    return slots[position++];
+}
+
+/**
+ * @brief Copies a string out of the string pool.
+ *
+ * @param slot A slot referring to the string.
+ * @return The string.
+ * @throws runtime_error if the string lies outside the pool.
+ */
+string BinaryRecordReader::text(const BinarySlot& slot) const
+{
+    if (uint64_t(slot.text.offset) + slot.text.length > stringPoolSize)
+        throw runtime_error("Corrupt binary snapshot string");
+    return string(stringPool + slot.text.offset, slot.text.length);
+}
+
+/**
+ * @brief Packs the record into one byte string.
+ *
+ * @return The sizes of the three areas followed by the areas themselves.
+ */
+string PackedBinaryRecord::pack() const
+{
+    uint64_t sizes[3] = {slots.size(), lists.size(), stringPool.size()};
+
+    string bytes;
+    bytes.reserve(sizeof(sizes) + (slots.size() + lists.size()) * sizeof(BinarySlot) + stringPool.size());
+    bytes.append(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    bytes.append(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(BinarySlot));
+    bytes.append(reinterpret_cast<const char*>(lists.data()), lists.size() * sizeof(BinarySlot));
+    bytes.append(stringPool);
+    return bytes;
+}
+
+/**
+ * @brief Reads a record packed by pack().
+ *
+ * The slots are read in place, which relies on the string's buffer being 8 byte aligned as
+ * every heap allocation is.
+ *
+ * @param bytes The packed record.
+ * @return A reader over the record.
+ * @throws runtime_error if the sizes do not match the bytes.
+ */
+BinaryRecordReader PackedBinaryRecord::unpack(const string& bytes)
+{
+    uint64_t sizes[3];
+    if (bytes.size() < sizeof(sizes))
+        throw runtime_error("Corrupt packed binary record");
+    memcpy(sizes, bytes.data(), sizeof(sizes));
+
+    uint64_t available = (bytes.size() - sizeof(sizes)) / sizeof(BinarySlot);
+    if (sizes[0] > available || sizes[1] > available - sizes[0] ||
+        sizes[2] != bytes.size() - sizeof(sizes) - (sizes[0] + sizes[1]) * sizeof(BinarySlot))
+        throw runtime_error("Corrupt packed binary record");
+
+    const BinarySlot* slots = reinterpret_cast<const BinarySlot*>(bytes.data() + sizeof(sizes));
+    const char* stringPool = bytes.data() + sizeof(sizes) + (sizes[0] + sizes[1]) * sizeof(BinarySlot);
+    return BinaryRecordReader(slots, sizes[0], slots + sizes[0], sizes[1], stringPool, sizes[2]);
+}
+
+/**
+ * @brief Starts a new record.
+ *
+ * @return A writer that appends the record's fields. The id must be written first.
+ */
+BinaryRecordWriter BinarySnapshotWriter::beginRecord()
+{
+    recordStarts.push_back(slots.size());
+    return BinaryRecordWriter(slots, lists, stringPool);
+}
+
+/**
+ * @brief Writes every record to a binary snapshot file.
+ *
+ * Like saveToFile, the file is written to a temporary name, synced and renamed over the
+ * target so a crash never leaves a half written snapshot behind.
+ *
+ * @param filename The name of the file to write.
+ * @return True if the file was written and synced, false otherwise.
+ */
+bool BinarySnapshotWriter::save(string filename)
+{
+    // Every record of a collection must have the same layout.
+    uint64_t slotsPerRecord = recordStarts.empty() ? 0 : slots.size() / recordStarts.size();
+    if (slots.size() != recordStarts.size() * slotsPerRecord)
+        return false;
+
+    for (size_t i = 0; i < recordStarts.size(); i++)
+    {
+        if (recordStarts[i] != i * slotsPerRecord)
+            return false;
+    }
+
+    BinarySnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = binarySnapshotVersion;
+    header.byteOrder = snapshotByteOrder;
+    strncpy(header.collection, collection.c_str(), sizeof(header.collection) - 1);
+    header.recordCount = recordStarts.size();
+    header.slotsPerRecord = slotsPerRecord;
+    header.offsetTableOffset = alignSlot(sizeof(header));
+    header.recordsOffset = header.offsetTableOffset + header.recordCount * sizeof(uint64_t);
+    header.listsOffset = header.recordsOffset + slots.size() * sizeof(BinarySlot);
+    header.listsCount = lists.size();
+    header.stringPoolOffset = header.listsOffset + lists.size() * sizeof(BinarySlot);
+    header.stringPoolSize = stringPool.size();
+
+    vector<uint64_t> offsetTable(header.recordCount);
+    for (size_t i = 0; i < recordStarts.size(); i++)
+        offsetTable[i] = header.recordsOffset + recordStarts[i] * sizeof(BinarySlot);
+
+    string temporaryFilename = filename + ".tmp";
+    ofstream file(temporaryFilename, ios::binary | ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    string padding(header.offsetTableOffset - sizeof(header), '\0');
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char*>(offsetTable.data()), offsetTable.size() * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(BinarySlot));
+    file.write(reinterpret_cast<const char*>(lists.data()), lists.size() * sizeof(BinarySlot));
+    file.write(stringPool.data(), stringPool.size());
+    file.close();
+    if (file.fail())
+        return false;
+
+    return replaceFile(temporaryFilename, filename);
+}
+
+/**
+ * @brief Unmaps the file.
+ */
+BinarySnapshotFile::~BinarySnapshotFile()
+{
+    close();
+}
+
+/**
+ * @brief Maps a binary snapshot file and checks that it can be read.
+ *
+ * Only the header and the offset table are checked here; nothing is parsed.
+ *
+ * @param filename The name of the file to map.
+ * @param collection The collection the file must hold.
+ * @return True if the file is a valid snapshot of the collection, false otherwise.
+ */
+bool BinarySnapshotFile::open(string filename, string collection)
+{
+    close();
+
+    int descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        return false;
+
+    struct stat fileStatus;
+    if (fstat(descriptor, &fileStatus) != 0 || fileStatus.st_size < (off_t)sizeof(BinarySnapshotHeader))
+    {
+        ::close(descriptor);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, fileStatus.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    data = static_cast<const char*>(mapping);
+    length = fileStatus.st_size;
+    const BinarySnapshotHeader* candidate = reinterpret_cast<const BinarySnapshotHeader*>(data);
+
+    // Check the header and that every section lies inside the file, in order.
+    bool valid = memcmp(candidate->magic, snapshotMagic, sizeof(candidate->magic)) == 0
+        && candidate->version == binarySnapshotVersion
+        && candidate->byteOrder == snapshotByteOrder
+        && strncmp(candidate->collection, collection.c_str(), sizeof(candidate->collection)) == 0
+        && candidate->offsetTableOffset >= sizeof(BinarySnapshotHeader)
+        && candidate->offsetTableOffset % sizeof(BinarySlot) == 0
+        && candidate->offsetTableOffset <= length
+        && candidate->slotsPerRecord <= maximumSlotsPerRecord
+        && candidate->recordCount <= (length - candidate->offsetTableOffset) / sizeof(uint64_t)
+        && candidate->recordsOffset == candidate->offsetTableOffset + candidate->recordCount * sizeof(uint64_t)
+        && candidate->listsOffset >= candidate->recordsOffset
+        && candidate->listsOffset <= length
+        && (candidate->listsOffset - candidate->recordsOffset) / sizeof(BinarySlot) == candidate->recordCount * candidate->slotsPerRecord
+        && candidate->listsCount <= (length - candidate->listsOffset) / sizeof(BinarySlot)
+        && candidate->stringPoolOffset == candidate->listsOffset + candidate->listsCount * sizeof(BinarySlot)
+        && candidate->stringPoolSize <= length - candidate->stringPoolOffset;
+
+    // Every record must start on a slot inside the records section.
+    const uint64_t* offsetTable = reinterpret_cast<const uint64_t*>(data + candidate->offsetTableOffset);
+    for (uint64_t i = 0; valid && i < candidate->recordCount; i++)
+    {
+        valid = offsetTable[i] >= candidate->recordsOffset
+            && (offsetTable[i] - candidate->recordsOffset) % sizeof(BinarySlot) == 0
+            && offsetTable[i] + candidate->slotsPerRecord * sizeof(BinarySlot) <= candidate->listsOffset;
+    }
+
+    if (!valid)
+    {
+        close();
+        return false;
+    }
+
+    header = candidate;
+    return true;
+}
+
+/**
+ * @brief Unmaps the file.
+ */
+void BinarySnapshotFile::close()
+{
+    if (data)
+        munmap(const_cast<char*>(data), length);
+    data = nullptr;
+    length = 0;
+    header = nullptr;
+}
+
+/**
+ * @brief Gets a reader over one record.
+ *
+ * @param index The position of the record, in id order.
+ * @return A reader over the record's slots.
+ * @throws out_of_range if there is no such record.
+ */
+BinaryRecordReader BinarySnapshotFile::record(uint64_t index) const
+{
+    if (index >= size())
+        throw out_of_range("No such binary snapshot record");
+
+    const uint64_t* offsetTable = reinterpret_cast<const uint64_t*>(data + header->offsetTableOffset);
+    return BinaryRecordReader(reinterpret_cast<const BinarySlot*>(data + offsetTable[index]), header->slotsPerRecord,
+        reinterpret_cast<const BinarySlot*>(data + header->listsOffset), header->listsCount,
+        data + header->stringPoolOffset, header->stringPoolSize);
+}
+
+/**
+ * @brief Gets the id of one record, which is always its first slot.
+ *
+ * @param index The position of the record, in id order.
+ * @return The id.
+ */
+string BinarySnapshotFile::recordId(uint64_t index) const
+{
+    return record(index).readString();
+}
+
+/**
+ * @brief Finds a record by id with a binary search over the offset table.
+ *
+ * @param id The id to find.
+ * @return The position of the record, or -1 if there is none.
+ */
+int64_t BinarySnapshotFile::find(const string& id) const
+{
+    uint64_t low = 0;
+    uint64_t high = size();
+    while (low < high)
+    {
+        uint64_t middle = low + (high - low) / 2;
+        string middleId = recordId(middle);
+        if (middleId == id)
+            return middle;
+        if (middleId < id)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return -1;
+}
+
+/**
+ * @brief Checks whether a binary snapshot is at least as new as the matching JSON file.
+ *
+ * @param snapshotFilename The name of the binary snapshot file.
+ * @param jsonFilename The name of the JSON file holding the same collection.
+ * @return True if the snapshot exists and the JSON file is missing or not newer.
+ */
+bool BinarySnapshotFile::isCurrent(string snapshotFilename, string jsonFilename)
+{
+    struct stat snapshotStatus;
+    struct stat jsonStatus;
+    if (stat(snapshotFilename.c_str(), &snapshotStatus) != 0)
+        return false;
+    if (stat(jsonFilename.c_str(), &jsonStatus) != 0)
+        return true;
+
+    if (jsonStatus.st_mtim.tv_sec != snapshotStatus.st_mtim.tv_sec)
+        return jsonStatus.st_mtim.tv_sec < snapshotStatus.st_mtim.tv_sec;
+    return jsonStatus.st_mtim.tv_nsec <= snapshotStatus.st_mtim.tv_nsec;
+}
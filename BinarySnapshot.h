@@ -0,0 +1,163 @@
+#ifndef BINARY_SNAPSHOT_H
+#define BINARY_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bump whenever a record layout changes so old files are rejected instead of misread.
+const uint32_t binarySnapshotVersion = 1;
+
+// Fixed header at the start of every binary snapshot file. Offsets are from the start of the file.
+struct BinarySnapshotHeader
+{
+    char magic[8];              // "LFSNAP" padded with zeros.
+    uint32_t version;           // binarySnapshotVersion.
+    uint32_t byteOrder;         // 0x01020304 as written by the host that made the file.
+    char collection[16];        // e.g. "experiments", zero padded.
+    uint64_t recordCount;
+    uint64_t slotsPerRecord;    // Every record of a collection has the same number of 8 byte slots.
+    uint64_t offsetTableOffset; // recordCount uint64 offsets of the records, in id order.
+    uint64_t recordsOffset;     // The records themselves.
+    uint64_t listsOffset;       // String references used by list slots.
+    uint64_t listsCount;
+    uint64_t stringPoolOffset;  // Every string, back to back, without terminators.
+    uint64_t stringPoolSize;
+};
+
+// One 8 byte field of a record. Strings and lists refer into the string pool and list area.
+union BinarySlot
+{
+    struct
+    {
+        uint32_t offset;
+        uint32_t length;
+    } text;           // A string: pool offset and length.
+    struct
+    {
+        uint32_t first;
+        uint32_t count;
+    } list;           // A list of strings: first index in the list area and count.
+    double number;
+    uint64_t flag;
+};
+
+// Appends the fields of one record in a fixed order.
+class BinaryRecordWriter
+{
+public:
+    BinaryRecordWriter(std::vector<BinarySlot>& slotsInput, std::vector<BinarySlot>& listsInput, std::string& stringPoolInput);
+
+    void writeString(const std::string& value);
+    void writeStringList(const std::vector<std::string>& values);
+    void writeNumber(double value);
+    void writeBool(bool value);
+
+private:
+    BinarySlot textSlot(const std::string& value);
+
+    std::vector<BinarySlot>& slots;
+    std::vector<BinarySlot>& lists;
+    std::string& stringPool;
+};
+
+// Reads the fields of one mapped record back in the order they were written.
+class BinaryRecordReader
+{
+public:
+    BinaryRecordReader(const BinarySlot* slotsInput, uint64_t slotCountInput, const BinarySlot* listsInput, uint64_t listsCountInput, const char* stringPoolInput, uint64_t stringPoolSizeInput);
+
+    // Getters
+    uint64_t getSlotsRead() const { return position; }
+
+    std::string readString();
+    std::vector<std::string> readStringList();
+    double readNumber();
+    bool readBool();
+
+private:
+    const BinarySlot& nextSlot();
+    std::string text(const BinarySlot& slot) const;
+
+    const BinarySlot* slots;
+    uint64_t slotCount;
+    const BinarySlot* lists;
+    uint64_t listsCount;
+    const char* stringPool;
+    uint64_t stringPoolSize;
+    uint64_t position = 0;
+};
+
+// One record packed into a buffer of its own, for stores that keep records apart.
+class PackedBinaryRecord
+{
+public:
+    // Fields are written through the returned writer, as for a snapshot record.
+    BinaryRecordWriter writer() { return BinaryRecordWriter(slots, lists, stringPool); }
+
+    // Three uint64 sizes followed by the slots, the list area and the string pool.
+    std::string pack() const;
+
+    // Read a packed record. The bytes must outlive the reader.
+    static BinaryRecordReader unpack(const std::string& bytes);
+
+private:
+    std::vector<BinarySlot> slots;
+    std::vector<BinarySlot> lists;
+    std::string stringPool;
+};
+
+// Collects records in memory and writes them as one binary snapshot file.
+class BinarySnapshotWriter
+{
+public:
+    BinarySnapshotWriter(std::string collectionInput) : collection(collectionInput) {}
+
+    // Start the next record; its fields are written through the returned writer.
+    BinaryRecordWriter beginRecord();
+
+    // Write the file to a temporary name, sync it and rename it over filename.
+    bool save(std::string filename);
+
+private:
+    std::string collection;
+    std::vector<BinarySlot> slots;
+    std::vector<uint64_t> recordStarts;
+    std::vector<BinarySlot> lists;
+    std::string stringPool;
+};
+
+// A read-only memory mapping of a binary snapshot file.
+class BinarySnapshotFile
+{
+public:
+    // Constructors
+    BinarySnapshotFile() {}
+    ~BinarySnapshotFile();
+    BinarySnapshotFile(const BinarySnapshotFile&) = delete;
+    BinarySnapshotFile& operator=(const BinarySnapshotFile&) = delete;
+
+    // Map a file and check its header, returns false if it is missing or not a valid snapshot.
+    bool open(std::string filename, std::string collection);
+    void close();
+
+    // Getters
+    bool isOpen() const { return header != nullptr; }
+    uint64_t size() const { return header ? header->recordCount : 0; }
+    uint64_t getSlotsPerRecord() const { return header ? header->slotsPerRecord : 0; }
+
+    // Record access without building objects.
+    BinaryRecordReader record(uint64_t index) const;
+    std::string recordId(uint64_t index) const;
+    int64_t find(const std::string& id) const;
+
+    // True if the snapshot exists and the JSON file it was made from is not newer.
+    static bool isCurrent(std::string snapshotFilename, std::string jsonFilename);
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    const BinarySnapshotHeader* header = nullptr;
+};
+
+#endif // BINARY_SNAPSHOT_H
@@ -0,0 +1,328 @@
+/**
+ * @file BitmapIndex.cpp
+ * @brief Implementation of the Bitmap, BitmapQuery and BitmapIndex classes.
+ *
+ * This file provides the implementation for the BitmapIndex class, which finds and counts
+ * the ids whose attribute has one of a few values without reading their objects. Each value
+ * keeps a bit per id number; a query is a few passes over machine words, and its count is
+ * the sum of their popcounts.
+ */
+
+#include "BitmapIndex.h"
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+using namespace std;
+
+/**
+ * @brief Checks whether a number is in the set.
+ *
+ * @param number The number.
+ * @return True if it is in the set.
+ */
+bool Bitmap::test(uint32_t number) const
+{
+    size_t word = number / 64;
+    return word < words.size() && (words[word] >> (number % 64) & 1);
+}
+
+/**
+ * @brief Counts the numbers in the set, a popcount per word.
+ *
+ * @return The number of bits set.
+ */
+size_t Bitmap::count() const
+{
+    size_t bits = 0;
+    for (uint64_t word : words)
+        bits += __builtin_popcountll(word);
+    return bits;
+}
+
+/**
+ * @brief Estimates the memory the set takes.
+ *
+ * @return The size in bytes.
+ */
+size_t Bitmap::memoryBytes() const
+{
+    return sizeof(*this) + words.capacity() * sizeof(uint64_t);
+}
+
+/**
+ * @brief Adds a number to the set.
+ *
+ * @param number The number.
+ */
+void Bitmap::set(uint32_t number)
+{
+    size_t word = number / 64;
+    if (word >= words.size())
+        words.resize(word + 1);
+    words[word] |= uint64_t(1) << (number % 64);
+}
+
+/**
+ * @brief Removes a number from the set.
+ *
+ * @param number The number.
+ */
+void Bitmap::reset(uint32_t number)
+{
+    size_t word = number / 64;
+    if (word < words.size())
+        words[word] &= ~(uint64_t(1) << (number % 64));
+}
+
+/**
+ * @brief Adds the numbers of another set to this one.
+ *
+ * @param other The other set.
+ * @return This set.
+ */
+Bitmap& Bitmap::operator|=(const Bitmap& other)
+{
+    if (words.size() < other.words.size())
+        words.resize(other.words.size());
+    for (size_t i = 0; i < other.words.size(); i++)
+        words[i] |= other.words[i];
+    return *this;
+}
+
+/**
+ * @brief Removes the numbers of another set from this one.
+ *
+ * @param other The other set.
+ * @return This set.
+ */
+Bitmap& Bitmap::andNot(const Bitmap& other)
+{
+    size_t shared = min(words.size(), other.words.size());
+    for (size_t i = 0; i < shared; i++)
+        words[i] &= ~other.words[i];
+    return *this;
+}
+
+/**
+ * @brief Checks whether the query accepts a value.
+ *
+ * @param value The value of an attribute.
+ * @return True if the value is one of anyOf, or anyOf is empty, and not one of noneOf.
+ */
+bool BitmapQuery::matches(const string& value) const
+{
+    if (!anyOf.empty() && find(anyOf.begin(), anyOf.end(), value) == anyOf.end())
+        return false;
+    return find(noneOf.begin(), noneOf.end(), value) == noneOf.end();
+}
+
+/**
+ * @brief Reads a query from a comma separated list of values. Empty values are skipped.
+ *
+ * @param text The list, e.g. "boston,!cambridge".
+ * @return The query.
+ */
+BitmapQuery BitmapQuery::parse(const string& text)
+{
+    BitmapQuery query;
+    istringstream list(text);
+    string value;
+    while (getline(list, value, ','))
+    {
+        if (value.size() > 1 && value[0] == '!')
+            query.noneOf.push_back(value.substr(1));
+        else if (!value.empty() && value != "!")
+            query.anyOf.push_back(value);
+    }
+    return query;
+}
+
+/**
+ * @brief Gets the number of ids indexed.
+ *
+ * @return The number of ids.
+ */
+size_t BitmapIndex::size() const
+{
+    shared_lock<shared_mutex> reading(indexMutex);
+    return numbers.size();
+}
+
+/**
+ * @brief Estimates the memory the index takes: the bitmaps, the ids, their numbers in id
+ * order and the hash tables' nodes and buckets.
+ *
+ * @return The size in bytes.
+ */
+size_t BitmapIndex::memoryBytes() const
+{
+    shared_lock<shared_mutex> reading(indexMutex);
+    const size_t nodeBytes = 2 * sizeof(void*);
+
+    size_t bytes = sizeof(*this) + used.memoryBytes();
+    for (const Bitmap& bitmap : bitmaps)
+        bytes += bitmap.memoryBytes();
+
+    bytes += numberedIds.capacity() * sizeof(string);
+    for (const string& id : numberedIds)
+        bytes += stringHeapBytes(id);
+    bytes += (valueOfNumber.capacity() + idOrder.capacity() + freeNumbers.capacity()) * sizeof(uint32_t);
+
+    bytes += numbers.bucket_count() * sizeof(void*);
+    for (const pair<const string, uint32_t>& number : numbers)
+        bytes += sizeof(number) + nodeBytes + stringHeapBytes(number.first);
+
+    bytes += values.capacity() * sizeof(string) + valueNumbers.bucket_count() * sizeof(void*);
+    for (const pair<const string, uint32_t>& valueNumber : valueNumbers)
+        bytes += sizeof(valueNumber) + nodeBytes + 2 * stringHeapBytes(valueNumber.first);
+    return bytes;
+}
+
+/**
+ * @brief Indexes the value of an id, replacing the value it had. A new id takes the number
+ * of the last removed one, if any, and its place among the numbers in id order.
+ *
+ * @param id The id.
+ * @param value The value of its attribute.
+ */
+void BitmapIndex::add(const string& id, const string& value)
+{
+    unique_lock<shared_mutex> writing(indexMutex);
+    unordered_map<string, uint32_t>::iterator foundValue = valueNumbers.find(value);
+    if (foundValue == valueNumbers.end())
+    {
+        foundValue = valueNumbers.emplace(value, values.size()).first;
+        values.push_back(value);
+        bitmaps.emplace_back();
+    }
+
+    uint32_t number;
+    unordered_map<string, uint32_t>::iterator found = numbers.find(id);
+    if (found != numbers.end())
+    {
+        number = found->second;
+        bitmaps[valueOfNumber[number]].reset(number);
+    }
+    else
+    {
+        if (!freeNumbers.empty())
+        {
+            number = freeNumbers.back();
+            freeNumbers.pop_back();
+            numberedIds[number] = id;
+        }
+        else
+        {
+            number = numberedIds.size();
+            numberedIds.push_back(id);
+            valueOfNumber.push_back(0);
+        }
+        numbers[id] = number;
+        used.set(number);
+
+        // Ids usually come in id order, as the repository is scanned, so most are appended.
+        vector<uint32_t>::iterator place = idOrder.end();
+        if (!idOrder.empty() && !idBefore(idOrder.back(), id))
+            place = lower_bound(idOrder.begin(), idOrder.end(), id, [this](uint32_t other, const string& key) { return idBefore(other, key); });
+        idOrder.insert(place, number);
+    }
+
+    valueOfNumber[number] = foundValue->second;
+    bitmaps[foundValue->second].set(number);
+}
+
+/**
+ * @brief Removes the value of an id. Its number is kept for the next id added.
+ *
+ * @param id The id.
+ */
+void BitmapIndex::remove(const string& id)
+{
+    unique_lock<shared_mutex> writing(indexMutex);
+    unordered_map<string, uint32_t>::iterator found = numbers.find(id);
+    if (found == numbers.end())
+        return;
+
+    uint32_t number = found->second;
+    bitmaps[valueOfNumber[number]].reset(number);
+    used.reset(number);
+    idOrder.erase(lower_bound(idOrder.begin(), idOrder.end(), id, [this](uint32_t other, const string& key) { return idBefore(other, key); }));
+    numberedIds[number].clear();
+    freeNumbers.push_back(number);
+    numbers.erase(found);
+}
+
+/**
+ * @brief Removes every value.
+ */
+void BitmapIndex::clear()
+{
+    unique_lock<shared_mutex> writing(indexMutex);
+    numberedIds.clear();
+    valueOfNumber.clear();
+    idOrder.clear();
+    freeNumbers.clear();
+    numbers.clear();
+    values.clear();
+    valueNumbers.clear();
+    bitmaps.clear();
+    used = Bitmap();
+}
+
+/**
+ * @brief Finds the ids a query matches, a page at a time.
+ *
+ * The bitmap of the query is counted whole, and the page is read by walking the numbers in
+ * id order from the cursor, testing each one's bit, until the page is full.
+ *
+ * @param query The values to find.
+ * @param after The id the page starts after, or null to start from the first.
+ * @param count The most ids to list, or 0 for every one.
+ * @param ids Receives the ids of the page in id order.
+ * @return The number of ids the query matches, on every page.
+ */
+size_t BitmapIndex::select(const BitmapQuery& query, const string* after, size_t count, vector<string>& ids) const
+{
+    ids.clear();
+    shared_lock<shared_mutex> reading(indexMutex);
+    Bitmap matched = matching(query);
+    size_t total = matched.count();
+
+    vector<uint32_t>::const_iterator next = idOrder.begin();
+    if (after)
+        next = upper_bound(idOrder.begin(), idOrder.end(), *after, [this](const string& key, uint32_t other) { return key < numberedIds[other]; });
+    for (; next != idOrder.end() && (count == 0 || ids.size() < count); ++next)
+    {
+        if (matched.test(*next))
+            ids.push_back(numberedIds[*next]);
+    }
+    return total;
+}
+
+/**
+ * @brief Combines the bitmaps of the values a query accepts, then takes out the bitmaps of
+ * the values it excludes. The caller holds the lock.
+ *
+ * @param query The values to find.
+ * @return The numbers of the ids the query matches.
+ */
+Bitmap BitmapIndex::matching(const BitmapQuery& query) const
+{
+    Bitmap matched;
+    if (query.anyOf.empty())
+        matched = used;
+    for (const string& value : query.anyOf)
+    {
+        unordered_map<string, uint32_t>::const_iterator found = valueNumbers.find(value);
+        if (found != valueNumbers.end())
+            matched |= bitmaps[found->second];
+    }
+    for (const string& value : query.noneOf)
+    {
+        unordered_map<string, uint32_t>::const_iterator found = valueNumbers.find(value);
+        if (found != valueNumbers.end())
+            matched.andNot(bitmaps[found->second]);
+    }
+    return matched;
+}
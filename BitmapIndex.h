@@ -0,0 +1,183 @@
+#ifndef BITMAP_INDEX_H
+#define BITMAP_INDEX_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Pagination.h"
+#include "Repository.h"
+
+// A set of numbers, one bit each in 64-bit words. Combining two sets and counting one read
+// whole words, 64 numbers at a time.
+class Bitmap
+{
+public:
+    // Getters
+    bool test(uint32_t number) const;
+    size_t count() const;
+    size_t memoryBytes() const;
+
+    // Changes
+    void set(uint32_t number);
+    void reset(uint32_t number);
+
+    // Keeps the numbers in either set, or only the ones not in other.
+    Bitmap& operator|=(const Bitmap& other);
+    Bitmap& andNot(const Bitmap& other);
+
+private:
+    std::vector<uint64_t> words;
+};
+
+// Which values of an attribute a filter accepts: any of anyOf, or every value when anyOf is
+// empty, but none of noneOf.
+struct BitmapQuery
+{
+    std::vector<std::string> anyOf;
+    std::vector<std::string> noneOf;
+
+    bool matches(const std::string& value) const;
+
+    // Reads a comma separated list of values, where a value starting with ! is excluded,
+    // e.g. "boston,cambridge" or "!boston".
+    static BitmapQuery parse(const std::string& text);
+};
+
+// The ids of a repository's objects by the value of one attribute with few values, such as
+// whether equipment is available, as one Bitmap per value. A query ORs the bitmaps of the
+// values it accepts and takes out the ones it excludes, and the bits left are counted.
+//
+// Ids are numbered densely, a removed id's number going to the next id added, so the bitmaps
+// stay as long as the number of ids. The numbers are also kept in id order, which a page of
+// matches is read in from the cursor on.
+class BitmapIndex
+{
+public:
+    // Getters
+    size_t size() const;
+    size_t memoryBytes() const;
+
+    // Changes. add replaces the value of an id that is already indexed.
+    void add(const std::string& id, const std::string& value);
+    void remove(const std::string& id);
+    void clear();
+
+    // Up to count ids a query matches, or every one when count is 0, in id order after the id
+    // after, or from the first when it is null. Returns how many ids the query matches in all.
+    size_t select(const BitmapQuery& query, const std::string* after, size_t count, std::vector<std::string>& ids) const;
+
+private:
+    Bitmap matching(const BitmapQuery& query) const;
+    bool idBefore(uint32_t number, const std::string& id) const { return numberedIds[number] < id; }
+
+    mutable std::shared_mutex indexMutex;
+    std::vector<std::string> numberedIds;
+    std::vector<uint32_t> valueOfNumber;
+    std::vector<uint32_t> idOrder;
+    std::vector<uint32_t> freeNumbers;
+    std::unordered_map<std::string, uint32_t> numbers;
+    std::vector<std::string> values;
+    std::unordered_map<std::string, uint32_t> valueNumbers;
+    std::vector<Bitmap> bitmaps;
+    Bitmap used;
+};
+
+// Indexes one attribute of a repository's objects, e.g. the approval status of experiments.
+template <typename T>
+class AttributeIndex : public RepositoryIndex<T>
+{
+public:
+    // Constructors
+    AttributeIndex(std::function<std::string(const T&)> valueInput) : value(valueInput) {}
+
+    // Getters
+    const BitmapIndex& getBitmaps() const { return bitmaps; }
+    size_t memoryBytes() const override { return bitmaps.memoryBytes(); }
+
+    // Changes
+    void put(const std::string& id, const T& object) override { bitmaps.add(id, value(object)); }
+    void erase(const std::string& id) override { bitmaps.remove(id); }
+    void clear() override { bitmaps.clear(); }
+
+private:
+    std::function<std::string(const T&)> value;
+    BitmapIndex bitmaps;
+};
+
+// The name a repository keeps the AttributeIndex of an attribute under, e.g. "attribute:available".
+inline std::string attributeIndexName(const std::string& attribute)
+{
+    return "attribute:" + attribute;
+}
+
+/**
+ * @brief Visits, in id order, the objects of a repository an attribute query matches, for a
+ * page of a filter, and counts every object it matches.
+ *
+ * Only the objects the page can hold are visited: those after its cursor, and no more than
+ * one past its limit. With the AttributeIndex of the attribute, the count is the popcount of
+ * the query's bitmap and only the page's objects are read. Without one, every object is checked.
+ *
+ * @tparam T The type of the filtered objects.
+ * @param repository The filtered collection.
+ * @param attribute The name of the attribute, e.g. "available".
+ * @param value Gets the value of the attribute of an object, the same the index is built from.
+ * @param query The values to find.
+ * @param page The page the request asks for, in id order.
+ * @param visit Called with each object of the page.
+ * @return The number of objects the query matches, on every page.
+ */
+template <typename T>
+size_t scanAttribute(const Repository<T>& repository, const std::string& attribute, const std::function<std::string(const T&)>& value, const BitmapQuery& query, const PageRequest& page, const std::function<void(const std::string&, const T&)>& visit)
+{
+    size_t total = 0;
+    size_t visited = 0;
+    size_t wanted = page.getLimit() > 0 ? page.getLimit() + 1 : 0;
+    std::shared_ptr<AttributeIndex<T>> index = repository.template getIndex<AttributeIndex<T>>(attributeIndexName(attribute));
+    if (!index)
+    {
+        repository.scan([&](const std::string& id, const T& object)
+        {
+            if (!query.matches(value(object)))
+                return;
+            total++;
+            if (page.isAfter(id) && (wanted == 0 || visited < wanted))
+            {
+                visit(id, object);
+                visited++;
+            }
+        });
+        return total;
+    }
+
+    // An object changed or removed since its id was selected is skipped, and more ids are
+    // selected after it to fill the page.
+    std::string after = page.hasCursor() ? page.getCursorPosition().id : "";
+    bool hasAfter = page.hasCursor();
+    std::vector<std::string> ids;
+    T object;
+    while (true)
+    {
+        size_t count = wanted > 0 ? wanted - visited : 0;
+        total = index->getBitmaps().select(query, hasAfter ? &after : nullptr, count, ids);
+        for (const std::string& id : ids)
+        {
+            if (repository.get(id, object) && query.matches(value(object)))
+            {
+                visit(id, object);
+                visited++;
+            }
+        }
+
+        if (wanted == 0 || visited >= wanted || ids.size() < count)
+            return total;
+        after = ids.back();
+        hasAfter = true;
+    }
+}
+
+#endif // BITMAP_INDEX_H
@@ -0,0 +1,1068 @@
+/**
+ * @file BodyFormat.cpp
+ * @brief Implementation of the body formats and the BinaryBodies middleware.
+ *
+ * This file provides the translation between JSON text and MessagePack or CBOR. JSON is read
+ * in one pass and written out as the binary format, without building a tree first. Containers
+ * are written with the shortest length header, which is put in front of their elements once
+ * they are counted. Binary bodies are read the same way and written as JSON.
+ */
+
+#include "BodyFormat.h"
+#include "JsonWriter.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace crow;
+
+// Bodies nested deeper than this are refused instead of overflowing the stack.
+static const int maxDepth = 64;
+
+/**
+ * @brief Appends the lowest bytes of a number, most significant first.
+ *
+ * @param value The number.
+ * @param bytes How many bytes to append.
+ * @param out Receives the bytes.
+ */
+static void appendBigEndian(uint64_t value, int bytes, string& out)
+{
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8)
+        out.push_back(static_cast<char>((value >> shift) & 0xff));
+}
+
+/**
+ * @brief Appends a CBOR head: the major type and its argument in the fewest bytes.
+ *
+ * @param major The major type, 0 to 7.
+ * @param argument The argument, e.g. a number or a length.
+ * @param out Receives the head.
+ */
+static void appendCborHead(int major, uint64_t argument, string& out)
+{
+    char type = static_cast<char>(major << 5);
+    if (argument < 24)
+        out.push_back(type | static_cast<char>(argument));
+    else if (argument <= 0xff)
+    {
+        out.push_back(type | 24);
+        appendBigEndian(argument, 1, out);
+    }
+    else if (argument <= 0xffff)
+    {
+        out.push_back(type | 25);
+        appendBigEndian(argument, 2, out);
+    }
+    else if (argument <= 0xffffffff)
+    {
+        out.push_back(type | 26);
+        appendBigEndian(argument, 4, out);
+    }
+    else
+    {
+        out.push_back(type | 27);
+        appendBigEndian(argument, 8, out);
+    }
+}
+
+/**
+ * @brief Makes the length header of an array or a map.
+ *
+ * @param format The binary format.
+ * @param isMap True for a map, false for an array.
+ * @param count The number of elements, or of key and value pairs.
+ * @return The header.
+ */
+static string containerHead(BodyFormat format, bool isMap, size_t count)
+{
+    string head;
+    if (format == BodyFormat::Cbor)
+        appendCborHead(isMap ? 5 : 4, count, head);
+    else if (count < 16)
+        head.push_back(static_cast<char>((isMap ? 0x80 : 0x90) | count));
+    else if (count <= 0xffff)
+    {
+        head.push_back(static_cast<char>(isMap ? 0xde : 0xdc));
+        appendBigEndian(count, 2, head);
+    }
+    else
+    {
+        head.push_back(static_cast<char>(isMap ? 0xdf : 0xdd));
+        appendBigEndian(count, 4, head);
+    }
+    return head;
+}
+
+/**
+ * @brief Appends a UTF-8 string.
+ *
+ * @param format The binary format.
+ * @param text The bytes of the string.
+ * @param length The number of bytes.
+ * @param out Receives the string.
+ */
+static void appendBinaryString(BodyFormat format, const char* text, size_t length, string& out)
+{
+    if (format == BodyFormat::Cbor)
+        appendCborHead(3, length, out);
+    else if (length < 32)
+        out.push_back(static_cast<char>(0xa0 | length));
+    else if (length <= 0xff)
+    {
+        out.push_back(static_cast<char>(0xd9));
+        appendBigEndian(length, 1, out);
+    }
+    else if (length <= 0xffff)
+    {
+        out.push_back(static_cast<char>(0xda));
+        appendBigEndian(length, 2, out);
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xdb));
+        appendBigEndian(length, 4, out);
+    }
+    out.append(text, length);
+}
+
+/**
+ * @brief Appends an integer in the fewest bytes.
+ *
+ * @param format The binary format.
+ * @param value The integer.
+ * @param out Receives the integer.
+ */
+static void appendBinaryInteger(BodyFormat format, int64_t value, string& out)
+{
+    if (format == BodyFormat::Cbor)
+    {
+        if (value >= 0)
+            appendCborHead(0, static_cast<uint64_t>(value), out);
+        else
+            appendCborHead(1, static_cast<uint64_t>(-1 - value), out);
+        return;
+    }
+
+    // MessagePack: positive and negative fixints, then the smallest fitting width.
+    uint64_t bits = static_cast<uint64_t>(value);
+    if (value >= -32 && value < 128)
+        out.push_back(static_cast<char>(value));
+    else if (value >= 0 && value <= 0xff)
+    {
+        out.push_back(static_cast<char>(0xcc));
+        appendBigEndian(bits, 1, out);
+    }
+    else if (value >= 0 && value <= 0xffff)
+    {
+        out.push_back(static_cast<char>(0xcd));
+        appendBigEndian(bits, 2, out);
+    }
+    else if (value >= 0 && value <= 0xffffffff)
+    {
+        out.push_back(static_cast<char>(0xce));
+        appendBigEndian(bits, 4, out);
+    }
+    else if (value >= 0)
+    {
+        out.push_back(static_cast<char>(0xcf));
+        appendBigEndian(bits, 8, out);
+    }
+    else if (value >= -128)
+    {
+        out.push_back(static_cast<char>(0xd0));
+        appendBigEndian(bits, 1, out);
+    }
+    else if (value >= -32768)
+    {
+        out.push_back(static_cast<char>(0xd1));
+        appendBigEndian(bits, 2, out);
+    }
+    else if (value >= INT32_MIN)
+    {
+        out.push_back(static_cast<char>(0xd2));
+        appendBigEndian(bits, 4, out);
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xd3));
+        appendBigEndian(bits, 8, out);
+    }
+}
+
+/**
+ * @brief Appends a 64-bit floating point number.
+ *
+ * @param format The binary format.
+ * @param value The number.
+ * @param out Receives the number.
+ */
+static void appendBinaryDouble(BodyFormat format, double value, string& out)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out.push_back(static_cast<char>(format == BodyFormat::Cbor ? 0xfb : 0xcb));
+    appendBigEndian(bits, 8, out);
+}
+
+/**
+ * @brief Appends a Unicode code point as UTF-8.
+ *
+ * @param codePoint The code point.
+ * @param out Receives the bytes.
+ */
+static void appendUtf8(uint32_t codePoint, string& out)
+{
+    if (codePoint < 0x80)
+        out.push_back(static_cast<char>(codePoint));
+    else if (codePoint < 0x800)
+    {
+        out.push_back(static_cast<char>(0xc0 | (codePoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+    else if (codePoint < 0x10000)
+    {
+        out.push_back(static_cast<char>(0xe0 | (codePoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xf0 | (codePoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+// Reads JSON text and writes each value in a binary format as it goes.
+struct JsonToBinary
+{
+    const string& text;
+    BodyFormat format;
+    string& out;
+    size_t pos = 0;
+
+    /**
+     * @brief Skips the whitespace JSON allows between tokens.
+     */
+    void skipSpace()
+    {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+            pos++;
+    }
+
+    /**
+     * @brief Reads four hexadecimal digits of a \u escape.
+     *
+     * @param codeUnit Receives the UTF-16 code unit.
+     * @return True if there were four hexadecimal digits.
+     */
+    bool readHex4(uint32_t& codeUnit)
+    {
+        if (text.size() - pos < 4)
+            return false;
+        codeUnit = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = text[pos++];
+            codeUnit <<= 4;
+            if (c >= '0' && c <= '9')
+                codeUnit |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                codeUnit |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                codeUnit |= c - 'A' + 10;
+            else
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads a string, undoing its escapes.
+     *
+     * @param decoded Receives the string as UTF-8.
+     * @return True if the string was valid.
+     */
+    bool readString(string& decoded)
+    {
+        pos++; // The opening quote.
+        while (pos < text.size())
+        {
+            // Copy runs of characters that are not escaped at once.
+            size_t runEnd = pos;
+            while (runEnd < text.size() && text[runEnd] != '"' && text[runEnd] != '\\' && static_cast<unsigned char>(text[runEnd]) >= 0x20)
+                runEnd++;
+            decoded.append(text, pos, runEnd - pos);
+            pos = runEnd;
+            if (pos >= text.size() || static_cast<unsigned char>(text[pos]) < 0x20)
+                return false;
+            if (text[pos++] == '"')
+                return true;
+
+            if (pos >= text.size())
+                return false;
+            char escaped = text[pos++];
+            switch (escaped)
+            {
+                case '"': decoded.push_back('"'); break;
+                case '\\': decoded.push_back('\\'); break;
+                case '/': decoded.push_back('/'); break;
+                case 'b': decoded.push_back('\b'); break;
+                case 'f': decoded.push_back('\f'); break;
+                case 'n': decoded.push_back('\n'); break;
+                case 'r': decoded.push_back('\r'); break;
+                case 't': decoded.push_back('\t'); break;
+                case 'u':
+                {
+                    uint32_t codePoint;
+                    if (!readHex4(codePoint) || (codePoint >= 0xdc00 && codePoint <= 0xdfff))
+                        return false;
+
+                    // A high surrogate must be followed by the escape of a low one.
+                    if (codePoint >= 0xd800 && codePoint <= 0xdbff)
+                    {
+                        uint32_t low;
+                        if (text.compare(pos, 2, "\\u") != 0)
+                            return false;
+                        pos += 2;
+                        if (!readHex4(low) || low < 0xdc00 || low > 0xdfff)
+                            return false;
+                        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    appendUtf8(codePoint, decoded);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Reads a string and writes it. Strings without escapes, which are most of them,
+     * are copied straight from the text.
+     *
+     * @return True if the string was valid.
+     */
+    bool copyString()
+    {
+        size_t end = pos + 1;
+        while (end < text.size() && text[end] != '"' && text[end] != '\\' && static_cast<unsigned char>(text[end]) >= 0x20)
+            end++;
+        if (end < text.size() && text[end] == '"')
+        {
+            appendBinaryString(format, text.data() + pos + 1, end - pos - 1, out);
+            pos = end + 1;
+            return true;
+        }
+
+        string decoded;
+        if (!readString(decoded))
+            return false;
+        appendBinaryString(format, decoded.data(), decoded.size(), out);
+        return true;
+    }
+
+    /**
+     * @brief Reads a number. Numbers with a fraction or an exponent, and integers too large for
+     * 64 bits, are written as floating point numbers, other numbers as integers.
+     *
+     * @return True if the number was valid.
+     */
+    bool readNumber()
+    {
+        size_t start = pos;
+        bool isInteger = true;
+        while (pos < text.size() && strchr("+-0123456789.eE", text[pos]) != nullptr && text[pos] != '\0')
+        {
+            if (text[pos] == '.' || text[pos] == 'e' || text[pos] == 'E')
+                isInteger = false;
+            pos++;
+        }
+        const char* first = text.data() + start;
+        const char* last = text.data() + pos;
+
+        if (isInteger)
+        {
+            int64_t integer;
+            from_chars_result result = from_chars(first, last, integer);
+            if (result.ec == errc() && result.ptr == last)
+            {
+                appendBinaryInteger(format, integer, out);
+                return true;
+            }
+            if (result.ec != errc::result_out_of_range)
+                return false;
+        }
+
+        double number;
+        from_chars_result result = from_chars(first, last, number);
+        if (result.ec != errc() || result.ptr != last)
+            return false;
+        appendBinaryDouble(format, number, out);
+        return true;
+    }
+
+    /**
+     * @brief Reads one value and everything in it.
+     *
+     * @param depth How many arrays and objects the value is in.
+     * @return True if the value was valid.
+     */
+    bool readValue(int depth)
+    {
+        skipSpace();
+        if (pos >= text.size() || depth > maxDepth)
+            return false;
+
+        char c = text[pos];
+        if (c == '{' || c == '[')
+        {
+            bool isMap = c == '{';
+            char close = isMap ? '}' : ']';
+            size_t start = out.size();
+            size_t count = 0;
+            pos++;
+            skipSpace();
+            if (pos < text.size() && text[pos] == close)
+                pos++;
+            else
+            {
+                while (true)
+                {
+                    if (isMap)
+                    {
+                        skipSpace();
+                        if (pos >= text.size() || text[pos] != '"' || !copyString())
+                            return false;
+                        skipSpace();
+                        if (pos >= text.size() || text[pos++] != ':')
+                            return false;
+                    }
+                    if (!readValue(depth + 1))
+                        return false;
+                    count++;
+
+                    skipSpace();
+                    if (pos >= text.size())
+                        return false;
+                    char separator = text[pos++];
+                    if (separator == close)
+                        break;
+                    if (separator != ',')
+                        return false;
+                }
+            }
+
+            // Put the length in front of the elements, now that they are counted.
+            out.insert(start, containerHead(format, isMap, count));
+            return true;
+        }
+
+        if (c == '"')
+            return copyString();
+
+        if (text.compare(pos, 4, "true") == 0)
+        {
+            pos += 4;
+            out.push_back(static_cast<char>(format == BodyFormat::Cbor ? 0xf5 : 0xc3));
+            return true;
+        }
+        if (text.compare(pos, 5, "false") == 0)
+        {
+            pos += 5;
+            out.push_back(static_cast<char>(format == BodyFormat::Cbor ? 0xf4 : 0xc2));
+            return true;
+        }
+        if (text.compare(pos, 4, "null") == 0)
+        {
+            pos += 4;
+            out.push_back(static_cast<char>(format == BodyFormat::Cbor ? 0xf6 : 0xc0));
+            return true;
+        }
+
+        if (c == '-' || (c >= '0' && c <= '9'))
+            return readNumber();
+        return false;
+    }
+};
+
+/**
+ * @brief Appends a floating point number as JSON, with every digit it needs to read back
+ * the same.
+ *
+ * @param number The number.
+ * @param json Receives the number, or null for numbers JSON cannot hold.
+ */
+static void appendJsonDouble(double number, string& json)
+{
+    if (isnan(number) || isinf(number))
+    {
+        json.append("null");
+        return;
+    }
+    char digits[32];
+    int length = snprintf(digits, sizeof(digits), "%.17g", number);
+    json.append(digits, length);
+    if (strpbrk(digits, ".eEn") == nullptr)
+        json.append(".0");
+}
+
+/**
+ * @brief Turns the bits of a CBOR half precision number into a double.
+ *
+ * @param half The 16 bits.
+ * @return The number.
+ */
+static double halfToDouble(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double value;
+    if (exponent == 0)
+        value = ldexp(mantissa, -24);
+    else if (exponent == 31)
+        value = mantissa == 0 ? INFINITY : NAN;
+    else
+        value = ldexp(mantissa + 1024, exponent - 25);
+    return (half & 0x8000) ? -value : value;
+}
+
+// Reads a MessagePack or CBOR body and writes each value as JSON as it goes.
+struct BinaryToJson
+{
+    const string& body;
+    BodyFormat format;
+    string& json;
+    size_t pos = 0;
+
+    /**
+     * @brief Reads a big-endian number.
+     *
+     * @param bytes How many bytes the number has.
+     * @param value Receives the number.
+     * @return True if the body had that many bytes left.
+     */
+    bool take(size_t bytes, uint64_t& value)
+    {
+        if (body.size() - pos < bytes)
+            return false;
+        value = 0;
+        for (size_t i = 0; i < bytes; i++)
+            value = (value << 8) | static_cast<unsigned char>(body[pos++]);
+        return true;
+    }
+
+    /**
+     * @brief Reads the bytes of a string and writes it as a JSON string.
+     *
+     * @param length The length of the string.
+     * @return True if the body had that many bytes left.
+     */
+    bool takeString(uint64_t length)
+    {
+        if (body.size() - pos < length)
+            return false;
+        json.push_back('"');
+        JsonWriter::appendEscaped(body.substr(pos, length), json);
+        json.push_back('"');
+        pos += length;
+        return true;
+    }
+
+    /**
+     * @brief Reads the elements of an array or the members of a map.
+     *
+     * @param isMap True for a map, whose keys must be strings.
+     * @param count The number of elements or members, unless indefinite.
+     * @param indefinite True for a CBOR container that ends with a break byte.
+     * @param depth How many arrays and maps the container is in.
+     * @return True if every element was valid.
+     */
+    bool readContainer(bool isMap, uint64_t count, bool indefinite, int depth)
+    {
+        // Every element takes at least a byte, so a longer count can only be a bad body.
+        if (!indefinite && count > (body.size() - pos) / (isMap ? 2 : 1))
+            return false;
+
+        json.push_back(isMap ? '{' : '[');
+        for (uint64_t i = 0; indefinite || i < count; i++)
+        {
+            if (indefinite && pos < body.size() && static_cast<unsigned char>(body[pos]) == 0xff)
+            {
+                pos++;
+                break;
+            }
+            if (i > 0)
+                json.push_back(',');
+            if (isMap)
+            {
+                if (!readKey())
+                    return false;
+                json.push_back(':');
+            }
+            if (!readValue(depth + 1))
+                return false;
+        }
+        json.push_back(isMap ? '}' : ']');
+        return true;
+    }
+
+    /**
+     * @brief Reads a map key, which must be a string.
+     *
+     * @return True if the key was a valid string.
+     */
+    bool readKey()
+    {
+        if (pos >= body.size())
+            return false;
+        unsigned char initial = static_cast<unsigned char>(body[pos]);
+        bool isString = format == BodyFormat::Cbor ? (initial >> 5) == 3 : ((initial >= 0xa0 && initial <= 0xbf) || (initial >= 0xd9 && initial <= 0xdb));
+        return isString && readValue(maxDepth);
+    }
+
+    /**
+     * @brief Reads one value and everything in it.
+     *
+     * @param depth How many arrays and maps the value is in.
+     * @return True if the value was valid.
+     */
+    bool readValue(int depth)
+    {
+        if (pos >= body.size() || depth > maxDepth)
+            return false;
+        return format == BodyFormat::Cbor ? readCbor(depth) : readMessagePack(depth);
+    }
+
+    /**
+     * @brief Reads one MessagePack value. Binary and extension types have no JSON equivalent
+     * and are refused.
+     *
+     * @param depth How many arrays and maps the value is in.
+     * @return True if the value was valid.
+     */
+    bool readMessagePack(int depth)
+    {
+        unsigned char initial = static_cast<unsigned char>(body[pos++]);
+        uint64_t value;
+
+        if (initial <= 0x7f)
+            json.append(to_string(initial));
+        else if (initial >= 0xe0)
+            json.append(to_string(static_cast<int>(static_cast<int8_t>(initial))));
+        else if (initial <= 0x8f)
+            return readContainer(true, initial & 0x0f, false, depth);
+        else if (initial <= 0x9f)
+            return readContainer(false, initial & 0x0f, false, depth);
+        else if (initial <= 0xbf)
+            return takeString(initial & 0x1f);
+        else if (initial == 0xc0)
+            json.append("null");
+        else if (initial == 0xc2)
+            json.append("false");
+        else if (initial == 0xc3)
+            json.append("true");
+        else if (initial == 0xca)
+        {
+            if (!take(4, value))
+                return false;
+            uint32_t bits = static_cast<uint32_t>(value);
+            float number;
+            memcpy(&number, &bits, sizeof(number));
+            appendJsonDouble(number, json);
+        }
+        else if (initial == 0xcb)
+        {
+            if (!take(8, value))
+                return false;
+            double number;
+            memcpy(&number, &value, sizeof(number));
+            appendJsonDouble(number, json);
+        }
+        else if (initial >= 0xcc && initial <= 0xcf)
+        {
+            if (!take(size_t(1) << (initial - 0xcc), value))
+                return false;
+            json.append(to_string(value));
+        }
+        else if (initial >= 0xd0 && initial <= 0xd3)
+        {
+            size_t bytes = size_t(1) << (initial - 0xd0);
+            if (!take(bytes, value))
+                return false;
+            // Sign-extend the two's complement value to 64 bits.
+            int shift = 64 - 8 * static_cast<int>(bytes);
+            int64_t number = static_cast<int64_t>(value << shift) >> shift;
+            json.append(to_string(number));
+        }
+        else if (initial >= 0xd9 && initial <= 0xdb)
+            return take(size_t(1) << (initial - 0xd9), value) && takeString(value);
+        else if (initial == 0xdc || initial == 0xdd)
+            return take(initial == 0xdc ? 2 : 4, value) && readContainer(false, value, false, depth);
+        else if (initial == 0xde || initial == 0xdf)
+            return take(initial == 0xde ? 2 : 4, value) && readContainer(true, value, false, depth);
+        else
+            return false;
+        return true;
+    }
+
+    /**
+     * @brief Reads one CBOR value. Byte strings have no JSON equivalent and are refused; tags
+     * are skipped and undefined is read as null.
+     *
+     * @param depth How many arrays and maps the value is in.
+     * @return True if the value was valid.
+     */
+    bool readCbor(int depth)
+    {
+        unsigned char initial = static_cast<unsigned char>(body[pos++]);
+        int major = initial >> 5;
+        int info = initial & 0x1f;
+
+        // Floating point numbers and simple values keep their own encoding of the argument.
+        if (major == 7)
+        {
+            uint64_t bits;
+            switch (info)
+            {
+                case 20: json.append("false"); return true;
+                case 21: json.append("true"); return true;
+                case 22:
+                case 23: json.append("null"); return true;
+                case 25:
+                    if (!take(2, bits))
+                        return false;
+                    appendJsonDouble(halfToDouble(static_cast<uint16_t>(bits)), json);
+                    return true;
+                case 26:
+                {
+                    if (!take(4, bits))
+                        return false;
+                    uint32_t singleBits = static_cast<uint32_t>(bits);
+                    float number;
+                    memcpy(&number, &singleBits, sizeof(number));
+                    appendJsonDouble(number, json);
+                    return true;
+                }
+                case 27:
+                {
+                    if (!take(8, bits))
+                        return false;
+                    double number;
+                    memcpy(&number, &bits, sizeof(number));
+                    appendJsonDouble(number, json);
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        uint64_t argument = info;
+        bool indefinite = info == 31;
+        if (info >= 24 && info <= 27)
+        {
+            if (!take(size_t(1) << (info - 24), argument))
+                return false;
+        }
+        else if (info > 27 && !indefinite)
+            return false;
+        if (indefinite && major != 3 && major != 4 && major != 5)
+            return false;
+
+        switch (major)
+        {
+            case 0:
+                json.append(to_string(argument));
+                return true;
+            case 1:
+                // -1 - argument, which for the largest argument does not fit in 64 bits.
+                json.push_back('-');
+                json.append(argument == UINT64_MAX ? "18446744073709551616" : to_string(argument + 1));
+                return true;
+            case 3:
+            {
+                if (!indefinite)
+                    return takeString(argument);
+
+                // An indefinite string is a run of definite strings ended by a break byte.
+                string text;
+                while (true)
+                {
+                    if (pos >= body.size())
+                        return false;
+                    unsigned char chunkHead = static_cast<unsigned char>(body[pos++]);
+                    if (chunkHead == 0xff)
+                        break;
+                    uint64_t length = chunkHead & 0x1f;
+                    if ((chunkHead >> 5) != 3 || length > 27 || (length >= 24 && !take(size_t(1) << (length - 24), length)))
+                        return false;
+                    if (body.size() - pos < length)
+                        return false;
+                    text.append(body, pos, length);
+                    pos += length;
+                }
+                json.push_back('"');
+                JsonWriter::appendEscaped(text, json);
+                json.push_back('"');
+                return true;
+            }
+            case 4:
+                return readContainer(false, argument, indefinite, depth);
+            case 5:
+                return readContainer(true, argument, indefinite, depth);
+            case 6:
+                return readValue(depth + 1);
+            default:
+                return false;
+        }
+    }
+};
+
+/**
+ * @brief Picks the format an Accept header asks for.
+ *
+ * @param acceptHeader The value of the Accept header, e.g. "application/msgpack".
+ * @return The binary format with the highest q value above JSON's, otherwise JSON.
+ */
+BodyFormat acceptedBodyFormat(const string& acceptHeader)
+{
+    if (acceptHeader.empty())
+        return BodyFormat::Json;
+
+    double jsonQuality = 0;
+    double messagePackQuality = 0;
+    double cborQuality = 0;
+    size_t start = 0;
+    while (start < acceptHeader.size())
+    {
+        size_t end = acceptHeader.find(',', start);
+        if (end == string::npos)
+            end = acceptHeader.size();
+        string range = acceptHeader.substr(start, end - start);
+        start = end + 1;
+
+        // Split "type/subtype;q=0.5" into the media type and its quality.
+        double quality = 1;
+        size_t parameters = range.find(';');
+        size_t qualityStart = range.find("q=", parameters == string::npos ? range.size() : parameters);
+        if (qualityStart != string::npos)
+            quality = strtod(range.c_str() + qualityStart + 2, nullptr);
+        string mediaType = range.substr(0, parameters);
+        mediaType.erase(remove_if(mediaType.begin(), mediaType.end(), [](char c) { return isspace(static_cast<unsigned char>(c)); }), mediaType.end());
+        transform(mediaType.begin(), mediaType.end(), mediaType.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+
+        if (mediaType == "application/json" || mediaType == "application/*" || mediaType == "*/*")
+            jsonQuality = max(jsonQuality, quality);
+        else if (mediaType == "application/msgpack" || mediaType == "application/x-msgpack" || mediaType == "application/vnd.msgpack")
+            messagePackQuality = max(messagePackQuality, quality);
+        else if (mediaType == "application/cbor")
+            cborQuality = max(cborQuality, quality);
+    }
+
+    if (messagePackQuality > jsonQuality && messagePackQuality >= cborQuality)
+        return BodyFormat::MessagePack;
+    if (cborQuality > jsonQuality)
+        return BodyFormat::Cbor;
+    return BodyFormat::Json;
+}
+
+/**
+ * @brief Picks the format of a request body.
+ *
+ * @param contentTypeHeader The value of the Content-Type header, e.g. "application/cbor".
+ * @return The binary format the header names, otherwise JSON.
+ */
+BodyFormat contentBodyFormat(const string& contentTypeHeader)
+{
+    string mediaType = contentTypeHeader.substr(0, contentTypeHeader.find(';'));
+    mediaType.erase(remove_if(mediaType.begin(), mediaType.end(), [](char c) { return isspace(static_cast<unsigned char>(c)); }), mediaType.end());
+    transform(mediaType.begin(), mediaType.end(), mediaType.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+
+    if (mediaType == "application/msgpack" || mediaType == "application/x-msgpack" || mediaType == "application/vnd.msgpack")
+        return BodyFormat::MessagePack;
+    if (mediaType == "application/cbor")
+        return BodyFormat::Cbor;
+    return BodyFormat::Json;
+}
+
+/**
+ * @brief Names the Content-Type of a format.
+ *
+ * @param format The format.
+ * @return The media type.
+ */
+const char* bodyFormatContentType(BodyFormat format)
+{
+    switch (format)
+    {
+        case BodyFormat::MessagePack: return "application/msgpack";
+        case BodyFormat::Cbor: return "application/cbor";
+        default: return "application/json";
+    }
+}
+
+/**
+ * @brief Tags a representation in a format, by the tag of the JSON it was translated from.
+ *
+ * @param entityTag The quoted tag of the JSON.
+ * @param format The format of the representation.
+ * @return The quoted tag with the name of the format before the closing quote, or the tag
+ * unchanged for JSON.
+ */
+string formatEntityTag(const string& entityTag, BodyFormat format)
+{
+    if (format == BodyFormat::Json || entityTag.size() < 2 || entityTag.back() != '"')
+        return entityTag;
+    return entityTag.substr(0, entityTag.size() - 1) + (format == BodyFormat::Cbor ? "-cbor\"" : "-msgpack\"");
+}
+
+/**
+ * @brief Translates JSON text to MessagePack or CBOR.
+ *
+ * @param json The JSON text.
+ * @param format The binary format.
+ * @param out Receives the body.
+ * @return True if the text was a single valid JSON value.
+ */
+bool encodeJsonBody(const string& json, BodyFormat format, string& out)
+{
+    size_t start = out.size();
+    JsonToBinary reader{json, format, out};
+    bool valid = reader.readValue(0);
+    reader.skipSpace();
+    if (!valid || reader.pos != json.size())
+    {
+        out.resize(start);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Translates a MessagePack or CBOR body to JSON text.
+ *
+ * @param body The body.
+ * @param format The binary format.
+ * @param json Receives the JSON text.
+ * @return True if the body was a single valid value whose map keys are all strings.
+ */
+bool decodeToJsonBody(const string& body, BodyFormat format, string& json)
+{
+    size_t start = json.size();
+    BinaryToJson reader{body, format, json};
+    if (!reader.readValue(0) || reader.pos != body.size())
+    {
+        json.resize(start);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Drops the name of a format from the tags in a conditional header, so handlers
+ * compare them with the tags of their JSON.
+ *
+ * @param req The HTTP request object.
+ * @param header The header, If-None-Match or If-Match.
+ * @param format The format whose tags are translated.
+ */
+static void translateTags(request& req, const string& header, BodyFormat format)
+{
+    string tags = req.get_header_value(header);
+    string suffix = formatEntityTag("\"\"", format);
+    suffix.erase(0, 1);
+    size_t found = tags.find(suffix);
+    if (found == string::npos)
+        return;
+
+    while (found != string::npos)
+    {
+        tags.replace(found, suffix.size(), "\"");
+        found = tags.find(suffix, found + 1);
+    }
+    req.headers.erase(header);
+    req.add_header(header, tags);
+}
+
+/**
+ * @brief Reads a binary request body as JSON and notes the format of the response.
+ *
+ * If-None-Match names the tags of the representations the client has, so only tags of the
+ * format it asks for now can match. If-Match names a state of the object whatever the format
+ * the client read it in.
+ *
+ * @param req The HTTP request object.
+ * @param res The HTTP response object, ended with 400 if the body is not valid.
+ * @param ctx Receives the format of the response.
+ */
+void BinaryBodies::before_handle(request& req, response& res, context& ctx)
+{
+    ctx.responseFormat = acceptedBodyFormat(req.get_header_value("Accept"));
+    if (ctx.responseFormat != BodyFormat::Json)
+        translateTags(req, "If-None-Match", ctx.responseFormat);
+    translateTags(req, "If-Match", BodyFormat::MessagePack);
+    translateTags(req, "If-Match", BodyFormat::Cbor);
+
+    BodyFormat requestFormat = contentBodyFormat(req.get_header_value("Content-Type"));
+    if (requestFormat == BodyFormat::Json || req.body.empty())
+        return;
+
+    string json;
+    if (!decodeToJsonBody(req.body, requestFormat, json))
+    {
+        res.code = 400; // Bad Request
+        res.end("Invalid " + string(bodyFormatContentType(requestFormat)) + " body");
+        return;
+    }
+    req.body = move(json);
+    req.headers.erase("Content-Type");
+    req.add_header("Content-Type", "application/json");
+}
+
+/**
+ * @brief Sends a JSON response in the format the request asked for.
+ *
+ * Successful responses with a JSON body are translated, and their tags, like those of
+ * 304 responses, name the format. Other responses, and lists sent from a spool file, are left
+ * as they are.
+ *
+ * @param req The HTTP request object.
+ * @param res The HTTP response object.
+ * @param ctx The format of the response.
+ */
+void BinaryBodies::after_handle(request& req, response& res, context& ctx)
+{
+    res.set_header("Vary", "Accept");
+    if (ctx.responseFormat == BodyFormat::Json)
+        return;
+
+    string entityTag = res.get_header_value("ETag");
+    if (res.code != 304)
+    {
+        if ((res.code != 200 && res.code != 201) || res.body.empty() || !res.file_info.path.empty())
+            return;
+
+        // Bodies a handler gave a type of their own, such as exports, are sent as they are.
+        string contentType = res.get_header_value("Content-Type");
+        if (!contentType.empty() && contentType.compare(0, 16, "application/json") != 0)
+            return;
+
+        string encoded;
+        if (!encodeJsonBody(res.body, ctx.responseFormat, encoded))
+            return;
+        res.body = move(encoded);
+        res.set_header("Content-Type", bodyFormatContentType(ctx.responseFormat));
+    }
+    if (!entityTag.empty())
+        res.set_header("ETag", formatEntityTag(entityTag, ctx.responseFormat));
+}
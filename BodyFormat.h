@@ -0,0 +1,54 @@
+#ifndef BODY_FORMAT_H
+#define BODY_FORMAT_H
+
+#include <crow.h>
+#include <string>
+
+// The formats request and response bodies can be in. JSON is the default. Clients that read
+// responses programmatically can ask for MessagePack or CBOR with the Accept header, and send
+// bodies in them with Content-Type. Handlers only see and write JSON: the BinaryBodies
+// middleware translates binary bodies value by value at the edge of the server, so both
+// formats carry the same fields in the same order.
+enum class BodyFormat
+{
+    Json,
+    MessagePack,
+    Cbor
+};
+
+// The format an Accept header asks for: the binary format with the highest q value, unless
+// JSON's is as high. JSON when the header is empty or names neither binary format.
+BodyFormat acceptedBodyFormat(const std::string& acceptHeader);
+
+// The format of a body with a Content-Type, JSON for any type that is not a binary format.
+BodyFormat contentBodyFormat(const std::string& contentTypeHeader);
+
+// The Content-Type of a format.
+const char* bodyFormatContentType(BodyFormat format);
+
+// The tag of a representation in a format, e.g. "1a2b-msgpack" for the JSON tag "1a2b".
+std::string formatEntityTag(const std::string& entityTag, BodyFormat format);
+
+// Translate JSON text to a binary format, appending to out. Returns false if the text is not
+// JSON, leaving out as it was.
+bool encodeJsonBody(const std::string& json, BodyFormat format, std::string& out);
+
+// Translate a binary body to JSON text, appending to json. Returns false if the body is not a
+// single valid value of the format or has map keys that are not strings.
+bool decodeToJsonBody(const std::string& body, BodyFormat format, std::string& json);
+
+// Crow middleware that reads MessagePack and CBOR request bodies as JSON and sends responses
+// in the format the Accept header asks for. Entity tags of binary representations carry the
+// name of their format, so a client's cached copy only matches the format it was sent in.
+struct BinaryBodies
+{
+    struct context
+    {
+        BodyFormat responseFormat = BodyFormat::Json;
+    };
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx);
+    void after_handle(crow::request& req, crow::response& res, context& ctx);
+};
+
+#endif // BODY_FORMAT_H
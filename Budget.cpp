@@ -7,6 +7,8 @@
  */
 
 #include "Budget.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
 
 using namespace crow;
 
@@ -25,7 +27,7 @@ Budget::Budget(json::rvalue readValueJson)
  * 
  * @return A JSON object containing the budget details.
  */
-json::wvalue Budget::convertToJson()
+json::wvalue Budget::convertToJson() const
 {
     json::wvalue writeJson;
     writeJson["totalAmount"] = totalAmount;
@@ -34,6 +36,22 @@ json::wvalue Budget::convertToJson()
     return writeJson;
 }
 
+/**
+ * @brief Writes the Budget object as JSON, the same text convertToJson().dump() gives.
+ * 
+ * Members are written in the order crow dumps them in, so both paths give the same bytes.
+ * 
+ * @param writer Receives the budget details.
+ */
+void Budget::writeJson(JsonWriter& writer) const
+{
+    writer.beginObject();
+    writer.member("remainingAmount", remainingAmount);
+    writer.member("spentAmount", spentAmount);
+    writer.member("totalAmount", totalAmount);
+    writer.endObject();
+}
+
 /**
  * @brief Updates the Budget object from a JSON representation.
  * 
@@ -45,3 +63,27 @@ void Budget::updateFromJson(json::rvalue readValueJson)
     spentAmount = readValueJson["spentAmount"].d();
     remainingAmount = readValueJson["remainingAmount"].d();
 }
+
+/**
+ * @brief Writes the Budget object as a binary snapshot record.
+ * 
+ * @param writer The writer for the record. Fields are written in a fixed order.
+ */
+void Budget::writeBinaryRecord(BinaryRecordWriter& writer) const
+{
+    writer.writeNumber(totalAmount);
+    writer.writeNumber(spentAmount);
+    writer.writeNumber(remainingAmount);
+}
+
+/**
+ * @brief Reads the Budget object from a binary snapshot record.
+ * 
+ * @param reader The reader for the record. Fields are read in the order they were written.
+ */
+void Budget::readBinaryRecord(BinaryRecordReader& reader)
+{
+    totalAmount = reader.readNumber();
+    spentAmount = reader.readNumber();
+    remainingAmount = reader.readNumber();
+}
@@ -3,6 +3,10 @@
 
 #include <crow.h>
 
+class BinaryRecordWriter;
+class BinaryRecordReader;
+class JsonWriter;
+
 class Budget
 {
 public:
@@ -19,9 +23,14 @@ public:
     void setRemainingAmount(float amount) { remainingAmount = amount; }
 
     // JSON methods
-    crow::json::wvalue convertToJson();
+    crow::json::wvalue convertToJson() const;
+    void writeJson(JsonWriter& writer) const;
     void updateFromJson(crow::json::rvalue readValueJson);
 
+    // Binary snapshot methods
+    void writeBinaryRecord(BinaryRecordWriter& writer) const;
+    void readBinaryRecord(BinaryRecordReader& reader);
+
 private:
     float totalAmount;
     float spentAmount;
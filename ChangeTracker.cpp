@@ -0,0 +1,94 @@
+/**
+ * @file ChangeTracker.cpp
+ * @brief Implementation of the ChangeTracker class.
+ *
+ * This file provides the implementation for the ChangeTracker class, which remembers the ids
+ * of the resources changed or deleted since the collections were last flushed, so a flush
+ * only has to write those resources instead of whole collections.
+ */
+
+#include "ChangeTracker.h"
+
+using namespace std;
+
+/**
+ * @brief Records that a resource was created or updated.
+ *
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param id The id of the resource.
+ */
+void ChangeTracker::markChanged(const string& collection, const string& id)
+{
+    lock_guard<mutex> lock(changesMutex);
+    CollectionChanges& collectionChanges = changes[collection];
+    collectionChanges.deleted.erase(id);
+    collectionChanges.changed.insert(id);
+}
+
+/**
+ * @brief Records that a resource was deleted.
+ *
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param id The id of the resource.
+ */
+void ChangeTracker::markDeleted(const string& collection, const string& id)
+{
+    lock_guard<mutex> lock(changesMutex);
+    CollectionChanges& collectionChanges = changes[collection];
+    collectionChanges.changed.erase(id);
+    collectionChanges.deleted.insert(id);
+}
+
+/**
+ * @brief Takes every change recorded since the last call.
+ *
+ * @return The changes, keyed by collection.
+ */
+ChangeSet ChangeTracker::takeChanges()
+{
+    lock_guard<mutex> lock(changesMutex);
+    ChangeSet taken;
+    taken.swap(changes);
+    return taken;
+}
+
+/**
+ * @brief Puts back changes taken for a flush that failed.
+ *
+ * A change recorded after the failed flush took its changes is newer, so it wins over the
+ * restored one.
+ *
+ * @param changesInput The changes that were not flushed.
+ */
+void ChangeTracker::restoreChanges(const ChangeSet& changesInput)
+{
+    lock_guard<mutex> lock(changesMutex);
+    for (const pair<const string, CollectionChanges>& keyValuePair : changesInput)
+    {
+        CollectionChanges& collectionChanges = changes[keyValuePair.first];
+        for (const string& id : keyValuePair.second.changed)
+        {
+            if (!collectionChanges.deleted.count(id))
+                collectionChanges.changed.insert(id);
+        }
+        for (const string& id : keyValuePair.second.deleted)
+        {
+            if (!collectionChanges.changed.count(id))
+                collectionChanges.deleted.insert(id);
+        }
+    }
+}
+
+/**
+ * @brief Gets the number of resources changed or deleted since the last flush.
+ *
+ * @return The number of changed and deleted ids over every collection.
+ */
+size_t ChangeTracker::getChangeCount() const
+{
+    lock_guard<mutex> lock(changesMutex);
+    size_t count = 0;
+    for (const pair<const string, CollectionChanges>& keyValuePair : changes)
+        count += keyValuePair.second.changed.size() + keyValuePair.second.deleted.size();
+    return count;
+}
@@ -0,0 +1,41 @@
+#ifndef CHANGE_TRACKER_H
+#define CHANGE_TRACKER_H
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+// The ids of one collection changed or deleted since the last flush. An id is in at most
+// one of the two sets, whichever happened to it last.
+struct CollectionChanges
+{
+    std::set<std::string> changed;
+    std::set<std::string> deleted;
+};
+
+// Changes keyed by collection name, e.g. "experiments".
+typedef std::map<std::string, CollectionChanges> ChangeSet;
+
+class ChangeTracker
+{
+public:
+    // Record a change. Handlers call these next to the write-ahead log append.
+    void markChanged(const std::string& collection, const std::string& id);
+    void markDeleted(const std::string& collection, const std::string& id);
+
+    // Take every change recorded so far, leaving the tracker empty.
+    ChangeSet takeChanges();
+
+    // Put back changes whose flush failed, keeping anything recorded after they were taken.
+    void restoreChanges(const ChangeSet& changesInput);
+
+    // Getters
+    size_t getChangeCount() const;
+
+private:
+    mutable std::mutex changesMutex;
+    ChangeSet changes;
+};
+
+#endif // CHANGE_TRACKER_H
@@ -0,0 +1,51 @@
+/**
+ * @file DurableFile.cpp
+ * @brief Implementation of the atomic, durable replacement of a file.
+ *
+ * Every file the server writes whole (JSON and binary snapshots and compacted log segments)
+ * is written to a temporary file first and handed to replaceFile, which makes the contents
+ * and then the rename durable.
+ */
+
+#include "DurableFile.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+
+using namespace std;
+
+/**
+ * @brief Syncs a file or directory to disk.
+ *
+ * @param path The path of the file or directory.
+ * @return True if it was synced, false otherwise.
+ */
+static bool syncPath(const string& path)
+{
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        return false;
+    bool synced = fsync(descriptor) == 0;
+    close(descriptor);
+    return synced;
+}
+
+/**
+ * @brief Replaces a file by a temporary file holding its new contents.
+ *
+ * The temporary file is synced, renamed over the file, and then the directory holding them is
+ * synced, since a rename is only durable once the directory entry is.
+ *
+ * @param temporaryFilename The fully written temporary file, in the same directory.
+ * @param filename The file to replace.
+ * @return True if the new contents are in place and durable, false otherwise.
+ */
+bool replaceFile(const string& temporaryFilename, const string& filename)
+{
+    if (!syncPath(temporaryFilename) || rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+        return false;
+
+    size_t slash = filename.find_last_of('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : filename.substr(0, slash);
+    return syncPath(directory);
+}
@@ -0,0 +1,12 @@
+#ifndef DURABLE_FILE_H
+#define DURABLE_FILE_H
+
+#include <string>
+
+// Replace a file by a fully written temporary file, so readers see either the old contents or
+// the new ones. The temporary file is synced before the rename makes it visible, and the
+// directory after it, so the new name survives a crash; only then may a caller delete what
+// the old file made redundant, such as rotated log segments.
+bool replaceFile(const std::string& temporaryFilename, const std::string& filename);
+
+#endif // DURABLE_FILE_H
@@ -0,0 +1,174 @@
+/**
+ * @file EntityTag.cpp
+ * @brief Implementation of the entity tag helpers for conditional requests.
+ *
+ * This file provides the functions that tag responses with strong ETags and evaluate the
+ * If-None-Match and If-Match headers of requests against them.
+ */
+
+#include "EntityTag.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+using namespace crow;
+
+/**
+ * @brief Hashes a string with 64-bit FNV-1a.
+ *
+ * @param text The string to hash.
+ * @return The hash.
+ */
+static uint64_t hashText(const string& text)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Formats a number as 16 hexadecimal digits.
+ *
+ * @param number The number.
+ * @return The digits.
+ */
+static string toHex(uint64_t number)
+{
+    char digits[17];
+    snprintf(digits, sizeof(digits), "%016llx", (unsigned long long)number);
+    return digits;
+}
+
+/**
+ * @brief Gets the token that tells this run of the server from earlier ones.
+ *
+ * @return The token, the same for the whole run.
+ */
+static const string& instanceToken()
+{
+    static const string token = toHex(random_device()() ^ (uint64_t)chrono::system_clock::now().time_since_epoch().count());
+    return token;
+}
+
+/**
+ * @brief Tags a response body by its content.
+ *
+ * @param body The response body.
+ * @return The quoted tag.
+ */
+string makeEntityTag(const string& body)
+{
+    return "\"" + toHex(hashText(body)) + "\"";
+}
+
+/**
+ * @brief Tags a state of a collection by its version and the query that selected it.
+ *
+ * @param version The version of the collection.
+ * @param query The request URL with its query string, so differently searched or sorted
+ * lists of one version get different tags.
+ * @return The quoted tag.
+ */
+string makeVersionTag(uint64_t version, const string& query)
+{
+    return "\"" + instanceToken() + "-" + to_string(version) + "-" + toHex(hashText(query)) + "\"";
+}
+
+/**
+ * @brief Checks a comma separated list of tags from a header against a tag.
+ *
+ * @param headerValue The value of an If-Match or If-None-Match header.
+ * @param entityTag The quoted tag to look for.
+ * @param weakComparison True to also accept the tag marked weak with W/, as If-None-Match does.
+ * @return True if the list is "*" or names the tag, false otherwise.
+ */
+bool entityTagListMatches(const string& headerValue, const string& entityTag, bool weakComparison)
+{
+    size_t start = 0;
+    while (start < headerValue.size())
+    {
+        size_t end = headerValue.find(',', start);
+        if (end == string::npos)
+            end = headerValue.size();
+
+        size_t first = headerValue.find_first_not_of(" \t", start);
+        size_t last = headerValue.find_last_not_of(" \t", end - 1);
+        if (first != string::npos && first < end)
+        {
+            string candidate = headerValue.substr(first, last - first + 1);
+            if (candidate == "*")
+                return true;
+            if (weakComparison && candidate.compare(0, 2, "W/") == 0)
+                candidate = candidate.substr(2);
+            if (candidate == entityTag)
+                return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+/**
+ * @brief Checks whether the client already has the tagged representation.
+ *
+ * @param req The HTTP request object.
+ * @param entityTag The quoted tag of the current representation.
+ * @return True if the request has an If-None-Match header that names the tag.
+ */
+bool isNotModified(const request& req, const string& entityTag)
+{
+    const string& ifNoneMatch = req.get_header_value("If-None-Match");
+    return !ifNoneMatch.empty() && entityTagListMatches(ifNoneMatch, entityTag, true);
+}
+
+/**
+ * @brief Checks the If-Match precondition of a change.
+ *
+ * @param req The HTTP request object.
+ * @param currentBody Gets the body a GET would answer with now.
+ * @return True if the request has no If-Match header or the header names the current tag.
+ */
+bool ifMatchHolds(const request& req, const function<string()>& currentBody)
+{
+    const string& ifMatch = req.get_header_value("If-Match");
+    return ifMatch.empty() || entityTagListMatches(ifMatch, makeEntityTag(currentBody()), false);
+}
+
+/**
+ * @brief Answers that the client's copy is still current.
+ *
+ * @param entityTag The quoted tag of the current representation.
+ * @return The 304 Not Modified response, without a body.
+ */
+response notModified(const string& entityTag)
+{
+    response res(304);
+    res.set_header("ETag", entityTag);
+    return res;
+}
+
+/**
+ * @brief Tags a successful response by its body.
+ *
+ * @param req The HTTP request object.
+ * @param res The response of the handler.
+ * @return The response with an ETag header, 304 Not Modified if the request already names
+ * that tag, or the response unchanged if it is not a 200.
+ */
+response withEntityTag(const request& req, response res)
+{
+    if (res.code != 200)
+        return res;
+
+    string entityTag = makeEntityTag(res.body);
+    if (isNotModified(req, entityTag))
+        return notModified(entityTag);
+
+    res.set_header("ETag", entityTag);
+    return res;
+}
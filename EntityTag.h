@@ -0,0 +1,36 @@
+#ifndef ENTITY_TAG_H
+#define ENTITY_TAG_H
+
+#include <crow.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Strong entity tags (ETags) for conditional requests. A resource is tagged by a hash of its
+// JSON; a collection by its repository version, so an unchanged list is answered with
+// 304 Not Modified before any of it is serialized.
+
+// Tag a response body by its content.
+std::string makeEntityTag(const std::string& body);
+
+// Tag a state of a collection by its version and the query that selected it. Tags also carry
+// a token picked when the server starts, since versions start again from 0 after a restart.
+std::string makeVersionTag(uint64_t version, const std::string& query);
+
+// Check a comma separated If-Match or If-None-Match header against a tag. "*" matches any tag.
+bool entityTagListMatches(const std::string& headerValue, const std::string& entityTag, bool weakComparison);
+
+// True if the request has an If-None-Match header that names the tag.
+bool isNotModified(const crow::request& req, const std::string& entityTag);
+
+// True if the request has no If-Match header, or the header names the tag of the current
+// body. currentBody is only called when the request has the header.
+bool ifMatchHolds(const crow::request& req, const std::function<std::string()>& currentBody);
+
+// 304 Not Modified carrying the tag.
+crow::response notModified(const std::string& entityTag);
+
+// Tag a successful response by its body, or turn it into 304 if the client has that body.
+crow::response withEntityTag(const crow::request& req, crow::response res);
+
+#endif // ENTITY_TAG_H
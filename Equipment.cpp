@@ -8,6 +8,8 @@
  */
 
 #include "Equipment.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
 
 using namespace crow;
 
@@ -26,7 +28,7 @@ Equipment::Equipment(json::rvalue readValueJson)
  * 
  * @return A JSON object containing the equipment details.
  */
-json::wvalue Equipment::convertToJson()
+json::wvalue Equipment::convertToJson() const
 {
     json::wvalue writeJson;
     writeJson["equipmentId"] = equipmentId;
@@ -37,6 +39,23 @@ json::wvalue Equipment::convertToJson()
     return writeJson;
 }
 
+/**
+ * @brief Writes the Equipment object as JSON, the same text convertToJson().dump() gives.
+ * 
+ * Members are written in the order crow dumps them in, so both paths give the same bytes.
+ * 
+ * @param writer Receives the equipment details.
+ */
+void Equipment::writeJson(JsonWriter& writer) const
+{
+    writer.beginObject();
+    writer.member("available", available);
+    writer.member("description", description);
+    writer.member("name", name);
+    writer.member("equipmentId", equipmentId);
+    writer.endObject();
+}
+
 /**
  * @brief Updates the Equipment object from a JSON representation.
  * 
@@ -49,3 +68,29 @@ void Equipment::updateFromJson(json::rvalue readValueJson)
     description = readValueJson["description"].s();
     available = readValueJson["available"].b();
 }
+
+/**
+ * @brief Writes the Equipment object as a binary snapshot record.
+ * 
+ * @param writer The writer for the record. Fields are written in a fixed order.
+ */
+void Equipment::writeBinaryRecord(BinaryRecordWriter& writer) const
+{
+    writer.writeString(equipmentId);
+    writer.writeString(name);
+    writer.writeString(description);
+    writer.writeBool(available);
+}
+
+/**
+ * @brief Reads the Equipment object from a binary snapshot record.
+ * 
+ * @param reader The reader for the record. Fields are read in the order they were written.
+ */
+void Equipment::readBinaryRecord(BinaryRecordReader& reader)
+{
+    equipmentId = reader.readString();
+    name = reader.readString();
+    description = reader.readString();
+    available = reader.readBool();
+}
@@ -4,6 +4,10 @@
 #include <crow.h>
 #include <string>
 
+class BinaryRecordWriter;
+class BinaryRecordReader;
+class JsonWriter;
+
 class Equipment
 {
 public:
@@ -24,9 +28,14 @@ public:
     void setAvailability(bool availabilityInput) { available = availabilityInput; }
 
     // JSON Methods
-    crow::json::wvalue convertToJson();
+    crow::json::wvalue convertToJson() const;
+    void writeJson(JsonWriter& writer) const;
     void updateFromJson(crow::json::rvalue readValueJson);
 
+    // Binary snapshot methods
+    void writeBinaryRecord(BinaryRecordWriter& writer) const;
+    void readBinaryRecord(BinaryRecordReader& reader);
+
 private:
     std::string equipmentId;
     std::string name;
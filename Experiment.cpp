@@ -8,6 +8,8 @@
  */
 
 #include "Experiment.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
 #include <algorithm> // For std::remove
 
 using namespace std;
@@ -28,7 +30,7 @@ Experiment::Experiment(json::rvalue readValueJson)
  * 
  * @return A JSON object containing the experiment details.
  */
-json::wvalue Experiment::convertToJson()
+json::wvalue Experiment::convertToJson() const
 {
     json::wvalue writeJson;
     writeJson["experimentId"] = experimentId;
@@ -61,6 +63,30 @@ json::wvalue Experiment::convertToJson()
     return writeJson;
 }
 
+/**
+ * @brief Writes the Experiment object as JSON, the same text convertToJson().dump() gives.
+ * 
+ * Members are written in the order crow dumps them in, so both paths give the same bytes.
+ * 
+ * @param writer Receives the experiment details.
+ */
+void Experiment::writeJson(JsonWriter& writer) const
+{
+    writer.beginObject();
+    writer.member("equipmentIds", equipmentIds);
+    writer.member("userIds", userIds);
+    writer.member("approvalStatus", approvalStatus);
+    writer.member("cost", cost);
+    if (writer.key("researchOutput"))
+        researchOutput.writeJson(writer);
+    writer.member("endTime", endTime);
+    writer.member("startTime", startTime);
+    writer.member("description", description);
+    writer.member("title", title);
+    writer.member("experimentId", experimentId);
+    writer.endObject();
+}
+
 /**
  * @brief Updates the Experiment object from a JSON representation.
  * 
@@ -102,3 +128,41 @@ void Experiment::updateFromJson(json::rvalue readValueJson)
         researchOutput.updateFromJson(readValueJson["researchOutput"]); 
     }
 }
+
+/**
+ * @brief Writes the Experiment object as a binary snapshot record.
+ * 
+ * @param writer The writer for the record. Fields are written in a fixed order.
+ */
+void Experiment::writeBinaryRecord(BinaryRecordWriter& writer) const
+{
+    writer.writeString(experimentId);
+    writer.writeString(title);
+    writer.writeString(description);
+    writer.writeString(startTime);
+    writer.writeString(endTime);
+    writer.writeNumber(cost);
+    writer.writeBool(approvalStatus);
+    writer.writeStringList(userIds);
+    writer.writeStringList(equipmentIds);
+    researchOutput.writeBinaryRecord(writer);
+}
+
+/**
+ * @brief Reads the Experiment object from a binary snapshot record.
+ * 
+ * @param reader The reader for the record. Fields are read in the order they were written.
+ */
+void Experiment::readBinaryRecord(BinaryRecordReader& reader)
+{
+    experimentId = reader.readString();
+    title = reader.readString();
+    description = reader.readString();
+    startTime = reader.readString();
+    endTime = reader.readString();
+    cost = reader.readNumber();
+    approvalStatus = reader.readBool();
+    userIds = reader.readStringList();
+    equipmentIds = reader.readStringList();
+    researchOutput.readBinaryRecord(reader);
+}
@@ -37,11 +37,16 @@ public:
     void setResearchOutput(ResearchOutput researchOutputInput) { researchOutput = researchOutputInput; }
 
     // Convert to JSON
-    crow::json::wvalue convertToJson();
+    crow::json::wvalue convertToJson() const;
+    void writeJson(JsonWriter& writer) const;
 
     // Update from JSON
     void updateFromJson(crow::json::rvalue readValueJson);
 
+    // Binary snapshot methods
+    void writeBinaryRecord(BinaryRecordWriter& writer) const;
+    void readBinaryRecord(BinaryRecordReader& reader);
+
 private:
     std::string experimentId;
     std::string title;
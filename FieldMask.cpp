@@ -0,0 +1,140 @@
+/**
+ * @file FieldMask.cpp
+ * @brief Implementation of the FieldMask class.
+ *
+ * This file provides the implementation for the FieldMask class, which reads the fields
+ * parameter of GET requests into a tree of the members to write. Masks are small, so the
+ * members of each level are looked up by a linear search.
+ */
+
+#include "FieldMask.h"
+#include <cctype>
+#include <cstring>
+
+using namespace std;
+
+/**
+ * @brief Whether the mask selects every field.
+ *
+ * @return True if no field was named.
+ */
+bool FieldMask::isEmpty() const
+{
+    return fields.empty();
+}
+
+/**
+ * @brief Reads a fields parameter, e.g. "labId,budget.remainingAmount".
+ *
+ * Names hold letters, digits and underscores. Names no object has are accepted and select
+ * nothing.
+ *
+ * @param text The parameter, or null if the request has none.
+ * @return True if the parameter is absent or valid, false otherwise.
+ */
+bool FieldMask::parse(const char* text)
+{
+    fields.clear();
+    if (text == nullptr)
+        return true;
+
+    string list = text;
+    if (list.empty() || list.size() > maxLength)
+        return false;
+
+    for (size_t start = 0; start <= list.size();)
+    {
+        size_t end = list.find(',', start);
+        if (end == string::npos)
+            end = list.size();
+        string path = list.substr(start, end - start);
+
+        // Every name of the path must be non-empty.
+        if (path.empty() || path.front() == '.' || path.back() == '.' || path.find("..") != string::npos)
+            return false;
+        for (char c : path)
+        {
+            if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '.')
+                return false;
+        }
+
+        add(path);
+        start = end + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Whether the mask selects a member of the objects it applies to.
+ *
+ * @param name The name of the member.
+ * @return True if the member is written.
+ */
+bool FieldMask::selects(const char* name) const
+{
+    return find(name) != nullptr;
+}
+
+/**
+ * @brief Whether the mask selects a member, and which fields of its value are written.
+ *
+ * @param name The name of the member.
+ * @param nestedFields Receives the mask of the member's value, or null when the member is
+ * written whole.
+ * @return True if the member is written.
+ */
+bool FieldMask::select(const char* name, const FieldMask*& nestedFields) const
+{
+    const Field* field = find(name);
+    if (field == nullptr)
+        return false;
+    nestedFields = field->nested.isEmpty() ? nullptr : &field->nested;
+    return true;
+}
+
+/**
+ * @brief Finds a selected member.
+ *
+ * @param name The name of the member.
+ * @return The member, or null if the mask does not select it.
+ */
+const FieldMask::Field* FieldMask::find(const char* name) const
+{
+    for (const Field& field : fields)
+    {
+        if (strcmp(field.name.c_str(), name) == 0)
+            return &field;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Adds a path to the mask. A member named whole stays whole when paths inside it are
+ * added too.
+ *
+ * @param path The path, e.g. "budget.remainingAmount".
+ */
+void FieldMask::add(const string& path)
+{
+    size_t dot = path.find('.');
+    string name = path.substr(0, dot);
+
+    for (Field& field : fields)
+    {
+        if (field.name != name)
+            continue;
+
+        // The member is already written whole, or is from now on.
+        if (field.nested.isEmpty())
+            return;
+        if (dot == string::npos)
+            field.nested.fields.clear();
+        else
+            field.nested.add(path.substr(dot + 1));
+        return;
+    }
+
+    fields.push_back(Field{name, FieldMask()});
+    if (dot != string::npos)
+        fields.back().nested.add(path.substr(dot + 1));
+}
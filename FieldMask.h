@@ -0,0 +1,48 @@
+#ifndef FIELD_MASK_H
+#define FIELD_MASK_H
+
+#include <string>
+#include <vector>
+
+// The fields a request asks for with the fields parameter, e.g.
+// "experimentId,title,researchOutput.numCitations". A name selects a member of the written
+// objects and a dotted path a member of a nested object; a member named without a path is
+// written whole. An empty mask selects every field. A request parses its mask once and
+// JsonWriter consults it while writing, so the fields left out are never serialized.
+class FieldMask
+{
+public:
+    // Getters
+    bool isEmpty() const;
+
+    // Read a fields parameter, returns false if it is not a comma separated list of paths.
+    // Without the parameter, text is null and the mask is empty.
+    bool parse(const char* text);
+
+    // Whether the mask selects a member of the objects it applies to.
+    bool selects(const char* name) const;
+
+    // Whether the mask selects a member, and the mask of the member's value, which is null
+    // when the member is written whole.
+    bool select(const char* name, const FieldMask*& nestedFields) const;
+
+    // The longest fields parameter accepted.
+    static const size_t maxLength = 1024;
+
+private:
+    struct Field;
+
+    const Field* find(const char* name) const;
+    void add(const std::string& path);
+
+    std::vector<Field> fields;
+};
+
+// A selected member and the mask of its value, empty when it is written whole.
+struct FieldMask::Field
+{
+    std::string name;
+    FieldMask nested;
+};
+
+#endif // FIELD_MASK_H
@@ -7,49 +7,111 @@
  */
 
 #include <crow.h>
+#include <cstdio>
+#include <deque>
 #include <fstream>
+#include <future>
+#include <iterator>
 #include "FileHandlingTemplate.h"
+#include "JsonRecordReader.h"
+#include "BinarySnapshot.h"
+#include "DurableFile.h"
+#include "JsonWriter.h"
+#include "RelatedChanges.h"
+#include "ThreadPool.h"
 
 using namespace std;
 using namespace crow;
 
+/**
+ * @brief Saves objects to a file as a JSON array.
+ * 
+ * The data is written to a temporary file which replaceFile syncs and renames over the
+ * target, so a crash part way through never leaves a half written file behind.
+ * 
+ * @tparam T The type of the objects to save.
+ * @param forEachObject Calls its argument with every object to save, in order.
+ * @param filename The name of the file to save the data to.
+ * @return True if the file was written and synced, false otherwise.
+ */
+template <typename T, typename ForEachObject>
+bool saveObjectsToFile(ForEachObject forEachObject, string filename)  
+{
+    string temporaryFilename = filename + ".tmp";
+
+    // Open the temporary file for writing
+    ofstream file(temporaryFilename);
+
+    if (!file.is_open()) 
+        return false;
+
+    // Write each object into a buffer and hand the buffer to the file whenever it fills up,
+    // so saving never holds more than one buffer of JSON text.
+    const size_t flushBytes = 1 << 20;
+    string buffer;
+    JsonWriter writer(buffer);
+    writer.beginList();
+    forEachObject([&](const T& object)
+    {
+        object.writeJson(writer);
+        if (buffer.size() >= flushBytes)
+        {
+            file << buffer;
+            buffer.clear();
+        }
+    });
+    writer.endList();
+
+    // Write the rest of the JSON to the file.
+    file << buffer;
+    file.close();
+    if (file.fail())
+        return false;
+
+    return replaceFile(temporaryFilename, filename);
+}
+
 /**
  * @brief Saves data from a map to a file in JSON format.
  * 
  * @tparam T The type of the objects stored in the map.
  * @param data A map containing data to be saved.
  * @param filename The name of the file to save the data to.
+ * @return True if the file was written and synced, false otherwise.
  */
 template <typename T>
-void saveToFile(map<string, T> data, string filename)  
+bool saveToFile(const map<string, T>& data, string filename)  
 {
-    // Open the file for writing
-    ofstream file(filename);
-
-    if (file.is_open()) 
+    return saveObjectsToFile<T>([&data](auto visit)
     {
-        // Create a new JSON write value to write to the file.
-        json::wvalue jsonWriteValue;
-        
-        // For each object in the map, convert the object to JSON and add to the write value.
-        int index = 0;
-        for (pair<string, T> keyValuePair : data)
-        {
-            // first: gives you access to the first item in the pair.
-            // second: gives you access to the second item in the pair.
-            jsonWriteValue[index] = keyValuePair.second.convertToJson();
-            index++;
-        }
+        for (const pair<const string, T>& keyValuePair : data)
+            visit(keyValuePair.second);
+    }, filename);
+}
 
-        // Write the JSON to the file.
-        file << jsonWriteValue.dump();
-        file.close();
-    }
+/**
+ * @brief Saves a repository to a file in JSON format.
+ * 
+ * @tparam T The type of the objects stored in the repository.
+ * @param data The repository to save.
+ * @param filename The name of the file to save the data to.
+ * @return True if the file was written and synced, false otherwise.
+ */
+template <typename T>
+bool saveToFile(const Repository<T>& data, string filename)  
+{
+    return saveObjectsToFile<T>([&data](auto visit)
+    {
+        data.scan([&visit](const string& id, const T& object) { visit(object); });
+    }, filename);
 }
 
 /**
  * @brief Loads data from a file and populates a map with the deserialized objects.
  * 
+ * The file is streamed one object at a time, so only one chunk of the file and the
+ * object being built are held in memory besides the map itself.
+ * 
  * @tparam T The type of the objects to load into the map.
  * @param filename The name of the file to load the data from.
  * @return A map containing the loaded data.
@@ -60,29 +122,502 @@ map<string, T> loadFromFile(string filename)
     map<string, T> data;
     
     // Open the file for reading.
-    ifstream file(filename);
+    ifstream file(filename, ios::binary);
 
     if (file.is_open()) 
     {      
-        // Create a stream for reading in the file.
-        ostringstream stringStreamJson;
+        // Read the JSON array one object at a time.
+        JsonRecordReader reader(file);
+        string recordText;
 
-        // Read the entire JSON string.
-        stringStreamJson << file.rdbuf();
+        while (reader.next(recordText))
+        {
+            // Load the object's text into a JSON read value.
+            json::rvalue item = json::load(recordText);
+            if (!item)
+            {
+                cerr << "Skipping a malformed record in " << filename << endl;
+                continue;
+            }
 
-        // Load the string into a JSON read value object.
-        json::rvalue jsonReadValue = json::load(stringStreamJson.str());
+            // Convert it to an object, and add it to the data map.
+            T object{item};
+            string id = object.getId();
+            data.insert_or_assign(data.end(), id, std::move(object));
+        }
+
+        if (reader.hasFailed())
+            cerr << "Stopped loading " << filename << " at malformed or truncated JSON." << endl;
 
         // Close the file.
         file.close();
+    }
+    
+    return data;
+}
+
+/**
+ * @brief Saves data from a map to a binary snapshot file.
+ * 
+ * @tparam T The type of the objects stored in the map.
+ * @param data A map containing data to be saved.
+ * @param filename The name of the file to save the data to.
+ * @param collection The name of the collection, checked again when the file is loaded.
+ * @return True if the file was written and synced, false otherwise.
+ */
+template <typename T>
+bool saveToBinarySnapshot(const map<string, T>& data, string filename, string collection)
+{
+    BinarySnapshotWriter writer(collection);
+
+    // The map is ordered by id, so the records are too.
+    for (const pair<const string, T>& keyValuePair : data)
+    {
+        BinaryRecordWriter record = writer.beginRecord();
+        keyValuePair.second.writeBinaryRecord(record);
+    }
+
+    return writer.save(filename);
+}
 
-        // For each item in the JSON, convert it to an object, and add it to the data map.
-        for (json::rvalue item : jsonReadValue) 
+/**
+ * @brief Saves a repository to a binary snapshot file.
+ * 
+ * @tparam T The type of the objects stored in the repository.
+ * @param data The repository to save.
+ * @param filename The name of the file to save the data to.
+ * @param collection The name of the collection, checked again when the file is loaded.
+ * @return True if the file was written and synced, false otherwise.
+ */
+template <typename T>
+bool saveToBinarySnapshot(const Repository<T>& data, string filename, string collection)
+{
+    BinarySnapshotWriter writer(collection);
+
+    // Every backend scans in id order, so the records are in id order too.
+    data.scan([&writer](const string& id, const T& object)
+    {
+        BinaryRecordWriter record = writer.beginRecord();
+        object.writeBinaryRecord(record);
+    });
+
+    return writer.save(filename);
+}
+
+/**
+ * @brief Loads data from a binary snapshot file into a map.
+ * 
+ * The file is mapped into memory and each record is read straight into an object, without
+ * any text parsing.
+ * 
+ * @tparam T The type of the objects to load into the map.
+ * @param filename The name of the file to load the data from.
+ * @param collection The name of the collection the file must hold.
+ * @param data Receives the loaded data.
+ * @return True if the file was loaded, false if it is missing, invalid or from another layout.
+ */
+template <typename T>
+bool loadFromBinarySnapshot(string filename, string collection, map<string, T>& data)
+{
+    BinarySnapshotFile snapshot;
+    if (!snapshot.open(filename, collection))
+        return false;
+
+    map<string, T> loaded;
+    try
+    {
+        for (uint64_t index = 0; index < snapshot.size(); index++)
         {
-            T object{item};
-            data[object.getId()] = object;
+            BinaryRecordReader record = snapshot.record(index);
+            T object;
+            object.readBinaryRecord(record);
+
+            // A record that does not fill its slots was written with another layout.
+            if (record.getSlotsRead() != snapshot.getSlotsPerRecord())
+                return false;
+
+            string id = object.getId();
+            loaded.insert_or_assign(loaded.end(), id, std::move(object));
         }
     }
-    
+    catch (runtime_error& exception)
+    {
+        cerr << "Can't read " << filename << ": " << exception.what() << endl;
+        return false;
+    }
+
+    data = std::move(loaded);
+    return true;
+}
+
+/**
+ * @brief Loads a resource collection from its binary snapshot, or from its JSON file.
+ * 
+ * The binary snapshot <collection>.lfb is used unless <collection>.json is newer, so a JSON
+ * file copied in to import data still takes effect.
+ * 
+ * @tparam T The type of the objects to load into the map.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @return A map containing the loaded data.
+ */
+template <typename T>
+map<string, T> loadCollection(string collection)
+{
+    map<string, T> data;
+    string snapshotFilename = collection + ".lfb";
+    string jsonFilename = collection + ".json";
+
+    if (BinarySnapshotFile::isCurrent(snapshotFilename, jsonFilename) && loadFromBinarySnapshot<T>(snapshotFilename, collection, data))
+        return data;
+
+    return loadFromFile<T>(jsonFilename);
+}
+
+/**
+ * @brief Loads data from a file, parsing chunks of records in parallel.
+ * 
+ * The calling thread streams the file and hands each chunk of record text to the pool. The
+ * parsed chunks are merged in file order, so a later record still replaces an earlier one
+ * with the same id. Only a few chunks per pool thread are in flight at a time.
+ * 
+ * @tparam T The type of the objects to load into the map.
+ * @param filename The name of the file to load the data from.
+ * @param pool The pool that parses the chunks.
+ * @param chunkRecords The number of records in each chunk.
+ * @return A map containing the loaded data.
+ */
+template <typename T>
+map<string, T> loadFromFileInParallel(string filename, ThreadPool& pool, size_t chunkRecords)
+{
+    map<string, T> data;
+    ifstream file(filename, ios::binary);
+    if (!file.is_open())
+        return data;
+
+    deque<future<vector<T>>> chunks;
+    size_t maximumChunksInFlight = 4 * pool.getThreadCount();
+
+    // Merge the oldest parsed chunk into the map.
+    auto mergeOldestChunk = [&]()
+    {
+        vector<T> objects = pool.wait(chunks.front());
+        chunks.pop_front();
+        for (T& object : objects)
+        {
+            string id = object.getId();
+            data.insert_or_assign(id, std::move(object));
+        }
+    };
+
+    // Hand a chunk of record text to the pool.
+    auto submitChunk = [&](vector<string>& texts)
+    {
+        chunks.push_back(pool.submit([texts = std::move(texts), filename]()
+        {
+            vector<T> objects;
+            objects.reserve(texts.size());
+            for (const string& text : texts)
+            {
+                json::rvalue item = json::load(text);
+                if (!item)
+                {
+                    cerr << "Skipping a malformed record in " << filename << endl;
+                    continue;
+                }
+                objects.emplace_back(item);
+            }
+            return objects;
+        }));
+        texts = vector<string>();
+
+        if (chunks.size() > maximumChunksInFlight)
+            mergeOldestChunk();
+    };
+
+    JsonRecordReader reader(file);
+    vector<string> texts;
+    string recordText;
+    while (reader.next(recordText))
+    {
+        texts.push_back(std::move(recordText));
+        if (texts.size() >= chunkRecords)
+            submitChunk(texts);
+    }
+    if (!texts.empty())
+        submitChunk(texts);
+
+    if (reader.hasFailed())
+        cerr << "Stopped loading " << filename << " at malformed or truncated JSON." << endl;
+
+    while (!chunks.empty())
+        mergeOldestChunk();
+
     return data;
 }
+
+/**
+ * @brief Loads data from a binary snapshot file, reading ranges of records in parallel.
+ * 
+ * @tparam T The type of the objects to load into the map.
+ * @param filename The name of the file to load the data from.
+ * @param collection The name of the collection the file must hold.
+ * @param data Receives the loaded data.
+ * @param pool The pool that reads the ranges.
+ * @param chunkRecords The number of records in each range.
+ * @return True if the file was loaded, false if it is missing, invalid or from another layout.
+ */
+template <typename T>
+bool loadFromBinarySnapshotInParallel(string filename, string collection, map<string, T>& data, ThreadPool& pool, size_t chunkRecords)
+{
+    BinarySnapshotFile snapshot;
+    if (!snapshot.open(filename, collection))
+        return false;
+
+    // Each range is read into its own vector by one pool task.
+    vector<future<vector<T>>> chunks;
+    for (uint64_t begin = 0; begin < snapshot.size(); begin += chunkRecords)
+    {
+        uint64_t end = min<uint64_t>(begin + chunkRecords, snapshot.size());
+        chunks.push_back(pool.submit([&snapshot, begin, end]()
+        {
+            vector<T> objects(end - begin);
+            for (uint64_t index = begin; index < end; index++)
+            {
+                BinaryRecordReader record = snapshot.record(index);
+                objects[index - begin].readBinaryRecord(record);
+
+                // A record that does not fill its slots was written with another layout.
+                if (record.getSlotsRead() != snapshot.getSlotsPerRecord())
+                    throw runtime_error("Binary snapshot record layout does not match");
+            }
+            return objects;
+        }));
+    }
+
+    // Records are in id order, so each one goes at the end of the map. Every range is waited
+    // for even after a failure, because they all read from the mapping.
+    map<string, T> loaded;
+    bool valid = true;
+    for (future<vector<T>>& chunk : chunks)
+    {
+        try
+        {
+            vector<T> objects = pool.wait(chunk);
+            for (T& object : objects)
+            {
+                string id = object.getId();
+                loaded.insert_or_assign(loaded.end(), id, std::move(object));
+            }
+        }
+        catch (runtime_error& exception)
+        {
+            if (valid)
+                cerr << "Can't read " << filename << ": " << exception.what() << endl;
+            valid = false;
+        }
+    }
+
+    if (valid)
+        data = std::move(loaded);
+    return valid;
+}
+
+/**
+ * @brief Loads a resource collection like loadCollection, parsing chunks of it in parallel.
+ * 
+ * Not for administrators, which change the labs repository while they are built.
+ * 
+ * @tparam T The type of the objects to load into the map.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param pool The pool that parses the chunks.
+ * @param filename Receives the name of the file the collection was loaded from.
+ * @return A map containing the loaded data.
+ */
+template <typename T>
+map<string, T> loadCollectionInParallel(string collection, ThreadPool& pool, string& filename)
+{
+    map<string, T> data;
+    string snapshotFilename = collection + ".lfb";
+    string jsonFilename = collection + ".json";
+
+    filename = snapshotFilename;
+    if (BinarySnapshotFile::isCurrent(snapshotFilename, jsonFilename) && loadFromBinarySnapshotInParallel<T>(snapshotFilename, collection, data, pool, 16384))
+        return data;
+
+    filename = jsonFilename;
+    return loadFromFileInParallel<T>(jsonFilename, pool, 4096);
+}
+
+/**
+ * @brief Applies one write-ahead log record to a repository loaded from a file.
+ * 
+ * @tparam T The type of the objects stored in the repository.
+ * @param data The repository to apply the change to.
+ * @param record The logged change. Put records hold the whole object as JSON.
+ */
+template <typename T>
+void replayLogRecord(Repository<T>& data, const LogRecord& record)
+{
+    if (record.operation == LogOperation::Delete)
+    {
+        data.erase(record.id);
+        return;
+    }
+
+    // Rebuild the object from its logged JSON and put it back into the repository.
+    json::rvalue readValueJson = json::load(record.payload);
+    if (!readValueJson)
+        return;
+
+    T object{readValueJson};
+    data.put(record.id, object);
+}
+
+/**
+ * @brief Turns the tracked changes of one collection into log records holding their
+ * current state, one record per changed or deleted id.
+ * 
+ * Only the changed objects are serialized, so the cost follows the number of changes and
+ * not the size of the collection.
+ * 
+ * @tparam T The type of the objects stored in the repository.
+ * @param data The collection the changes were made to.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param changes The ids changed and deleted since the last flush.
+ * @param records Receives the records.
+ */
+template <typename T>
+void collectChanges(const Repository<T>& data, string collection, const CollectionChanges& changes, vector<LogRecord>& records)
+{
+    for (const string& id : changes.changed)
+    {
+        // Skip ids that are no longer in the repository.
+        T object;
+        if (data.get(id, object))
+            records.push_back({collection, LogOperation::Put, id, toJsonString(object)});
+    }
+
+    for (const string& id : changes.deleted)
+        records.push_back({collection, LogOperation::Delete, id, ""});
+}
+
+/**
+ * @brief Imports newline-delimited JSON, one object per line, into a repository.
+ * 
+ * Lines are parsed one at a time and the objects are stored in batches of batchRecords.
+ * Each batch is stored and logged under one mutation lock and made durable by one wait for
+ * the log, so an import costs a fraction of the requests it replaces while memory holds a
+ * batch. Objects replace those with the same id. A line that is not a valid object is
+ * skipped and reported; the lines around it are still imported. Blank lines are ignored.
+ * A batch is logged before it is stored, and the import stops, with logFailed set, at the
+ * first batch the log can't record, so the repository never holds what the log doesn't.
+ * Objects that change other collections, as administrators change the lab they manage,
+ * make those changes as a create would, logged in their batch and stored with it.
+ * 
+ * @tparam T The type of the objects stored in the repository.
+ * @param body The text to import.
+ * @param data The repository to store the objects in.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param log The write-ahead log the changes are recorded in.
+ * @param tracker Tracks the changed ids for the next delta snapshot.
+ * @param batchRecords The number of objects stored together.
+ * @return The number of objects imported and the lines that were not.
+ */
+template <typename T>
+ImportReport importFromNdjson(const string& body, Repository<T>& data, string collection, WriteAheadLog& log, ChangeTracker& tracker, size_t batchRecords)
+{
+    ImportReport report;
+    vector<T> objects;
+    vector<LogRecord> records;
+    RelatedChanges<T> related;
+
+    auto fail = [&report](size_t line, string reason) {
+        report.failed++;
+        if (report.errors.size() < ImportReport::maxErrors)
+            report.errors.push_back({line, reason});
+    };
+
+    // Log and store a batch as one change, as a create handler does for one object.
+    auto commit = [&]() {
+        shared_lock<shared_mutex> mutationLock = log.lockForMutation();
+        vector<string> ids;
+        ids.reserve(objects.size());
+        for (const T& object : objects)
+            ids.push_back(object.getId());
+        vector<unique_lock<mutex>> objectLocks = data.lockObjects(ids);
+        vector<unique_lock<mutex>> relatedLocks = related.lock();
+
+        // The changes the batch makes to other collections go ahead of it in the same append.
+        vector<LogRecord> relatedRecords;
+        related.collect(relatedRecords);
+        records.insert(records.begin(), make_move_iterator(relatedRecords.begin()), make_move_iterator(relatedRecords.end()));
+        try
+        {
+            log.append(records);
+        }
+        catch (runtime_error& exception)
+        {
+            report.logFailed = true;
+            return;
+        }
+        for (const T& object : objects)
+            data.put(object.getId(), object);
+        for (const string& id : ids)
+            tracker.markChanged(collection, id);
+        related.store(tracker);
+        report.imported += objects.size();
+        objects.clear();
+        records.clear();
+    };
+
+    size_t line = 0;
+    for (size_t start = 0; start < body.size(); start++)
+    {
+        size_t end = body.find('\n', start);
+        if (end == string::npos)
+            end = body.size();
+        line++;
+
+        // A line may end in \r\n, which the parser skips as whitespace.
+        size_t lineStart = start;
+        start = end;
+        if (body.find_first_not_of(" \t\r", lineStart) >= end)
+            continue;
+
+        json::rvalue readValueJson = json::load(body.data() + lineStart, end - lineStart);
+        if (!readValueJson || readValueJson.t() != json::type::Object)
+        {
+            fail(line, "Invalid JSON");
+            continue;
+        }
+
+        try
+        {
+            T object{readValueJson};
+            if (object.getId().empty())
+            {
+                fail(line, "Missing id");
+                continue;
+            }
+            related.add(readValueJson);
+            records.push_back({collection, LogOperation::Put, object.getId(), toJsonString(object)});
+            objects.push_back(std::move(object));
+        }
+        catch (runtime_error& exception)
+        {
+            fail(line, exception.what());
+            continue;
+        }
+
+        if (objects.size() >= batchRecords)
+        {
+            commit();
+            if (report.logFailed)
+                return report;
+        }
+    }
+
+    if (!objects.empty())
+        commit();
+    return report;
+}
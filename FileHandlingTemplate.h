@@ -3,13 +3,65 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include "ChangeTracker.h"
+#include "Repository.h"
+#include "WriteAheadLog.h"
+
+class ThreadPool;
+
+// The outcome of an import: how many records were stored, and the line and reason of the
+// first records that were not. An import stops at the first batch the log can't record.
+struct ImportReport
+{
+    size_t imported = 0;
+    size_t failed = 0;
+    std::vector<std::pair<size_t, std::string>> errors;
+    bool logFailed = false;
+
+    // The most errors a report lists, so a file of bad lines can't grow it without bound.
+    static const size_t maxErrors = 100;
+};
 
 template <typename T>
-void saveToFile(std::map<std::string, T> data, std::string filename);
+bool saveToFile(const std::map<std::string, T>& data, std::string filename);
+
+template <typename T>
+bool saveToFile(const Repository<T>& data, std::string filename);
 
 template <typename T>
 std::map<std::string, T> loadFromFile(std::string filename);
 
+template <typename T>
+bool saveToBinarySnapshot(const std::map<std::string, T>& data, std::string filename, std::string collection);
+
+template <typename T>
+bool saveToBinarySnapshot(const Repository<T>& data, std::string filename, std::string collection);
+
+template <typename T>
+bool loadFromBinarySnapshot(std::string filename, std::string collection, std::map<std::string, T>& data);
+
+template <typename T>
+std::map<std::string, T> loadCollection(std::string collection);
+
+template <typename T>
+std::map<std::string, T> loadFromFileInParallel(std::string filename, ThreadPool& pool, size_t chunkRecords);
+
+template <typename T>
+bool loadFromBinarySnapshotInParallel(std::string filename, std::string collection, std::map<std::string, T>& data, ThreadPool& pool, size_t chunkRecords);
+
+template <typename T>
+std::map<std::string, T> loadCollectionInParallel(std::string collection, ThreadPool& pool, std::string& filename);
+
+template <typename T>
+void replayLogRecord(Repository<T>& data, const LogRecord& record);
+
+template <typename T>
+void collectChanges(const Repository<T>& data, std::string collection, const CollectionChanges& changes, std::vector<LogRecord>& records);
+
+template <typename T>
+ImportReport importFromNdjson(const std::string& body, Repository<T>& data, std::string collection, WriteAheadLog& log, ChangeTracker& tracker, size_t batchRecords);
+
 #include "FileHandlingTemplate.cpp"
 
 #endif // FILE_HANDLING_TEMPLATE_H
\ No newline at end of file
@@ -0,0 +1,368 @@
+/**
+ * @file FullTextIndex.cpp
+ * @brief Implementation of the FullTextIndex class.
+ *
+ * This file provides the implementation for the FullTextIndex class, which ranks texts by
+ * Okapi BM25. Each word maps to the sorted numbers of the texts holding it and how often each
+ * holds it. A query reads the lists of its words side by side, one text at a time, with the
+ * MaxScore method: the words are ordered by the most they can add to a score, and once the
+ * heap of the best texts is full, the lists whose words together can't beat its worst text
+ * are no longer read through, only looked up for the texts the others offer.
+ */
+
+#include "FullTextIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+using namespace std;
+
+namespace
+{
+    // Whether a byte is part of a word.
+    bool isWordByte(unsigned char c)
+    {
+        return isalnum(c) || c >= 0x80;
+    }
+}
+
+/**
+ * @brief Gets the number of texts indexed.
+ *
+ * @return The number of ids.
+ */
+size_t FullTextIndex::size() const
+{
+    shared_lock<shared_mutex> reading(indexMutex);
+    return texts.size();
+}
+
+/**
+ * @brief Estimates the memory the index takes: the posting lists, the words, the ids and the
+ * hash tables' nodes and buckets.
+ *
+ * @return The size in bytes.
+ */
+size_t FullTextIndex::memoryBytes() const
+{
+    shared_lock<shared_mutex> reading(indexMutex);
+    const size_t nodeBytes = 2 * sizeof(void*);
+
+    size_t bytes = sizeof(*this) + texts.memoryBytes();
+    bytes += terms.bucket_count() * sizeof(void*);
+    for (const pair<const string, Term>& term : terms)
+        bytes += sizeof(term) + nodeBytes + stringHeapBytes(term.first) + term.second.postings.capacity() * sizeof(Posting);
+
+    bytes += lengths.capacity() * sizeof(uint32_t) + numberedTerms.capacity() * sizeof(vector<Term*>);
+    for (const vector<Term*>& textTerms : numberedTerms)
+        bytes += textTerms.capacity() * sizeof(Term*);
+    return bytes;
+}
+
+/**
+ * @brief Indexes the text of an id, replacing the text it had.
+ *
+ * @param id The id.
+ * @param text The text.
+ */
+void FullTextIndex::add(const string& id, const string& text)
+{
+    vector<string> textWords = words(text);
+    uint32_t length = textWords.size();
+    sort(textWords.begin(), textWords.end());
+
+    unique_lock<shared_mutex> writing(indexMutex);
+    uint32_t number;
+    if (texts.find(id, number))
+        removeNumber(number);
+
+    number = texts.add(id);
+    lengths.push_back(length);
+    numberedTerms.emplace_back();
+    totalLength += length;
+
+    // The words are sorted, so each run of one word is counted once.
+    for (size_t i = 0; i < textWords.size();)
+    {
+        size_t end = i + 1;
+        while (end < textWords.size() && textWords[end] == textWords[i])
+            end++;
+
+        Term& term = terms[textWords[i]];
+        term.postings.push_back(Posting{number, static_cast<uint32_t>(end - i)});
+        term.textCount++;
+        numberedTerms.back().push_back(&term);
+        i = end;
+    }
+    compact();
+}
+
+/**
+ * @brief Removes the text of an id.
+ *
+ * @param id The id.
+ */
+void FullTextIndex::remove(const string& id)
+{
+    unique_lock<shared_mutex> writing(indexMutex);
+    uint32_t number;
+    if (!texts.find(id, number))
+        return;
+
+    removeNumber(number);
+    texts.remove(id);
+    compact();
+}
+
+/**
+ * @brief Removes every text.
+ */
+void FullTextIndex::clear()
+{
+    unique_lock<shared_mutex> writing(indexMutex);
+    terms.clear();
+    texts.clear();
+    lengths.clear();
+    numberedTerms.clear();
+    totalLength = 0;
+}
+
+/**
+ * @brief Ranks the texts by their BM25 score for a query.
+ *
+ * A word adds idf * f * (k1 + 1) / (f + k1 * (1 - b + b * length / average length)) to the
+ * score of a text holding it f times, where idf = ln(1 + (N - n + 0.5) / (n + 0.5)) for N
+ * texts of which n hold it. A word repeated in the query counts once. A text's score is
+ * always summed in the same order of the words, so it is the same on every page.
+ *
+ * @param query The words to look for.
+ * @param count The most texts to return.
+ * @param after The text the previous page ended with, or null for the first page.
+ * @return The best texts holding at least one of the words, best first.
+ */
+vector<RankedId> FullTextIndex::rank(const string& query, size_t count, const RankedId* after) const
+{
+    vector<string> queryWords = words(query);
+    sort(queryWords.begin(), queryWords.end());
+    queryWords.erase(unique(queryWords.begin(), queryWords.end()), queryWords.end());
+
+    shared_lock<shared_mutex> reading(indexMutex);
+    if (count == 0 || texts.empty())
+        return {};
+
+    // The lists of the words, each with its idf and the most it adds to a score.
+    struct Cursor
+    {
+        const vector<Posting>* postings;
+        size_t next;
+        double idf;
+        double maxScore;
+    };
+    vector<Cursor> cursors;
+    double textCount = texts.size();
+    double averageLength = max(1.0, static_cast<double>(totalLength) / textCount);
+    for (const string& word : queryWords)
+    {
+        unordered_map<string, Term>::const_iterator found = terms.find(word);
+        if (found == terms.end() || found->second.textCount == 0)
+            continue;
+        double holding = found->second.textCount;
+        double idf = log(1 + (textCount - holding + 0.5) / (holding + 0.5));
+        cursors.push_back(Cursor{&found->second.postings, 0, idf, idf * (k1 + 1)});
+    }
+    sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) { return a.maxScore < b.maxScore; });
+
+    // boundBelow[i] is the most the words before i can add together.
+    vector<double> boundBelow(cursors.size() + 1, 0);
+    for (size_t i = 0; i < cursors.size(); i++)
+        boundBelow[i + 1] = boundBelow[i] + cursors[i].maxScore;
+
+    // The heap keeps the worst of the best texts on top. Texts rank by score, then id.
+    auto ranksBefore = [this](const pair<double, uint32_t>& a, const pair<double, uint32_t>& b) {
+        return a.first != b.first ? a.first > b.first : texts.idOf(a.second) < texts.idOf(b.second);
+    };
+    vector<pair<double, uint32_t>> best;
+    best.reserve(count + 1);
+
+    // Rounding can make a score summed in another order a little off, so bounds leave a margin.
+    const double margin = 1e-9;
+    double threshold = -numeric_limits<double>::infinity();
+    size_t firstEssential = 0;
+    vector<double> contributions(cursors.size());
+
+    while (true)
+    {
+        while (firstEssential < cursors.size() && boundBelow[firstEssential + 1] * (1 + margin) < threshold)
+            firstEssential++;
+
+        // The next text one of the essential lists holds.
+        uint32_t number = UINT32_MAX;
+        for (size_t i = firstEssential; i < cursors.size(); i++)
+        {
+            if (cursors[i].next < cursors[i].postings->size())
+                number = min(number, (*cursors[i].postings)[cursors[i].next].number);
+        }
+        if (number == UINT32_MAX)
+            break;
+
+        double norm = k1 * (1 - b + b * lengths[number] / averageLength);
+        double partial = 0;
+        fill(contributions.begin(), contributions.end(), 0);
+        for (size_t i = firstEssential; i < cursors.size(); i++)
+        {
+            Cursor& cursor = cursors[i];
+            if (cursor.next < cursor.postings->size() && (*cursor.postings)[cursor.next].number == number)
+            {
+                double frequency = (*cursor.postings)[cursor.next].frequency;
+                contributions[i] = cursor.idf * frequency * (k1 + 1) / (frequency + norm);
+                partial += contributions[i];
+                cursor.next++;
+            }
+        }
+        if (texts.isRemoved(number))
+            continue;
+
+        // Look the text up in the other lists, from the one adding most, while it may still
+        // make the heap.
+        bool reachable = true;
+        for (size_t i = firstEssential; i-- > 0;)
+        {
+            if ((partial + boundBelow[i + 1]) * (1 + margin) < threshold)
+            {
+                reachable = false;
+                break;
+            }
+            Cursor& cursor = cursors[i];
+            vector<Posting>::const_iterator position = lower_bound(cursor.postings->begin() + cursor.next, cursor.postings->end(), number,
+                [](const Posting& posting, uint32_t value) { return posting.number < value; });
+            cursor.next = position - cursor.postings->begin();
+            if (position != cursor.postings->end() && position->number == number)
+            {
+                double frequency = position->frequency;
+                contributions[i] = cursor.idf * frequency * (k1 + 1) / (frequency + norm);
+                partial += contributions[i];
+                cursor.next++;
+            }
+        }
+        if (!reachable)
+            continue;
+
+        // Sum in the same order for every text.
+        double score = 0;
+        for (double contribution : contributions)
+            score += contribution;
+
+        pair<double, uint32_t> candidate(score, number);
+        if (after && (score > after->score || (score == after->score && texts.idOf(number) <= after->id)))
+            continue;
+        if (best.size() == count && !ranksBefore(candidate, best.front()))
+            continue;
+
+        best.push_back(candidate);
+        push_heap(best.begin(), best.end(), ranksBefore);
+        if (best.size() > count)
+        {
+            pop_heap(best.begin(), best.end(), ranksBefore);
+            best.pop_back();
+        }
+        if (best.size() == count)
+            threshold = best.front().first;
+    }
+
+    sort_heap(best.begin(), best.end(), ranksBefore);
+    vector<RankedId> ranked;
+    ranked.reserve(best.size());
+    for (const pair<double, uint32_t>& result : best)
+        ranked.push_back(RankedId{result.first, texts.idOf(result.second)});
+    return ranked;
+}
+
+/**
+ * @brief Splits a text into words: runs of letters, digits and bytes outside ASCII.
+ *
+ * @param text The text.
+ * @return The words, lowercased, in the order they are in the text.
+ */
+vector<string> FullTextIndex::words(const string& text)
+{
+    vector<string> textWords;
+    for (size_t i = 0; i < text.size();)
+    {
+        if (!isWordByte(static_cast<unsigned char>(text[i])))
+        {
+            i++;
+            continue;
+        }
+
+        string word;
+        for (; i < text.size() && isWordByte(static_cast<unsigned char>(text[i])); i++)
+            word.push_back(static_cast<char>(tolower(static_cast<unsigned char>(text[i]))));
+        textWords.push_back(std::move(word));
+    }
+    return textWords;
+}
+
+/**
+ * @brief Names the order of a query's ranking by an FNV-1a hash of its words, so queries that
+ * differ only in case or punctuation share their cursors.
+ *
+ * @param query The words to look for.
+ * @return The order, e.g. "rank:5e3b1f0c2a7d9e41".
+ */
+string FullTextIndex::rankOrder(const string& query)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const string& word : words(query))
+    {
+        for (unsigned char c : word + " ")
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    static const char digits[] = "0123456789abcdef";
+    string order = "rank:";
+    for (int shift = 60; shift >= 0; shift -= 4)
+        order.push_back(digits[(hash >> shift) & 0xf]);
+    return order;
+}
+
+/**
+ * @brief Takes the words and length of a text out of the totals, before its number goes out
+ * of use. Its postings stay until the lists are compacted.
+ *
+ * @param number The number of the text.
+ */
+void FullTextIndex::removeNumber(uint32_t number)
+{
+    for (Term* term : numberedTerms[number])
+        term->textCount--;
+    vector<Term*>().swap(numberedTerms[number]);
+    totalLength -= lengths[number];
+}
+
+/**
+ * @brief Drops the numbers no longer in use from the posting lists, and the words no text
+ * holds any more, once the unused numbers outnumber the texts.
+ */
+void FullTextIndex::compact()
+{
+    vector<uint32_t> renumbered;
+    if (!texts.renumber(renumbered))
+        return;
+    PostingNumbers::keepRenumbered(lengths, renumbered);
+    PostingNumbers::keepRenumbered(numberedTerms, renumbered);
+
+    // Words no text holds are no longer pointed at, so erasing them is safe.
+    for (unordered_map<string, Term>::iterator term = terms.begin(); term != terms.end();)
+    {
+        PostingNumbers::renumberList(term->second.postings, renumbered, [](Posting& posting) -> uint32_t& { return posting.number; });
+        if (term->second.postings.empty())
+            term = terms.erase(term);
+        else
+            ++term;
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef FULL_TEXT_INDEX_H
+#define FULL_TEXT_INDEX_H
+
+#include <crow.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "JsonWriter.h"
+#include "Pagination.h"
+#include "PostingNumbers.h"
+#include "Repository.h"
+
+// One result of a ranked search: the id of a text and how relevant it is to the query.
+struct RankedId
+{
+    double score = 0;
+    std::string id;
+};
+
+// An inverted index of the words of one text per id, ranking texts by how well they answer a
+// query with Okapi BM25. Words are runs of letters and digits, compared without case; bytes
+// outside ASCII are kept as part of the word they are in.
+//
+// Only the best texts are kept while the posting lists are read, in a heap of the size asked
+// for, and lists whose words can no longer lift a text into it are only looked up for the
+// texts the other lists offer. Texts are numbered by PostingNumbers, as in TrigramIndex.
+class FullTextIndex
+{
+public:
+    // Getters
+    size_t size() const;
+    size_t memoryBytes() const;
+
+    // Changes. add replaces the text of an id that is already indexed.
+    void add(const std::string& id, const std::string& text);
+    void remove(const std::string& id);
+    void clear();
+
+    // The count best texts for a query, best first. Texts with the same score are in id
+    // order. With after, only the texts ranked after it are considered, so a list can be read
+    // a page at a time.
+    std::vector<RankedId> rank(const std::string& query, size_t count, const RankedId* after = nullptr) const;
+
+    // The words of a text, lowercased, in order.
+    static std::vector<std::string> words(const std::string& text);
+
+    // The order the cursors of a query's ranking are made for, "rank:" and a hash of its
+    // words, so a cursor only continues the query it came from.
+    static std::string rankOrder(const std::string& query);
+
+    // The BM25 parameters: how fast repeating a word stops counting, and how much a long text
+    // is marked down.
+    static constexpr double k1 = 1.2;
+    static constexpr double b = 0.75;
+
+private:
+    struct Posting
+    {
+        uint32_t number;
+        uint32_t frequency;
+    };
+
+    struct Term
+    {
+        std::vector<Posting> postings;
+        uint32_t textCount = 0; // The texts in use holding the word.
+    };
+
+    void removeNumber(uint32_t number);
+    void compact();
+
+    mutable std::shared_mutex indexMutex;
+    std::unordered_map<std::string, Term> terms;
+    PostingNumbers texts;
+    std::vector<uint32_t> lengths;
+    std::vector<std::vector<Term*>> numberedTerms;
+    uint64_t totalLength = 0;
+};
+
+// Ranks the objects of a repository by one text made of their searched fields, e.g. the
+// title and description of experiments.
+template <typename T>
+class RankedTextIndex : public RepositoryIndex<T>
+{
+public:
+    // Constructors
+    RankedTextIndex(std::function<std::string(const T&)> textInput) : text(textInput) {}
+
+    // Getters
+    const FullTextIndex& getFullText() const { return fullText; }
+    size_t memoryBytes() const override { return fullText.memoryBytes(); }
+
+    // Changes
+    void put(const std::string& id, const T& object) override { fullText.add(id, text(object)); }
+    void erase(const std::string& id) override { fullText.remove(id); }
+    void clear() override { fullText.clear(); }
+
+private:
+    std::function<std::string(const T&)> text;
+    FullTextIndex fullText;
+};
+
+// The page size of ranked searches that don't ask for one.
+const size_t defaultRankedLimit = 10;
+
+/**
+ * @brief Responds with the objects of a repository that best answer a query, best first.
+ *
+ * The ranking comes from the RankedTextIndex of the repository registered under indexName.
+ * Without one, the collection is indexed for the request. Only the objects of the page are
+ * serialized. A page with more objects after it names the cursor of the next page in its
+ * X-Next-Cursor header, which holds the score and id of its last object and the words of the
+ * query it ranks, hashed, as its order.
+ *
+ * @tparam T The type of the ranked objects.
+ * @param repository The searched collection.
+ * @param indexName The name the RankedTextIndex was added under.
+ * @param text The text of an object, the same the index is built from.
+ * @param query The words to look for.
+ * @param page The page the request asks for. Without a limit, defaultRankedLimit objects are sent.
+ * @return The response with the page, or 400 Bad Request if the query has no words or the
+ * cursor is not from a ranked search for the same words.
+ */
+template <typename T>
+crow::response rankedPageResponse(const Repository<T>& repository, const std::string& indexName, std::function<std::string(const T&)> text, const std::string& query, const PageRequest& page)
+{
+    if (FullTextIndex::words(query).empty())
+        return crow::response(400, "Invalid query");
+    std::string order = FullTextIndex::rankOrder(query);
+    if (!page.fits(order))
+        return crow::response(400, "Invalid cursor");
+
+    RankedId after;
+    if (page.hasCursor())
+        after = RankedId{page.getCursorPosition().key.number, page.getCursorPosition().id};
+    size_t limit = page.getLimit() > 0 ? page.getLimit() : defaultRankedLimit;
+
+    // One more than the page is ranked, to know whether there is a next page.
+    std::vector<RankedId> ranked;
+    std::shared_ptr<RankedTextIndex<T>> index = repository.template getIndex<RankedTextIndex<T>>(indexName);
+    if (index)
+        ranked = index->getFullText().rank(query, limit + 1, page.hasCursor() ? &after : nullptr);
+    else
+    {
+        FullTextIndex fullText;
+        repository.scan([&fullText, &text](const std::string& id, const T& object) { fullText.add(id, text(object)); });
+        ranked = fullText.rank(query, limit + 1, page.hasCursor() ? &after : nullptr);
+    }
+
+    bool more = ranked.size() > limit;
+    if (more)
+        ranked.resize(limit);
+
+    std::string body;
+    JsonWriter writer(body, &page.getFields());
+    writer.beginList();
+    std::string json;
+    T object;
+    for (const RankedId& result : ranked)
+    {
+        if (page.getFields().isEmpty() && repository.getJson(result.id, json))
+            writer.rawValue(json);
+        else if (!page.getFields().isEmpty() && repository.get(result.id, object))
+            object.writeJson(writer);
+    }
+    writer.endList();
+
+    crow::response res(body);
+    if (more)
+        res.set_header("X-Next-Cursor", PageRequest::makeCursor(order, SortedId{SortKey{ranked.back().score, ""}, ranked.back().id}));
+    return res;
+}
+
+#endif // FULL_TEXT_INDEX_H
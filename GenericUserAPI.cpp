@@ -14,109 +14,122 @@
 #include "Student.h"
 #include "Lab.h"
 #include "labFunctions.h"
-#include <regex>
+#include "WriteAheadLog.h"
+#include "ChangeTracker.h"
+#include "RelatedChanges.h"
+#include "Repository.h"
+#include "EntityTag.h"
+#include "JsonWriter.h"
+#include "Pagination.h"
+#include "SearchPattern.h"
+#include "TrigramIndex.h"
+#include "SortedIndex.h"
 
 using namespace std;
 using namespace crow;
 
 template<typename T> 
-map<string, T> GenericUserAPI<T>::resourceMap;
-extern std::map<std::string, Lab> labsMap;
+Repository<T> GenericUserAPI<T>::repository;
+extern WriteAheadLog writeAheadLog;
+extern ChangeTracker changeTracker;
+
+// Names under which each resource type is recorded in the write-ahead log.
+template<> const string GenericUserAPI<Professor>::collectionName = "professors";
+template<> const string GenericUserAPI<Student>::collectionName = "students";
+template<> const string GenericUserAPI<Administrator>::collectionName = "administrators";
 
 /**
  * @brief Searches for resources by name.
  *
  * @tparam T The type of the resource.
  * @param searchString A string pattern to search for in resource names.
+ * @param page The page of the matching resources to send, in id order.
  * @return A JSON response containing matching resources.
  */
 template<typename T>
-response GenericUserAPI<T>::searchUsers(string searchString)
+response GenericUserAPI<T>::searchUsers(string searchString, const PageRequest& page)
 {
-    vector<T> found;
-    for(pair<string, T> resourcePair : resourceMap)
-    {
-        string target = resourcePair.second.getName();
-        regex pattern(searchString, regex_constants::icase);
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
 
-        if (regex_search(target, pattern))
-        {
-            found.push_back(resourcePair.second);
-        }
-    }
+    shared_ptr<const SearchPattern> pattern = compileSearchPattern(searchString);
+    if (!pattern)
+        return response(400, "Invalid search");
 
-    if (found.size() == 0)
-        return response(404, "Not Found");
+    // Literal patterns only check the resources whose indexed names may hold them.
+    PageCollector<T> found(page);
+    scanMatches<T>(repository, {"name"}, *pattern,
+        [&pattern](const T& resource) { return pattern->matches(resource.getName()); },
+        [&found](const string& id, const T& resource) { found.add(id, resource); });
 
-    // Create a new JSON write value to write to the file
-    json::wvalue jsonWriteValue;
-    int index = 0;
-    for (T resource : found)
-    {
-        jsonWriteValue[index] = resource.convertToJson();
-        index++;
-    }
+    if (found.empty() && !page.hasCursor())
+        return response(404, "Not Found");
 
-    return response(jsonWriteValue.dump());
+    return found.respond();
 }
 
-
-// Comparator to sort pairs according to name.
-struct
+/**
+ * @brief Indexes the trigrams of the names of resources, the field searchUsers matches.
+ *
+ * @tparam T The type of the resource.
+ */
+template<typename T>
+void GenericUserAPI<T>::addSearchIndexes()
 {
-    template<typename T>
-    bool operator()(pair<string, T>& a, pair<string, T>& b) 
-    { 
-        return a.second.getName() < b.second.getName(); 
-    } 
-} comparatorName;
+    repository.addIndex("name", make_shared<TextIndex<T>>([](const T& resource) { return resource.getName(); }));
+}
 
-// Comparator to sort pairs according to id.
+
+// Sort key of a user's name.
 struct
 {
     template<typename T>
-    bool operator()(pair<string, T>& a, pair<string, T>& b) 
+    SortKey operator()(const T& resource) const
     { 
-        return a.second.getId() < b.second.getId(); 
+        return SortKey{0, resource.getName()}; 
     } 
-} comparatorId;
+} sortKeyName;
 
 /**
- * @brief Handles the GET request that includes the sort parameter for sorting users
+ * @brief Sorts users by a key string
+ * 
+ * Users with the same key are sorted by id. Each order is walked from its sorted index, or
+ * sorted once per version of the users without one, so each page only costs finding where
+ * it starts.
  * 
  * @param sortString a string indicating the sorting criterion
- * @return a response object containing a JSON array of sorted T objects. 
- *         If an unsupported sortString is provided, returns the T in their original order.
+ * @param page The page of the sorted users to send.
+ * @return a response object containing the page of sorted users as a JSON array,
+ *         or 400 if the sortString isn't supported or the cursor is from another order.
 */
 template<typename T>
-response GenericUserAPI<T>::sortUsers(string sortString) 
+response GenericUserAPI<T>::sortUsers(string sortString, const PageRequest& page) 
 {
-    // Vector to store the T pairs.
-    vector<pair<string, T>> objectsToSort;
-
-    // For each string/PizzaSize pair in the pizzaSizes map.
-    for (pair<string, T> resourcePair : resourceMap) 
-        objectsToSort.push_back(resourcePair);
+    function<SortKey(const T&)> sortKey;
 
     if (sortString == "name")
-        sort(objectsToSort.begin(), objectsToSort.end(), comparatorName); 
+        sortKey = sortKeyName;
     else if (sortString == "id") 
-        sort(objectsToSort.begin(), objectsToSort.end(), comparatorId); 
+        sortKey = nullptr;
     else
         return response(400, "Invalid sort request");
 
-    // Create a new JSON write value use to write to the file.
-    json::wvalue jsonWriteValue;
-    
-    // For each T in the vector, convert the T to JSON and add to the write value.
-    int index = 0;
-    for (pair<string, T> resourcePair : objectsToSort)
-    {
-        jsonWriteValue[index] = resourcePair.second.convertToJson();
-        index++;
-    }
+    if (!page.fits(sortString))
+        return response(400, "Invalid cursor");
 
-    return response(jsonWriteValue.dump());
+    return sortedResponse(repository, sortString, sortKey, page);
+}
+
+/**
+ * @brief Keeps the users sorted by name and by id, the orders sortUsers offers.
+ *
+ * @tparam T The type of the resource.
+ */
+template<typename T>
+void GenericUserAPI<T>::addSortIndexes()
+{
+    repository.addIndex(sortedIndexName("id"), make_shared<SortedIndex<T>>(nullptr));
+    repository.addIndex(sortedIndexName("name"), make_shared<SortedIndex<T>>(sortKeyName));
 }
 
 /**
@@ -148,77 +161,129 @@ response GenericUserAPI<T>::createResource(request req)
     if (!readValueJson) 
         return response(400, "Invalid JSON");
     
-    // Create a new resource.
+    // Create a new resource, and read the changes it makes to other collections.
     T resource{readValueJson};
+    RelatedChanges<T> related;
+    related.add(readValueJson);
+
+    // Hold off snapshots while the repository and the log are being changed.
+    shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+    // Refuse the change if the write-ahead log can no longer record it.
+    // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+    if (writeAheadLog.hasFailed())
+        return response(503, "Write-ahead log unavailable");
+
+    // Keep other requests from changing a resource with the same id until this one is logged and stored.
+    unique_lock<mutex> resourceLock = repository.lockObject(resource.getId());
+    vector<unique_lock<mutex>> relatedLocks = related.lock();
+
+    // Record the new resource and its related changes in one append, then change the repositories.
+    vector<LogRecord> records;
+    related.collect(records);
+    string resourceJson = toJsonString(resource);
+    records.push_back({collectionName, LogOperation::Put, resource.getId(), resourceJson});
+    try
+    {
+        writeAheadLog.append(records);
+    }
+    catch (runtime_error& exception)
+    {
+        // The log couldn't record the change, so it isn't made, and later changes are refused.
+        return response(503, "Write-ahead log unavailable");
+    }
 
-    // Add the new resource to the map.
-    resourceMap[resource.getId()] = resource;
+    // Add the new resource to the repository.
+    repository.put(resource.getId(), resource);
+    changeTracker.markChanged(collectionName, resource.getId());
+    related.store(changeTracker);
 
     // Return the create resource as a JSON string.
     // 201 Created: The request succeeded, and a new resource was created as a result.
     // This is typically the response sent after POST requests, or some PUT requests.
-    return response(201, resource.convertToJson().dump());
+    return response(201, resourceJson);
 }
 
 /**
  * @brief Read a specific resource.
  * 
  * This method retrieves a resource identified by a unique ID.
+ * With fields, only the requested fields are sent.
  * 
+ * @param req The HTTP request object.
  * @param id The unique identifier of the resource.
  * @return res The HTTP response object.
  */
 template<typename T> 
-response GenericUserAPI<T>::readResource(string id) 
+response GenericUserAPI<T>::readResource(request req, string id) 
 {
-    try 
+    // With fields, serialize only the requested fields instead of sending the kept JSON.
+    FieldMask fields;
+    if (!fields.parse(req.url_params.get("fields")))
+        return response(400, "Invalid fields");
+    if (!fields.isEmpty())
     {
-        // Get the resource from the resource map.
-        T resource = resourceMap.at(id);
+        T resource;
+        if (!repository.get(id, resource))
+            return response(404, "Resource Not Found");
+        return response(toJsonString(resource, &fields));
+    }
 
-        // Return the resource as a JSON string.
-        return response(resource.convertToJson().dump());
-    } 
-    catch (out_of_range& exception) 
+    // Get the resource as JSON from the repository, which keeps it serialized between changes.
+    string resourceJson;
+    if (!repository.getJson(id, resourceJson))
     {
-        // If the resource was not found in the map return a 404 not found error.
+        // If the resource was not found in the repository return a 404 not found error.
         // 404 Not Found: The server cannot find the requested resource.
         return response(404, "Resource Not Found");
     }
+
+    // Return the resource as a JSON string.
+    return response(resourceJson);
 }
 
 /**
  * @brief Read all resources.
  * 
  * This method retrieves a resource identified by a unique ID.
+ * With limit, only that many resources are sent, and cursor picks up where the previous
+ * page ended.
  * 
  * @return res The HTTP response object.
  */
 template<typename T> 
 response GenericUserAPI<T>::readAllResources(request req) 
 {
+    PageRequest page;
+    if (!page.parse(req.url_params))
+        return response(400, "Invalid limit or cursor");
+
+    FieldMask fields;
+    if (!fields.parse(req.url_params.get("fields")))
+        return response(400, "Invalid fields");
+    page.setFields(fields);
+
     // If there is a search parameter on the request, then search by name.
     if (req.url_params.get("search"))
-        return searchUsers(req.url_params.get("search"));
+        return searchUsers(req.url_params.get("search"), page);
 
     // If there is a search parameter on the request, then search by name.
     if (req.url_params.get("sort"))
-        return sortUsers(req.url_params.get("sort"));
+        return sortUsers(req.url_params.get("sort"), page);
 
-    // Create a new JSON write value use to write to the file.
-    json::wvalue jsonWriteValue;
-    
-    // For each resource in the map, convert the resource to JSON and add to the write value.
-    int index = 0;
-    for (pair<string, T> keyValuePair : resourceMap)
+    // A page of every resource, in id order, or every resource with only the requested fields.
+    if (page.isPaged() || !page.getFields().isEmpty())
     {
-        // first: gives you access to the first item in the pair.
-        // second: gives you access to the second item in the pair.
-        jsonWriteValue[index] = keyValuePair.second.convertToJson();
-        index++;
+        if (!page.fits("id"))
+            return response(400, "Invalid cursor");
+        return sortedResponse<T>(repository, "id", nullptr, page);
     }
 
-    return response(jsonWriteValue.dump());
+    // Get every resource as one JSON list, which the repository keeps until the next change.
+    string resourcesJson;
+    repository.getAllJson(resourcesJson);
+
+    return response(resourcesJson);
 }
 
 /**
@@ -246,8 +311,30 @@ void GenericUserAPI<T>::updateResource(request req, response& res, string id)
 
     try 
     {
-        // Get the resource from the resource map.
-        T& resource = resourceMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+        {
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+
+        // Get the resource from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> resourceLock = repository.lockObject(id);
+        T resource = repository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older resource.
+        // 412 Precondition Failed: the resource changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; repository.getJson(id, current); return current; }))
+        {
+            res.code = 412;
+            res.end("Precondition Failed");
+            return;
+        }
 
         // Convert the request body to JSON.
         json::rvalue readValueJson = json::load(req.body);
@@ -263,16 +350,33 @@ void GenericUserAPI<T>::updateResource(request req, response& res, string id)
         // Update the resource.
         resource.updateFromJson(readValueJson);
 
+        // Record the updated resource in the write-ahead log, then change the repository.
+        string resourceJson = toJsonString(resource);
+        try
+        {
+            writeAheadLog.append({collectionName, LogOperation::Put, id, resourceJson});
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+        repository.put(id, resource);
+        changeTracker.markChanged(collectionName, id);
+
         // Return the updated resource as a JSON string.
         // 200 OK: The request succeeded.
         res.code = 200;
         res.set_header("Content-Type", "application/json");
-        res.write(resource.convertToJson().dump());
+        res.set_header("ETag", makeEntityTag(resourceJson));
+        res.write(resourceJson);
         res.end();
     } 
     catch (out_of_range& exception) 
     {
-        // If the resource was not found in the map return a 404 not found error.
+        // If the resource was not found in the repository return a 404 not found error.
         res.code = 404;
         res.end("Resource Not Found");
     }
@@ -294,7 +398,30 @@ void GenericUserAPI<Administrator>::updateResource(request req, response& res, s
 
     try 
     {
-        Administrator& resource = resourceMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+        {
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+
+        // Get the resource from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> resourceLock = repository.lockObject(id);
+        Administrator resource = repository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older resource.
+        // 412 Precondition Failed: the resource changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; repository.getJson(id, current); return current; }))
+        {
+            res.code = 412;
+            res.end("Precondition Failed");
+            return;
+        }
 
         json::rvalue readValueJson = json::load(req.body);
 
@@ -306,10 +433,34 @@ void GenericUserAPI<Administrator>::updateResource(request req, response& res, s
         }
 
         resource.updateFromJson(readValueJson);
+        RelatedChanges<Administrator> related;
+        related.add(readValueJson);
+        vector<unique_lock<mutex>> relatedLocks = related.lock();
+
+        // Log the administrator and the lab it manages together, so neither is stored without the other.
+        vector<LogRecord> records;
+        related.collect(records);
+        string resourceJson = toJsonString(resource);
+        records.push_back({collectionName, LogOperation::Put, id, resourceJson});
+        try
+        {
+            writeAheadLog.append(records);
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+        repository.put(id, resource);
+        changeTracker.markChanged(collectionName, id);
+        related.store(changeTracker);
 
         res.code = 200;
         res.set_header("Content-Type", "application/json");
-        res.write(resource.convertToJson().dump());
+        res.set_header("ETag", makeEntityTag(resourceJson));
+        res.write(resourceJson);
         res.end();
     } 
     catch (std::out_of_range& exception) 
@@ -340,18 +491,44 @@ response GenericUserAPI<T>::deleteResource(request req, string id)
 
     try 
     {
-        // Get the resource from the resource map.
-        T resource = resourceMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+            return response(503, "Write-ahead log unavailable");
+
+        // Get the resource from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> resourceLock = repository.lockObject(id);
+        T resource = repository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older resource.
+        // 412 Precondition Failed: the resource changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; repository.getJson(id, current); return current; }))
+            return response(412, "Precondition Failed");
+
+        // Record the deletion in the write-ahead log, then change the repository.
+        try
+        {
+            writeAheadLog.append({collectionName, LogOperation::Delete, id, ""});
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            return response(503, "Write-ahead log unavailable");
+        }
 
-        // Remove the resource from the resource map.
-        resourceMap.erase(id);
+        // Remove the resource from the repository.
+        repository.erase(id);
+        changeTracker.markDeleted(collectionName, id);
 
         // Return a successful code 204 which means success but no content to return.
         return response(204);
     } 
     catch (out_of_range& exception) 
     {
-        // If the resource was not found in the map return a 404 not found error.
+        // If the resource was not found in the repository return a 404 not found error.
         return response(404, "Resource Not Found");
     }
 }
@@ -4,16 +4,21 @@
 #include <crow.h>
 #include <map>
 #include <string>
+#include "Repository.h"
+#include "Pagination.h"
 
 template<typename T> 
 class GenericUserAPI 
 {
 public:
-    static std::map<std::string, T> resourceMap;
-    static crow::response searchUsers(std::string searchString);
-    static crow::response sortUsers(std::string sortString);
+    static Repository<T> repository;
+    static const std::string collectionName;
+    static crow::response searchUsers(std::string searchString, const PageRequest& page = PageRequest());
+    static void addSearchIndexes();
+    static crow::response sortUsers(std::string sortString, const PageRequest& page = PageRequest());
+    static void addSortIndexes();
     static crow::response createResource(crow::request req);
-    static crow::response readResource(std::string id); 
+    static crow::response readResource(crow::request req, std::string id); 
     static crow::response readAllResources(crow::request req);
     static void updateResource(crow::request req, crow::response& res, std::string id); 
     static crow::response deleteResource(crow::request req, std::string id); 
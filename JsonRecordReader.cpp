@@ -0,0 +1,132 @@
+/**
+ * @file JsonRecordReader.cpp
+ * @brief Implementation of the JsonRecordReader class.
+ *
+ * This file provides the implementation for the JsonRecordReader class, which reads a JSON
+ * array of objects from a stream one element at a time. Only one chunk of the stream and
+ * the record being read are held in memory, so files of any size can be loaded with
+ * memory bounded by the largest record.
+ */
+
+#include "JsonRecordReader.h"
+#include <cctype>
+
+using namespace std;
+
+/**
+ * @brief Constructs a JsonRecordReader over a stream holding a JSON array.
+ *
+ * @param inputStream The stream to read from.
+ * @param chunkSizeInput The number of bytes read from the stream at a time.
+ */
+JsonRecordReader::JsonRecordReader(istream& inputStream, size_t chunkSizeInput)
+    : input(inputStream), buffer(chunkSizeInput > 0 ? chunkSizeInput : 1)
+{
+}
+
+/**
+ * @brief Reads the text of the next object in the array.
+ *
+ * The reader only tracks strings and nesting depth to find where each element ends;
+ * the element itself is left for the caller to parse.
+ *
+ * @param record Receives the text of the next element.
+ * @return True if an element was read, false at the end of the array or on malformed input.
+ */
+bool JsonRecordReader::next(string& record)
+{
+    record.clear();
+    if (finished || failed)
+        return false;
+
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+
+    while (true)
+    {
+        if (position == length && !fill())
+        {
+            // The stream ended before the array was closed.
+            failed = true;
+            return false;
+        }
+
+        if (record.empty())
+        {
+            // Between elements: skip whitespace and commas, stop at the end of the array.
+            char character = buffer[position];
+            if (isspace(static_cast<unsigned char>(character)) || (started && character == ','))
+            {
+                position++;
+                continue;
+            }
+
+            if (!started)
+            {
+                started = character == '[';
+                failed = !started;
+                position++;
+                if (failed)
+                    return false;
+                continue;
+            }
+
+            if (character == ']')
+            {
+                position++;
+                finished = true;
+                return false;
+            }
+
+            if (character != '{')
+            {
+                failed = true;
+                return false;
+            }
+        }
+
+        // Inside an element: consume the chunk until the element closes.
+        size_t spanStart = position;
+        while (position < length)
+        {
+            char character = buffer[position++];
+            if (inString)
+            {
+                if (escaped)
+                    escaped = false;
+                else if (character == '\\')
+                    escaped = true;
+                else if (character == '"')
+                    inString = false;
+            }
+            else if (character == '"')
+            {
+                inString = true;
+            }
+            else if (character == '{' || character == '[')
+            {
+                depth++;
+            }
+            else if ((character == '}' || character == ']') && --depth == 0)
+            {
+                record.append(&buffer[spanStart], position - spanStart);
+                return true;
+            }
+        }
+        record.append(&buffer[spanStart], position - spanStart);
+    }
+}
+
+/**
+ * @brief Reads the next chunk of the stream into the buffer.
+ *
+ * @return True if any bytes were read, false at the end of the stream.
+ */
+bool JsonRecordReader::fill()
+{
+    input.read(buffer.data(), buffer.size());
+    length = input.gcount();
+    position = 0;
+    return length > 0;
+}
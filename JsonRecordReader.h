@@ -0,0 +1,33 @@
+#ifndef JSON_RECORD_READER_H
+#define JSON_RECORD_READER_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+class JsonRecordReader
+{
+public:
+    // Constructors
+    JsonRecordReader(std::istream& inputStream, size_t chunkSizeInput = 64 * 1024);
+
+    // Getters
+    bool hasFailed() const { return failed; }
+    bool isFinished() const { return finished; }
+
+    // Reads the text of the next record in the array, returns false at the end.
+    bool next(std::string& record);
+
+private:
+    bool fill();
+
+    std::istream& input;
+    std::vector<char> buffer;
+    size_t position = 0;
+    size_t length = 0;
+    bool started = false;
+    bool finished = false;
+    bool failed = false;
+};
+
+#endif // JSON_RECORD_READER_H
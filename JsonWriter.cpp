@@ -0,0 +1,302 @@
+/**
+ * @file JsonWriter.cpp
+ * @brief Implementation of the JsonWriter class.
+ *
+ * This file provides the implementation for the JsonWriter class, which writes JSON text
+ * directly into a string with the escaping and number formatting of crow's dump, leaving out
+ * the members a field mask does not select.
+ */
+
+#include "JsonWriter.h"
+#include <charconv>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * @brief Constructs a JsonWriter appending to a string.
+ *
+ * @param outputInput The string to append to.
+ * @param fieldsInput The fields to write, or null for every field. An empty mask writes
+ * every field as well.
+ */
+JsonWriter::JsonWriter(string& outputInput, const FieldMask* fieldsInput) : output(outputInput)
+{
+    if (fieldsInput != nullptr && !fieldsInput->isEmpty())
+    {
+        masked = true;
+        fields = fieldsInput;
+    }
+}
+
+/**
+ * @brief Writes the comma before a value when it is not the first of its array.
+ */
+void JsonWriter::beforeValue()
+{
+    if (afterKey)
+    {
+        afterKey = false;
+        return;
+    }
+    if (!first)
+        output.push_back(',');
+    first = false;
+}
+
+/**
+ * @brief Makes the field mask of a new object or array current. The value of a member gets
+ * the mask of the member; an array element keeps the mask of its array.
+ */
+void JsonWriter::enterFields()
+{
+    if (!masked)
+        return;
+    enclosingFields.push_back(fields);
+    if (afterKey)
+        fields = keyFields;
+}
+
+/**
+ * @brief Goes back to the field mask of the enclosing object or array.
+ */
+void JsonWriter::leaveFields()
+{
+    if (!masked)
+        return;
+    fields = enclosingFields.back();
+    enclosingFields.pop_back();
+}
+
+/**
+ * @brief Starts an object.
+ */
+void JsonWriter::beginObject()
+{
+    enterFields();
+    beforeValue();
+    output.push_back('{');
+    first = true;
+}
+
+/**
+ * @brief Ends the current object.
+ */
+void JsonWriter::endObject()
+{
+    leaveFields();
+    output.push_back('}');
+    first = false;
+}
+
+/**
+ * @brief Starts an array.
+ */
+void JsonWriter::beginArray()
+{
+    enterFields();
+    beforeValue();
+    output.push_back('[');
+    first = true;
+}
+
+/**
+ * @brief Ends the current array.
+ */
+void JsonWriter::endArray()
+{
+    leaveFields();
+    output.push_back(']');
+    first = false;
+}
+
+/**
+ * @brief Starts a list of objects at the top of a response.
+ */
+void JsonWriter::beginList()
+{
+    listStart = output.size();
+    beginArray();
+}
+
+/**
+ * @brief Ends the list, writing null instead of an empty array.
+ */
+void JsonWriter::endList()
+{
+    if (first)
+    {
+        output.resize(listStart);
+        output.append("null");
+        first = false;
+        leaveFields();
+        return;
+    }
+    endArray();
+}
+
+/**
+ * @brief Starts a member of the current object, unless the field mask leaves it out.
+ *
+ * @param name The name of the member. It must not contain characters JSON escapes.
+ * @return True if the member was started and its value must follow, false if the member is
+ * left out.
+ */
+bool JsonWriter::key(const char* name)
+{
+    if (fields != nullptr && !fields->select(name, keyFields))
+        return false;
+
+    if (!first)
+        output.push_back(',');
+    first = false;
+    output.push_back('"');
+    output.append(name);
+    output.append("\":");
+    afterKey = true;
+    return true;
+}
+
+/**
+ * @brief Writes a string.
+ *
+ * @param text The string.
+ */
+void JsonWriter::value(const string& text)
+{
+    beforeValue();
+    output.push_back('"');
+    appendEscaped(text, output);
+    output.push_back('"');
+}
+
+/**
+ * @brief Writes a string.
+ *
+ * @param text The string.
+ */
+void JsonWriter::value(const char* text)
+{
+    value(string(text));
+}
+
+/**
+ * @brief Writes true or false.
+ *
+ * @param flag The value.
+ */
+void JsonWriter::value(bool flag)
+{
+    beforeValue();
+    output.append(flag ? "true" : "false");
+}
+
+/**
+ * @brief Writes an integer.
+ *
+ * @param number The integer.
+ */
+void JsonWriter::value(int number)
+{
+    beforeValue();
+    char digits[16];
+    char* end = to_chars(digits, digits + sizeof(digits), number).ptr;
+    output.append(digits, end - digits);
+}
+
+/**
+ * @brief Writes a floating point number.
+ *
+ * @param number The number.
+ */
+void JsonWriter::value(double number)
+{
+    beforeValue();
+    appendNumber(number, output);
+}
+
+/**
+ * @brief Writes an array of strings.
+ *
+ * @param texts The strings.
+ */
+void JsonWriter::value(const vector<string>& texts)
+{
+    beginArray();
+    for (const string& text : texts)
+        value(text);
+    endArray();
+}
+
+/**
+ * @brief Writes a value that is already JSON text.
+ *
+ * @param json The JSON text.
+ */
+void JsonWriter::rawValue(const string& json)
+{
+    beforeValue();
+    output.append(json);
+}
+
+/**
+ * @brief Appends a string with the characters JSON needs escaped the way crow escapes them.
+ *
+ * @param text The string.
+ * @param out Receives the escaped string, without quotes.
+ */
+void JsonWriter::appendEscaped(const string& text, string& out)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    // Copy runs of characters that need no escaping at once.
+    size_t runStart = 0;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = text[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        out.append(text, runStart, i - runStart);
+        runStart = i + 1;
+        switch (c)
+        {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                out.append("\\u00");
+                out.push_back(hexDigits[c >> 4]);
+                out.push_back(hexDigits[c & 0xf]);
+        }
+    }
+    out.append(text, runStart, string::npos);
+}
+
+/**
+ * @brief Appends a floating point number the way crow dumps it: six decimals, then the
+ * trailing zeros dropped but one decimal kept, so 1500 is 1500.0 and 0.25 is 0.25. Numbers
+ * JSON cannot hold are null.
+ *
+ * @param number The number.
+ * @param out Receives the number.
+ */
+void JsonWriter::appendNumber(double number, string& out)
+{
+    if (isnan(number) || isinf(number))
+    {
+        out.append("null");
+        return;
+    }
+
+    char digits[400];
+    char* end = to_chars(digits, digits + sizeof(digits), number, chars_format::fixed, 6).ptr;
+    char* point = end - 7;
+    while (end > point + 2 && end[-1] == '0')
+        end--;
+    out.append(digits, end - digits);
+}
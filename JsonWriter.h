@@ -0,0 +1,91 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string>
+#include <vector>
+#include "FieldMask.h"
+
+// Writes JSON text straight into a string, without building a crow::json::wvalue tree first.
+// The text is the same crow's dump gives: strings are escaped and floating point numbers
+// formatted the way crow does it, so both paths give the same bytes. The string is appended
+// to, so one buffer can be reused for many objects. Given a field mask, the writer leaves
+// out the members the mask does not select.
+class JsonWriter
+{
+public:
+    // Constructors
+    JsonWriter(std::string& outputInput, const FieldMask* fieldsInput = nullptr);
+
+    // Getters
+    std::string& getOutput() { return output; }
+
+    // Objects and arrays
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    // A list of objects at the top of a response. Written as null when nothing was put in it,
+    // as crow dumps a wvalue that was never given an element.
+    void beginList();
+    void endList();
+
+    // Whether the field mask selects a member of the current object.
+    bool wants(const char* name) const { return fields == nullptr || fields->selects(name); }
+
+    // Start a member of the current object. The name must not need escaping. Returns false,
+    // writing nothing, when the field mask leaves the member out; its value is then skipped.
+    bool key(const char* name);
+
+    // Values, either members after key or array elements.
+    void value(const std::string& text);
+    void value(const char* text);
+    void value(bool flag);
+    void value(int number);
+    void value(double number);
+    void value(const std::vector<std::string>& texts);
+
+    // A value that is already JSON text, e.g. an object serialized earlier.
+    void rawValue(const std::string& json);
+
+    // A member: the key, then its value.
+    template <typename V>
+    void member(const char* name, const V& memberValue)
+    {
+        if (key(name))
+            value(memberValue);
+    }
+
+    // Helpers
+    static void appendEscaped(const std::string& text, std::string& out);
+    static void appendNumber(double number, std::string& out);
+
+private:
+    void beforeValue();
+    void enterFields();
+    void leaveFields();
+
+    std::string& output;
+    bool first = true;     // Nothing written yet in the current object or array.
+    bool afterKey = false; // A key was written and waits for its value.
+    size_t listStart = 0;
+
+    // The field mask of the current object or array, null for every field, the mask of the
+    // value after the last key, and the masks of the enclosing objects and arrays.
+    bool masked = false;
+    const FieldMask* fields = nullptr;
+    const FieldMask* keyFields = nullptr;
+    std::vector<const FieldMask*> enclosingFields;
+};
+
+// Serialize an object that has writeJson(JsonWriter&), with only the fields a mask selects.
+template <typename T>
+std::string toJsonString(const T& object, const FieldMask* fields = nullptr)
+{
+    std::string json;
+    JsonWriter writer(json, fields);
+    object.writeJson(writer);
+    return json;
+}
+
+#endif // JSON_WRITER_H
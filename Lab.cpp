@@ -1,4 +1,6 @@
 #include "Lab.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
 #include <algorithm> 
 
 using namespace std;
@@ -11,7 +13,7 @@ Lab::Lab(json::rvalue readValueJson)
 }
 
 // Convert to JSON
-json::wvalue Lab::convertToJson()
+json::wvalue Lab::convertToJson() const
 {
     json::wvalue writeJson;
     writeJson["labId"] = labId;
@@ -50,6 +52,23 @@ json::wvalue Lab::convertToJson()
     return writeJson;
 }
 
+// Write JSON, the same text convertToJson().dump() gives: members in the order crow dumps them in
+void Lab::writeJson(JsonWriter& writer) const
+{
+    writer.beginObject();
+    writer.member("userIds", userIds);
+    writer.member("equipmentIds", equipmentIds);
+    if (writer.key("budget"))
+        budget.writeJson(writer);
+    writer.member("capacity", capacity);
+    writer.member("location", location);
+    writer.member("name", name);
+    writer.member("labAdminId", labAdminId);
+    writer.member("experimentIds", experimentIds);
+    writer.member("labId", labId);
+    writer.endObject();
+}
+
 // Update from JSON
 void Lab::updateFromJson(json::rvalue readValueJson)
 {
@@ -94,4 +113,32 @@ void Lab::updateFromJson(json::rvalue readValueJson)
             userIds.push_back(idJson.s());
         }
     }
-}
\ No newline at end of file
+}
+
+// Write to a binary snapshot record
+void Lab::writeBinaryRecord(BinaryRecordWriter& writer) const
+{
+    writer.writeString(labId);
+    writer.writeString(labAdminId);
+    writer.writeString(name);
+    writer.writeString(location);
+    writer.writeString(capacity);
+    budget.writeBinaryRecord(writer);
+    writer.writeStringList(equipmentIds);
+    writer.writeStringList(experimentIds);
+    writer.writeStringList(userIds);
+}
+
+// Read from a binary snapshot record
+void Lab::readBinaryRecord(BinaryRecordReader& reader)
+{
+    labId = reader.readString();
+    labAdminId = reader.readString();
+    name = reader.readString();
+    location = reader.readString();
+    capacity = reader.readString();
+    budget.readBinaryRecord(reader);
+    equipmentIds = reader.readStringList();
+    experimentIds = reader.readStringList();
+    userIds = reader.readStringList();
+}
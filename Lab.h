@@ -36,11 +36,16 @@ public:
     void setExperimentIds(std::vector<std::string> experimentIdsInput) { experimentIds = experimentIdsInput; }
 
     // Convert to JSON.
-    crow::json::wvalue convertToJson();
+    crow::json::wvalue convertToJson() const;
+    void writeJson(JsonWriter& writer) const;
 
     // Update from JSON.
     void updateFromJson(crow::json::rvalue readValueJson);
 
+    // Binary snapshot methods
+    void writeBinaryRecord(BinaryRecordWriter& writer) const;
+    void readBinaryRecord(BinaryRecordReader& reader);
+
 private:
     std::string labId;
     std::string labAdminId;
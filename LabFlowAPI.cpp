@@ -10,6 +10,7 @@
 #include <crow.h>
 #include <map>
 #include <string>
+#include <vector>
 #include "resourceMaps.h"
 #include "Professor.h"
 #include "Administrator.h"
@@ -22,83 +23,583 @@
 #include "equipmentFunctions.h"
 #include "experimentFunctions.h"
 #include "FileHandlingTemplate.h"
+#include "Repository.h"
+#include "EntityTag.h"
+#include "BodyFormat.h"
+#include "ListSpool.h"
+#include "WriteAheadLog.h"
+#include "Snapshotter.h"
+#include "ChangeTracker.h"
+#include "ThreadPool.h"
+#include "ServerConfig.h"
+#include <chrono>
+#include <sstream>
+#include <cstdlib>
 
 using namespace std;
 using namespace crow;
 
-extern map<string, Professor> professorsMap;
-extern map<string, Student> studentsMap;
-extern map<string, Lab> labsMap;
-extern map<string, Administrator> administratorsMap;
-extern map<string, Experiment> experimentsMap;
-extern map<string, Equipment> equipmentsMap;
+extern Repository<Lab> labsRepository;
+extern Repository<Experiment> experimentsRepository;
+extern Repository<Equipment> equipmentsRepository;
+extern WriteAheadLog writeAheadLog;
+extern ChangeTracker changeTracker;
+
+// Name of the write-ahead log that holds every change made since the last save.
+const string writeAheadLogFile = "labflow.wal";
+
+// Delta segments are named labflow.delta.1, labflow.delta.2 and so on.
+const string deltaSegmentPrefix = "labflow.delta";
+
+// Long collection lists are sent from spool files named e.g. labflow.list.experiments.7.json.
+const string listSpoolPrefix = "labflow.list";
+
+// Exports of whole collections are sent from spool files named e.g. labflow.export.labs.7.json.
+const string exportSpoolPrefix = "labflow.export";
+
+// Imports store and log this many records at a time.
+const size_t importBatchRecords = 1000;
+
+/**
+ * @brief Applies one write-ahead log record to the resource collection it belongs to.
+ * 
+ * @param record The logged change.
+ */
+void replayLogRecord(const LogRecord& record)
+{
+    if (record.collection == "professors")
+        replayLogRecord<Professor>(GenericUserAPI<Professor>::repository, record);
+    else if (record.collection == "students")
+        replayLogRecord<Student>(GenericUserAPI<Student>::repository, record);
+    else if (record.collection == "administrators")
+        replayLogRecord<Administrator>(GenericUserAPI<Administrator>::repository, record);
+    else if (record.collection == "labs")
+        replayLogRecord<Lab>(labsRepository, record);
+    else if (record.collection == "equipments")
+        replayLogRecord<Equipment>(equipmentsRepository, record);
+    else if (record.collection == "experiments")
+        replayLogRecord<Experiment>(experimentsRepository, record);
+}
+
+/**
+ * @brief Loads one resource collection in parallel and logs how long it took.
+ * 
+ * @tparam T The type of the objects stored in the repository.
+ * @param data Receives the collection.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param pool The pool that parses chunks of the collection.
+ */
+template <typename T>
+void loadAndLogCollection(Repository<T>& data, string collection, ThreadPool& pool)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    string filename;
+    data.assign(loadCollectionInParallel<T>(collection, pool, filename));
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    // One line per collection, written whole so concurrent loads do not interleave.
+    ostringstream message;
+    message << "Loaded " << data.size() << " " << collection << " from " << filename << " in " << milliseconds << " ms" << endl;
+    cout << message.str();
+}
+
+/**
+ * @brief Loads every resource collection, parsing the collections and chunks of each
+ * collection in parallel on a thread pool.
+ */
+void loadAllResources()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ThreadPool pool(thread::hardware_concurrency());
+
+    vector<future<void>> collections;
+    collections.push_back(pool.submit([&pool] { loadAndLogCollection<Lab>(labsRepository, "labs", pool); }));
+    collections.push_back(pool.submit([&pool] { loadAndLogCollection<Experiment>(experimentsRepository, "experiments", pool); }));
+    collections.push_back(pool.submit([&pool] { loadAndLogCollection<Equipment>(equipmentsRepository, "equipments", pool); }));
+    collections.push_back(pool.submit([&pool] { loadAndLogCollection<Professor>(GenericUserAPI<Professor>::repository, "professors", pool); }));
+    collections.push_back(pool.submit([&pool] { loadAndLogCollection<Student>(GenericUserAPI<Student>::repository, "students", pool); }));
+    collections.push_back(pool.submit([&pool] { loadAndLogCollection<Administrator>(GenericUserAPI<Administrator>::repository, "administrators", pool); }));
+
+    for (future<void>& collection : collections)
+        pool.wait(collection);
+
+    cout << "Loaded every collection in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()
+         << " ms on " << pool.getThreadCount() << " threads" << endl;
+}
+
+/**
+ * @brief Saves one resource collection to its JSON file and then its binary snapshot.
+ * 
+ * The binary snapshot is written last so it is at least as new as the JSON file, and
+ * startup loads it instead of parsing the JSON.
+ * 
+ * @tparam T The type of the objects stored in the repository.
+ * @param data The collection to save.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @return True if both files were saved, false otherwise.
+ */
+template <typename T>
+bool saveCollection(const Repository<T>& data, string collection)
+{
+    return saveToFile<T>(data, collection + ".json") && saveToBinarySnapshot<T>(data, collection + ".lfb", collection);
+}
+
+/**
+ * @brief Saves every resource collection to its files.
+ * 
+ * @return True if every file was saved, false otherwise.
+ */
+bool saveAllResources()
+{
+    bool saved = saveCollection<Professor>(GenericUserAPI<Professor>::repository, "professors");
+    saved = saveCollection<Student>(GenericUserAPI<Student>::repository, "students") && saved;
+    saved = saveCollection<Administrator>(GenericUserAPI<Administrator>::repository, "administrators") && saved;
+    saved = saveCollection<Lab>(labsRepository, "labs") && saved;
+    saved = saveCollection<Equipment>(equipmentsRepository, "equipments") && saved;
+    saved = saveCollection<Experiment>(experimentsRepository, "experiments") && saved;
+    return saved;
+}
+
+/**
+ * @brief Turns the tracked changes of every collection into records holding the current
+ * state of each changed resource.
+ * 
+ * @param changes The ids changed and deleted since the last flush, keyed by collection.
+ * @return The records to write to a delta segment.
+ */
+vector<LogRecord> collectAllChanges(const ChangeSet& changes)
+{
+    vector<LogRecord> records;
+    for (const pair<const string, CollectionChanges>& keyValuePair : changes)
+    {
+        if (keyValuePair.first == "professors")
+            collectChanges<Professor>(GenericUserAPI<Professor>::repository, keyValuePair.first, keyValuePair.second, records);
+        else if (keyValuePair.first == "students")
+            collectChanges<Student>(GenericUserAPI<Student>::repository, keyValuePair.first, keyValuePair.second, records);
+        else if (keyValuePair.first == "administrators")
+            collectChanges<Administrator>(GenericUserAPI<Administrator>::repository, keyValuePair.first, keyValuePair.second, records);
+        else if (keyValuePair.first == "labs")
+            collectChanges<Lab>(labsRepository, keyValuePair.first, keyValuePair.second, records);
+        else if (keyValuePair.first == "equipments")
+            collectChanges<Equipment>(equipmentsRepository, keyValuePair.first, keyValuePair.second, records);
+        else if (keyValuePair.first == "experiments")
+            collectChanges<Experiment>(experimentsRepository, keyValuePair.first, keyValuePair.second, records);
+    }
+    return records;
+}
+
+/**
+ * @brief Sets the backend of one repository from its name.
+ * 
+ * @tparam T The type of the objects stored in the repository.
+ * @param data The repository to change.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param backendName The name of the backend: "versioned", "sharded", "map", "hash" or "log".
+ */
+template <typename T>
+void setStorageBackend(Repository<T>& data, string collection, string backendName)
+{
+    unique_ptr<RepositoryBackend<T>> backend = makeRepositoryBackend<T>(backendName, collection);
+    if (!backend)
+    {
+        cerr << "Unknown storage backend " << backendName << " for " << collection << ". Keeping " << data.getBackendName() << "." << endl;
+        return;
+    }
+    data.setBackend(std::move(backend));
+    cout << "Keeping " << collection << " in the " << backendName << " backend" << endl;
+}
+
+/**
+ * @brief Sets the backend of each collection listed in a storage setting.
+ * 
+ * @param storage A comma separated list of collection=backend pairs, e.g. "experiments=log,equipments=hash".
+ */
+void configureStorage(string storage)
+{
+    stringstream settings(storage);
+    string setting;
+    while (getline(settings, setting, ','))
+    {
+        size_t separator = setting.find('=');
+        if (separator == string::npos)
+        {
+            cerr << "Ignoring storage setting " << setting << ". Expected collection=backend." << endl;
+            continue;
+        }
+        string collection = setting.substr(0, separator);
+        string backendName = setting.substr(separator + 1);
+
+        if (collection == "professors")
+            setStorageBackend<Professor>(GenericUserAPI<Professor>::repository, collection, backendName);
+        else if (collection == "students")
+            setStorageBackend<Student>(GenericUserAPI<Student>::repository, collection, backendName);
+        else if (collection == "administrators")
+            setStorageBackend<Administrator>(GenericUserAPI<Administrator>::repository, collection, backendName);
+        else if (collection == "labs")
+            setStorageBackend<Lab>(labsRepository, collection, backendName);
+        else if (collection == "equipments")
+            setStorageBackend<Equipment>(equipmentsRepository, collection, backendName);
+        else if (collection == "experiments")
+            setStorageBackend<Experiment>(experimentsRepository, collection, backendName);
+        else
+            cerr << "Ignoring storage setting for unknown collection " << collection << endl;
+    }
+}
+
+/**
+ * @brief Runs a CPU heavy handler on the CPU pool and waits for its response.
+ * 
+ * @param pool The pool for CPU heavy work.
+ * @param handler The handler to run.
+ * @return The response of the handler, or 503 if the pool already has as many requests as
+ * it may queue.
+ */
+response runOnCpuPool(ThreadPool& pool, function<response()> handler)
+{
+    future<response> result;
+    if (!pool.trySubmit(handler, result))
+    {
+        response busy(503, "Too many expensive requests, try again later");
+        busy.set_header("Retry-After", "1");
+        return busy;
+    }
+    return result.get();
+}
+
+/**
+ * @brief Answers a list GET tagged with the version of the collection it lists.
+ *
+ * A client that already has this version of the list gets 304 Not Modified before the list
+ * is built or the request waits for the CPU pool. Collections whose JSON embeds objects of
+ * other collections are tagged by the body instead.
+ *
+ * A JSON list without search, sort or filter parameters is sent through the list spool,
+ * which builds it once per version and streams long lists from a file.
+ *
+ * @tparam T The type of the listed objects.
+ * @param req The HTTP request object.
+ * @param repository The listed collection.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param pool The pool for CPU heavy work.
+ * @param spool The spool for lists of whole collections.
+ * @param handler The handler that builds the list.
+ * @return The response of the handler with an ETag header, or 304 Not Modified.
+ */
+template <typename T>
+response readAllWithEntityTag(const request& req, const Repository<T>& repository, const string& collection, ThreadPool& pool, ListSpool& spool, function<response()> handler)
+{
+    if (!repository.getCacheSerialized())
+        return withEntityTag(req, runOnCpuPool(pool, handler));
+
+    uint64_t version = repository.getVersion();
+    string entityTag = makeVersionTag(version, req.raw_url);
+    if (isNotModified(req, entityTag))
+        return notModified(entityTag);
+
+    if (req.raw_url.find('?') == string::npos && acceptedBodyFormat(req.get_header_value("Accept")) == BodyFormat::Json)
+    {
+        handler = [&repository, &collection, &spool, version] {
+            return spool.respond(collection, version, [&repository](const function<void(const string&)>& write) { repository.writeAllJson(write, ListSpool::chunkBytes); });
+        };
+    }
+
+    response res = runOnCpuPool(pool, handler);
+    if (res.code == 200)
+        res.set_header("ETag", entityTag);
+    return res;
+}
+
+/**
+ * @brief Answers an export GET with every object of a collection as newline-delimited JSON,
+ * one object per line, all from one version of the collection.
+ *
+ * Exports are built once per version through their own spool, so long ones are streamed from
+ * a file, and are tagged like lists. Collections whose JSON embeds objects of other
+ * collections are serialized for every export instead.
+ *
+ * @tparam T The type of the exported objects.
+ * @param req The HTTP request object.
+ * @param repository The exported collection.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param pool The pool for CPU heavy work.
+ * @param spool The spool for exports.
+ * @return The response with the objects, or 304 Not Modified.
+ */
+template <typename T>
+response exportCollection(const request& req, const Repository<T>& repository, const string& collection, ThreadPool& pool, ListSpool& spool)
+{
+    function<void(const function<void(const string&)>&)> writeLines = [&repository](const function<void(const string&)>& write) {
+        repository.writeAllNdjson(write, ListSpool::chunkBytes);
+    };
+
+    response res;
+    if (repository.getCacheSerialized())
+    {
+        uint64_t version = repository.getVersion();
+        string entityTag = makeVersionTag(version, req.raw_url);
+        if (isNotModified(req, entityTag))
+            return notModified(entityTag);
+
+        res = runOnCpuPool(pool, [&collection, &spool, &writeLines, version] { return spool.respond(collection, version, writeLines); });
+        if (res.code == 200)
+            res.set_header("ETag", entityTag);
+    }
+    else
+    {
+        res = withEntityTag(req, runOnCpuPool(pool, [&writeLines] {
+            string lines;
+            writeLines([&lines](const string& piece) { lines += piece; });
+            return response(lines);
+        }));
+    }
+
+    if (res.code == 200)
+        res.set_header("Content-Type", "application/x-ndjson");
+    return res;
+}
+
+/**
+ * @brief Answers an import POST, storing every object of a newline-delimited JSON body.
+ *
+ * The objects are stored in batches as the body is parsed. Lines that are not valid objects
+ * are skipped and reported with their line numbers.
+ *
+ * @tparam T The type of the imported objects.
+ * @param req The HTTP request object.
+ * @param repository The collection to import into.
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param pool The pool for CPU heavy work.
+ * @return The number of objects imported and failed, and the first errors.
+ */
+template <typename T>
+response importCollection(const request& req, Repository<T>& repository, const string& collection, ThreadPool& pool)
+{
+    string apiKeyHeader = "Authorization";
+    string expectedApiKey = "PHYS17";
+
+    // Validate the api key in the request header.
+    if (!req.headers.count(apiKeyHeader) || req.headers.find(apiKeyHeader)->second != expectedApiKey)
+        return response(401);
+
+    return runOnCpuPool(pool, [&req, &repository, &collection]
+    {
+        ImportReport report = importFromNdjson<T>(req.body, repository, collection, writeAheadLog, changeTracker, importBatchRecords);
+
+        string json;
+        JsonWriter writer(json);
+        writer.beginObject();
+        writer.member("imported", static_cast<int>(report.imported));
+        writer.member("failed", static_cast<int>(report.failed));
+        writer.key("errors");
+        writer.beginArray();
+        for (const pair<size_t, string>& error : report.errors)
+        {
+            writer.beginObject();
+            writer.member("line", static_cast<int>(error.first));
+            writer.member("error", error.second);
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.endObject();
+
+        // 503 Service Unavailable: the log failed, and the batches after the last one
+        // imported were not stored.
+        return response(report.logFailed ? 503 : 200, json);
+    });
+}
 
 /**
  * @brief Entry point for the LabFlow API application.
  * 
- * Initializes resource maps, sets up API routes using the Crow framework,
- * and runs the application.
+ * Loads the resource repositories, replays the write-ahead log on top of them,
+ * sets up API routes using the Crow framework, and runs the application.
  * 
  * @return int Exit status of the application.
  */
 int main()
 {
-    // Create GenericUserAPIs to use in the CROW_ROUTES
-    GenericUserAPI<Professor>::resourceMap = professorsMap;
-    GenericUserAPI<Student>::resourceMap = studentsMap;
-    GenericUserAPI<Administrator>::resourceMap = administratorsMap;
+    // Read the settings from the config file named by LABFLOW_CONFIG, labflow.conf by default,
+    // then let LABFLOW_ environment variables override them.
+    ServerConfig config;
+    const char* configFile = getenv("LABFLOW_CONFIG");
+    if (!config.loadFromFile(configFile ? configFile : "labflow.conf") && configFile)
+        cerr << "Can't read the config file " << configFile << ". Using the defaults." << endl;
+    config.loadFromEnvironment();
+    if (!config.applyCpuAffinity())
+        cerr << "Can't restrict the server to the CPUs " << config.getCpuAffinity() << endl;
+    for (string key : ServerConfig::getKeys())
+        cout << key << " = " << config.getValue(key) << " (" << config.getSource(key) << ")" << endl;
 
-    SimpleApp app;
+    // Pick where each collection is kept, then load the resource collections. storage lists
+    // collection=backend pairs, e.g. "experiments=log,equipments=hash". Collections not
+    // listed use the versioned backend, which serves reads without locks.
+    if (!config.getStorage().empty())
+        configureStorage(config.getStorage());
+
+    // Single resource reads are served from JSON kept with each object until it changes.
+    // Administrators embed the lab they manage, which changes on its own, so they are
+    // serialized on every read.
+    GenericUserAPI<Administrator>::repository.setCacheSerialized(false);
+
+    // Searches for plain text only check the resources whose searched fields hold all of its
+    // trigrams, and ranked searches read the words of experiments and equipments from an
+    // index. search_index off trades that for the memory of the indexes.
+    if (config.getSearchIndex() == "on")
+    {
+        GenericUserAPI<Professor>::addSearchIndexes();
+        GenericUserAPI<Student>::addSearchIndexes();
+        GenericUserAPI<Administrator>::addSearchIndexes();
+        addLabSearchIndexes();
+        addEquipmentSearchIndexes();
+        addExperimentSearchIndexes();
+    }
+
+    // Every sort order is kept as a tree of ids that each change updates, instead of being
+    // sorted again after each change. sort_index off sorts on the next request instead.
+    if (config.getSortIndex() == "on")
+    {
+        GenericUserAPI<Professor>::addSortIndexes();
+        GenericUserAPI<Student>::addSortIndexes();
+        GenericUserAPI<Administrator>::addSortIndexes();
+        addLabSortIndexes();
+        addEquipmentSortIndexes();
+        addExperimentSortIndexes();
+    }
+
+    // Filters by approval, availability and location read bitmaps of the matching ids, and
+    // count them without reading the objects. bitmap_index off checks every object instead.
+    if (config.getBitmapIndex() == "on")
+    {
+        addLabFilterIndexes();
+        addEquipmentFilterIndexes();
+        addExperimentFilterIndexes();
+    }
+    loadAllResources();
+
+    // Replay the changes made after the resource files were last saved, in the order they
+    // were made: first the delta segments, then the write-ahead log. Then keep logging new
+    // changes. durability picks none, group or sync.
+    for (string segment : Snapshotter::listDeltaSegments(deltaSegmentPrefix))
+    {
+        for (const LogRecord& record : WriteAheadLog::readSegment(segment))
+            replayLogRecord(record);
+    }
+    for (const LogRecord& record : WriteAheadLog::readAll(writeAheadLogFile))
+        replayLogRecord(record);
+
+    if (!writeAheadLog.open(writeAheadLogFile, WriteAheadLog::parseDurability(config.getDurability())))
+        cerr << "Can't open the write-ahead log. Changes will only be saved on shutdown!" << endl;
+
+    // Save the collections in the background every snapshot_seconds. persistence picks full,
+    // which saves every collection each time, or delta, which saves only the changed resources
+    // and every collection once every merge_every times.
+    vector<string> resourceFiles;
+    for (string collection : {"professors", "students", "administrators", "labs", "equipments", "experiments"})
+    {
+        resourceFiles.push_back(collection + ".json");
+        resourceFiles.push_back(collection + ".lfb");
+    }
+    Snapshotter snapshotter(writeAheadLog, saveAllResources, resourceFiles);
+    bool fullPersistence = config.getPersistence() == "full";
+    snapshotter.enableDeltas(changeTracker, collectAllChanges, deltaSegmentPrefix, fullPersistence ? 0 : config.getMergeEvery());
+    snapshotter.start(config.getSnapshotSeconds());
+
+    // Listing, searching and sorting a whole collection run on their own bounded pool, so they
+    // can never hold more than cpu_threads + cpu_queue of the request threads.
+    ThreadPool cpuPool(config.getCpuThreads(), config.getCpuThreads() + config.getCpuQueue());
+
+    // Lists of whole collections longer than stream_threshold_bytes are sent from spool files
+    // in pieces instead of from a copy in every response.
+    ListSpool listSpool(listSpoolPrefix, config.getStreamThresholdBytes());
+    ListSpool exportSpool(exportSpoolPrefix, config.getStreamThresholdBytes());
+
+    // Bodies can also be MessagePack or CBOR, translated to and from JSON around the handlers.
+    App<RequestLimits, BinaryBodies> app;
+    app.get_middleware<RequestLimits>().maxBodyBytes = config.getMaxBodyBytes();
+    app.get_middleware<RequestLimits>().maxImportBytes = config.getMaxImportBytes();
+
+    // Metrics API route
+    CROW_ROUTE(app, "/api/metrics").methods(HTTPMethod::GET)([&snapshotter, &cpuPool](const request& req)
+    {
+        json::wvalue metrics = snapshotter.convertToJson();
+        metrics["cpuPool"]["threads"] = cpuPool.getThreadCount();
+        metrics["cpuPool"]["pending"] = cpuPool.getPendingCount();
+        metrics["cpuPool"]["rejected"] = cpuPool.getRejectedCount();
+        metrics["indexBytes"]["professors"] = GenericUserAPI<Professor>::repository.getIndexBytes();
+        metrics["indexBytes"]["students"] = GenericUserAPI<Student>::repository.getIndexBytes();
+        metrics["indexBytes"]["administrators"] = GenericUserAPI<Administrator>::repository.getIndexBytes();
+        metrics["indexBytes"]["labs"] = labsRepository.getIndexBytes();
+        metrics["indexBytes"]["equipments"] = equipmentsRepository.getIndexBytes();
+        metrics["indexBytes"]["experiments"] = experimentsRepository.getIndexBytes();
+        return withEntityTag(req, response(metrics.dump()));
+    });
 
     // Professors API routes
     CROW_ROUTE(app, "/api/professors").methods(HTTPMethod::POST)(GenericUserAPI<Professor>::createResource);
-    CROW_ROUTE(app, "/api/professors").methods(HTTPMethod::GET)(GenericUserAPI<Professor>::readAllResources);
-    CROW_ROUTE(app, "/api/professors/<string>").methods(HTTPMethod::GET)(GenericUserAPI<Professor>::readResource);
+    CROW_ROUTE(app, "/api/professors").methods(HTTPMethod::GET)([&cpuPool, &listSpool](const request& req) { return readAllWithEntityTag(req, GenericUserAPI<Professor>::repository, "professors", cpuPool, listSpool, [&req] { return GenericUserAPI<Professor>::readAllResources(req); }); });
+    CROW_ROUTE(app, "/api/professors/export").methods(HTTPMethod::GET)([&cpuPool, &exportSpool](const request& req) { return exportCollection(req, GenericUserAPI<Professor>::repository, "professors", cpuPool, exportSpool); });
+    CROW_ROUTE(app, "/api/professors/import").methods(HTTPMethod::POST)([&cpuPool](const request& req) { return importCollection(req, GenericUserAPI<Professor>::repository, "professors", cpuPool); });
+    CROW_ROUTE(app, "/api/professors/<string>").methods(HTTPMethod::GET)([](const request& req, string id) { return withEntityTag(req, GenericUserAPI<Professor>::readResource(req, id)); });
     CROW_ROUTE(app, "/api/professors/<string>").methods(HTTPMethod::PUT)(GenericUserAPI<Professor>::updateResource);
     CROW_ROUTE(app, "/api/professors/<string>").methods(HTTPMethod::DELETE)(GenericUserAPI<Professor>::deleteResource);
 
     // Students API routes
     CROW_ROUTE(app, "/api/students").methods(HTTPMethod::POST)(GenericUserAPI<Student>::createResource);
-    CROW_ROUTE(app, "/api/students").methods(HTTPMethod::GET)(GenericUserAPI<Student>::readAllResources);
-    CROW_ROUTE(app, "/api/students/<string>").methods(HTTPMethod::GET)(GenericUserAPI<Student>::readResource);
+    CROW_ROUTE(app, "/api/students").methods(HTTPMethod::GET)([&cpuPool, &listSpool](const request& req) { return readAllWithEntityTag(req, GenericUserAPI<Student>::repository, "students", cpuPool, listSpool, [&req] { return GenericUserAPI<Student>::readAllResources(req); }); });
+    CROW_ROUTE(app, "/api/students/export").methods(HTTPMethod::GET)([&cpuPool, &exportSpool](const request& req) { return exportCollection(req, GenericUserAPI<Student>::repository, "students", cpuPool, exportSpool); });
+    CROW_ROUTE(app, "/api/students/import").methods(HTTPMethod::POST)([&cpuPool](const request& req) { return importCollection(req, GenericUserAPI<Student>::repository, "students", cpuPool); });
+    CROW_ROUTE(app, "/api/students/<string>").methods(HTTPMethod::GET)([](const request& req, string id) { return withEntityTag(req, GenericUserAPI<Student>::readResource(req, id)); });
     CROW_ROUTE(app, "/api/students/<string>").methods(HTTPMethod::PUT)(GenericUserAPI<Student>::updateResource);
     CROW_ROUTE(app, "/api/students/<string>").methods(HTTPMethod::DELETE)(GenericUserAPI<Student>::deleteResource);
 
     // Administrators API routes
     CROW_ROUTE(app, "/api/administrators").methods(HTTPMethod::POST)(GenericUserAPI<Administrator>::createResource);
-    CROW_ROUTE(app, "/api/administrators").methods(HTTPMethod::GET)(GenericUserAPI<Administrator>::readAllResources);
-    CROW_ROUTE(app, "/api/administrators/<string>").methods(HTTPMethod::GET)(GenericUserAPI<Administrator>::readResource);
+    CROW_ROUTE(app, "/api/administrators").methods(HTTPMethod::GET)([&cpuPool, &listSpool](const request& req) { return readAllWithEntityTag(req, GenericUserAPI<Administrator>::repository, "administrators", cpuPool, listSpool, [&req] { return GenericUserAPI<Administrator>::readAllResources(req); }); });
+    CROW_ROUTE(app, "/api/administrators/export").methods(HTTPMethod::GET)([&cpuPool, &exportSpool](const request& req) { return exportCollection(req, GenericUserAPI<Administrator>::repository, "administrators", cpuPool, exportSpool); });
+    CROW_ROUTE(app, "/api/administrators/import").methods(HTTPMethod::POST)([&cpuPool](const request& req) { return importCollection(req, GenericUserAPI<Administrator>::repository, "administrators", cpuPool); });
+    CROW_ROUTE(app, "/api/administrators/<string>").methods(HTTPMethod::GET)([](const request& req, string id) { return withEntityTag(req, GenericUserAPI<Administrator>::readResource(req, id)); });
     CROW_ROUTE(app, "/api/administrators/<string>").methods(HTTPMethod::PUT)(GenericUserAPI<Administrator>::updateResource);
     CROW_ROUTE(app, "/api/administrators/<string>").methods(HTTPMethod::DELETE)(GenericUserAPI<Administrator>::deleteResource);
 
     // Labs API routes
     CROW_ROUTE(app, "/api/labs").methods(HTTPMethod::POST)(createLab);
-    CROW_ROUTE(app, "/api/labs").methods(HTTPMethod::GET)(readAllLabs);
-    CROW_ROUTE(app, "/api/labs/<string>").methods(HTTPMethod::GET)(readLab);
+    CROW_ROUTE(app, "/api/labs").methods(HTTPMethod::GET)([&cpuPool, &listSpool](const request& req) { return readAllWithEntityTag(req, labsRepository, "labs", cpuPool, listSpool, [&req] { return readAllLabs(req); }); });
+    CROW_ROUTE(app, "/api/labs/export").methods(HTTPMethod::GET)([&cpuPool, &exportSpool](const request& req) { return exportCollection(req, labsRepository, "labs", cpuPool, exportSpool); });
+    CROW_ROUTE(app, "/api/labs/import").methods(HTTPMethod::POST)([&cpuPool](const request& req) { return importCollection(req, labsRepository, "labs", cpuPool); });
+    CROW_ROUTE(app, "/api/labs/<string>").methods(HTTPMethod::GET)([](const request& req, string id) { return withEntityTag(req, readLab(req, id)); });
     CROW_ROUTE(app, "/api/labs/<string>").methods(HTTPMethod::PUT)(updateLab);
     CROW_ROUTE(app, "/api/labs/<string>").methods(HTTPMethod::DELETE)(deleteLab);
 
     // Equipment API routes
     CROW_ROUTE(app, "/api/equipments").methods(HTTPMethod::POST)(createEquipment);
-    CROW_ROUTE(app, "/api/equipments").methods(HTTPMethod::GET)(readAllEquipments);
-    CROW_ROUTE(app, "/api/equipments/<string>").methods(HTTPMethod::GET)(readEquipment);
+    CROW_ROUTE(app, "/api/equipments").methods(HTTPMethod::GET)([&cpuPool, &listSpool](const request& req) { return readAllWithEntityTag(req, equipmentsRepository, "equipments", cpuPool, listSpool, [&req] { return readAllEquipments(req); }); });
+    CROW_ROUTE(app, "/api/equipments/export").methods(HTTPMethod::GET)([&cpuPool, &exportSpool](const request& req) { return exportCollection(req, equipmentsRepository, "equipments", cpuPool, exportSpool); });
+    CROW_ROUTE(app, "/api/equipments/import").methods(HTTPMethod::POST)([&cpuPool](const request& req) { return importCollection(req, equipmentsRepository, "equipments", cpuPool); });
+    CROW_ROUTE(app, "/api/equipments/<string>").methods(HTTPMethod::GET)([](const request& req, string id) { return withEntityTag(req, readEquipment(req, id)); });
     CROW_ROUTE(app, "/api/equipments/<string>").methods(HTTPMethod::PUT)(updateEquipment);
     CROW_ROUTE(app, "/api/equipments/<string>").methods(HTTPMethod::DELETE)(deleteEquipment);
 
     // Experiments API routes
     CROW_ROUTE(app, "/api/experiments").methods(HTTPMethod::POST)(createExperiment);
-    CROW_ROUTE(app, "/api/experiments").methods(HTTPMethod::GET)(readAllExperiments);
-    CROW_ROUTE(app, "/api/experiments/<string>").methods(HTTPMethod::GET)(readExperiment);
+    CROW_ROUTE(app, "/api/experiments").methods(HTTPMethod::GET)([&cpuPool, &listSpool](const request& req) { return readAllWithEntityTag(req, experimentsRepository, "experiments", cpuPool, listSpool, [&req] { return readAllExperiments(req); }); });
+    CROW_ROUTE(app, "/api/experiments/export").methods(HTTPMethod::GET)([&cpuPool, &exportSpool](const request& req) { return exportCollection(req, experimentsRepository, "experiments", cpuPool, exportSpool); });
+    CROW_ROUTE(app, "/api/experiments/import").methods(HTTPMethod::POST)([&cpuPool](const request& req) { return importCollection(req, experimentsRepository, "experiments", cpuPool); });
+    CROW_ROUTE(app, "/api/experiments/<string>").methods(HTTPMethod::GET)([](const request& req, string id) { return withEntityTag(req, readExperiment(req, id)); });
     CROW_ROUTE(app, "/api/experiments/<string>").methods(HTTPMethod::PUT)(updateExperiment);
     CROW_ROUTE(app, "/api/experiments/<string>").methods(HTTPMethod::DELETE)(deleteExperiment);
 
-    app.port(17177).run();
+    // Every repository can be shared between threads, so handle requests on worker_threads threads.
+    app.port(config.getPort()).concurrency(config.getWorkerThreads()).timeout(config.getKeepAliveSeconds()).run();
 
     // Save resources back to files
-    saveToFile<Professor>(GenericUserAPI<Professor>::resourceMap, "professors.json");
-    saveToFile<Student>(GenericUserAPI<Student>::resourceMap, "students.json");
-    saveToFile<Administrator>(GenericUserAPI<Administrator>::resourceMap, "administrators.json");
-    saveToFile<Lab>(labsMap, "labs.json");
-    saveToFile<Equipment>(equipmentsMap, "equipments.json");
-    saveToFile<Experiment>(experimentsMap, "experiments.json");
+    snapshotter.stop();
+    if (!saveAllResources())
+    {
+        cerr << "Can't save the resource files. The write-ahead log still holds every change." << endl;
+        return 1;
+    }
+
+    // Every delta segment and logged change is now in the resource files.
+    snapshotter.discardDeltaSegments();
+    writeAheadLog.checkpoint();
 }
@@ -0,0 +1,185 @@
+/**
+ * @file ListSpool.cpp
+ * @brief Implementation of the ListSpool class.
+ *
+ * This file provides the implementation for the ListSpool class, which sends the lists of
+ * whole collections. Short lists are sent from memory. Long ones are serialized in pieces
+ * into a spool file that crow streams to the client, so a list read needs memory for one
+ * piece instead of the whole list. A spool file is replaced once its collection changes and
+ * a newer list is read; the file before it is kept until the next replacement, so responses
+ * still being sent from it are not cut short.
+ */
+
+#include "ListSpool.h"
+#include <dirent.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace crow;
+
+/**
+ * @brief Constructs a ListSpool and removes the spool files a previous server left.
+ *
+ * @param prefixInput The name spool files start with, e.g. "labflow.list".
+ * @param thresholdBytesInput The longest list kept in memory.
+ */
+ListSpool::ListSpool(string prefixInput, size_t thresholdBytesInput) : prefix(prefixInput), thresholdBytes(thresholdBytesInput)
+{
+    for (string filename : listSpoolFiles(prefix))
+        remove(filename.c_str());
+}
+
+/**
+ * @brief Removes the spool files.
+ */
+ListSpool::~ListSpool()
+{
+    for (pair<const string, unique_ptr<SpooledList>>& keyValuePair : lists)
+    {
+        if (!keyValuePair.second->filename.empty())
+            remove(keyValuePair.second->filename.c_str());
+        if (!keyValuePair.second->previousFilename.empty())
+            remove(keyValuePair.second->previousFilename.c_str());
+    }
+}
+
+/**
+ * @brief Responds with the list of a collection, built if the collection changed since the
+ * list was last built.
+ *
+ * @param collection The name of the collection, e.g. "experiments".
+ * @param version The version of the collection, read before the list is serialized.
+ * @param writeList Serializes the list, handing every piece to the function it gets.
+ * @return The response, with the list in its body or in a file crow sends.
+ */
+response ListSpool::respond(const string& collection, uint64_t version, const function<void(const function<void(const string&)>&)>& writeList)
+{
+    SpooledList* list;
+    {
+        lock_guard<mutex> guard(listsMutex);
+        unique_ptr<SpooledList>& found = lists[collection];
+        if (!found)
+            found.reset(new SpooledList());
+        list = found.get();
+    }
+
+    // Reads of the same version wait for one build and share it.
+    lock_guard<mutex> building(list->building);
+    if (!list->built || list->version != version)
+        build(*list, collection, version, writeList);
+
+    if (list->filename.empty())
+        return response(list->body);
+
+    response res;
+    res.set_static_file_info(list->filename);
+    return res;
+}
+
+/**
+ * @brief Serializes the list of a collection. The pieces are collected in memory until they
+ * pass thresholdBytes, then they go to a spool file instead.
+ *
+ * If the spool file can't be written the list is kept in memory, whatever its length.
+ *
+ * @param list The list to build, with its building mutex held.
+ * @param collection The name of the collection.
+ * @param version The version of the collection.
+ * @param writeList Serializes the list, handing every piece to the function it gets.
+ */
+void ListSpool::build(SpooledList& list, const string& collection, uint64_t version, const function<void(const function<void(const string&)>&)>& writeList)
+{
+    string filename = prefix + "." + collection + "." + to_string(version) + ".json";
+    string temporaryFilename = filename + ".tmp";
+    string body;
+    ofstream file;
+    bool spooling = false;
+    bool spoolFailed = false;
+
+    writeList([&](const string& piece) {
+        if (!spooling && !spoolFailed && body.size() + piece.size() > thresholdBytes)
+        {
+            file.open(temporaryFilename, ios::binary | ios::trunc);
+            file.write(body.data(), body.size());
+            spooling = file.good();
+            spoolFailed = !spooling;
+            if (spooling)
+                string().swap(body);
+        }
+
+        if (spooling)
+            file.write(piece.data(), piece.size());
+        else
+            body.append(piece);
+    });
+
+    if (spooling)
+    {
+        file.close();
+        if (!file || rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+        {
+            cerr << "Can't write the spool file " << filename << ". Sending the " << collection << " list from memory." << endl;
+            remove(temporaryFilename.c_str());
+            spooling = false;
+            writeList([&body](const string& piece) { body.append(piece); });
+        }
+    }
+    else if (spoolFailed)
+    {
+        cerr << "Can't write the spool file " << filename << ". Sending the " << collection << " list from memory." << endl;
+        remove(temporaryFilename.c_str());
+    }
+
+    list.built = true;
+    list.version = version;
+    list.body = move(body);
+    keepFile(list, spooling ? filename : "");
+}
+
+/**
+ * @brief Makes a file the current one of a list and removes the file before the one it
+ * replaces.
+ *
+ * @param list The list.
+ * @param filename The new spool file, or an empty string for a list kept in memory.
+ */
+void ListSpool::keepFile(SpooledList& list, const string& filename)
+{
+    if (filename == list.filename)
+        return;
+    if (!list.previousFilename.empty())
+        remove(list.previousFilename.c_str());
+    list.previousFilename = list.filename;
+    list.filename = filename;
+}
+
+/**
+ * @brief Lists the spool files written with a prefix, finished or not.
+ *
+ * @param prefix The name the spool files start with, e.g. "labflow.list".
+ * @return The spool file names.
+ */
+vector<string> ListSpool::listSpoolFiles(string prefix)
+{
+    size_t slash = prefix.find_last_of('/');
+    string directory = slash == string::npos ? "." : prefix.substr(0, slash);
+    string name = (slash == string::npos ? prefix : prefix.substr(slash + 1)) + ".";
+
+    vector<string> filenames;
+    DIR* directoryStream = opendir(directory.c_str());
+    if (directoryStream == nullptr)
+        return filenames;
+
+    while (dirent* entry = readdir(directoryStream))
+    {
+        string entryName = entry->d_name;
+        bool finished = entryName.size() > 5 && entryName.compare(entryName.size() - 5, 5, ".json") == 0;
+        bool unfinished = entryName.size() > 9 && entryName.compare(entryName.size() - 9, 9, ".json.tmp") == 0;
+        if (entryName.compare(0, name.size(), name) == 0 && (finished || unfinished))
+            filenames.push_back(slash == string::npos ? entryName : directory + "/" + entryName);
+    }
+    closedir(directoryStream);
+    return filenames;
+}
@@ -0,0 +1,63 @@
+#ifndef LIST_SPOOL_H
+#define LIST_SPOOL_H
+
+#include <crow.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Sends lists of whole collections without copying long ones into every response. A list of
+// up to thresholdBytes is kept in memory. A longer one is written piece by piece to a spool
+// file named <prefix>.<collection>.<version>.json, which crow sends in pieces, so no request
+// holds the whole list. Each list is built once per version of its collection and shared by
+// every read of that version.
+class ListSpool
+{
+public:
+    // Constructors
+    ListSpool(std::string prefixInput, size_t thresholdBytesInput);
+    ~ListSpool();
+    ListSpool(const ListSpool&) = delete;
+    ListSpool& operator=(const ListSpool&) = delete;
+
+    // Getters
+    std::string getPrefix() const { return prefix; }
+    size_t getThresholdBytes() const { return thresholdBytes; }
+
+    // Respond with the list of a collection at a version. writeList serializes the list and
+    // hands every piece to the function it gets, the way Repository::writeAllJson does.
+    crow::response respond(const std::string& collection, uint64_t version, const std::function<void(const std::function<void(const std::string&)>&)>& writeList);
+
+    // The spool files left with a prefix, e.g. by a server that was killed.
+    static std::vector<std::string> listSpoolFiles(std::string prefix);
+
+    // The size of the pieces lists are serialized in.
+    static const size_t chunkBytes = 65536;
+
+private:
+    // The list of one collection, either in memory or in a spool file.
+    struct SpooledList
+    {
+        std::mutex building;
+        bool built = false;
+        uint64_t version = 0;
+        std::string body;
+        std::string filename;
+        std::string previousFilename;
+    };
+
+    void build(SpooledList& list, const std::string& collection, uint64_t version, const std::function<void(const std::function<void(const std::string&)>&)>& writeList);
+    void keepFile(SpooledList& list, const std::string& filename);
+
+    std::string prefix;
+    size_t thresholdBytes;
+
+    std::mutex listsMutex;
+    std::map<std::string, std::unique_ptr<SpooledList>> lists;
+};
+
+#endif // LIST_SPOOL_H
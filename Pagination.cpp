@@ -0,0 +1,93 @@
+/**
+ * @file Pagination.cpp
+ * @brief Implementation of the PageRequest class.
+ *
+ * This file provides the implementation for the PageRequest class, which reads the limit and
+ * cursor parameters of list requests and makes the cursors of next pages. A cursor holds the
+ * order, key and id of an object, hex encoded so it can go in a URL as it is.
+ */
+
+#include "Pagination.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace crow;
+
+/**
+ * @brief Reads the limit and cursor parameters of a list request.
+ *
+ * @param params The query string of the request.
+ * @return True if both are absent or valid, false otherwise.
+ */
+bool PageRequest::parse(const query_string& params)
+{
+    if (params.get("limit"))
+    {
+        string value = params.get("limit");
+        if (value.empty() || value.size() > 9 || value.find_first_not_of("0123456789") != string::npos)
+            return false;
+        limit = stoul(value);
+        if (limit == 0 || limit > maxLimit)
+            return false;
+    }
+
+    if (!params.get("cursor"))
+        return true;
+
+    // Decode the hex, then split "<order>\n<number>\n<text length>\n<text><id>".
+    string hex = params.get("cursor");
+    if (hex.empty() || hex.size() % 2 != 0 || hex.find_first_not_of("0123456789abcdef") != string::npos)
+        return false;
+    string cursor;
+    for (size_t i = 0; i < hex.size(); i += 2)
+        cursor.push_back(static_cast<char>(stoi(hex.substr(i, 2), nullptr, 16)));
+
+    size_t orderEnd = cursor.find('\n');
+    size_t numberEnd = orderEnd == string::npos ? string::npos : cursor.find('\n', orderEnd + 1);
+    size_t lengthEnd = numberEnd == string::npos ? string::npos : cursor.find('\n', numberEnd + 1);
+    if (lengthEnd == string::npos)
+        return false;
+
+    string number = cursor.substr(orderEnd + 1, numberEnd - orderEnd - 1);
+    string length = cursor.substr(numberEnd + 1, lengthEnd - numberEnd - 1);
+    if (number.empty() || length.empty() || length.find_first_not_of("0123456789") != string::npos || length.size() > 9)
+        return false;
+    size_t textLength = stoul(length);
+    if (textLength > cursor.size() - lengthEnd - 1)
+        return false;
+
+    char* numberStop = nullptr;
+    cursorPosition.key.number = strtod(number.c_str(), &numberStop);
+    if (*numberStop != '\0')
+        return false;
+    cursorOrder = cursor.substr(0, orderEnd);
+    cursorPosition.key.text = cursor.substr(lengthEnd + 1, textLength);
+    cursorPosition.id = cursor.substr(lengthEnd + 1 + textLength);
+    cursorSet = true;
+    return true;
+}
+
+/**
+ * @brief Makes the cursor pointing at an object of a list.
+ *
+ * @param order The name of the order of the list, e.g. "cost".
+ * @param position The key and id of the object.
+ * @return The cursor, in lowercase hex.
+ */
+string PageRequest::makeCursor(const string& order, const SortedId& position)
+{
+    char number[32];
+    snprintf(number, sizeof(number), "%.17g", position.key.number);
+    string cursor = order + "\n" + number + "\n" + to_string(position.key.text.size()) + "\n" + position.key.text + position.id;
+
+    static const char hexDigits[] = "0123456789abcdef";
+    string hex;
+    hex.reserve(cursor.size() * 2);
+    for (unsigned char c : cursor)
+    {
+        hex.push_back(hexDigits[c >> 4]);
+        hex.push_back(hexDigits[c & 0xf]);
+    }
+    return hex;
+}
@@ -0,0 +1,195 @@
+#ifndef PAGINATION_H
+#define PAGINATION_H
+
+#include <crow.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "FieldMask.h"
+#include "JsonWriter.h"
+#include "Repository.h"
+
+// Which part of a list a request asks for: at most limit objects, or every object when limit
+// is 0, after the object the cursor points at. The cursor is opaque to clients; it holds the
+// order of the list and the key and id of the last object of the previous page. A paged
+// response names the cursor of the next page in its X-Next-Cursor header. The request also
+// carries the field mask the listed objects are written with.
+class PageRequest
+{
+public:
+    // Getters
+    size_t getLimit() const { return limit; }
+    bool hasCursor() const { return cursorSet; }
+    const SortedId& getCursorPosition() const { return cursorPosition; }
+    bool isPaged() const { return limit > 0 || cursorSet; }
+    const FieldMask& getFields() const { return fields; }
+
+    // Setters
+    void setFields(const FieldMask& fieldsInput) { fields = fieldsInput; }
+
+    // Read the limit and cursor parameters, returns false if either is not valid.
+    bool parse(const crow::query_string& params);
+
+    // Whether the cursor continues a list in this order. Without a cursor every order fits.
+    bool fits(const std::string& order) const { return !cursorSet || order == cursorOrder; }
+
+    // Whether an object of a list in id order comes after the cursor.
+    bool isAfter(const std::string& id) const { return !cursorSet || cursorPosition.id < id; }
+
+    // The cursor pointing at an object of a list.
+    static std::string makeCursor(const std::string& order, const SortedId& position);
+
+    // The largest page a request may ask for.
+    static const size_t maxLimit = 10000;
+
+private:
+    size_t limit = 0;
+    bool cursorSet = false;
+    std::string cursorOrder;
+    SortedId cursorPosition;
+    FieldMask fields;
+};
+
+// Collects the objects a search or filter finds, which come in id order. A paged request only
+// keeps the objects of its page, plus one to know whether there is a next page.
+template <typename T>
+class PageCollector
+{
+public:
+    // Constructors
+    PageCollector(const PageRequest& pageInput) : page(pageInput) {}
+
+    // Getters
+    bool empty() const { return found.empty(); }
+
+    // Add an object the search or filter found.
+    void add(const std::string& id, const T& object)
+    {
+        if (!page.isAfter(id) || (page.getLimit() > 0 && found.size() > page.getLimit()))
+            return;
+        found.emplace_back(id, object);
+    }
+
+    // Respond with the page, writing each object straight into the response body.
+    crow::response respond() const
+    {
+        size_t count = found.size();
+        bool more = page.getLimit() > 0 && count > page.getLimit();
+        if (more)
+            count = page.getLimit();
+
+        std::string body;
+        JsonWriter writer(body, &page.getFields());
+        writer.beginList();
+        for (size_t i = 0; i < count; i++)
+            found[i].second.writeJson(writer);
+        writer.endList();
+
+        crow::response res(body);
+        if (more)
+            res.set_header("X-Next-Cursor", PageRequest::makeCursor("id", SortedId{SortKey(), found[count - 1].first}));
+        return res;
+    }
+
+private:
+    const PageRequest& page;
+    std::vector<std::pair<std::string, T>> found;
+};
+
+// Gets up to count ids of a sorted list, or every id when count is 0, after the position
+// after points at, or from the start when after is null.
+typedef std::function<std::vector<SortedId>(const SortedId* after, size_t count)> SortedFetch;
+
+/**
+ * @brief Responds with a page of a sorted list. The page starts right after the object the
+ * cursor points at, and each object's JSON comes from the repository. With a field mask the
+ * objects are serialized with it instead. Objects removed since their ids were fetched are
+ * skipped, and more ids are fetched in their place.
+ *
+ * @tparam T The type of the listed objects.
+ * @param repository The listed collection.
+ * @param order The name of the order of the list, e.g. "cost".
+ * @param fetch Gets the ids of the list.
+ * @param page The page the request asks for.
+ * @return The response with the page, and the cursor of the next page if there is one.
+ */
+template <typename T>
+crow::response sortedPageResponse(const Repository<T>& repository, const std::string& order, const SortedFetch& fetch, const PageRequest& page)
+{
+    std::string body;
+    JsonWriter writer(body, &page.getFields());
+    writer.beginList();
+    std::string json;
+    T object;
+
+    // One id past the page is fetched, to know whether there is a next page.
+    size_t limit = page.getLimit();
+    SortedId position = page.getCursorPosition();
+    bool positioned = page.hasCursor();
+    SortedId lastSent;
+    size_t sent = 0;
+    bool more = false;
+    while (true)
+    {
+        size_t wanted = limit == 0 ? 0 : limit - sent + 1;
+        std::vector<SortedId> ids = fetch(positioned ? &position : nullptr, wanted);
+        for (const SortedId& next : ids)
+        {
+            if (limit > 0 && sent == limit)
+            {
+                more = true;
+                break;
+            }
+            position = next;
+            positioned = true;
+
+            if (page.getFields().isEmpty())
+            {
+                if (!repository.getJson(next.id, json))
+                    continue;
+                writer.rawValue(json);
+            }
+            else
+            {
+                if (!repository.get(next.id, object))
+                    continue;
+                object.writeJson(writer);
+            }
+            lastSent = next;
+            sent++;
+        }
+        if (more || wanted == 0 || ids.size() < wanted)
+            break;
+    }
+    writer.endList();
+
+    crow::response res(body);
+    if (more)
+        res.set_header("X-Next-Cursor", PageRequest::makeCursor(order, lastSent));
+    return res;
+}
+
+/**
+ * @brief Responds with a page of a sorted list, found by binary search from the cursor.
+ *
+ * @tparam T The type of the listed objects.
+ * @param repository The listed collection.
+ * @param order The name of the order of the list, e.g. "cost".
+ * @param sorted The sorted list, from Repository::getSorted.
+ * @param page The page the request asks for.
+ * @return The response with the page, and the cursor of the next page if there is one.
+ */
+template <typename T>
+crow::response sortedPageResponse(const Repository<T>& repository, const std::string& order, const std::vector<SortedId>& sorted, const PageRequest& page)
+{
+    return sortedPageResponse<T>(repository, order, [&sorted](const SortedId* after, size_t count)
+    {
+        std::vector<SortedId>::const_iterator next = after ? std::upper_bound(sorted.begin(), sorted.end(), *after) : sorted.begin();
+        size_t available = sorted.end() - next;
+        return std::vector<SortedId>(next, next + (count == 0 ? available : std::min(count, available)));
+    }, page);
+}
+
+#endif // PAGINATION_H
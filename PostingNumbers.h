@@ -0,0 +1,162 @@
+#ifndef POSTING_NUMBERS_H
+#define POSTING_NUMBERS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Repository.h"
+
+// The numbers an inverted index, such as TrigramIndex or FullTextIndex, lists its texts by in
+// its posting lists. Texts are numbered in the order they are added, so posting lists stay
+// sorted by appending. A removed or replaced text only loses its number; once the unused
+// numbers outnumber the texts, renumber gives the texts in use new numbers in the same order
+// and the index drops the other numbers from its lists. The index's lock guards the numbers.
+class PostingNumbers
+{
+public:
+    // Lists are compacted once this many numbers, and more than there are texts, are no
+    // longer in use.
+    static constexpr size_t compactAfterRemovals = 1024;
+
+    // The new number of a number that is no longer in use.
+    static constexpr uint32_t unused = UINT32_MAX;
+
+    // Getters
+    size_t size() const { return numbers.size(); }
+    bool empty() const { return numbers.empty(); }
+    const std::string& idOf(uint32_t number) const { return numberedIds[number]; }
+    bool isRemoved(uint32_t number) const { return removedNumbers[number]; }
+
+    // Finds the number of an id. Returns false if the id is not numbered.
+    bool find(const std::string& id, uint32_t& number) const
+    {
+        std::unordered_map<std::string, uint32_t>::const_iterator found = numbers.find(id);
+        if (found == numbers.end())
+            return false;
+        number = found->second;
+        return true;
+    }
+
+    // The ids, their numbers and the hash table's nodes and buckets.
+    size_t memoryBytes() const
+    {
+        const size_t nodeBytes = 2 * sizeof(void*);
+        size_t bytes = numberedIds.capacity() * sizeof(std::string) + removedNumbers.capacity() / 8;
+        for (const std::string& id : numberedIds)
+            bytes += stringHeapBytes(id);
+
+        bytes += numbers.bucket_count() * sizeof(void*);
+        for (const std::pair<const std::string, uint32_t>& number : numbers)
+            bytes += sizeof(number) + nodeBytes + stringHeapBytes(number.first);
+        return bytes;
+    }
+
+    // Changes. add gives an id the next number, taking its old one out of use.
+    uint32_t add(const std::string& id)
+    {
+        uint32_t number;
+        if (find(id, number))
+            retire(number);
+
+        number = numberedIds.size();
+        numberedIds.push_back(id);
+        removedNumbers.push_back(false);
+        numbers[id] = number;
+        return number;
+    }
+
+    void remove(const std::string& id)
+    {
+        std::unordered_map<std::string, uint32_t>::iterator found = numbers.find(id);
+        if (found == numbers.end())
+            return;
+        retire(found->second);
+        numbers.erase(found);
+    }
+
+    void clear()
+    {
+        numberedIds.clear();
+        removedNumbers.clear();
+        numbers.clear();
+        removedCount = 0;
+    }
+
+    // Renumbers the texts in use, once the unused numbers outnumber them. Returns false if it
+    // is not yet time; otherwise renumbered receives the new number of each old one, or unused.
+    bool renumber(std::vector<uint32_t>& renumbered)
+    {
+        if (removedCount < compactAfterRemovals || removedCount <= numbers.size())
+            return false;
+
+        renumbered.assign(numberedIds.size(), unused);
+        uint32_t next = 0;
+        for (size_t number = 0; number < numberedIds.size(); number++)
+        {
+            if (removedNumbers[number])
+                continue;
+            renumbered[number] = next;
+            numbers[numberedIds[number]] = next++;
+        }
+
+        keepRenumbered(numberedIds, renumbered);
+        removedNumbers.assign(numberedIds.size(), false);
+        removedCount = 0;
+        return true;
+    }
+
+    // Moves the values an index keeps per number to the new numbers, dropping the values of
+    // unused numbers.
+    template <typename V>
+    static void keepRenumbered(std::vector<V>& values, const std::vector<uint32_t>& renumbered)
+    {
+        size_t kept = 0;
+        for (size_t number = 0; number < values.size(); number++)
+        {
+            if (renumbered[number] == unused)
+                continue;
+            // A value that keeps its number is not moved onto itself, which empties a vector.
+            if (kept != number)
+                values[kept] = std::move(values[number]);
+            kept++;
+        }
+        values.resize(kept);
+        values.shrink_to_fit();
+    }
+
+    // Renumbers the entries of a posting list, dropping the entries of unused numbers. The
+    // list stays sorted. numberOf gives a reference to the number of an entry.
+    template <typename Entry, typename NumberOf>
+    static void renumberList(std::vector<Entry>& list, const std::vector<uint32_t>& renumbered, NumberOf numberOf)
+    {
+        size_t kept = 0;
+        for (Entry& entry : list)
+        {
+            uint32_t number = renumbered[numberOf(entry)];
+            if (number == unused)
+                continue;
+            numberOf(entry) = number;
+            list[kept++] = entry;
+        }
+        list.resize(kept);
+        list.shrink_to_fit();
+    }
+
+private:
+    // Takes a number out of use, leaving it in the posting lists until they are compacted.
+    void retire(uint32_t number)
+    {
+        removedNumbers[number] = true;
+        std::string().swap(numberedIds[number]);
+        removedCount++;
+    }
+
+    std::vector<std::string> numberedIds;
+    std::vector<bool> removedNumbers;
+    std::unordered_map<std::string, uint32_t> numbers;
+    size_t removedCount = 0;
+};
+
+#endif // POSTING_NUMBERS_H
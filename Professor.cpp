@@ -8,6 +8,8 @@
  */
 
 #include "Professor.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
 #include <algorithm> 
 
 using namespace crow;
@@ -27,7 +29,7 @@ Professor::Professor(crow::json::rvalue readValueJson) : User(readValueJson)
  * 
  * @return A JSON object containing the professor's details.
  */
-crow::json::wvalue Professor::convertToJson()
+crow::json::wvalue Professor::convertToJson() const
 {
     crow::json::wvalue writeJson = User::convertToJson();
 
@@ -42,6 +44,22 @@ crow::json::wvalue Professor::convertToJson()
     return writeJson;
 }
 
+/**
+ * @brief Writes the Professor object as JSON, the same text convertToJson().dump() gives.
+ * 
+ * Members are written in the order crow dumps them in, so both paths give the same bytes.
+ * 
+ * @param writer Receives the professor's details.
+ */
+void Professor::writeJson(JsonWriter& writer) const
+{
+    writer.beginObject();
+    writer.member("experimentIds", experimentIds);
+    writer.member("userName", getName());
+    writer.member("userId", getId());
+    writer.endObject();
+}
+
 /**
  * @brief Updates the Professor object from a JSON representation.
  * 
@@ -60,3 +78,25 @@ void Professor::updateFromJson(crow::json::rvalue readValueJson)
         }
     }
 }
+
+/**
+ * @brief Writes the Professor object as a binary snapshot record.
+ * 
+ * @param writer The writer for the record. Fields are written in a fixed order.
+ */
+void Professor::writeBinaryRecord(BinaryRecordWriter& writer) const
+{
+    User::writeBinaryRecord(writer);
+    writer.writeStringList(experimentIds);
+}
+
+/**
+ * @brief Reads the Professor object from a binary snapshot record.
+ * 
+ * @param reader The reader for the record. Fields are read in the order they were written.
+ */
+void Professor::readBinaryRecord(BinaryRecordReader& reader)
+{
+    User::readBinaryRecord(reader);
+    experimentIds = reader.readStringList();
+}
@@ -0,0 +1,35 @@
+#ifndef RELATED_CHANGES_H
+#define RELATED_CHANGES_H
+
+#include <crow.h>
+#include <mutex>
+#include <vector>
+#include "ChangeTracker.h"
+#include "WriteAheadLog.h"
+
+// The changes storing objects of type T makes to objects of other collections, such as the
+// lab an administrator manages. They are logged in the same append as the objects, before
+// them, and stored with them. Most types make none, which this template does; a type that
+// makes some specializes it.
+//
+// A create, an update or an import batch adds the JSON of each object it stores, then, under
+// the mutation lock, locks the changed objects, collects their records, appends them with
+// its own and stores them once the append succeeds.
+template <typename T>
+class RelatedChanges
+{
+public:
+    // Reads the changes in the JSON of one object. Throws runtime_error if they are invalid.
+    void add(const crow::json::rvalue& readValueJson) {}
+
+    // Locks the objects the added JSON changes, for as long as the locks are held.
+    std::vector<std::unique_lock<std::mutex>> lock() const { return {}; }
+
+    // Applies the added changes to the stored objects and lists their records.
+    void collect(std::vector<LogRecord>& records) {}
+
+    // Stores and tracks the collected objects, once their records are logged.
+    void store(ChangeTracker& tracker) {}
+};
+
+#endif // RELATED_CHANGES_H
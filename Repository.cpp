@@ -0,0 +1,1522 @@
+/**
+ * @file Repository.cpp
+ * @brief Implementation of the Repository template and its storage backends.
+ *
+ * Handlers reach every resource collection through a Repository, which forwards to the
+ * backend picked for that collection: immutable versions read without locks, hash table
+ * shards behind their own locks, the in-memory std::map the server always used, an in-memory hash table, or a log-structured
+ * file that keeps only an index in memory. Backends that are not safe to share between
+ * threads are put behind a single reader-writer lock.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "Repository.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
+
+using namespace std;
+
+/**
+ * @brief Replaces every object in the backend.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param data The new objects, keyed by id.
+ */
+template <typename T>
+void RepositoryBackend<T>::assign(map<string, T>&& data)
+{
+    clear();
+    for (const pair<const string, T>& keyValuePair : data)
+        put(keyValuePair.first, keyValuePair.second);
+}
+
+/**
+ * @brief Gets an object serialized as JSON.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param json Receives the JSON text.
+ * @return True if the object was found, false otherwise.
+ */
+template <typename T>
+bool RepositoryBackend<T>::getJson(const string& id, string& json) const
+{
+    T object;
+    if (!get(id, object))
+        return false;
+
+    json = toJsonString(object);
+    return true;
+}
+
+/**
+ * @brief Visits every object in id order, serialized as JSON.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param visit Called with the id and the JSON text of the object.
+ */
+template <typename T>
+void RepositoryBackend<T>::scanJson(const function<void(const string&, const string&)>& visit) const
+{
+    string json;
+    scan([&visit, &json](const string& id, const T& object)
+    {
+        json.clear();
+        JsonWriter writer(json);
+        object.writeJson(writer);
+        visit(id, json);
+    });
+}
+
+/**
+ * @brief Gets a copy of an object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object Receives the object.
+ * @return True if the object was found, false otherwise.
+ */
+template <typename T>
+bool MapBackend<T>::get(const string& id, T& object) const
+{
+    typename map<string, T>::const_iterator found = objects.find(id);
+    if (found == objects.end())
+        return false;
+
+    object = found->second;
+    return true;
+}
+
+/**
+ * @brief Adds an object or replaces the object with the same id.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object The object.
+ */
+template <typename T>
+void MapBackend<T>::put(const string& id, const T& object)
+{
+    objects[id] = object;
+}
+
+/**
+ * @brief Removes an object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @return True if the object was there, false otherwise.
+ */
+template <typename T>
+bool MapBackend<T>::erase(const string& id)
+{
+    return objects.erase(id) > 0;
+}
+
+/**
+ * @brief Removes every object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+void MapBackend<T>::clear()
+{
+    objects.clear();
+}
+
+/**
+ * @brief Visits every object in id order.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param visit Called with the id and the object.
+ */
+template <typename T>
+void MapBackend<T>::scan(const function<void(const string&, const T&)>& visit) const
+{
+    for (const pair<const string, T>& keyValuePair : objects)
+        visit(keyValuePair.first, keyValuePair.second);
+}
+
+/**
+ * @brief Takes over a whole map of objects without copying them.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param data The new objects, keyed by id.
+ */
+template <typename T>
+void MapBackend<T>::assign(map<string, T>&& data)
+{
+    objects = std::move(data);
+}
+
+/**
+ * @brief Gets a copy of an object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object Receives the object.
+ * @return True if the object was found, false otherwise.
+ */
+template <typename T>
+bool HashBackend<T>::get(const string& id, T& object) const
+{
+    typename unordered_map<string, T>::const_iterator found = objects.find(id);
+    if (found == objects.end())
+        return false;
+
+    object = found->second;
+    return true;
+}
+
+/**
+ * @brief Adds an object or replaces the object with the same id.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object The object.
+ */
+template <typename T>
+void HashBackend<T>::put(const string& id, const T& object)
+{
+    objects[id] = object;
+}
+
+/**
+ * @brief Removes an object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @return True if the object was there, false otherwise.
+ */
+template <typename T>
+bool HashBackend<T>::erase(const string& id)
+{
+    return objects.erase(id) > 0;
+}
+
+/**
+ * @brief Removes every object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+void HashBackend<T>::clear()
+{
+    objects.clear();
+}
+
+/**
+ * @brief Visits every object in id order.
+ *
+ * The table has no order of its own, so the entries are sorted by id first.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param visit Called with the id and the object.
+ */
+template <typename T>
+void HashBackend<T>::scan(const function<void(const string&, const T&)>& visit) const
+{
+    vector<const pair<const string, T>*> entries;
+    entries.reserve(objects.size());
+    for (const pair<const string, T>& keyValuePair : objects)
+        entries.push_back(&keyValuePair);
+
+    sort(entries.begin(), entries.end(), [](const pair<const string, T>* a, const pair<const string, T>* b) { return a->first < b->first; });
+
+    for (const pair<const string, T>* entry : entries)
+        visit(entry->first, entry->second);
+}
+
+/**
+ * @brief Replaces every object in the backend.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param data The new objects, keyed by id.
+ */
+template <typename T>
+void HashBackend<T>::assign(map<string, T>&& data)
+{
+    objects.clear();
+    objects.reserve(data.size());
+    for (pair<const string, T>& keyValuePair : data)
+        objects.emplace(keyValuePair.first, std::move(keyValuePair.second));
+}
+
+/**
+ * @brief Creates an empty backend.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param shardCountInput The number of shards. More shards mean fewer threads waiting on the same lock.
+ */
+template <typename T>
+ShardedBackend<T>::ShardedBackend(size_t shardCountInput)
+    : shardCount(max<size_t>(shardCountInput, 1)), shards(new Shard[max<size_t>(shardCountInput, 1)]), count(0)
+{
+}
+
+/**
+ * @brief Gets a copy of an object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object Receives the object.
+ * @return True if the object was found, false otherwise.
+ */
+template <typename T>
+bool ShardedBackend<T>::get(const string& id, T& object) const
+{
+    Shard& shard = shardFor(id);
+    shared_lock<shared_mutex> reading(shard.lock);
+    typename unordered_map<string, T>::const_iterator found = shard.objects.find(id);
+    if (found == shard.objects.end())
+        return false;
+
+    object = found->second;
+    return true;
+}
+
+/**
+ * @brief Adds an object or replaces the object with the same id.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object The object.
+ */
+template <typename T>
+void ShardedBackend<T>::put(const string& id, const T& object)
+{
+    Shard& shard = shardFor(id);
+    unique_lock<shared_mutex> writing(shard.lock);
+    pair<typename unordered_map<string, T>::iterator, bool> inserted = shard.objects.insert_or_assign(id, object);
+    if (inserted.second)
+        count++;
+}
+
+/**
+ * @brief Removes an object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @return True if the object was there, false otherwise.
+ */
+template <typename T>
+bool ShardedBackend<T>::erase(const string& id)
+{
+    Shard& shard = shardFor(id);
+    unique_lock<shared_mutex> writing(shard.lock);
+    if (shard.objects.erase(id) == 0)
+        return false;
+
+    count--;
+    return true;
+}
+
+/**
+ * @brief Removes every object.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+void ShardedBackend<T>::clear()
+{
+    for (size_t i = 0; i < shardCount; i++)
+    {
+        unique_lock<shared_mutex> writing(shards[i].lock);
+        count -= shards[i].objects.size();
+        shards[i].objects.clear();
+    }
+}
+
+/**
+ * @brief Visits every object in id order.
+ *
+ * Every shard is read locked for the whole scan, so the objects visited are one consistent
+ * state of the collection and are not copied. Writers wait until the scan ends, and visit
+ * must not call back into the same repository.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param visit Called with the id and the object.
+ */
+template <typename T>
+void ShardedBackend<T>::scan(const function<void(const string&, const T&)>& visit) const
+{
+    vector<shared_lock<shared_mutex>> reading;
+    reading.reserve(shardCount);
+    for (size_t i = 0; i < shardCount; i++)
+        reading.emplace_back(shards[i].lock);
+
+    vector<const pair<const string, T>*> entries;
+    entries.reserve(count.load());
+    for (size_t i = 0; i < shardCount; i++)
+    {
+        for (const pair<const string, T>& keyValuePair : shards[i].objects)
+            entries.push_back(&keyValuePair);
+    }
+
+    sort(entries.begin(), entries.end(), [](const pair<const string, T>* a, const pair<const string, T>* b) { return a->first < b->first; });
+
+    for (const pair<const string, T>* entry : entries)
+        visit(entry->first, entry->second);
+}
+
+/**
+ * @brief Replaces every object in the backend.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param data The new objects, keyed by id.
+ */
+template <typename T>
+void ShardedBackend<T>::assign(map<string, T>&& data)
+{
+    vector<unordered_map<string, T>> sharded(shardCount);
+    for (pair<const string, T>& keyValuePair : data)
+        sharded[hash<string>()(keyValuePair.first) % shardCount].emplace(keyValuePair.first, std::move(keyValuePair.second));
+
+    for (size_t i = 0; i < shardCount; i++)
+    {
+        unique_lock<shared_mutex> writing(shards[i].lock);
+        count -= shards[i].objects.size();
+        count += sharded[i].size();
+        shards[i].objects = std::move(sharded[i]);
+    }
+}
+
+/**
+ * @brief Creates an empty backend.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param sliceCountInput The number of slices. A write copies one slice, so more slices mean
+ * cheaper writes.
+ */
+template <typename T>
+VersionedBackend<T>::VersionedBackend(size_t sliceCountInput) : sliceCount(max<size_t>(sliceCountInput, 1))
+{
+    current.store(emptyVersion());
+}
+
+/**
+ * @brief Frees the current version and every retired one. No reader may still be using the
+ * backend.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+VersionedBackend<T>::~VersionedBackend()
+{
+    for (vector<Version*>& versions : retired)
+    {
+        for (Version* version : versions)
+            delete version;
+    }
+    delete current.load();
+}
+
+/**
+ * @brief Announces the calling thread as a reader of the current epoch and takes the
+ * current version.
+ *
+ * The reader counts in the stripe of its thread. If a writer moves to the next epoch between
+ * reading the epoch and counting, the reader counts again in the new epoch, so a writer
+ * waiting for an epoch to drain never misses one.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param backend The backend to read.
+ */
+template <typename T>
+VersionedBackend<T>::ReadGuard::ReadGuard(const VersionedBackend& backend)
+{
+    size_t stripe = hash<thread::id>()(this_thread::get_id()) % readerStripes;
+    while (true)
+    {
+        uint64_t readEpoch = backend.epoch.load();
+        readers = &backend.readerCounts[readEpoch & 1][stripe].readers;
+        (*readers)++;
+        if (backend.epoch.load() == readEpoch)
+            break;
+        (*readers)--;
+    }
+    current = backend.current.load();
+}
+
+/**
+ * @brief Stops counting the calling thread as a reader.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+VersionedBackend<T>::ReadGuard::~ReadGuard()
+{
+    (*readers)--;
+}
+
+/**
+ * @brief Creates a version with no objects.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @return The version, owned by the caller.
+ */
+template <typename T>
+typename VersionedBackend<T>::Version* VersionedBackend<T>::emptyVersion() const
+{
+    Version* empty = new Version();
+    shared_ptr<const Slice> emptySlice(new Slice());
+    empty->slices.assign(sliceCount, emptySlice);
+    return empty;
+}
+
+/**
+ * @brief Checks whether any reader counted in an epoch is still reading.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param readEpoch The epoch.
+ * @return True if a reader of the epoch is still reading, false otherwise.
+ */
+template <typename T>
+bool VersionedBackend<T>::hasReaders(uint64_t readEpoch) const
+{
+    for (size_t stripe = 0; stripe < readerStripes; stripe++)
+    {
+        if (readerCounts[readEpoch & 1][stripe].readers.load() != 0)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Publishes a new version of the collection and retires the one it replaces.
+ *
+ * Only readers of the current and the previous epoch can be reading. Once the readers of
+ * the previous epoch are gone, the epoch moves on and the versions replaced during the
+ * previous epoch are freed: every reader that could have seen them is done. Must be called
+ * with writerMutex held.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param next The new version. The backend takes ownership of it.
+ */
+template <typename T>
+void VersionedBackend<T>::publish(Version* next)
+{
+    Version* previous = current.load();
+    next->number = previous->number + 1;
+    current.store(next);
+
+    uint64_t currentEpoch = epoch.load();
+    retired[currentEpoch & 1].push_back(previous);
+
+    if (currentEpoch == 0 || !hasReaders(currentEpoch - 1))
+    {
+        vector<Version*>& freeable = retired[(currentEpoch + 1) & 1];
+        epoch.store(currentEpoch + 1);
+        for (Version* version : freeable)
+            delete version;
+        freeable.clear();
+    }
+}
+
+/**
+ * @brief Counts the objects in the current version.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @return The number of objects.
+ */
+template <typename T>
+size_t VersionedBackend<T>::size() const
+{
+    ReadGuard reading(*this);
+    return reading.version().count;
+}
+
+/**
+ * @brief Gets the number of the current version, which goes up with every change.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @return The version number.
+ */
+template <typename T>
+uint64_t VersionedBackend<T>::getVersion() const
+{
+    ReadGuard reading(*this);
+    return reading.version().number;
+}
+
+/**
+ * @brief Gets a copy of an object from the current version without taking a lock.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object Receives the object.
+ * @return True if the object was found, false otherwise.
+ */
+template <typename T>
+bool VersionedBackend<T>::get(const string& id, T& object) const
+{
+    ReadGuard reading(*this);
+    const Slice& slice = *reading.version().slices[sliceFor(id)];
+    typename Slice::const_iterator found = slice.find(id);
+    if (found == slice.end())
+        return false;
+
+    object = found->second->object;
+    return true;
+}
+
+/**
+ * @brief Adds an object or replaces the object with the same id, publishing a new version.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object The object.
+ */
+template <typename T>
+void VersionedBackend<T>::put(const string& id, const T& object)
+{
+    shared_ptr<const Entry> stored(new Entry(object));
+
+    lock_guard<mutex> writing(writerMutex);
+    Version* next = new Version(*current.load());
+    size_t index = sliceFor(id);
+    shared_ptr<Slice> slice(new Slice(*next->slices[index]));
+    if (slice->insert_or_assign(id, std::move(stored)).second)
+        next->count++;
+    next->slices[index] = std::move(slice);
+    publish(next);
+}
+
+/**
+ * @brief Removes an object, publishing a new version.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @return True if the object was there, false otherwise.
+ */
+template <typename T>
+bool VersionedBackend<T>::erase(const string& id)
+{
+    lock_guard<mutex> writing(writerMutex);
+    size_t index = sliceFor(id);
+    if (current.load()->slices[index]->count(id) == 0)
+        return false;
+
+    Version* next = new Version(*current.load());
+    shared_ptr<Slice> slice(new Slice(*next->slices[index]));
+    slice->erase(id);
+    next->count--;
+    next->slices[index] = std::move(slice);
+    publish(next);
+    return true;
+}
+
+/**
+ * @brief Removes every object, publishing an empty version.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+void VersionedBackend<T>::clear()
+{
+    lock_guard<mutex> writing(writerMutex);
+    publish(emptyVersion());
+}
+
+/**
+ * @brief Visits every object of the current version in id order, without taking a lock.
+ *
+ * The whole scan sees the one version it started with, whatever is written meanwhile, and
+ * visit may call back into the repository.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param visit Called with the id and the object.
+ */
+template <typename T>
+void VersionedBackend<T>::scan(const function<void(const string&, const T&)>& visit) const
+{
+    ReadGuard reading(*this);
+    for (const typename Slice::value_type* entry : sortedEntries(reading.version()))
+        visit(entry->first, entry->second->object);
+}
+
+/**
+ * @brief Visits every object of the current version in id order as JSON, without taking a
+ * lock. Objects serialized before are not serialized again.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param visit Called with the id and the JSON text of the object.
+ */
+template <typename T>
+void VersionedBackend<T>::scanJson(const function<void(const string&, const string&)>& visit) const
+{
+    ReadGuard reading(*this);
+    for (const typename Slice::value_type* entry : sortedEntries(reading.version()))
+        visit(entry->first, entryJson(*entry->second));
+}
+
+/**
+ * @brief Lists the entries of a version in id order.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param version The version.
+ * @return Pointers to the entries, valid for as long as the version is read.
+ */
+template <typename T>
+vector<const typename VersionedBackend<T>::Slice::value_type*> VersionedBackend<T>::sortedEntries(const Version& version) const
+{
+    vector<const typename Slice::value_type*> entries;
+    entries.reserve(version.count);
+    for (const shared_ptr<const Slice>& slice : version.slices)
+    {
+        for (const typename Slice::value_type& keyValuePair : *slice)
+            entries.push_back(&keyValuePair);
+    }
+
+    sort(entries.begin(), entries.end(), [](const typename Slice::value_type* a, const typename Slice::value_type* b) { return a->first < b->first; });
+    return entries;
+}
+
+/**
+ * @brief Gets the JSON of an entry, serializing the object the first time.
+ *
+ * Two readers serializing at once both get the right JSON and only one copy is kept.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param entry The entry.
+ * @return The JSON text, valid for as long as the entry lives.
+ */
+template <typename T>
+const string& VersionedBackend<T>::entryJson(const Entry& entry) const
+{
+    const string* cached = entry.json.load();
+    if (cached == nullptr)
+    {
+        const string* serialized = new string(toJsonString(entry.object));
+        if (entry.json.compare_exchange_strong(cached, serialized))
+            cached = serialized;
+        else
+            delete serialized;
+    }
+    return *cached;
+}
+
+/**
+ * @brief Gets an object of the current version serialized as JSON, without taking a lock.
+ *
+ * The first reader of an object serializes it and keeps the JSON in the entry; later readers
+ * copy the kept JSON.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param json Receives the JSON text.
+ * @return True if the object was found, false otherwise.
+ */
+template <typename T>
+bool VersionedBackend<T>::getJson(const string& id, string& json) const
+{
+    ReadGuard reading(*this);
+    const Slice& slice = *reading.version().slices[sliceFor(id)];
+    typename Slice::const_iterator found = slice.find(id);
+    if (found == slice.end())
+        return false;
+
+    json = entryJson(*found->second);
+    return true;
+}
+
+/**
+ * @brief Replaces every object, publishing them as one new version.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param data The new objects, keyed by id.
+ */
+template <typename T>
+void VersionedBackend<T>::assign(map<string, T>&& data)
+{
+    Version* next = emptyVersion();
+    vector<shared_ptr<Slice>> slices;
+    for (size_t i = 0; i < sliceCount; i++)
+        slices.emplace_back(new Slice());
+    for (pair<const string, T>& keyValuePair : data)
+    {
+        shared_ptr<Slice>& slice = slices[sliceFor(keyValuePair.first)];
+        slice->emplace_hint(slice->end(), keyValuePair.first, make_shared<const Entry>(std::move(keyValuePair.second)));
+    }
+    next->count = data.size();
+    next->slices.assign(slices.begin(), slices.end());
+
+    lock_guard<mutex> writing(writerMutex);
+    publish(next);
+}
+
+/**
+ * @brief Counts the objects.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @return The number of objects.
+ */
+template <typename T>
+size_t LockedBackend<T>::size() const
+{
+    shared_lock<shared_mutex> reading(lock);
+    return backend->size();
+}
+
+/**
+ * @brief Gets a copy of an object under the read lock.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object Receives the object.
+ * @return True if the object was found, false otherwise.
+ */
+template <typename T>
+bool LockedBackend<T>::get(const string& id, T& object) const
+{
+    shared_lock<shared_mutex> reading(lock);
+    return backend->get(id, object);
+}
+
+/**
+ * @brief Adds or replaces an object under the write lock.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object The object.
+ */
+template <typename T>
+void LockedBackend<T>::put(const string& id, const T& object)
+{
+    unique_lock<shared_mutex> writing(lock);
+    backend->put(id, object);
+}
+
+/**
+ * @brief Removes an object under the write lock.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @return True if the object was there, false otherwise.
+ */
+template <typename T>
+bool LockedBackend<T>::erase(const string& id)
+{
+    unique_lock<shared_mutex> writing(lock);
+    return backend->erase(id);
+}
+
+/**
+ * @brief Removes every object under the write lock.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+void LockedBackend<T>::clear()
+{
+    unique_lock<shared_mutex> writing(lock);
+    backend->clear();
+}
+
+/**
+ * @brief Visits every object in id order under the read lock.
+ *
+ * The lock is held while visit runs, so visit must not call back into the same repository.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param visit Called with the id and the object.
+ */
+template <typename T>
+void LockedBackend<T>::scan(const function<void(const string&, const T&)>& visit) const
+{
+    shared_lock<shared_mutex> reading(lock);
+    backend->scan(visit);
+}
+
+/**
+ * @brief Replaces every object under the write lock.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param data The new objects, keyed by id.
+ */
+template <typename T>
+void LockedBackend<T>::assign(map<string, T>&& data)
+{
+    unique_lock<shared_mutex> writing(lock);
+    backend->assign(std::move(data));
+}
+
+/**
+ * @brief Creates the backend over an empty file.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param filenameInput The file the records are appended to. Anything in it is discarded.
+ * @throws runtime_error if the file cannot be created.
+ */
+template <typename T>
+LogStructuredBackend<T>::LogStructuredBackend(string filenameInput) : filename(filenameInput)
+{
+    fileDescriptor = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0)
+        throw runtime_error("Can't create " + filename);
+}
+
+/**
+ * @brief Closes and removes the file.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+LogStructuredBackend<T>::~LogStructuredBackend()
+{
+    if (fileDescriptor >= 0)
+        close(fileDescriptor);
+    remove(filename.c_str());
+}
+
+/**
+ * @brief Reads an object from the file.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object Receives the object.
+ * @return True if the object was found, false otherwise.
+ * @throws runtime_error if the record cannot be read back.
+ */
+template <typename T>
+bool LogStructuredBackend<T>::get(const string& id, T& object) const
+{
+    typename map<string, Location>::const_iterator found = index.find(id);
+    if (found == index.end())
+        return false;
+
+    string bytes = readRecord(found->second);
+    BinaryRecordReader reader = PackedBinaryRecord::unpack(bytes);
+    object.readBinaryRecord(reader);
+    return true;
+}
+
+/**
+ * @brief Appends an object to the file; an older record with the same id becomes garbage.
+ *
+ * The file is compacted once more than half of it is garbage.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @param object The object.
+ * @throws runtime_error if the record cannot be written.
+ */
+template <typename T>
+void LogStructuredBackend<T>::put(const string& id, const T& object)
+{
+    PackedBinaryRecord record;
+    BinaryRecordWriter writer = record.writer();
+    object.writeBinaryRecord(writer);
+    string bytes = record.pack();
+
+    writeRecord(bytes, fileBytes);
+
+    typename map<string, Location>::iterator found = index.find(id);
+    if (found != index.end())
+    {
+        garbageBytes += found->second.length;
+        found->second = {fileBytes, bytes.size()};
+    }
+    else
+    {
+        index.emplace(id, Location{fileBytes, bytes.size()});
+    }
+    fileBytes += bytes.size();
+
+    if (garbageBytes > 1024 * 1024 && garbageBytes * 2 > fileBytes)
+        compact();
+}
+
+/**
+ * @brief Forgets an object; its record becomes garbage.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param id The id of the object.
+ * @return True if the object was there, false otherwise.
+ */
+template <typename T>
+bool LogStructuredBackend<T>::erase(const string& id)
+{
+    typename map<string, Location>::iterator found = index.find(id);
+    if (found == index.end())
+        return false;
+
+    garbageBytes += found->second.length;
+    index.erase(found);
+    return true;
+}
+
+/**
+ * @brief Removes every object and replaces the file with an empty one.
+ *
+ * The file is replaced rather than truncated, so a forked snapshot still reading the old
+ * file is not affected.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ */
+template <typename T>
+void LogStructuredBackend<T>::clear()
+{
+    index.clear();
+    compact();
+}
+
+/**
+ * @brief Reads every object from the file in id order.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param visit Called with the id and the object.
+ * @throws runtime_error if a record cannot be read back.
+ */
+template <typename T>
+void LogStructuredBackend<T>::scan(const function<void(const string&, const T&)>& visit) const
+{
+    for (const pair<const string, Location>& keyValuePair : index)
+    {
+        string bytes = readRecord(keyValuePair.second);
+        BinaryRecordReader reader = PackedBinaryRecord::unpack(bytes);
+        T object;
+        object.readBinaryRecord(reader);
+        visit(keyValuePair.first, object);
+    }
+}
+
+/**
+ * @brief Rewrites the file with only the live records, in id order.
+ *
+ * The live records are copied to a new file which then replaces the old one.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @throws runtime_error if the new file cannot be written.
+ */
+template <typename T>
+void LogStructuredBackend<T>::compact()
+{
+    string compactFilename = filename + ".compact";
+    int compactDescriptor = open(compactFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (compactDescriptor < 0)
+        throw runtime_error("Can't create " + compactFilename);
+
+    map<string, Location> compactIndex;
+    uint64_t offset = 0;
+    for (const pair<const string, Location>& keyValuePair : index)
+    {
+        string bytes = readRecord(keyValuePair.second);
+        if (pwrite(compactDescriptor, bytes.data(), bytes.size(), offset) != (ssize_t)bytes.size())
+        {
+            close(compactDescriptor);
+            remove(compactFilename.c_str());
+            throw runtime_error("Can't write " + compactFilename);
+        }
+        compactIndex.emplace_hint(compactIndex.end(), keyValuePair.first, Location{offset, bytes.size()});
+        offset += bytes.size();
+    }
+
+    if (rename(compactFilename.c_str(), filename.c_str()) != 0)
+    {
+        close(compactDescriptor);
+        remove(compactFilename.c_str());
+        throw runtime_error("Can't replace " + filename);
+    }
+
+    close(fileDescriptor);
+    fileDescriptor = compactDescriptor;
+    index = std::move(compactIndex);
+    fileBytes = offset;
+    garbageBytes = 0;
+}
+
+/**
+ * @brief Reads the bytes of one record.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param location Where the record lies in the file.
+ * @return The packed record.
+ * @throws runtime_error if the record cannot be read.
+ */
+template <typename T>
+string LogStructuredBackend<T>::readRecord(const Location& location) const
+{
+    string bytes(location.length, '\0');
+    if (pread(fileDescriptor, &bytes[0], location.length, location.offset) != (ssize_t)location.length)
+        throw runtime_error("Can't read a record from " + filename);
+    return bytes;
+}
+
+/**
+ * @brief Writes the bytes of one record.
+ *
+ * @tparam T The type of the objects stored in the backend.
+ * @param bytes The packed record.
+ * @param offset Where to write it.
+ * @throws runtime_error if the record cannot be written.
+ */
+template <typename T>
+void LogStructuredBackend<T>::writeRecord(const string& bytes, uint64_t offset)
+{
+    if (pwrite(fileDescriptor, bytes.data(), bytes.size(), offset) != (ssize_t)bytes.size())
+        throw runtime_error("Can't write a record to " + filename);
+}
+
+/**
+ * @brief Checks whether an object is in the repository.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param id The id of the object.
+ * @return True if the object is there, false otherwise.
+ */
+template <typename T>
+bool Repository<T>::contains(const string& id) const
+{
+    T object;
+    return backend->get(id, object);
+}
+
+/**
+ * @brief Moves the objects to another backend.
+ *
+ * Not safe to call while other threads use the repository; call it before serving requests.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param backendInput The new backend. The objects already stored are copied into it. A
+ * backend that is not safe to share between threads is put behind a lock.
+ */
+template <typename T>
+void Repository<T>::setBackend(unique_ptr<RepositoryBackend<T>> backendInput)
+{
+    if (!backendInput->isConcurrent())
+        backendInput.reset(new LockedBackend<T>(std::move(backendInput)));
+
+    map<string, T> objects;
+    backend->scan([&objects](const string& id, const T& object) { objects.emplace_hint(objects.end(), id, object); });
+    backendInput->assign(std::move(objects));
+    backend = std::move(backendInput);
+    version++;
+}
+
+/**
+ * @brief Gets a copy of an object.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param id The id of the object.
+ * @return The object.
+ * @throws out_of_range if there is no object with the id, like std::map::at.
+ */
+template <typename T>
+T Repository<T>::at(const string& id) const
+{
+    T object;
+    if (!backend->get(id, object))
+        throw out_of_range("No resource with id " + id);
+    return object;
+}
+
+/**
+ * @brief Gets an object serialized as JSON, from the backend's cache when it keeps one.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param id The id of the object.
+ * @param json Receives the JSON text.
+ * @return True if the object was found, false otherwise.
+ */
+template <typename T>
+bool Repository<T>::getJson(const string& id, string& json) const
+{
+    if (cacheSerialized)
+        return backend->getJson(id, json);
+
+    T object;
+    if (!backend->get(id, object))
+        return false;
+
+    json = toJsonString(object);
+    return true;
+}
+
+/**
+ * @brief Gets the whole collection serialized as a JSON list, in id order.
+ *
+ * The list is built once per version of the collection and copied out to every caller
+ * until the next change. A change made while the list is built makes the next call build
+ * it again, so callers never get a list older than the changes they have seen.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param json Receives the JSON text.
+ */
+template <typename T>
+void Repository<T>::getAllJson(string& json) const
+{
+    if (!cacheSerialized)
+    {
+        json = *buildAllJson();
+        return;
+    }
+
+    shared_ptr<const string> built;
+    {
+        lock_guard<mutex> building(allJsonMutex);
+        uint64_t readVersion = version.load();
+        if (!allJson || allJsonVersion != readVersion)
+        {
+            allJson = buildAllJson();
+            allJsonVersion = readVersion;
+        }
+        built = allJson;
+    }
+    json = *built;
+}
+
+/**
+ * @brief Serializes the whole collection as a JSON list, the way crow dumps a list of the
+ * objects. An empty collection is "null", as an unset crow value is.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @return The JSON text.
+ */
+template <typename T>
+shared_ptr<const string> Repository<T>::buildAllJson() const
+{
+    shared_ptr<string> json(new string());
+    JsonWriter writer(*json);
+    writer.beginList();
+    if (cacheSerialized)
+        backend->scanJson([&writer](const string& id, const string& objectJson) { writer.rawValue(objectJson); });
+    else
+        backend->scan([&writer](const string& id, const T& object) { object.writeJson(writer); });
+    writer.endList();
+    return json;
+}
+
+/**
+ * @brief Serializes the whole collection as a JSON list in pieces, without ever holding the
+ * whole list. The objects come from one version of the collection, as getAllJson's do.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param write Called with each piece of the JSON text, in order.
+ * @param chunkBytes The size a piece grows to before it is handed to write.
+ */
+template <typename T>
+void Repository<T>::writeAllJson(const function<void(const string&)>& write, size_t chunkBytes) const
+{
+    string chunk;
+    JsonWriter writer(chunk);
+    bool empty = true;
+
+    // Hand a piece out once it is big enough. The writer keeps its place in the list, so the
+    // next object still gets its comma.
+    auto written = [&]() {
+        empty = false;
+        if (chunk.size() >= chunkBytes)
+        {
+            write(chunk);
+            chunk.clear();
+        }
+    };
+
+    writer.beginArray();
+    if (cacheSerialized)
+        backend->scanJson([&](const string& id, const string& objectJson) { writer.rawValue(objectJson); written(); });
+    else
+        backend->scan([&](const string& id, const T& object) { object.writeJson(writer); written(); });
+
+    // An empty collection is "null", as in getAllJson.
+    if (empty)
+        chunk = "null";
+    else
+        writer.endArray();
+    write(chunk);
+}
+
+/**
+ * @brief Serializes the whole collection as newline-delimited JSON in pieces: each object on
+ * a line of its own, in id order. The objects come from one version of the collection, as
+ * writeAllJson's do.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param write Called with each piece of the text, in order. Nothing is written for an empty
+ * collection.
+ * @param chunkBytes The size a piece grows to before it is handed to write.
+ */
+template <typename T>
+void Repository<T>::writeAllNdjson(const function<void(const string&)>& write, size_t chunkBytes) const
+{
+    string chunk;
+    auto written = [&]() {
+        chunk += '\n';
+        if (chunk.size() >= chunkBytes)
+        {
+            write(chunk);
+            chunk.clear();
+        }
+    };
+
+    if (cacheSerialized)
+        backend->scanJson([&](const string& id, const string& objectJson) { chunk += objectJson; written(); });
+    else
+        backend->scan([&](const string& id, const T& object) { JsonWriter writer(chunk); object.writeJson(writer); written(); });
+
+    if (!chunk.empty())
+        write(chunk);
+}
+
+/**
+ * @brief Gets the ids of every object sorted by a key, then by id.
+ *
+ * A list is sorted once per version of the collection and shared by every caller until the
+ * next change, so a page of it costs a binary search and the page itself.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param orderName The name of the order, e.g. "cost".
+ * @param sortKey Gets the key of an object, or null to sort by id alone.
+ * @return The sorted ids with their keys.
+ */
+template <typename T>
+shared_ptr<const vector<SortedId>> Repository<T>::getSorted(const string& orderName, const function<SortKey(const T&)>& sortKey) const
+{
+    lock_guard<mutex> sorting(sortedMutex);
+    uint64_t readVersion = version.load();
+    pair<uint64_t, shared_ptr<const vector<SortedId>>>& sorted = sortedLists[orderName];
+    if (sorted.second && sorted.first == readVersion)
+        return sorted.second;
+
+    // Objects are visited in id order, which is already the order when there is no key.
+    shared_ptr<vector<SortedId>> ids(new vector<SortedId>());
+    ids->reserve(backend->size());
+    backend->scan([&](const string& id, const T& object) { ids->push_back(SortedId{sortKey ? sortKey(object) : SortKey(), id}); });
+    if (sortKey)
+        sort(ids->begin(), ids->end());
+
+    sorted = make_pair(readVersion, shared_ptr<const vector<SortedId>>(ids));
+    return sorted.second;
+}
+
+/**
+ * @brief Adds an object or replaces the object with the same id.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param id The id of the object.
+ * @param object The object.
+ */
+template <typename T>
+void Repository<T>::put(const string& id, const T& object)
+{
+    if (indexes.empty())
+        backend->put(id, object);
+    else
+    {
+        lock_guard<mutex> indexing(indexMutex);
+        backend->put(id, object);
+        for (pair<const string, shared_ptr<RepositoryIndex<T>>>& index : indexes)
+            index.second->put(id, object);
+    }
+    version++;
+}
+
+/**
+ * @brief Removes an object.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param id The id of the object.
+ * @return True if the object was there, false otherwise.
+ */
+template <typename T>
+bool Repository<T>::erase(const string& id)
+{
+    unique_lock<mutex> indexing(indexMutex, defer_lock);
+    if (!indexes.empty())
+        indexing.lock();
+
+    if (!backend->erase(id))
+        return false;
+
+    for (pair<const string, shared_ptr<RepositoryIndex<T>>>& index : indexes)
+        index.second->erase(id);
+    version++;
+    return true;
+}
+
+/**
+ * @brief Removes every object.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ */
+template <typename T>
+void Repository<T>::clear()
+{
+    lock_guard<mutex> indexing(indexMutex);
+    backend->clear();
+    for (pair<const string, shared_ptr<RepositoryIndex<T>>>& index : indexes)
+        index.second->clear();
+    version++;
+}
+
+/**
+ * @brief Replaces every object.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param data The new objects, keyed by id.
+ */
+template <typename T>
+void Repository<T>::assign(map<string, T>&& data)
+{
+    lock_guard<mutex> indexing(indexMutex);
+    backend->assign(std::move(data));
+    rebuildIndexes();
+    version++;
+}
+
+/**
+ * @brief Adds an index and builds it from the objects already in the repository.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param name The name the index is found by, e.g. "title".
+ * @param index The index.
+ */
+template <typename T>
+void Repository<T>::addIndex(const string& name, shared_ptr<RepositoryIndex<T>> index)
+{
+    lock_guard<mutex> indexing(indexMutex);
+    index->clear();
+    backend->scan([&index](const string& id, const T& object) { index->put(id, object); });
+    indexes[name] = index;
+}
+
+/**
+ * @brief Gets an index by name.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @tparam I The type of the index.
+ * @param name The name of the index.
+ * @return The index, or null if the repository has no index of that name and type.
+ */
+template <typename T>
+template <typename I>
+shared_ptr<I> Repository<T>::getIndex(const string& name) const
+{
+    typename map<string, shared_ptr<RepositoryIndex<T>>>::const_iterator found = indexes.find(name);
+    if (found == indexes.end())
+        return nullptr;
+    return dynamic_pointer_cast<I>(found->second);
+}
+
+/**
+ * @brief Gets the memory the indexes take.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @return The bytes of every index together.
+ */
+template <typename T>
+size_t Repository<T>::getIndexBytes() const
+{
+    size_t bytes = 0;
+    for (const pair<const string, shared_ptr<RepositoryIndex<T>>>& index : indexes)
+        bytes += index.second->memoryBytes();
+    return bytes;
+}
+
+/**
+ * @brief Builds every index again from the objects in the repository, with the index lock
+ * held.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ */
+template <typename T>
+void Repository<T>::rebuildIndexes()
+{
+    if (indexes.empty())
+        return;
+
+    for (pair<const string, shared_ptr<RepositoryIndex<T>>>& index : indexes)
+        index.second->clear();
+    backend->scan([this](const string& id, const T& object) {
+        for (pair<const string, shared_ptr<RepositoryIndex<T>>>& index : indexes)
+            index.second->put(id, object);
+    });
+}
+
+/**
+ * @brief Locks one object for a read, check and write by a handler.
+ *
+ * Objects share locks, so a handler must not lock a second object of the same repository
+ * while it holds one.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param id The id of the object.
+ * @return The lock, held until it is destroyed.
+ */
+template <typename T>
+unique_lock<mutex> Repository<T>::lockObject(const string& id) const
+{
+    return unique_lock<mutex>(objectLocks[hash<string>()(id) % objectLockCount]);
+}
+
+/**
+ * @brief Locks several objects for one change to all of them, such as a batch of an import.
+ *
+ * Ids can share a lock, so each lock is taken once, and in the order of the locks rather
+ * than of the ids, so two batches never wait for each other.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @param ids The ids of the objects.
+ * @return The locks, held until they are destroyed.
+ */
+template <typename T>
+vector<unique_lock<mutex>> Repository<T>::lockObjects(const vector<string>& ids) const
+{
+    vector<bool> picked(objectLockCount, false);
+    for (const string& id : ids)
+        picked[hash<string>()(id) % objectLockCount] = true;
+
+    vector<unique_lock<mutex>> locks;
+    for (size_t i = 0; i < objectLockCount; i++)
+    {
+        if (picked[i])
+            locks.emplace_back(objectLocks[i]);
+    }
+    return locks;
+}
+
+/**
+ * @brief Copies every object, in id order.
+ *
+ * @tparam T The type of the objects stored in the repository.
+ * @return The id and object pairs.
+ */
+template <typename T>
+vector<pair<string, T>> Repository<T>::snapshot() const
+{
+    vector<pair<string, T>> objects;
+    objects.reserve(backend->size());
+    backend->scan([&objects](const string& id, const T& object) { objects.emplace_back(id, object); });
+    return objects;
+}
+
+/**
+ * @brief Creates a backend by name.
+ *
+ * @tparam T The type of the objects to store.
+ * @param backendName "versioned", "sharded", "map", "hash" or "log".
+ * @param collection The name of the collection; the log backend writes <collection>.store.
+ * @return The backend, or null if the name is not recognised.
+ */
+template <typename T>
+unique_ptr<RepositoryBackend<T>> makeRepositoryBackend(string backendName, string collection)
+{
+    if (backendName == "versioned")
+        return unique_ptr<RepositoryBackend<T>>(new VersionedBackend<T>());
+    if (backendName == "sharded")
+        return unique_ptr<RepositoryBackend<T>>(new ShardedBackend<T>());
+    if (backendName == "map")
+        return unique_ptr<RepositoryBackend<T>>(new MapBackend<T>());
+    if (backendName == "hash")
+        return unique_ptr<RepositoryBackend<T>>(new HashBackend<T>());
+    if (backendName == "log")
+        return unique_ptr<RepositoryBackend<T>>(new LogStructuredBackend<T>(collection + ".store"));
+    return nullptr;
+}
@@ -0,0 +1,427 @@
+#ifndef REPOSITORY_H
+#define REPOSITORY_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The value a sorted list orders objects by: a number, then a text.
+struct SortKey
+{
+    double number = 0;
+    std::string text;
+};
+
+inline bool operator<(const SortKey& a, const SortKey& b)
+{
+    return a.number != b.number ? a.number < b.number : a.text < b.text;
+}
+
+// One object of a sorted list. Objects with the same key are in id order, so every object has
+// one place in the list and a page can go on right after the object the previous one ended with.
+struct SortedId
+{
+    SortKey key;
+    std::string id;
+};
+
+inline bool operator<(const SortedId& a, const SortedId& b)
+{
+    if (a.key < b.key)
+        return true;
+    if (b.key < a.key)
+        return false;
+    return a.id < b.id;
+}
+
+// An index of a repository, such as the trigrams of a text field. The repository tells it of
+// every change, one at a time, so it never has to scan the collection again.
+template <typename T>
+class RepositoryIndex
+{
+public:
+    virtual ~RepositoryIndex() {}
+
+    // Getters
+    virtual size_t memoryBytes() const = 0;
+
+    // Changes, called with the repository's index lock held. put replaces the entry of an id
+    // that is already indexed.
+    virtual void put(const std::string& id, const T& object) = 0;
+    virtual void erase(const std::string& id) = 0;
+    virtual void clear() = 0;
+};
+
+// The heap bytes of a string beyond the string itself, none for short strings kept inline.
+// Indexes add it up for the ids and keys they hold in their memoryBytes.
+inline size_t stringHeapBytes(const std::string& text)
+{
+    return text.capacity() > 15 ? text.capacity() + 1 : 0;
+}
+
+// Where a Repository keeps its objects. Every backend visits objects in id order.
+template <typename T>
+class RepositoryBackend
+{
+public:
+    virtual ~RepositoryBackend() {}
+
+    // Getters
+    virtual std::string getName() const = 0;
+    virtual size_t size() const = 0;
+
+    // True if the backend can be called from several threads at once without a lock around it.
+    virtual bool isConcurrent() const { return false; }
+
+    // Object methods
+    virtual bool get(const std::string& id, T& object) const = 0;
+    virtual void put(const std::string& id, const T& object) = 0;
+    virtual bool erase(const std::string& id) = 0;
+    virtual void clear() = 0;
+    virtual void scan(const std::function<void(const std::string&, const T&)>& visit) const = 0;
+
+    // Get an object serialized as JSON. Backends that keep objects in memory may cache it.
+    virtual bool getJson(const std::string& id, std::string& json) const;
+    virtual void scanJson(const std::function<void(const std::string&, const std::string&)>& visit) const;
+
+    // Replace every object at once, e.g. after loading the collection.
+    virtual void assign(std::map<std::string, T>&& data);
+};
+
+// The existing in-memory std::map.
+template <typename T>
+class MapBackend : public RepositoryBackend<T>
+{
+public:
+    std::string getName() const override { return "map"; }
+    size_t size() const override { return objects.size(); }
+
+    bool get(const std::string& id, T& object) const override;
+    void put(const std::string& id, const T& object) override;
+    bool erase(const std::string& id) override;
+    void clear() override;
+    void scan(const std::function<void(const std::string&, const T&)>& visit) const override;
+    void assign(std::map<std::string, T>&& data) override;
+
+private:
+    std::map<std::string, T> objects;
+};
+
+// An in-memory hash table: constant time lookups, scans sort the ids first.
+template <typename T>
+class HashBackend : public RepositoryBackend<T>
+{
+public:
+    std::string getName() const override { return "hash"; }
+    size_t size() const override { return objects.size(); }
+
+    bool get(const std::string& id, T& object) const override;
+    void put(const std::string& id, const T& object) override;
+    bool erase(const std::string& id) override;
+    void clear() override;
+    void scan(const std::function<void(const std::string&, const T&)>& visit) const override;
+    void assign(std::map<std::string, T>&& data) override;
+
+private:
+    std::unordered_map<std::string, T> objects;
+};
+
+// Objects spread over hash table shards by id, each shard behind its own reader-writer lock,
+// so handlers on different threads only wait for each other when they touch the same shard.
+template <typename T>
+class ShardedBackend : public RepositoryBackend<T>
+{
+public:
+    // Constructors
+    ShardedBackend(size_t shardCountInput = 16);
+
+    // Getters
+    std::string getName() const override { return "sharded"; }
+    size_t size() const override { return count.load(); }
+    bool isConcurrent() const override { return true; }
+    size_t getShardCount() const { return shardCount; }
+
+    bool get(const std::string& id, T& object) const override;
+    void put(const std::string& id, const T& object) override;
+    bool erase(const std::string& id) override;
+    void clear() override;
+    void scan(const std::function<void(const std::string&, const T&)>& visit) const override;
+    void assign(std::map<std::string, T>&& data) override;
+
+private:
+    struct Shard
+    {
+        mutable std::shared_mutex lock;
+        std::unordered_map<std::string, T> objects;
+    };
+
+    Shard& shardFor(const std::string& id) const { return shards[std::hash<std::string>()(id) % shardCount]; }
+
+    size_t shardCount;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<size_t> count;
+};
+
+// Objects published as immutable versions of the collection. Readers never take a lock: they
+// announce themselves in a reader count of the current epoch and read whichever version is
+// current. Writers copy the slice of the version holding the id, change it and publish the
+// new version. Replaced versions are freed once no reader of an epoch that could have seen
+// them is left (epoch-based reclamation), so writers never wait for readers either.
+// Every object also keeps its JSON once a reader has asked for it; a write stores a new
+// entry, so the cached JSON can never outlive the object it was made from.
+template <typename T>
+class VersionedBackend : public RepositoryBackend<T>
+{
+public:
+    // Constructors
+    VersionedBackend(size_t sliceCountInput = 256);
+    ~VersionedBackend();
+    VersionedBackend(const VersionedBackend&) = delete;
+    VersionedBackend& operator=(const VersionedBackend&) = delete;
+
+    // Getters
+    std::string getName() const override { return "versioned"; }
+    size_t size() const override;
+    bool isConcurrent() const override { return true; }
+    uint64_t getVersion() const;
+
+    bool get(const std::string& id, T& object) const override;
+    void put(const std::string& id, const T& object) override;
+    bool erase(const std::string& id) override;
+    void clear() override;
+    void scan(const std::function<void(const std::string&, const T&)>& visit) const override;
+    bool getJson(const std::string& id, std::string& json) const override;
+    void scanJson(const std::function<void(const std::string&, const std::string&)>& visit) const override;
+    void assign(std::map<std::string, T>&& data) override;
+
+private:
+    // An object and, once serialized, its JSON. The JSON is set at most once and freed with the entry.
+    struct Entry
+    {
+        Entry(T objectInput) : object(std::move(objectInput)) {}
+        ~Entry() { delete json.load(); }
+
+        T object;
+        mutable std::atomic<const std::string*> json{nullptr};
+    };
+
+    typedef std::map<std::string, std::shared_ptr<const Entry>> Slice;
+
+    // One published state of the collection. Slices no write touched are shared with the
+    // previous version.
+    struct Version
+    {
+        uint64_t number = 0;
+        size_t count = 0;
+        std::vector<std::shared_ptr<const Slice>> slices;
+    };
+
+    // Readers of one epoch, spread over cache lines so readers on different cores do not
+    // contend on one counter.
+    static const size_t readerStripes = 16;
+    struct alignas(64) ReaderCount
+    {
+        std::atomic<long> readers{0};
+    };
+
+    // Marks the calling thread as reading for as long as it lives.
+    class ReadGuard
+    {
+    public:
+        ReadGuard(const VersionedBackend& backendInput);
+        ~ReadGuard();
+        const Version& version() const { return *current; }
+
+    private:
+        std::atomic<long>* readers;
+        const Version* current;
+    };
+
+    size_t sliceFor(const std::string& id) const { return std::hash<std::string>()(id) % sliceCount; }
+    std::vector<const typename Slice::value_type*> sortedEntries(const Version& version) const;
+    const std::string& entryJson(const Entry& entry) const;
+    Version* emptyVersion() const;
+    bool hasReaders(uint64_t readEpoch) const;
+    void publish(Version* next);
+
+    size_t sliceCount;
+    std::atomic<Version*> current;
+    std::atomic<uint64_t> epoch{0};
+    mutable ReaderCount readerCounts[2][readerStripes];
+
+    // Held by writers. Versions replaced in each of the last two epochs, waiting to be freed.
+    std::mutex writerMutex;
+    std::vector<Version*> retired[2];
+};
+
+// Puts one reader-writer lock around a backend that is not safe to call from several threads.
+template <typename T>
+class LockedBackend : public RepositoryBackend<T>
+{
+public:
+    // Constructors
+    LockedBackend(std::unique_ptr<RepositoryBackend<T>> backendInput) : backend(std::move(backendInput)) {}
+
+    // Getters
+    std::string getName() const override { return backend->getName(); }
+    size_t size() const override;
+    bool isConcurrent() const override { return true; }
+
+    bool get(const std::string& id, T& object) const override;
+    void put(const std::string& id, const T& object) override;
+    bool erase(const std::string& id) override;
+    void clear() override;
+    void scan(const std::function<void(const std::string&, const T&)>& visit) const override;
+    void assign(std::map<std::string, T>&& data) override;
+
+private:
+    mutable std::shared_mutex lock;
+    std::unique_ptr<RepositoryBackend<T>> backend;
+};
+
+// Objects packed as binary records and appended to a file; only an id index stays in memory.
+// The file is scratch space rebuilt from the resource files at startup, so durability stays
+// with the write-ahead log and the snapshots.
+template <typename T>
+class LogStructuredBackend : public RepositoryBackend<T>
+{
+public:
+    // Constructors
+    LogStructuredBackend(std::string filenameInput);
+    ~LogStructuredBackend();
+    LogStructuredBackend(const LogStructuredBackend&) = delete;
+    LogStructuredBackend& operator=(const LogStructuredBackend&) = delete;
+
+    // Getters
+    std::string getName() const override { return "log"; }
+    size_t size() const override { return index.size(); }
+    uint64_t getFileBytes() const { return fileBytes; }
+    uint64_t getGarbageBytes() const { return garbageBytes; }
+
+    bool get(const std::string& id, T& object) const override;
+    void put(const std::string& id, const T& object) override;
+    bool erase(const std::string& id) override;
+    void clear() override;
+    void scan(const std::function<void(const std::string&, const T&)>& visit) const override;
+
+    // Rewrite the file with only the live records.
+    void compact();
+
+private:
+    // Where a record lies in the file.
+    struct Location
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    std::string readRecord(const Location& location) const;
+    void writeRecord(const std::string& bytes, uint64_t offset);
+
+    std::string filename;
+    int fileDescriptor = -1;
+    std::map<std::string, Location> index;
+    uint64_t fileBytes = 0;
+    uint64_t garbageBytes = 0;
+};
+
+// The collection every handler reads and changes, whichever backend holds it. Every method
+// may be called from several threads at once, except setBackend, which is for startup.
+// Every change moves the collection to a new version; the JSON of the whole collection is
+// kept for the version it was built from.
+template <typename T>
+class Repository
+{
+public:
+    // Constructors
+    Repository() : backend(new VersionedBackend<T>()), cacheSerialized(true) {}
+    Repository(const Repository&) = delete;
+    Repository& operator=(const Repository&) = delete;
+
+    // Getters
+    std::string getBackendName() const { return backend->getName(); }
+    size_t size() const { return backend->size(); }
+    bool contains(const std::string& id) const;
+    bool getCacheSerialized() const { return cacheSerialized; }
+    uint64_t getVersion() const { return version.load(); }
+
+    // Setters
+    void setBackend(std::unique_ptr<RepositoryBackend<T>> backendInput);
+
+    // Whether the backend may cache the JSON of objects. Turn it off for types whose JSON
+    // embeds objects of other repositories, since those change without this one knowing.
+    void setCacheSerialized(bool cacheSerializedInput) { cacheSerialized = cacheSerializedInput; }
+
+    // Object methods
+    bool get(const std::string& id, T& object) const { return backend->get(id, object); }
+    T at(const std::string& id) const;
+    bool getJson(const std::string& id, std::string& json) const;
+    void getAllJson(std::string& json) const;
+    void writeAllJson(const std::function<void(const std::string&)>& write, size_t chunkBytes) const;
+    void writeAllNdjson(const std::function<void(const std::string&)>& write, size_t chunkBytes) const;
+
+    // The ids of every object sorted by a key and then by id, kept until the collection changes.
+    // Each orderName names one sortKey; a null sortKey sorts by id alone.
+    std::shared_ptr<const std::vector<SortedId>> getSorted(const std::string& orderName, const std::function<SortKey(const T&)>& sortKey) const;
+    void put(const std::string& id, const T& object);
+    bool erase(const std::string& id);
+    void clear();
+    void scan(const std::function<void(const std::string&, const T&)>& visit) const { backend->scan(visit); }
+    std::vector<std::pair<std::string, T>> snapshot() const;
+    void assign(std::map<std::string, T>&& data);
+
+    // Keep other handlers from changing one object while a handler reads, checks and writes it back.
+    std::unique_lock<std::mutex> lockObject(const std::string& id) const;
+    std::vector<std::unique_lock<std::mutex>> lockObjects(const std::vector<std::string>& ids) const;
+
+    // Indexes kept current by every change, found by name. Add them at startup, like the
+    // backend; an index added to a filled repository is built from it.
+    void addIndex(const std::string& name, std::shared_ptr<RepositoryIndex<T>> index);
+    template <typename I>
+    std::shared_ptr<I> getIndex(const std::string& name) const;
+    size_t getIndexBytes() const;
+
+private:
+    void rebuildIndexes();
+
+    std::shared_ptr<const std::string> buildAllJson() const;
+
+    std::unique_ptr<RepositoryBackend<T>> backend;
+    bool cacheSerialized;
+
+    // Bumped after every change, once the backend shows it.
+    std::atomic<uint64_t> version{0};
+
+    // The JSON of the whole collection and the version it was built from.
+    mutable std::mutex allJsonMutex;
+    mutable std::shared_ptr<const std::string> allJson;
+    mutable uint64_t allJsonVersion = 0;
+
+    // The sorted lists by order name, each with the version it was sorted at.
+    mutable std::mutex sortedMutex;
+    mutable std::map<std::string, std::pair<uint64_t, std::shared_ptr<const std::vector<SortedId>>>> sortedLists;
+
+    // The indexes by name. indexMutex keeps a change to the backend and to the indexes together.
+    std::map<std::string, std::shared_ptr<RepositoryIndex<T>>> indexes;
+    mutable std::mutex indexMutex;
+
+    // Locks for changing single objects, picked by a hash of the id.
+    static const size_t objectLockCount = 64;
+    mutable std::mutex objectLocks[objectLockCount];
+};
+
+// Create a backend by name: "versioned", "sharded", "map", "hash" or "log". Returns null for an unknown name.
+template <typename T>
+std::unique_ptr<RepositoryBackend<T>> makeRepositoryBackend(std::string backendName, std::string collection);
+
+#include "Repository.cpp"
+
+#endif // REPOSITORY_H
@@ -8,6 +8,8 @@
  */
 
 #include "ResearchOutput.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
 
 using namespace crow;
 
@@ -26,7 +28,7 @@ ResearchOutput::ResearchOutput(json::rvalue readValueJson)
  * 
  * @return A JSON object containing the research output details.
  */
-json::wvalue ResearchOutput::convertToJson()
+json::wvalue ResearchOutput::convertToJson() const
 {
     json::wvalue writeJson;
     writeJson["numCitations"] = numCitations;
@@ -50,6 +52,22 @@ json::wvalue ResearchOutput::convertToJson()
     return writeJson;
 }
 
+/**
+ * @brief Writes the ResearchOutput object as JSON, the same text convertToJson().dump() gives.
+ * 
+ * Members are written in the order crow dumps them in, so both paths give the same bytes.
+ * 
+ * @param writer Receives the research output details.
+ */
+void ResearchOutput::writeJson(JsonWriter& writer) const
+{
+    writer.beginObject();
+    writer.member("publishedOn", publishedOn);
+    writer.member("publishedIn", publishedIn);
+    writer.member("numCitations", numCitations);
+    writer.endObject();
+}
+
 /**
  * @brief Updates the ResearchOutput object from a JSON representation.
  * 
@@ -79,3 +97,27 @@ void ResearchOutput::updateFromJson(json::rvalue readValueJson)
         }
     }
 }
+
+/**
+ * @brief Writes the ResearchOutput object as a binary snapshot record.
+ * 
+ * @param writer The writer for the record. Fields are written in a fixed order.
+ */
+void ResearchOutput::writeBinaryRecord(BinaryRecordWriter& writer) const
+{
+    writer.writeNumber(numCitations);
+    writer.writeStringList(publishedIn);
+    writer.writeStringList(publishedOn);
+}
+
+/**
+ * @brief Reads the ResearchOutput object from a binary snapshot record.
+ * 
+ * @param reader The reader for the record. Fields are read in the order they were written.
+ */
+void ResearchOutput::readBinaryRecord(BinaryRecordReader& reader)
+{
+    numCitations = reader.readNumber();
+    publishedIn = reader.readStringList();
+    publishedOn = reader.readStringList();
+}
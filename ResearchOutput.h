@@ -4,6 +4,10 @@
 #include <crow.h>
 #include <string>
 
+class BinaryRecordWriter;
+class BinaryRecordReader;
+class JsonWriter;
+
 class ResearchOutput
 {
 public:
@@ -22,9 +26,14 @@ public:
     void setPublishedOn(std::vector<std::string> publishedOnInput) { publishedOn = publishedOnInput; }
 
     // JSON Methods
-    crow::json::wvalue convertToJson();
+    crow::json::wvalue convertToJson() const;
+    void writeJson(JsonWriter& writer) const;
     void updateFromJson(crow::json::rvalue readValueJson);
 
+    // Binary snapshot methods
+    void writeBinaryRecord(BinaryRecordWriter& writer) const;
+    void readBinaryRecord(BinaryRecordReader& reader);
+
 private:
     int numCitations;
     std::vector<std::string> publishedIn;
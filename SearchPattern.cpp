@@ -0,0 +1,195 @@
+/**
+ * @file SearchPattern.cpp
+ * @brief Implementation of the SearchPattern and SearchPatternCache classes.
+ *
+ * This file provides the implementation for the SearchPattern class, which matches the
+ * search parameter of list requests against names, titles and descriptions, and for the
+ * cache that keeps the patterns compiled by recent requests.
+ */
+
+#include "SearchPattern.h"
+#include <cctype>
+
+using namespace std;
+
+namespace
+{
+    // The most patterns the search handlers keep compiled.
+    const size_t sharedCacheCapacity = 256;
+
+    /**
+     * @brief Lowercases a character the way a case-insensitive regex compares it.
+     *
+     * @param c The character.
+     * @return The character in lowercase.
+     */
+    inline unsigned char lowerChar(unsigned char c)
+    {
+        return static_cast<unsigned char>(tolower(c));
+    }
+}
+
+/**
+ * @brief Constructs a SearchPattern, compiling a regex only for patterns that need one.
+ *
+ * @param patternInput The search parameter.
+ * @throws regex_error if the pattern is not a valid regex.
+ */
+SearchPattern::SearchPattern(const string& patternInput) : pattern(patternInput)
+{
+    if (isLiteralPattern(pattern))
+    {
+        for (char c : pattern)
+            lowerLiteral.push_back(static_cast<char>(lowerChar(c)));
+    }
+    else
+        regex.reset(new std::regex(pattern, regex_constants::icase));
+}
+
+/**
+ * @brief Whether the pattern occurs anywhere in a text, ignoring case.
+ *
+ * @param text The text to search.
+ * @return True if the text matches.
+ */
+bool SearchPattern::matches(const string& text) const
+{
+    if (regex)
+        return regex_search(text, *regex);
+
+    // Find the first character of the literal, then compare the rest.
+    size_t length = lowerLiteral.size();
+    if (length == 0)
+        return true;
+    if (text.size() < length)
+        return false;
+
+    const unsigned char* literal = reinterpret_cast<const unsigned char*>(lowerLiteral.data());
+    const unsigned char* characters = reinterpret_cast<const unsigned char*>(text.data());
+    size_t last = text.size() - length;
+    for (size_t start = 0; start <= last; start++)
+    {
+        if (lowerChar(characters[start]) != literal[0])
+            continue;
+
+        size_t matched = 1;
+        while (matched < length && lowerChar(characters[start + matched]) == literal[matched])
+            matched++;
+        if (matched == length)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Whether a pattern has no character with a meaning of its own in an ECMAScript regex,
+ * so it only matches its own text.
+ *
+ * @param pattern The search parameter.
+ * @return True if the pattern can be matched as a substring.
+ */
+bool SearchPattern::isLiteralPattern(const string& pattern)
+{
+    return pattern.find_first_of("^$\\.*+?()[]{}|") == string::npos;
+}
+
+/**
+ * @brief Constructs an empty SearchPatternCache.
+ *
+ * @param capacityInput The most patterns kept.
+ */
+SearchPatternCache::SearchPatternCache(size_t capacityInput) : capacity(capacityInput)
+{
+}
+
+/**
+ * @brief Gets the number of patterns kept.
+ *
+ * @return The number of patterns.
+ */
+size_t SearchPatternCache::size() const
+{
+    lock_guard<mutex> lock(cacheMutex);
+    return patterns.size();
+}
+
+/**
+ * @brief Gets the number of patterns found already compiled.
+ *
+ * @return The number of hits.
+ */
+uint64_t SearchPatternCache::getHitCount() const
+{
+    lock_guard<mutex> lock(cacheMutex);
+    return hits;
+}
+
+/**
+ * @brief Gets the number of patterns that had to be compiled.
+ *
+ * @return The number of misses.
+ */
+uint64_t SearchPatternCache::getMissCount() const
+{
+    lock_guard<mutex> lock(cacheMutex);
+    return misses;
+}
+
+/**
+ * @brief Gets a compiled pattern, compiling it if it is not kept.
+ *
+ * The pattern is compiled without the lock held, so a slow regex does not hold up searches
+ * for other patterns. Invalid patterns are not kept.
+ *
+ * @param pattern The search parameter.
+ * @return The compiled pattern, or null if the pattern is not a valid regex.
+ */
+shared_ptr<const SearchPattern> SearchPatternCache::get(const string& pattern)
+{
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        unordered_map<string, UseOrder::iterator>::iterator found = index.find(pattern);
+        if (found != index.end())
+        {
+            hits++;
+            patterns.splice(patterns.begin(), patterns, found->second);
+            return *found->second;
+        }
+        misses++;
+    }
+
+    shared_ptr<const SearchPattern> compiled;
+    try
+    {
+        compiled = make_shared<const SearchPattern>(pattern);
+    }
+    catch (regex_error& exception)
+    {
+        return nullptr;
+    }
+
+    lock_guard<mutex> lock(cacheMutex);
+    if (capacity == 0 || index.count(pattern))
+        return compiled;
+
+    patterns.push_front(compiled);
+    index[pattern] = patterns.begin();
+    if (patterns.size() > capacity)
+    {
+        index.erase(patterns.back()->getPattern());
+        patterns.pop_back();
+    }
+    return compiled;
+}
+
+/**
+ * @brief Compiles a search pattern through the cache shared by every search handler.
+ *
+ * @param pattern The search parameter.
+ * @return The compiled pattern, or null if the pattern is not a valid regex.
+ */
+shared_ptr<const SearchPattern> compileSearchPattern(const string& pattern)
+{
+    static SearchPatternCache cache(sharedCacheCapacity);
+    return cache.get(pattern);
+}
@@ -0,0 +1,70 @@
+#ifndef SEARCH_PATTERN_H
+#define SEARCH_PATTERN_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <unordered_map>
+
+// A search= pattern, compiled once and matched against every searched object. The pattern is
+// a case-insensitive ECMAScript regex. One without regex metacharacters, such as "robotics",
+// can only match itself, so it is matched as a case-insensitive substring without a regex.
+class SearchPattern
+{
+public:
+    // Constructors, throw std::regex_error if the pattern is not a valid regex.
+    SearchPattern(const std::string& patternInput);
+
+    // Getters
+    std::string getPattern() const { return pattern; }
+    bool isLiteral() const { return !regex; }
+
+    // Whether the pattern occurs anywhere in a text, ignoring case.
+    bool matches(const std::string& text) const;
+
+    // Whether a pattern has no character with a meaning of its own in a regex.
+    static bool isLiteralPattern(const std::string& pattern);
+
+private:
+    std::string pattern;
+    std::string lowerLiteral;
+    std::unique_ptr<std::regex> regex;
+};
+
+// The patterns compiled last, so a search repeated by many requests is compiled once. Once
+// capacity patterns are kept, the one used longest ago is dropped for a new one.
+class SearchPatternCache
+{
+public:
+    // Constructors
+    SearchPatternCache(size_t capacityInput);
+    SearchPatternCache(const SearchPatternCache&) = delete;
+    SearchPatternCache& operator=(const SearchPatternCache&) = delete;
+
+    // Getters
+    size_t getCapacity() const { return capacity; }
+    size_t size() const;
+    uint64_t getHitCount() const;
+    uint64_t getMissCount() const;
+
+    // The compiled pattern, compiled now if it is not kept. Null if it is not a valid regex.
+    std::shared_ptr<const SearchPattern> get(const std::string& pattern);
+
+private:
+    typedef std::list<std::shared_ptr<const SearchPattern>> UseOrder;
+
+    size_t capacity;
+    mutable std::mutex cacheMutex;
+    UseOrder patterns; // Most recently used first.
+    std::unordered_map<std::string, UseOrder::iterator> index;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// Compile a search pattern through the cache shared by every search handler.
+std::shared_ptr<const SearchPattern> compileSearchPattern(const std::string& pattern);
+
+#endif // SEARCH_PATTERN_H
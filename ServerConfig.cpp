@@ -0,0 +1,333 @@
+/**
+ * @file ServerConfig.cpp
+ * @brief Implementation of the ServerConfig class and the RequestLimits middleware.
+ *
+ * This file provides the implementation for the ServerConfig class, which gathers the
+ * runtime settings of the server from their defaults, a config file and the environment.
+ */
+
+#include "ServerConfig.h"
+#include "toLowerHelper.h"
+#include <sched.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using namespace crow;
+
+/**
+ * @brief Trims spaces and tabs from both ends of a string.
+ *
+ * @param text The string to trim.
+ * @return The trimmed string.
+ */
+static string trim(const string& text)
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == string::npos)
+        return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+/**
+ * @brief Parses a whole string as an unsigned number within a range.
+ *
+ * @param value The string to parse.
+ * @param minimum The smallest accepted number.
+ * @param maximum The largest accepted number.
+ * @param number Receives the number.
+ * @return True if the string is a number in the range, false otherwise.
+ */
+static bool parseNumber(const string& value, unsigned long long minimum, unsigned long long maximum, unsigned long long& number)
+{
+    if (value.empty() || !all_of(value.begin(), value.end(), [](unsigned char c) { return isdigit(c); }))
+        return false;
+
+    try
+    {
+        number = stoull(value);
+    }
+    catch (const exception&)
+    {
+        return false;
+    }
+    return number >= minimum && number <= maximum;
+}
+
+/**
+ * @brief Creates the default settings. The thread counts follow the number of cores.
+ */
+ServerConfig::ServerConfig()
+{
+    size_t cores = max<size_t>(thread::hardware_concurrency(), 1);
+    cpuThreads = max<size_t>(cores / 2, 1);
+    cpuQueue = cpuThreads;
+
+    for (string key : getKeys())
+        sources[key] = "default";
+}
+
+/**
+ * @brief Gets the number of threads that handle requests.
+ *
+ * By default every core gets a thread for cheap requests, plus one thread for each CPU heavy
+ * request that may be running or queued, so heavy requests never take all the threads.
+ *
+ * @return The number of threads.
+ */
+size_t ServerConfig::getWorkerThreads() const
+{
+    if (workerThreads > 0)
+        return workerThreads;
+    return max<size_t>(thread::hardware_concurrency(), 1) + cpuThreads + cpuQueue;
+}
+
+/**
+ * @brief Gets the effective value of a setting as text.
+ *
+ * @param key The name of the setting, e.g. "worker_threads".
+ * @return The value, or an empty string if the key is unknown.
+ */
+string ServerConfig::getValue(const string& key) const
+{
+    if (key == "port")
+        return to_string(port);
+    if (key == "worker_threads")
+        return to_string(getWorkerThreads());
+    if (key == "cpu_threads")
+        return to_string(cpuThreads);
+    if (key == "cpu_queue")
+        return to_string(cpuQueue);
+    if (key == "cpu_affinity")
+        return cpuAffinity;
+    if (key == "keep_alive_seconds")
+        return to_string(keepAliveSeconds);
+    if (key == "max_body_bytes")
+        return to_string(maxBodyBytes);
+    if (key == "max_import_bytes")
+        return to_string(maxImportBytes);
+    if (key == "stream_threshold_bytes")
+        return to_string(streamThresholdBytes);
+    if (key == "storage")
+        return storage;
+    if (key == "durability")
+        return durability;
+    if (key == "snapshot_seconds")
+        return to_string(snapshotSeconds);
+    if (key == "persistence")
+        return persistence;
+    if (key == "merge_every")
+        return to_string(mergeEvery);
+    if (key == "search_index")
+        return searchIndex;
+    if (key == "sort_index")
+        return sortIndex;
+    if (key == "bitmap_index")
+        return bitmapIndex;
+    return "";
+}
+
+/**
+ * @brief Gets where the value of a setting came from.
+ *
+ * @param key The name of the setting, e.g. "worker_threads".
+ * @return "default", the config file name or the environment variable name.
+ */
+string ServerConfig::getSource(const string& key) const
+{
+    map<string, string>::const_iterator found = sources.find(key);
+    return found == sources.end() ? "" : found->second;
+}
+
+/**
+ * @brief Changes one setting.
+ *
+ * @param key The name of the setting, e.g. "worker_threads".
+ * @param value The new value as text.
+ * @param source Where the value came from, reported when the settings are logged.
+ * @return True if the setting was changed, false if the key is unknown or the value is not valid.
+ */
+bool ServerConfig::set(const string& key, const string& value, const string& source)
+{
+    unsigned long long number = 0;
+    vector<int> cpus;
+
+    if (key == "port" && parseNumber(value, 1, 65535, number))
+        port = number;
+    else if (key == "worker_threads" && parseNumber(value, 0, 1024, number))
+        workerThreads = number;
+    else if (key == "cpu_threads" && parseNumber(value, 1, 1024, number))
+        cpuThreads = number;
+    else if (key == "cpu_queue" && parseNumber(value, 0, 65536, number))
+        cpuQueue = number;
+    else if (key == "cpu_affinity" && parseCpuList(value, cpus))
+        cpuAffinity = value;
+    else if (key == "keep_alive_seconds" && parseNumber(value, 1, 255, number))
+        keepAliveSeconds = number;
+    else if (key == "max_body_bytes" && parseNumber(value, 1, 1ULL << 32, number))
+        maxBodyBytes = number;
+    else if (key == "max_import_bytes" && parseNumber(value, 1, 1ULL << 40, number))
+        maxImportBytes = number;
+    else if (key == "stream_threshold_bytes" && parseNumber(value, 0, 1ULL << 32, number))
+        streamThresholdBytes = number;
+    else if (key == "storage")
+        storage = value;
+    else if (key == "durability" && (toLower(value) == "none" || toLower(value) == "group" || toLower(value) == "sync"))
+        durability = toLower(value);
+    else if (key == "snapshot_seconds" && parseNumber(value, 0, 86400, number))
+        snapshotSeconds = number;
+    else if (key == "persistence" && (toLower(value) == "full" || toLower(value) == "delta"))
+        persistence = toLower(value);
+    else if (key == "merge_every" && parseNumber(value, 0, 1000000, number))
+        mergeEvery = number;
+    else if (key == "search_index" && (toLower(value) == "on" || toLower(value) == "off"))
+        searchIndex = toLower(value);
+    else if (key == "sort_index" && (toLower(value) == "on" || toLower(value) == "off"))
+        sortIndex = toLower(value);
+    else if (key == "bitmap_index" && (toLower(value) == "on" || toLower(value) == "off"))
+        bitmapIndex = toLower(value);
+    else
+        return false;
+
+    sources[key] = source;
+    return true;
+}
+
+/**
+ * @brief Reads settings from a config file of "key = value" lines. Text after # is a comment.
+ *
+ * Lines with an unknown key or an invalid value are reported and skipped.
+ *
+ * @param filename The config file.
+ * @return True if the file was read, false if it could not be opened.
+ */
+bool ServerConfig::loadFromFile(string filename)
+{
+    ifstream file(filename);
+    if (!file.is_open())
+        return false;
+
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line))
+    {
+        lineNumber++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        size_t separator = line.find('=');
+        if (separator == string::npos || !set(trim(line.substr(0, separator)), trim(line.substr(separator + 1)), filename))
+            cerr << "Ignoring line " << lineNumber << " of " << filename << ": " << line << endl;
+    }
+    return true;
+}
+
+/**
+ * @brief Overrides settings with the LABFLOW_ environment variables that are set.
+ *
+ * Invalid values are reported and skipped.
+ */
+void ServerConfig::loadFromEnvironment()
+{
+    for (string key : getKeys())
+    {
+        string variable = "LABFLOW_" + key;
+        transform(variable.begin(), variable.end(), variable.begin(), [](unsigned char c) { return toupper(c); });
+
+        const char* value = getenv(variable.c_str());
+        if (value && !set(key, value, variable))
+            cerr << "Ignoring " << variable << "=" << value << endl;
+    }
+}
+
+/**
+ * @brief Restricts the process to the CPUs listed in cpu_affinity.
+ *
+ * The mask is set on the calling thread and inherited by every thread it starts, so this
+ * must run before any thread is started.
+ *
+ * @return True if the mask was set or no CPUs are listed, false otherwise.
+ */
+bool ServerConfig::applyCpuAffinity() const
+{
+    vector<int> cpus;
+    if (!parseCpuList(cpuAffinity, cpus))
+        return false;
+    if (cpus.empty())
+        return true;
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &mask);
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+}
+
+/**
+ * @brief Lists the names of every setting, in the order they are logged.
+ *
+ * @return The names.
+ */
+vector<string> ServerConfig::getKeys()
+{
+    return {"port", "worker_threads", "cpu_threads", "cpu_queue", "cpu_affinity", "keep_alive_seconds", "max_body_bytes",
+        "max_import_bytes", "stream_threshold_bytes", "storage", "durability", "snapshot_seconds", "persistence", "merge_every",
+        "search_index", "sort_index", "bitmap_index"};
+}
+
+/**
+ * @brief Parses a list of CPUs such as "0-3,6".
+ *
+ * @param cpuList Comma separated CPU numbers and ranges. An empty list means every CPU.
+ * @param cpus Receives the CPU numbers.
+ * @return True if the list is valid, false otherwise.
+ */
+bool ServerConfig::parseCpuList(const string& cpuList, vector<int>& cpus)
+{
+    cpus.clear();
+    stringstream items(cpuList);
+    string item;
+    while (getline(items, item, ','))
+    {
+        item = trim(item);
+        size_t dash = item.find('-');
+        unsigned long long first = 0;
+        unsigned long long last = 0;
+        if (!parseNumber(item.substr(0, dash), 0, CPU_SETSIZE - 1, first))
+            return false;
+        last = first;
+        if (dash != string::npos && (!parseNumber(item.substr(dash + 1), 0, CPU_SETSIZE - 1, last) || last < first))
+            return false;
+
+        for (unsigned long long cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return true;
+}
+
+/**
+ * @brief Answers 413 instead of running the handler when the request body is too large.
+ *
+ * Imports take a whole file in one request, so their bodies have a limit of their own. The
+ * body has already been received in full by the time this runs.
+ *
+ * @param req The HTTP request object.
+ * @param res The HTTP response object.
+ * @param ctx Unused.
+ */
+void RequestLimits::before_handle(request& req, response& res, context& ctx)
+{
+    bool isImport = req.url.size() >= 7 && req.url.compare(req.url.size() - 7, 7, "/import") == 0;
+    if (req.body.size() > (isImport ? maxImportBytes : maxBodyBytes))
+    {
+        res.code = 413; // Payload Too Large
+        res.end("Request body too large");
+    }
+}
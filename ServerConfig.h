@@ -0,0 +1,94 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <crow.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Runtime settings of the server. Each setting has a default, can be set in a config file of
+// "key = value" lines and can be overridden by an environment variable named LABFLOW_ and
+// the key in capitals, e.g. LABFLOW_WORKER_THREADS overrides worker_threads.
+class ServerConfig
+{
+public:
+    // Constructors
+    ServerConfig();
+
+    // Getters
+    uint16_t getPort() const { return port; }
+    size_t getWorkerThreads() const;
+    size_t getCpuThreads() const { return cpuThreads; }
+    size_t getCpuQueue() const { return cpuQueue; }
+    std::string getCpuAffinity() const { return cpuAffinity; }
+    uint8_t getKeepAliveSeconds() const { return keepAliveSeconds; }
+    size_t getMaxBodyBytes() const { return maxBodyBytes; }
+    size_t getMaxImportBytes() const { return maxImportBytes; }
+    size_t getStreamThresholdBytes() const { return streamThresholdBytes; }
+    std::string getStorage() const { return storage; }
+    std::string getDurability() const { return durability; }
+    int getSnapshotSeconds() const { return snapshotSeconds; }
+    std::string getPersistence() const { return persistence; }
+    int getMergeEvery() const { return mergeEvery; }
+    std::string getSearchIndex() const { return searchIndex; }
+    std::string getSortIndex() const { return sortIndex; }
+    std::string getBitmapIndex() const { return bitmapIndex; }
+    std::string getValue(const std::string& key) const;
+    std::string getSource(const std::string& key) const;
+
+    // Setters, return false if the key is unknown or the value is not valid for it.
+    bool set(const std::string& key, const std::string& value, const std::string& source);
+
+    // Loading methods
+    bool loadFromFile(std::string filename);
+    void loadFromEnvironment();
+
+    // Apply cpu_affinity to the whole process, so every thread started afterwards inherits it.
+    bool applyCpuAffinity() const;
+
+    // Helpers
+    static std::vector<std::string> getKeys();
+    static bool parseCpuList(const std::string& cpuList, std::vector<int>& cpus);
+
+private:
+    uint16_t port = 17177;
+    size_t workerThreads = 0; // 0 picks the number of cores plus cpuThreads plus cpuQueue.
+    size_t cpuThreads;
+    size_t cpuQueue;
+    std::string cpuAffinity;
+    uint8_t keepAliveSeconds = 5;
+    size_t maxBodyBytes = 1048576;
+    size_t maxImportBytes = 268435456;
+    size_t streamThresholdBytes = 1048576;
+    std::string storage;
+    std::string durability = "group";
+    int snapshotSeconds = 300;
+    std::string persistence = "delta";
+    int mergeEvery = 12;
+    std::string searchIndex = "on";
+    std::string sortIndex = "on";
+    std::string bitmapIndex = "on";
+
+    // Where each setting came from: "default", the config file name or the environment variable.
+    std::map<std::string, std::string> sources;
+};
+
+// Crow middleware that rejects request bodies larger than max_body_bytes with 413. Bodies of
+// bulk imports, sent to a URL ending in /import, may be up to max_import_bytes. Crow has read
+// the whole body before any middleware runs, so this bounds what handlers parse and store,
+// not the memory a request takes while it is received.
+struct RequestLimits
+{
+    struct context
+    {
+    };
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx);
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {}
+
+    size_t maxBodyBytes = 1048576;
+    size_t maxImportBytes = 268435456;
+};
+
+#endif // SERVER_CONFIG_H
@@ -0,0 +1,400 @@
+/**
+ * @file Snapshotter.cpp
+ * @brief Implementation of the Snapshotter class.
+ *
+ * This file provides the implementation for the Snapshotter class, which periodically saves
+ * every resource collection in the background. A snapshot forks the process while no handler
+ * is changing a map; the child writes the files from its copy-on-write image of the maps and
+ * exits, so the server only pauses for the fork itself. Once the files are saved the
+ * write-ahead log records they contain are deleted.
+ *
+ * With delta persistence most snapshots only write the resources changed since the previous
+ * one to a numbered delta segment in the write-ahead log format. Startup replays the
+ * segments in order on top of the full files, and every few snapshots the collections are
+ * saved in full again and the segments are removed.
+ */
+
+#include "Snapshotter.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <map>
+
+using namespace std;
+using namespace crow;
+
+/**
+ * @brief Constructs a Snapshotter.
+ *
+ * @param logInput The write-ahead log holding the changes not yet in a snapshot.
+ * @param writeSnapshotInput Saves every resource collection, returns true on success.
+ * It runs in a forked child process.
+ * @param filenamesInput The files the snapshot writes, used to report its size.
+ */
+Snapshotter::Snapshotter(WriteAheadLog& logInput, function<bool()> writeSnapshotInput, vector<string> filenamesInput)
+    : log(logInput), writeSnapshot(writeSnapshotInput), filenames(filenamesInput)
+{
+}
+
+/**
+ * @brief Stops the background thread.
+ */
+Snapshotter::~Snapshotter()
+{
+    stop();
+}
+
+/**
+ * @brief Starts taking a snapshot every intervalSecondsInput seconds in the background.
+ *
+ * @param intervalSecondsInput Seconds between snapshots. Zero or less disables snapshots.
+ */
+void Snapshotter::start(int intervalSecondsInput)
+{
+    stop();
+    if (intervalSecondsInput <= 0)
+        return;
+
+    lock_guard<mutex> lock(threadMutex);
+    intervalSeconds = intervalSecondsInput;
+    stopping = false;
+    snapshotThread = thread(&Snapshotter::snapshotLoop, this);
+}
+
+/**
+ * @brief Stops the background thread, waiting for a running snapshot to finish.
+ */
+void Snapshotter::stop()
+{
+    {
+        lock_guard<mutex> lock(threadMutex);
+        stopping = true;
+    }
+    stopRequested.notify_all();
+
+    if (snapshotThread.joinable())
+        snapshotThread.join();
+}
+
+/**
+ * @brief Switches the snapshots to delta persistence.
+ *
+ * Segments left by an earlier run are kept and counted towards the next full snapshot,
+ * since startup replays them on top of the full files.
+ *
+ * @param trackerInput Records the resources changed since the previous snapshot.
+ * @param collectChangesInput Turns changes into records holding the current resources.
+ * It runs while no handler is changing a map.
+ * @param segmentPrefixInput The name the delta segment files start with.
+ * @param mergeEveryInput Delta snapshots taken before the next full one, zero for only full ones.
+ */
+void Snapshotter::enableDeltas(ChangeTracker& trackerInput, function<vector<LogRecord>(const ChangeSet&)> collectChangesInput, string segmentPrefixInput, int mergeEveryInput)
+{
+    lock_guard<mutex> oneAtATime(snapshotMutex);
+    tracker = &trackerInput;
+    collectChanges = collectChangesInput;
+    segmentPrefix = segmentPrefixInput;
+    mergeEvery = mergeEveryInput;
+
+    vector<string> segments = listDeltaSegments(segmentPrefix);
+    nextSegment = segments.empty() ? 1 : stoull(segments.back().substr(segmentPrefix.size() + 1)) + 1;
+    deltasSinceMerge = segments.size();
+}
+
+/**
+ * @brief Takes one snapshot of every resource collection.
+ *
+ * With delta persistence only the resources changed since the previous snapshot are
+ * written, and every collection is saved in full once mergeEvery deltas have been taken.
+ *
+ * @return True if the snapshot was saved, false otherwise.
+ */
+bool Snapshotter::snapshotNow()
+{
+    lock_guard<mutex> oneAtATime(snapshotMutex);
+    if (tracker == nullptr || deltasSinceMerge >= mergeEvery)
+        return writeFull();
+    return writeDelta();
+}
+
+/**
+ * @brief Saves every resource collection in full, replacing the delta segments.
+ *
+ * @return True if every file was saved, false otherwise.
+ */
+bool Snapshotter::mergeNow()
+{
+    lock_guard<mutex> oneAtATime(snapshotMutex);
+    return writeFull();
+}
+
+/**
+ * @brief Removes every delta segment, oldest first.
+ *
+ * Call this only once the full files hold every change in the segments. Removing the
+ * oldest first means a crash part way leaves only newer segments, which replay correctly
+ * on top of the full files.
+ */
+void Snapshotter::discardDeltaSegments()
+{
+    if (segmentPrefix.empty())
+        return;
+
+    for (string segment : listDeltaSegments(segmentPrefix))
+        remove(segment.c_str());
+    deltasSinceMerge = 0;
+}
+
+/**
+ * @brief Lists the delta segments written with a prefix.
+ *
+ * @param segmentPrefix The name the segment files start with, e.g. "labflow.delta".
+ * @return The segment file names ordered by segment number, oldest first.
+ */
+vector<string> Snapshotter::listDeltaSegments(string segmentPrefix)
+{
+    size_t slash = segmentPrefix.find_last_of('/');
+    string directory = slash == string::npos ? "." : segmentPrefix.substr(0, slash);
+    string name = (slash == string::npos ? segmentPrefix : segmentPrefix.substr(slash + 1)) + ".";
+
+    map<uint64_t, string> segments;
+    DIR* directoryStream = opendir(directory.c_str());
+    if (directoryStream == nullptr)
+        return {};
+
+    while (dirent* entry = readdir(directoryStream))
+    {
+        string entryName = entry->d_name;
+        string number = entryName.substr(0, name.size()) == name ? entryName.substr(name.size()) : "";
+        if (!number.empty() && number.find_first_not_of("0123456789") == string::npos)
+            segments[stoull(number)] = segmentPrefix + "." + number;
+    }
+    closedir(directoryStream);
+
+    vector<string> filenames;
+    for (const pair<const uint64_t, string>& keyValuePair : segments)
+        filenames.push_back(keyValuePair.second);
+    return filenames;
+}
+
+/**
+ * @brief Saves every resource collection in full from a forked child process.
+ *
+ * @return True if every file was saved, false otherwise.
+ */
+bool Snapshotter::writeFull()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    pid_t child;
+    ChangeSet changes;
+    {
+        // Wait for the changes in flight, then rotate the log and fork while no handler is
+        // changing a map. The rotated records are exactly the changes the child can see.
+        unique_lock<shared_mutex> snapshotLock = log.lockForSnapshot();
+        if (!rotateLog())
+        {
+            recordSnapshot(false, false, 0, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(), 0, 0);
+            return false;
+        }
+        if (tracker)
+            changes = tracker->takeChanges();
+        child = fork();
+
+        if (child == 0)
+        {
+            bool saved = false;
+            try
+            {
+                saved = writeSnapshot();
+            }
+            catch (...)
+            {
+                saved = false;
+            }
+            _exit(saved ? 0 : 1);
+        }
+    }
+    chrono::steady_clock::time_point forked = chrono::steady_clock::now();
+
+    // Wait for the child to write the files.
+    bool saved = false;
+    if (child > 0)
+    {
+        int status = 0;
+        saved = waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    chrono::steady_clock::time_point finished = chrono::steady_clock::now();
+
+    // The rotated records and the delta segments are in the saved files now. The segments
+    // go first: a crash in between leaves the rotated log to replay after the full files,
+    // which holds every change made since the last segment.
+    if (saved)
+    {
+        discardDeltaSegments();
+        log.discardRotated();
+    }
+    else if (tracker)
+    {
+        tracker->restoreChanges(changes);
+    }
+
+    uint64_t bytes = 0;
+    for (string filename : filenames)
+    {
+        struct stat fileStatus;
+        if (stat(filename.c_str(), &fileStatus) == 0)
+            bytes += fileStatus.st_size;
+    }
+
+    recordSnapshot(saved, false, chrono::duration<double, milli>(forked - start).count(),
+                   chrono::duration<double, milli>(finished - start).count(), bytes, 0);
+    return saved;
+}
+
+/**
+ * @brief Writes the resources changed since the previous snapshot to a new delta segment.
+ *
+ * The changed resources are serialized while no handler is changing a map, and the segment
+ * is written after handlers are let back in. Both steps cost time in proportion to the
+ * number of changes, not to the size of the collections.
+ *
+ * @return True if the segment was saved or there was nothing to save, false otherwise.
+ */
+bool Snapshotter::writeDelta()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    ChangeSet changes;
+    vector<LogRecord> records;
+    {
+        unique_lock<shared_mutex> snapshotLock = log.lockForSnapshot();
+        if (!rotateLog())
+        {
+            recordSnapshot(false, true, 0, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(), 0, 0);
+            return false;
+        }
+        changes = tracker->takeChanges();
+        records = collectChanges(changes);
+    }
+    chrono::steady_clock::time_point collected = chrono::steady_clock::now();
+
+    string segment = segmentPrefix + "." + to_string(nextSegment);
+    bool saved = records.empty() || WriteAheadLog::writeSegment(segment, records);
+    chrono::steady_clock::time_point finished = chrono::steady_clock::now();
+
+    uint64_t bytes = 0;
+    if (saved)
+    {
+        if (!records.empty())
+        {
+            struct stat fileStatus;
+            if (stat(segment.c_str(), &fileStatus) == 0)
+                bytes = fileStatus.st_size;
+            nextSegment++;
+            deltasSinceMerge++;
+        }
+        log.discardRotated();
+    }
+    else
+    {
+        tracker->restoreChanges(changes);
+    }
+
+    recordSnapshot(saved, true, chrono::duration<double, milli>(collected - start).count(),
+                   chrono::duration<double, milli>(finished - start).count(), bytes, records.size());
+    return saved;
+}
+
+/**
+ * @brief Rotates the log for a snapshot. The caller holds the snapshot lock.
+ *
+ * A log that didn't rotate may still be writing to the file a saved snapshot would discard
+ * as the rotated log, so the snapshot is skipped and every change stays tracked and logged.
+ * A log that isn't open has nothing to rotate.
+ *
+ * @return True if the snapshot can go ahead, false otherwise.
+ */
+bool Snapshotter::rotateLog()
+{
+    if (!log.isOpen() || log.rotate())
+        return true;
+
+    cerr << "Can't rotate the write-ahead log, so the snapshot is skipped." << endl;
+    return false;
+}
+
+/**
+ * @brief Updates the metrics after a snapshot.
+ *
+ * @param saved Whether the snapshot was saved.
+ * @param delta Whether it was a delta snapshot.
+ * @param pauseMilliseconds How long handlers were held off.
+ * @param durationMilliseconds How long the whole snapshot took.
+ * @param bytes The size of the files written.
+ * @param records The number of resources in a delta, zero for a full snapshot.
+ */
+void Snapshotter::recordSnapshot(bool saved, bool delta, double pauseMilliseconds, double durationMilliseconds, uint64_t bytes, uint64_t records)
+{
+    lock_guard<mutex> lock(metricsMutex);
+    lastPauseMilliseconds = pauseMilliseconds;
+    lastDurationMilliseconds = durationMilliseconds;
+    if (saved)
+    {
+        snapshotCount++;
+        if (delta)
+            deltaCount++;
+        lastBytes = bytes;
+        lastRecords = records;
+        totalBytes += bytes;
+        lastSnapshotTime = chrono::system_clock::now();
+    }
+    else
+    {
+        failureCount++;
+    }
+}
+
+/**
+ * @brief Converts the snapshot metrics to a JSON representation.
+ *
+ * @return A JSON object with the snapshot and write-ahead log metrics.
+ */
+json::wvalue Snapshotter::convertToJson() const
+{
+    json::wvalue writeJson;
+
+    lock_guard<mutex> lock(metricsMutex);
+    writeJson["snapshot"]["count"] = snapshotCount;
+    writeJson["snapshot"]["failures"] = failureCount;
+    writeJson["snapshot"]["deltas"] = deltaCount;
+    writeJson["snapshot"]["lastRecords"] = lastRecords;
+    writeJson["snapshot"]["intervalSeconds"] = intervalSeconds;
+    writeJson["snapshot"]["lastPauseMilliseconds"] = lastPauseMilliseconds;
+    writeJson["snapshot"]["lastDurationMilliseconds"] = lastDurationMilliseconds;
+    writeJson["snapshot"]["lastBytes"] = lastBytes;
+    writeJson["snapshot"]["totalBytes"] = totalBytes;
+    writeJson["snapshot"]["lastSnapshotTime"] = (int64_t)chrono::system_clock::to_time_t(lastSnapshotTime);
+
+    writeJson["writeAheadLog"]["appends"] = log.getAppendCount();
+    writeJson["writeAheadLog"]["syncs"] = log.getSyncCount();
+
+    return writeJson;
+}
+
+/**
+ * @brief Body of the background thread, takes a snapshot every interval until stopped.
+ */
+void Snapshotter::snapshotLoop()
+{
+    unique_lock<mutex> lock(threadMutex);
+    while (!stopRequested.wait_for(lock, chrono::seconds(intervalSeconds), [&] { return stopping; }))
+    {
+        lock.unlock();
+        if (!snapshotNow())
+            cerr << "Background snapshot failed, the write-ahead log still holds every change." << endl;
+        lock.lock();
+    }
+}
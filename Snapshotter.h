@@ -0,0 +1,90 @@
+#ifndef SNAPSHOTTER_H
+#define SNAPSHOTTER_H
+
+#include <crow.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ChangeTracker.h"
+#include "WriteAheadLog.h"
+
+class Snapshotter
+{
+public:
+    // Constructors
+    Snapshotter(WriteAheadLog& logInput, std::function<bool()> writeSnapshotInput, std::vector<std::string> filenamesInput);
+    ~Snapshotter();
+    Snapshotter(const Snapshotter&) = delete;
+    Snapshotter& operator=(const Snapshotter&) = delete;
+
+    // Background thread
+    void start(int intervalSecondsInput);
+    void stop();
+
+    // Write only the resources changed since the previous snapshot to a delta segment named
+    // <segmentPrefixInput>.<n>, with a full snapshot after every mergeEveryInput deltas.
+    void enableDeltas(ChangeTracker& trackerInput, std::function<std::vector<LogRecord>(const ChangeSet&)> collectChangesInput, std::string segmentPrefixInput, int mergeEveryInput);
+
+    // Take one snapshot now, a delta or a full one as due, returns true if it was saved.
+    bool snapshotNow();
+
+    // Save every collection in full now and remove the delta segments it replaces.
+    bool mergeNow();
+
+    // Remove the delta segments once every collection was saved in full elsewhere, call it
+    // only while no snapshot is running.
+    void discardDeltaSegments();
+
+    // The delta segments written with a prefix, oldest first.
+    static std::vector<std::string> listDeltaSegments(std::string segmentPrefix);
+
+    // Convert the snapshot metrics to JSON.
+    crow::json::wvalue convertToJson() const;
+
+private:
+    void snapshotLoop();
+    bool writeFull();
+    bool writeDelta();
+    bool rotateLog();
+    void recordSnapshot(bool saved, bool delta, double pauseMilliseconds, double durationMilliseconds, uint64_t bytes, uint64_t records);
+
+    WriteAheadLog& log;
+    std::function<bool()> writeSnapshot;
+    std::vector<std::string> filenames;
+
+    std::thread snapshotThread;
+    std::mutex threadMutex;
+    std::condition_variable stopRequested;
+    bool stopping = false;
+    int intervalSeconds = 0;
+
+    // Only one snapshot runs at a time.
+    std::mutex snapshotMutex;
+
+    // Delta persistence, guarded by snapshotMutex. Off while tracker is null.
+    ChangeTracker* tracker = nullptr;
+    std::function<std::vector<LogRecord>(const ChangeSet&)> collectChanges;
+    std::string segmentPrefix;
+    int mergeEvery = 0;
+    uint64_t nextSegment = 1;
+    int deltasSinceMerge = 0;
+
+    // Metrics, guarded by metricsMutex.
+    mutable std::mutex metricsMutex;
+    uint64_t snapshotCount = 0;
+    uint64_t failureCount = 0;
+    uint64_t deltaCount = 0;
+    uint64_t lastRecords = 0;
+    double lastPauseMilliseconds = 0;
+    double lastDurationMilliseconds = 0;
+    uint64_t lastBytes = 0;
+    uint64_t totalBytes = 0;
+    std::chrono::system_clock::time_point lastSnapshotTime;
+};
+
+#endif // SNAPSHOTTER_H
@@ -0,0 +1,235 @@
+#ifndef SORTED_INDEX_H
+#define SORTED_INDEX_H
+
+#include <crow.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Pagination.h"
+#include "Repository.h"
+
+// The ids of a repository's objects kept sorted by one key and then by id, the order of a
+// sort parameter such as sort=cost. A change moves one id, so a sorted list is never sorted
+// again, and a page of it is found by walking the tree from the cursor.
+template <typename T>
+class SortedIndex : public RepositoryIndex<T>
+{
+public:
+    // Constructors. A null sortKey orders objects by id alone.
+    SortedIndex(std::function<SortKey(const T&)> sortKeyInput) : sortKey(sortKeyInput) {}
+
+    // Getters
+    size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> reading(indexMutex);
+        return sorted.size();
+    }
+
+    size_t memoryBytes() const override
+    {
+        std::shared_lock<std::shared_mutex> reading(indexMutex);
+        const size_t treeNodeBytes = 4 * sizeof(void*);
+        const size_t hashNodeBytes = 2 * sizeof(void*);
+        size_t bytes = sizeof(*this) + positions.bucket_count() * sizeof(void*);
+        for (const SortedId& entry : sorted)
+        {
+            bytes += treeNodeBytes + sizeof(SortedId) + stringHeapBytes(entry.key.text) + stringHeapBytes(entry.id);
+            bytes += hashNodeBytes + sizeof(typename Positions::value_type) + stringHeapBytes(entry.id);
+        }
+        return bytes;
+    }
+
+    // Changes
+    void put(const std::string& id, const T& object) override
+    {
+        SortedId entry{sortKey ? sortKey(object) : SortKey(), id};
+        std::unique_lock<std::shared_mutex> writing(indexMutex);
+        typename Positions::iterator found = positions.find(id);
+        if (found != positions.end())
+            sorted.erase(found->second);
+        positions[id] = sorted.insert(std::move(entry)).first;
+    }
+
+    void erase(const std::string& id) override
+    {
+        std::unique_lock<std::shared_mutex> writing(indexMutex);
+        typename Positions::iterator found = positions.find(id);
+        if (found == positions.end())
+            return;
+        sorted.erase(found->second);
+        positions.erase(found);
+    }
+
+    void clear() override
+    {
+        std::unique_lock<std::shared_mutex> writing(indexMutex);
+        sorted.clear();
+        positions.clear();
+    }
+
+    // Up to count ids, or every id when count is 0, in order after the position after points
+    // at, or from the start when after is null.
+    std::vector<SortedId> page(const SortedId* after, size_t count) const
+    {
+        std::shared_lock<std::shared_mutex> reading(indexMutex);
+        typename std::set<SortedId>::const_iterator next = after ? sorted.upper_bound(*after) : sorted.begin();
+        std::vector<SortedId> ids;
+        ids.reserve(count > 0 ? count : sorted.size());
+        for (; next != sorted.end() && (count == 0 || ids.size() < count); ++next)
+            ids.push_back(*next);
+        return ids;
+    }
+
+    // The ids whose key number is from min to max, in key order. The walk starts where min
+    // would be inserted and ends at the first key past max.
+    std::vector<std::string> range(double min, double max) const
+    {
+        std::shared_lock<std::shared_mutex> reading(indexMutex);
+        std::vector<std::string> ids;
+        typename std::set<SortedId>::const_iterator next = sorted.lower_bound(SortedId{SortKey{min, ""}, ""});
+        for (; next != sorted.end() && next->key.number <= max; ++next)
+            ids.push_back(next->id);
+        return ids;
+    }
+
+private:
+    typedef std::unordered_map<std::string, typename std::set<SortedId>::iterator> Positions;
+
+    std::function<SortKey(const T&)> sortKey;
+    mutable std::shared_mutex indexMutex;
+    std::set<SortedId> sorted;
+    Positions positions;
+};
+
+// The name a repository keeps the SortedIndex of an order under, e.g. "sort:cost".
+inline std::string sortedIndexName(const std::string& order)
+{
+    return "sort:" + order;
+}
+
+/**
+ * @brief Responds with a page of the objects of a repository in a sort order.
+ *
+ * The page is walked from the SortedIndex of the order when the repository has one, so it
+ * costs the same before and after the collection changes. Otherwise the whole collection is
+ * sorted once per version with Repository::getSorted.
+ *
+ * @tparam T The type of the listed objects.
+ * @param repository The listed collection.
+ * @param order The name of the order, e.g. "cost".
+ * @param sortKey Gets the key of an object, or null to sort by id alone.
+ * @param page The page the request asks for.
+ * @return The response with the page, and the cursor of the next page if there is one.
+ */
+template <typename T>
+crow::response sortedResponse(const Repository<T>& repository, const std::string& order, const std::function<SortKey(const T&)>& sortKey, const PageRequest& page)
+{
+    std::shared_ptr<SortedIndex<T>> index = repository.template getIndex<SortedIndex<T>>(sortedIndexName(order));
+    if (!index)
+        return sortedPageResponse(repository, order, *repository.getSorted(order, sortKey), page);
+
+    return sortedPageResponse<T>(repository, order, [&index](const SortedId* after, size_t count) { return index->page(after, count); }, page);
+}
+
+/**
+ * @brief Reads the bounds of a range filter, min and max. Older requests give the lower bound
+ * in a parameter of its own, such as amount, which min takes the place of when both are given.
+ * A bound that isn't given is open.
+ *
+ * @param params The query string of the request.
+ * @param minimumName The older name of the lower bound.
+ * @param min Receives the lower bound.
+ * @param max Receives the upper bound.
+ * @throws std::invalid_argument If a bound is not a number, and std::out_of_range if it is
+ * too large for a float, as std::stof does. Callers catch their base, std::logic_error.
+ */
+inline void readRange(const crow::query_string& params, const char* minimumName, double& min, double& max)
+{
+    min = -std::numeric_limits<double>::infinity();
+    max = std::numeric_limits<double>::infinity();
+    if (params.get(minimumName))
+        min = std::stof(params.get(minimumName));
+    if (params.get("min"))
+        min = std::stof(params.get("min"));
+    if (params.get("max"))
+        max = std::stof(params.get("max"));
+
+    // NaN is in no range, and can't be looked up in an ordered index.
+    if (std::isnan(min) || std::isnan(max))
+        throw std::invalid_argument("Range bound is not a number");
+}
+
+/**
+ * @brief Visits, in id order, the objects of a repository whose key number in an order is
+ * from min to max, for a page of a filter.
+ *
+ * Only the objects the page can hold are visited: those after its cursor, and no more than
+ * one past its limit. With the SortedIndex of the order, the ids come from a walk of the
+ * range, and only the ones the page needs are put in id order and read. Without one, every
+ * object is checked.
+ *
+ * @tparam T The type of the filtered objects.
+ * @param repository The filtered collection.
+ * @param order The name of the order, e.g. "cost".
+ * @param sortKey Gets the key of an object in the order.
+ * @param min The lowest key number of the range.
+ * @param max The highest key number of the range.
+ * @param page The page the request asks for, in id order.
+ * @param visit Called with each object in the range.
+ */
+template <typename T>
+void scanRange(const Repository<T>& repository, const std::string& order, const std::function<SortKey(const T&)>& sortKey, double min, double max, const PageRequest& page, const std::function<void(const std::string&, const T&)>& visit)
+{
+    auto inRange = [&sortKey, min, max](const T& object)
+    {
+        double number = sortKey(object).number;
+        return number >= min && number <= max;
+    };
+
+    std::shared_ptr<SortedIndex<T>> index = repository.template getIndex<SortedIndex<T>>(sortedIndexName(order));
+    size_t visited = 0;
+    if (!index)
+    {
+        repository.scan([&](const std::string& id, const T& object)
+        {
+            if (page.isAfter(id) && (page.getLimit() == 0 || visited <= page.getLimit()) && inRange(object))
+            {
+                visit(id, object);
+                visited++;
+            }
+        });
+        return;
+    }
+
+    std::vector<std::string> ids = index->range(min, max);
+    ids.erase(std::remove_if(ids.begin(), ids.end(), [&page](const std::string& id) { return !page.isAfter(id); }), ids.end());
+
+    // Ids are put in order a page at a time, so a page of a wide range doesn't sort all of it.
+    // An object changed or removed since the walk is checked again, and skipped if it left.
+    size_t chunk = page.getLimit() > 0 ? page.getLimit() + 1 : ids.size();
+    size_t ordered = 0;
+    T object;
+    for (size_t i = 0; i < ids.size() && (page.getLimit() == 0 || visited <= page.getLimit()); i++)
+    {
+        if (i == ordered)
+        {
+            ordered = std::min(ids.size(), ordered + chunk);
+            std::partial_sort(ids.begin() + i, ids.begin() + ordered, ids.end());
+        }
+        if (repository.get(ids[i], object) && inRange(object))
+        {
+            visit(ids[i], object);
+            visited++;
+        }
+    }
+}
+
+#endif // SORTED_INDEX_H
@@ -19,9 +19,14 @@ public:
     void setExperimentIds(std::vector<std::string> experimentIdsInput) { experimentIds = experimentIdsInput; }
 
     // Override JSON methods
-    crow::json::wvalue convertToJson() override;
+    crow::json::wvalue convertToJson() const override;
+    void writeJson(JsonWriter& writer) const override;
     void updateFromJson(crow::json::rvalue readValueJson) override;
 
+    // Override binary snapshot methods
+    void writeBinaryRecord(BinaryRecordWriter& writer) const override;
+    void readBinaryRecord(BinaryRecordReader& reader) override;
+
 private:
     std::vector<std::string> experimentIds;
 };
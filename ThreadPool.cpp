@@ -0,0 +1,80 @@
+/**
+ * @file ThreadPool.cpp
+ * @brief Implementation of the ThreadPool class.
+ *
+ * This file provides the implementation for the ThreadPool class, a fixed set of worker
+ * threads that run queued tasks in the order they were submitted.
+ */
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param threadCount The number of worker threads, at least one is started.
+ * @param maxPendingInput The most tasks trySubmit lets be queued or running at once, 0 for no limit.
+ */
+ThreadPool::ThreadPool(size_t threadCount, size_t maxPendingInput) : maxPending(maxPendingInput)
+{
+    for (size_t i = 0; i < max<size_t>(threadCount, 1); i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+/**
+ * @brief Runs the tasks still queued and stops the worker threads.
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    taskQueued.notify_all();
+
+    for (thread& worker : workers)
+        worker.join();
+}
+
+/**
+ * @brief Runs the oldest queued task on the calling thread.
+ *
+ * @return True if a task was run, false if the queue was empty.
+ */
+bool ThreadPool::runPendingTask()
+{
+    function<void()> task;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (tasks.empty())
+            return false;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+
+    task();
+    return true;
+}
+
+/**
+ * @brief Body of each worker thread, runs tasks until the pool is destroyed.
+ */
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            taskQueued.wait(lock, [&] { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task();
+    }
+}
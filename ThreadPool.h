@@ -0,0 +1,100 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // Constructors. With maxPendingInput above zero, trySubmit refuses tasks once that many
+    // are queued or running.
+    ThreadPool(size_t threadCount, size_t maxPendingInput = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Getters
+    size_t getThreadCount() const { return workers.size(); }
+    size_t getMaxPending() const { return maxPending; }
+    size_t getPendingCount() const { return pending.load(); }
+    uint64_t getRejectedCount() const { return rejected.load(); }
+
+    // Queue a task, the returned future holds its result or exception.
+    template <typename F>
+    auto submit(F task) -> std::future<decltype(task())>
+    {
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        std::future<decltype(task())> result = packaged->get_future();
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push_back([this, packaged] { (*packaged)(); pending--; });
+        }
+        taskQueued.notify_one();
+        return result;
+    }
+
+    // Queue a task unless maxPending tasks are already queued or running. Returns false and
+    // leaves result alone if the task was refused.
+    template <typename F>
+    bool trySubmit(F task, std::future<decltype(task())>& result)
+    {
+        size_t expected = pending.load();
+        do
+        {
+            if (maxPending > 0 && expected >= maxPending)
+            {
+                rejected++;
+                return false;
+            }
+        } while (!pending.compare_exchange_weak(expected, expected + 1));
+
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push_back([this, packaged] { (*packaged)(); pending--; });
+        }
+        taskQueued.notify_one();
+        return true;
+    }
+
+    // Wait for a future, running queued tasks meanwhile so tasks can wait on tasks they submit.
+    template <typename T>
+    T wait(std::future<T>& result)
+    {
+        while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!runPendingTask())
+                result.wait_for(std::chrono::milliseconds(1));
+        }
+        return result.get();
+    }
+
+    // Run one queued task on the calling thread, returns false if none was queued.
+    bool runPendingTask();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable taskQueued;
+    bool stopping = false;
+    size_t maxPending = 0;
+    std::atomic<size_t> pending{0};
+    std::atomic<uint64_t> rejected{0};
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,182 @@
+/**
+ * @file TrigramIndex.cpp
+ * @brief Implementation of the TrigramIndex class.
+ *
+ * This file provides the implementation for the TrigramIndex class, which finds the texts
+ * that may hold a literal search pattern without reading every text. Each trigram is packed
+ * into the low three bytes of a number and maps to the sorted numbers of the texts holding
+ * it. Ids are kept once, in the list of numbers.
+ */
+
+#include "TrigramIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+using namespace std;
+
+/**
+ * @brief Gets the number of texts indexed.
+ *
+ * @return The number of ids.
+ */
+size_t TrigramIndex::size() const
+{
+    shared_lock<shared_mutex> reading(indexMutex);
+    return texts.size();
+}
+
+/**
+ * @brief Estimates the memory the index takes: the posting lists, the ids and the hash
+ * tables' nodes and buckets.
+ *
+ * @return The size in bytes.
+ */
+size_t TrigramIndex::memoryBytes() const
+{
+    shared_lock<shared_mutex> reading(indexMutex);
+    const size_t nodeBytes = 2 * sizeof(void*);
+
+    size_t bytes = sizeof(*this) + texts.memoryBytes();
+    bytes += postings.bucket_count() * sizeof(void*);
+    for (const pair<const uint32_t, vector<uint32_t>>& posting : postings)
+        bytes += sizeof(posting) + nodeBytes + posting.second.capacity() * sizeof(uint32_t);
+    return bytes;
+}
+
+/**
+ * @brief Indexes the text of an id, replacing the text it had.
+ *
+ * @param id The id.
+ * @param text The text.
+ */
+void TrigramIndex::add(const string& id, const string& text)
+{
+    vector<uint32_t> textTrigrams = trigrams(text);
+
+    unique_lock<shared_mutex> writing(indexMutex);
+    uint32_t number = texts.add(id);
+    for (uint32_t trigram : textTrigrams)
+        postings[trigram].push_back(number);
+    compact();
+}
+
+/**
+ * @brief Removes the text of an id.
+ *
+ * @param id The id.
+ */
+void TrigramIndex::remove(const string& id)
+{
+    unique_lock<shared_mutex> writing(indexMutex);
+    texts.remove(id);
+    compact();
+}
+
+/**
+ * @brief Removes every text.
+ */
+void TrigramIndex::clear()
+{
+    unique_lock<shared_mutex> writing(indexMutex);
+    postings.clear();
+    texts.clear();
+}
+
+/**
+ * @brief Finds the ids of the texts that hold every trigram of a literal.
+ *
+ * The posting lists are intersected from the shortest up, so the work follows the rarest
+ * trigram rather than the number of texts.
+ *
+ * @param literal The literal, compared without case.
+ * @param ids Receives the ids in id order. Every text holding the literal is among them.
+ * @param maxIds The most ids worth listing.
+ * @return True if the index narrowed the texts down, false for literals under three characters
+ * or when more than maxIds texts may hold the literal.
+ */
+bool TrigramIndex::candidates(const string& literal, vector<string>& ids, size_t maxIds) const
+{
+    ids.clear();
+    vector<uint32_t> literalTrigrams = trigrams(literal);
+    if (literalTrigrams.empty())
+        return false;
+
+    shared_lock<shared_mutex> reading(indexMutex);
+    vector<const vector<uint32_t>*> lists;
+    for (uint32_t trigram : literalTrigrams)
+    {
+        unordered_map<uint32_t, vector<uint32_t>>::const_iterator found = postings.find(trigram);
+        if (found == postings.end())
+            return true;
+        lists.push_back(&found->second);
+    }
+    sort(lists.begin(), lists.end(), [](const vector<uint32_t>* a, const vector<uint32_t>* b) { return a->size() < b->size(); });
+
+    vector<uint32_t> matched = *lists[0];
+    vector<uint32_t> narrowed;
+    for (size_t i = 1; i < lists.size() && !matched.empty(); i++)
+    {
+        narrowed.clear();
+        set_intersection(matched.begin(), matched.end(), lists[i]->begin(), lists[i]->end(), back_inserter(narrowed));
+        matched.swap(narrowed);
+    }
+    if (matched.size() > maxIds)
+        return false;
+
+    for (uint32_t number : matched)
+    {
+        if (!texts.isRemoved(number))
+            ids.push_back(texts.idOf(number));
+    }
+    reading.unlock();
+
+    sort(ids.begin(), ids.end());
+    return true;
+}
+
+/**
+ * @brief Lists the trigrams of a text. Each is three lowercased bytes packed into a number.
+ *
+ * @param text The text.
+ * @return The trigrams, sorted and without repeats.
+ */
+vector<uint32_t> TrigramIndex::trigrams(const string& text)
+{
+    vector<uint32_t> textTrigrams;
+    if (text.size() < 3)
+        return textTrigrams;
+
+    textTrigrams.reserve(text.size() - 2);
+    uint32_t window = 0;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        window = ((window << 8) | static_cast<unsigned char>(tolower(static_cast<unsigned char>(text[i])))) & 0xffffff;
+        if (i >= 2)
+            textTrigrams.push_back(window);
+    }
+
+    sort(textTrigrams.begin(), textTrigrams.end());
+    textTrigrams.erase(unique(textTrigrams.begin(), textTrigrams.end()), textTrigrams.end());
+    return textTrigrams;
+}
+
+/**
+ * @brief Drops the numbers no longer in use from the posting lists, once they outnumber the
+ * texts. Numbers keep their order, so the lists stay sorted.
+ */
+void TrigramIndex::compact()
+{
+    vector<uint32_t> renumbered;
+    if (!texts.renumber(renumbered))
+        return;
+
+    for (unordered_map<uint32_t, vector<uint32_t>>::iterator posting = postings.begin(); posting != postings.end();)
+    {
+        PostingNumbers::renumberList(posting->second, renumbered, [](uint32_t& number) -> uint32_t& { return number; });
+        if (posting->second.empty())
+            posting = postings.erase(posting);
+        else
+            ++posting;
+    }
+}
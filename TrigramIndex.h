@@ -0,0 +1,115 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "PostingNumbers.h"
+#include "Repository.h"
+#include "SearchPattern.h"
+
+// An inverted index of the trigrams, the runs of three characters, of one text per id. A
+// text that holds a literal holds every trigram of it, so intersecting the posting lists of
+// the literal's trigrams gives every id that may match, and usually few others. Case is
+// ignored the way SearchPattern ignores it.
+//
+// Texts are numbered by PostingNumbers, so posting lists stay sorted by appending, and the
+// lists are compacted once most of the numbers in them are gone.
+class TrigramIndex
+{
+public:
+    // Getters
+    size_t size() const;
+    size_t memoryBytes() const;
+
+    // Changes. add replaces the text of an id that is already indexed.
+    void add(const std::string& id, const std::string& text);
+    void remove(const std::string& id);
+    void clear();
+
+    // The ids, in id order, of the texts holding every trigram of a literal. Returns false
+    // for literals shorter than a trigram, which the index can't narrow down, and when more
+    // than maxIds texts may hold the literal.
+    bool candidates(const std::string& literal, std::vector<std::string>& ids, size_t maxIds = SIZE_MAX) const;
+
+    // The trigrams of a text, lowercased, each once and in order.
+    static std::vector<uint32_t> trigrams(const std::string& text);
+
+private:
+    void compact();
+
+    mutable std::shared_mutex indexMutex;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+    PostingNumbers texts;
+};
+
+// Indexes one text field of a repository's objects, e.g. the titles of experiments.
+template <typename T>
+class TextIndex : public RepositoryIndex<T>
+{
+public:
+    // Constructors
+    TextIndex(std::function<std::string(const T&)> textInput) : text(textInput) {}
+
+    // Getters
+    const TrigramIndex& getTrigrams() const { return trigrams; }
+    size_t memoryBytes() const override { return trigrams.memoryBytes(); }
+
+    // Changes
+    void put(const std::string& id, const T& object) override { trigrams.add(id, text(object)); }
+    void erase(const std::string& id) override { trigrams.remove(id); }
+    void clear() override { trigrams.clear(); }
+
+private:
+    std::function<std::string(const T&)> text;
+    TrigramIndex trigrams;
+};
+
+// Visit, in id order, every object of a repository a search pattern matches. matches checks
+// an object. A literal pattern checks only the objects the TextIndex of each named field
+// offers, unless they are more than a quarter of the repository; other patterns, and
+// repositories without those indexes, check every object.
+template <typename T>
+void scanMatches(const Repository<T>& repository, const std::vector<std::string>& fields, const SearchPattern& pattern, const std::function<bool(const T&)>& matches, const std::function<void(const std::string&, const T&)>& visit)
+{
+    // An object matches if one of its fields does, so the candidates of every field are merged.
+    // Getting the candidates one by one costs more than a scan once they are a good part of
+    // the repository, as they are for literals most objects hold.
+    std::vector<std::string> candidates;
+    size_t scanCandidates = repository.size() / 4;
+    bool indexed = pattern.isLiteral();
+    for (size_t i = 0; indexed && i < fields.size(); i++)
+    {
+        std::shared_ptr<TextIndex<T>> index = repository.template getIndex<TextIndex<T>>(fields[i]);
+        std::vector<std::string> fieldCandidates;
+        indexed = index && index->getTrigrams().candidates(pattern.getPattern(), fieldCandidates, scanCandidates);
+        if (indexed)
+            candidates.insert(candidates.end(), fieldCandidates.begin(), fieldCandidates.end());
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    if (!indexed || candidates.size() > scanCandidates)
+    {
+        repository.scan([&matches, &visit](const std::string& id, const T& object)
+        {
+            if (matches(object))
+                visit(id, object);
+        });
+        return;
+    }
+
+    for (const std::string& id : candidates)
+    {
+        T object;
+        if (repository.get(id, object) && matches(object))
+            visit(id, object);
+    }
+}
+
+#endif // TRIGRAM_INDEX_H
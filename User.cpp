@@ -8,6 +8,8 @@
  */
 
 #include "User.h"
+#include "BinarySnapshot.h"
+#include "JsonWriter.h"
 
 using namespace crow;
 
@@ -26,7 +28,7 @@ User::User(json::rvalue readValueJson)
  * 
  * @return A JSON object containing the user's details.
  */
-json::wvalue User::convertToJson()
+json::wvalue User::convertToJson() const
 {
     json::wvalue writeJson;
     writeJson["userId"] = userId;
@@ -35,6 +37,21 @@ json::wvalue User::convertToJson()
     return writeJson;
 }
 
+/**
+ * @brief Writes the User object as JSON, the same text convertToJson().dump() gives.
+ * 
+ * Members are written in the order crow dumps them in, so both paths give the same bytes.
+ * 
+ * @param writer Receives the user's details.
+ */
+void User::writeJson(JsonWriter& writer) const
+{
+    writer.beginObject();
+    writer.member("userName", userName);
+    writer.member("userId", userId);
+    writer.endObject();
+}
+
 /**
  * @brief Updates the User object from a JSON representation.
  * 
@@ -45,3 +62,25 @@ void User::updateFromJson(json::rvalue readValueJson)
     userId = readValueJson["userId"].s();
     userName = readValueJson["userName"].s();
 }
+
+/**
+ * @brief Writes the User object as a binary snapshot record.
+ * 
+ * @param writer The writer for the record. Fields are written in a fixed order.
+ */
+void User::writeBinaryRecord(BinaryRecordWriter& writer) const
+{
+    writer.writeString(userId);
+    writer.writeString(userName);
+}
+
+/**
+ * @brief Reads the User object from a binary snapshot record.
+ * 
+ * @param reader The reader for the record. Fields are read in the order they were written.
+ */
+void User::readBinaryRecord(BinaryRecordReader& reader)
+{
+    userId = reader.readString();
+    userName = reader.readString();
+}
@@ -4,6 +4,10 @@
 #include <string>
 #include <crow.h>
 
+class BinaryRecordWriter;
+class BinaryRecordReader;
+class JsonWriter;
+
 class User
 {
 public:
@@ -20,9 +24,14 @@ public:
     void setUserName(std::string userNameInput) { userName = userNameInput; }
 
     // JSON Methods
-    virtual crow::json::wvalue convertToJson();
+    virtual crow::json::wvalue convertToJson() const;
+    virtual void writeJson(JsonWriter& writer) const;
     virtual void updateFromJson(crow::json::rvalue readValueJson);
 
+    // Binary snapshot methods
+    virtual void writeBinaryRecord(BinaryRecordWriter& writer) const;
+    virtual void readBinaryRecord(BinaryRecordReader& reader);
+
 private:
     std::string userId;
     std::string userName;
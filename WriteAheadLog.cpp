@@ -0,0 +1,555 @@
+/**
+ * @file WriteAheadLog.cpp
+ * @brief Implementation of the WriteAheadLog class.
+ *
+ * This file provides the implementation for the WriteAheadLog class, an append-only,
+ * checksummed log of every change made to the resource collections. Records are framed as
+ * [uint32 length][uint32 crc32][body] where body is operation, collection, id and payload.
+ * Replaying the log on top of the last saved files restores every change since the save.
+ * A snapshot rotates the active log to <log>.prev and deletes it once the snapshot is safe.
+ */
+
+#include "WriteAheadLog.h"
+#include "DurableFile.h"
+#include "toLowerHelper.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    const size_t frameHeaderSize = 2 * sizeof(uint32_t);
+
+    /**
+     * @brief Encodes a record as one log frame.
+     *
+     * @param record The record to encode.
+     * @return The framed bytes ready to be written to the log file.
+     */
+    string encodeFrame(const LogRecord& record)
+    {
+        string body;
+        body.reserve(record.collection.size() + record.id.size() + record.payload.size() + 3);
+        body += static_cast<char>(record.operation);
+        body += record.collection;
+        body += '\0';
+        body += record.id;
+        body += '\0';
+        body += record.payload;
+
+        uint32_t length = body.size();
+        uint32_t crc = WriteAheadLog::checksum(body);
+
+        string frame(frameHeaderSize, '\0');
+        memcpy(&frame[0], &length, sizeof(length));
+        memcpy(&frame[sizeof(length)], &crc, sizeof(crc));
+        return frame + body;
+    }
+
+    /**
+     * @brief Decodes every intact frame at the start of the log bytes.
+     *
+     * Decoding stops at the first truncated or corrupt frame, which is what a crash in the
+     * middle of a write leaves behind.
+     *
+     * @param bytes The contents of the log file.
+     * @param records Receives the decoded records, may be null.
+     * @return The number of bytes covered by intact frames.
+     */
+    size_t decodeFrames(const string& bytes, vector<LogRecord>* records)
+    {
+        size_t offset = 0;
+        while (bytes.size() - offset >= frameHeaderSize)
+        {
+            uint32_t length;
+            uint32_t crc;
+            memcpy(&length, &bytes[offset], sizeof(length));
+            memcpy(&crc, &bytes[offset + sizeof(length)], sizeof(crc));
+
+            if (length < 3 || bytes.size() - offset - frameHeaderSize < length)
+                break;
+
+            string body = bytes.substr(offset + frameHeaderSize, length);
+            if (WriteAheadLog::checksum(body) != crc)
+                break;
+
+            size_t collectionEnd = body.find('\0', 1);
+            size_t idEnd = collectionEnd == string::npos ? string::npos : body.find('\0', collectionEnd + 1);
+            if (idEnd == string::npos || (body[0] != 'P' && body[0] != 'D'))
+                break;
+
+            if (records)
+            {
+                LogRecord record;
+                record.operation = static_cast<LogOperation>(body[0]);
+                record.collection = body.substr(1, collectionEnd - 1);
+                record.id = body.substr(collectionEnd + 1, idEnd - collectionEnd - 1);
+                record.payload = body.substr(idEnd + 1);
+                records->push_back(record);
+            }
+
+            offset += frameHeaderSize + length;
+        }
+
+        return offset;
+    }
+
+    /**
+     * @brief Reads a whole file into a string.
+     *
+     * @param filename The name of the file to read.
+     * @return The file contents, or an empty string if the file cannot be opened.
+     */
+    string readFileBytes(const string& filename)
+    {
+        ifstream file(filename, ios::binary);
+        ostringstream contents;
+        if (file.is_open())
+            contents << file.rdbuf();
+        return contents.str();
+    }
+}
+
+/**
+ * @brief Flushes outstanding records and closes the log.
+ */
+WriteAheadLog::~WriteAheadLog()
+{
+    close();
+}
+
+/**
+ * @brief Gets the number of records appended since the log was opened.
+ *
+ * @return The number of appended records.
+ */
+uint64_t WriteAheadLog::getAppendCount() const
+{
+    lock_guard<mutex> lock(logMutex);
+    return appendedSequence;
+}
+
+/**
+ * @brief Gets the number of fsync calls made since the log was opened.
+ *
+ * @return The number of fsync calls.
+ */
+uint64_t WriteAheadLog::getSyncCount() const
+{
+    lock_guard<mutex> lock(logMutex);
+    return syncCount;
+}
+
+/**
+ * @brief Checks whether a write or sync of the log has failed since it was opened.
+ *
+ * @return True if the log refuses appends.
+ */
+bool WriteAheadLog::hasFailed() const
+{
+    lock_guard<mutex> lock(logMutex);
+    return failed;
+}
+
+/**
+ * @brief Opens the log for appending.
+ *
+ * Any torn record left at the end of the file by a crash is cut off so that new records
+ * are appended directly after the last intact one.
+ *
+ * @param filenameInput The name of the log file.
+ * @param durabilityInput How long append() waits before it returns.
+ * @return True if the log was opened, false otherwise.
+ */
+bool WriteAheadLog::open(string filenameInput, Durability durabilityInput)
+{
+    close();
+
+    size_t intactLength = decodeFrames(readFileBytes(filenameInput), nullptr);
+
+    int descriptor = ::open(filenameInput.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (descriptor < 0)
+        return false;
+
+    if (ftruncate(descriptor, intactLength) != 0)
+    {
+        ::close(descriptor);
+        return false;
+    }
+
+    lock_guard<mutex> lock(logMutex);
+    filename = filenameInput;
+    fileDescriptor = descriptor;
+    durability = durabilityInput;
+    stopping = false;
+    failed = false;
+    pendingBytes.clear();
+    appendedSequence = 0;
+    durableSequence = 0;
+    syncCount = 0;
+
+    if (durability == Durability::GroupCommit)
+        flushThread = thread(&WriteAheadLog::flushLoop, this);
+
+    return true;
+}
+
+/**
+ * @brief Flushes outstanding records and closes the log.
+ */
+void WriteAheadLog::close()
+{
+    {
+        lock_guard<mutex> lock(logMutex);
+        stopping = true;
+    }
+    flushRequested.notify_all();
+
+    if (flushThread.joinable())
+        flushThread.join();
+
+    lock_guard<mutex> lock(logMutex);
+    if (fileDescriptor >= 0)
+    {
+        fdatasync(fileDescriptor);
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+}
+
+/**
+ * @brief Appends a record to the log.
+ *
+ * Returns once the record is as durable as the log's durability level requires. Appending
+ * to a log that is not open does nothing, so handlers can be used without a log.
+ *
+ * @param record The change to append.
+ * @throws runtime_error if the record could not be written, or the log failed before.
+ */
+void WriteAheadLog::append(const LogRecord& record)
+{
+    appendFrames(encodeFrame(record), 1);
+}
+
+/**
+ * @brief Appends several records to the log, written together and made durable by one wait.
+ *
+ * A bulk change logs its records this way, so it waits for one fsync instead of one each.
+ *
+ * @param records The changes to append, in order.
+ * @throws runtime_error if the records could not be written, or the log failed before.
+ */
+void WriteAheadLog::append(const vector<LogRecord>& records)
+{
+    string frames;
+    for (const LogRecord& record : records)
+        frames += encodeFrame(record);
+    appendFrames(frames, records.size());
+}
+
+/**
+ * @brief Writes encoded frames to the log and waits until they are as durable as the log's
+ * durability level requires.
+ *
+ * @param frames The framed records.
+ * @param count The number of records in frames.
+ * @throws runtime_error if the frames could not be written, or the log failed before.
+ */
+void WriteAheadLog::appendFrames(const string& frames, uint64_t count)
+{
+    unique_lock<mutex> lock(logMutex);
+    if (fileDescriptor < 0 || count == 0)
+        return;
+
+    // After a lost or torn record, later records could be replayed without it.
+    if (failed)
+        throw runtime_error("The write-ahead log failed and takes no more records");
+
+    if (durability != Durability::GroupCommit)
+    {
+        try
+        {
+            writeFully(frames);
+        }
+        catch (runtime_error& exception)
+        {
+            failed = true;
+            throw;
+        }
+        if (durability == Durability::Sync)
+        {
+            if (fdatasync(fileDescriptor) != 0)
+            {
+                failed = true;
+                throw runtime_error("Failed to sync the write-ahead log");
+            }
+            syncCount++;
+        }
+        appendedSequence += count;
+        durableSequence = appendedSequence;
+        return;
+    }
+
+    // Queue the frames for the flush thread and wait for the fsync that covers them.
+    pendingBytes += frames;
+    appendedSequence += count;
+    uint64_t sequence = appendedSequence;
+    flushRequested.notify_one();
+    flushCompleted.wait(lock, [&] { return durableSequence >= sequence || failed; });
+
+    if (durableSequence < sequence)
+        throw runtime_error("Failed to sync the write-ahead log");
+}
+
+/**
+ * @brief Empties the log once every change in it has been saved elsewhere.
+ *
+ * Call this only after the resource files hold every change that has been appended.
+ */
+void WriteAheadLog::checkpoint()
+{
+    unique_lock<mutex> lock(logMutex);
+    if (fileDescriptor < 0)
+        return;
+
+    flushCompleted.wait(lock, [&] { return durableSequence >= appendedSequence || failed; });
+
+    if (failed || ftruncate(fileDescriptor, 0) != 0 || fdatasync(fileDescriptor) != 0)
+        throw runtime_error("Failed to truncate the write-ahead log");
+
+    remove(rotatedFilename(filename).c_str());
+}
+
+/**
+ * @brief Moves every record logged so far into the rotated log and starts an empty one.
+ * 
+ * A snapshot rotates the log at the moment it captures the resource maps, so the rotated
+ * records are exactly the ones the snapshot contains. If an earlier rotated log is still
+ * around because its snapshot failed, the records are added to the end of it instead.
+ * 
+ * @return True if the log was rotated, false otherwise.
+ */
+bool WriteAheadLog::rotate()
+{
+    unique_lock<mutex> lock(logMutex);
+    if (fileDescriptor < 0)
+        return false;
+
+    // Wait for queued records, after which the flush thread is idle until the next append.
+    flushCompleted.wait(lock, [&] { return durableSequence >= appendedSequence || failed; });
+    if (failed)
+        return false;
+
+    string rotated = rotatedFilename(filename);
+    if (access(rotated.c_str(), F_OK) == 0)
+    {
+        // Keep the older records first, then empty the active log.
+        ofstream rotatedFile(rotated, ios::binary | ios::app);
+        rotatedFile << readFileBytes(filename);
+        rotatedFile.close();
+        if (rotatedFile.fail())
+            return false;
+
+        int rotatedDescriptor = ::open(rotated.c_str(), O_WRONLY);
+        bool synced = rotatedDescriptor >= 0 && fdatasync(rotatedDescriptor) == 0;
+        if (rotatedDescriptor >= 0)
+            ::close(rotatedDescriptor);
+
+        return synced && ftruncate(fileDescriptor, 0) == 0 && fdatasync(fileDescriptor) == 0;
+    }
+
+    int descriptor = ::open((filename + ".next").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (descriptor < 0)
+        return false;
+
+    if (rename(filename.c_str(), rotated.c_str()) != 0)
+    {
+        ::close(descriptor);
+        return false;
+    }
+    if (rename((filename + ".next").c_str(), filename.c_str()) != 0)
+    {
+        // Give the active log its name back, so a later discardRotated can't delete it.
+        rename(rotated.c_str(), filename.c_str());
+        ::close(descriptor);
+        return false;
+    }
+
+    ::close(fileDescriptor);
+    fileDescriptor = descriptor;
+    return true;
+}
+
+/**
+ * @brief Deletes the rotated log once a snapshot holding its records has been saved.
+ */
+void WriteAheadLog::discardRotated()
+{
+    lock_guard<mutex> lock(logMutex);
+    if (!filename.empty())
+        remove(rotatedFilename(filename).c_str());
+}
+
+/**
+ * @brief Reads every intact record from a log file and the log rotated out of it.
+ *
+ * @param filename The name of the log file.
+ * @return The records in the order they were appended.
+ */
+vector<LogRecord> WriteAheadLog::readAll(string filename)
+{
+    vector<LogRecord> records;
+    decodeFrames(readFileBytes(rotatedFilename(filename)), &records);
+    decodeFrames(readFileBytes(filename), &records);
+    return records;
+}
+
+/**
+ * @brief Reads every intact record from a segment, a file of log frames written in one go.
+ *
+ * @param filename The name of the segment file.
+ * @return The records in the order they were written.
+ */
+vector<LogRecord> WriteAheadLog::readSegment(string filename)
+{
+    vector<LogRecord> records;
+    decodeFrames(readFileBytes(filename), &records);
+    return records;
+}
+
+/**
+ * @brief Writes records as a segment in the log frame format.
+ *
+ * The segment is written to a temporary file and put in place by replaceFile, so it either
+ * appears whole or not at all, and stays once it has.
+ *
+ * @param filename The name of the segment file.
+ * @param records The records to write.
+ * @return True if the segment was written, false otherwise.
+ */
+bool WriteAheadLog::writeSegment(string filename, const vector<LogRecord>& records)
+{
+    string temporaryFilename = filename + ".tmp";
+    ofstream file(temporaryFilename, ios::binary | ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    for (const LogRecord& record : records)
+        file << encodeFrame(record);
+    file.close();
+    if (file.fail())
+        return false;
+
+    return replaceFile(temporaryFilename, filename);
+}
+
+/**
+ * @brief Converts a durability name to a durability level.
+ *
+ * @param durabilityString One of "none", "group" or "sync".
+ * @return The matching durability level, GroupCommit if the name is not recognised.
+ */
+WriteAheadLog::Durability WriteAheadLog::parseDurability(string durabilityString)
+{
+    if (toLower(durabilityString) == "none")
+        return Durability::None;
+    if (toLower(durabilityString) == "sync")
+        return Durability::Sync;
+    return Durability::GroupCommit;
+}
+
+/**
+ * @brief Computes the CRC-32 (IEEE 802.3) checksum of a byte string.
+ *
+ * @param bytes The bytes to checksum.
+ * @return The checksum.
+ */
+uint32_t WriteAheadLog::checksum(const string& bytes)
+{
+    static const vector<uint32_t> table = []
+    {
+        vector<uint32_t> entries(256);
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++)
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned char byte : bytes)
+        crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * @brief Writes bytes to the end of the log file, retrying short writes.
+ *
+ * @param bytes The bytes to write.
+ * @throws runtime_error if the bytes could not be written.
+ */
+void WriteAheadLog::writeFully(const string& bytes)
+{
+    size_t written = 0;
+    while (written < bytes.size())
+    {
+        ssize_t result = ::write(fileDescriptor, bytes.data() + written, bytes.size() - written);
+        if (result < 0)
+            throw runtime_error("Failed to write to the write-ahead log");
+        written += result;
+    }
+}
+
+/**
+ * @brief Body of the group commit thread.
+ *
+ * Takes every frame queued since the previous flush, writes them with a single write and
+ * a single fsync, then wakes every append that was waiting on them.
+ */
+void WriteAheadLog::flushLoop()
+{
+    unique_lock<mutex> lock(logMutex);
+    while (true)
+    {
+        flushRequested.wait(lock, [&] { return stopping || !pendingBytes.empty(); });
+        if (pendingBytes.empty())
+            break;
+
+        string batch;
+        batch.swap(pendingBytes);
+        uint64_t batchSequence = appendedSequence;
+        lock.unlock();
+
+        bool synced = true;
+        try
+        {
+            writeFully(batch);
+            synced = fdatasync(fileDescriptor) == 0;
+        }
+        catch (runtime_error& exception)
+        {
+            synced = false;
+        }
+
+        lock.lock();
+        if (synced)
+        {
+            durableSequence = batchSequence;
+            syncCount++;
+        }
+        else
+        {
+            failed = true;
+        }
+        flushCompleted.notify_all();
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The kind of change a log record describes.
+enum class LogOperation : char
+{
+    Put = 'P',
+    Delete = 'D'
+};
+
+// A single change to one of the resource collections.
+struct LogRecord
+{
+    std::string collection;
+    LogOperation operation;
+    std::string id;
+    std::string payload; // JSON of the whole resource for Put, empty for Delete.
+};
+
+class WriteAheadLog
+{
+public:
+    // How long append() waits before it returns.
+    enum class Durability
+    {
+        None,        // Hand the record to the OS and never fsync.
+        GroupCommit, // Wait for an fsync that is shared by every append queued at the same time.
+        Sync         // fsync every append on its own.
+    };
+
+    // Constructors
+    WriteAheadLog() {}
+    ~WriteAheadLog();
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Getters
+    bool isOpen() const { return fileDescriptor >= 0; }
+    Durability getDurability() const { return durability; }
+    uint64_t getAppendCount() const;
+    uint64_t getSyncCount() const;
+
+    // True once a record could not be written or synced. The log then refuses every append
+    // until it is opened again, so handlers check it before changing a repository and answer
+    // 503 instead of making a change the log can't hold.
+    bool hasFailed() const;
+
+    // Log file methods
+    bool open(std::string filenameInput, Durability durabilityInput);
+    void close();
+    void append(const LogRecord& record);
+    void append(const std::vector<LogRecord>& records);
+    void checkpoint();
+
+    // Snapshot coordination. Handlers hold the mutation lock while they change a resource
+    // map and log the change; a snapshot holds the snapshot lock while it rotates the log
+    // and captures the maps, so it always sees whole changes.
+    std::shared_lock<std::shared_mutex> lockForMutation() { return std::shared_lock<std::shared_mutex>(mutationMutex); }
+    std::unique_lock<std::shared_mutex> lockForSnapshot() { return std::unique_lock<std::shared_mutex>(mutationMutex); }
+    bool rotate();
+    void discardRotated();
+
+    // Helpers
+    static std::vector<LogRecord> readAll(std::string filename);
+    static std::vector<LogRecord> readSegment(std::string filename);
+    static bool writeSegment(std::string filename, const std::vector<LogRecord>& records);
+    static std::string rotatedFilename(std::string filename) { return filename + ".prev"; }
+    static Durability parseDurability(std::string durabilityString);
+    static uint32_t checksum(const std::string& bytes);
+
+private:
+    void appendFrames(const std::string& frames, uint64_t count);
+    void writeFully(const std::string& bytes);
+    void flushLoop();
+
+    std::string filename;
+    int fileDescriptor = -1;
+    Durability durability = Durability::GroupCommit;
+
+    std::shared_mutex mutationMutex;
+    mutable std::mutex logMutex;
+    std::condition_variable flushRequested;
+    std::condition_variable flushCompleted;
+    std::thread flushThread;
+    bool stopping = false;
+    bool failed = false;
+
+    // Group commit state, guarded by logMutex.
+    std::string pendingBytes;
+    uint64_t appendedSequence = 0;
+    uint64_t durableSequence = 0;
+    uint64_t syncCount = 0;
+};
+
+#endif // WRITE_AHEAD_LOG_H
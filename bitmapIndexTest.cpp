@@ -0,0 +1,147 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BitmapIndex.h"
+#include "Equipment.h"
+
+using namespace std;
+
+// Makes an equipment that is available or not.
+static Equipment makeEquipment(const string& id, bool available)
+{
+    Equipment equipment;
+    equipment.setId(id);
+    equipment.setName("Oscilloscope " + id);
+    equipment.setAvailability(available);
+    return equipment;
+}
+
+TEST_CASE("Combining and counting bitmaps.")
+{
+    Bitmap low;
+    Bitmap high;
+    for (uint32_t number : {0, 3, 63, 64})
+        low.set(number);
+    for (uint32_t number : {3, 64, 200})
+        high.set(number);
+    CHECK(low.count() == 4);
+    CHECK(low.test(63));
+    CHECK_FALSE(low.test(62));
+    CHECK_FALSE(low.test(100000));
+
+    Bitmap either = low;
+    either |= high;
+    CHECK(either.count() == 5);
+    CHECK(either.test(200));
+
+    Bitmap onlyLow = low;
+    onlyLow.andNot(high);
+    CHECK(onlyLow.count() == 2);
+    CHECK(onlyLow.test(0));
+    CHECK_FALSE(onlyLow.test(64));
+
+    high.andNot(low);
+    CHECK(high.count() == 1);
+    high.reset(200);
+    high.reset(100000);
+    CHECK(high.count() == 0);
+
+    BitmapQuery query = BitmapQuery::parse("boston,,cambridge,!lab 2,!");
+    CHECK(query.anyOf == vector<string>{"boston", "cambridge"});
+    CHECK(query.noneOf == vector<string>{"lab 2"});
+    CHECK(query.matches("cambridge"));
+    CHECK_FALSE(query.matches("lab 2"));
+    CHECK_FALSE(query.matches("denver"));
+    CHECK(BitmapQuery::parse("!boston").matches("denver"));
+}
+
+TEST_CASE("Finding ids by the value of an attribute.")
+{
+    BitmapIndex index;
+    index.add("lab_004", "boston");
+    index.add("lab_001", "cambridge");
+    index.add("lab_003", "boston");
+    index.add("lab_002", "denver");
+    CHECK(index.size() == 4);
+    CHECK(index.memoryBytes() > 0);
+
+    vector<string> ids;
+    SUBCASE("Queries OR the values they accept and take out the ones they exclude")
+    {
+        CHECK(index.select(BitmapQuery::parse("boston"), nullptr, 0, ids) == 2);
+        CHECK(ids == vector<string>{"lab_003", "lab_004"});
+        CHECK(index.select(BitmapQuery::parse("boston,denver"), nullptr, 0, ids) == 3);
+        CHECK(ids == vector<string>{"lab_002", "lab_003", "lab_004"});
+        CHECK(index.select(BitmapQuery::parse("!boston"), nullptr, 0, ids) == 2);
+        CHECK(ids == vector<string>{"lab_001", "lab_002"});
+        CHECK(index.select(BitmapQuery::parse("boston,denver,!denver"), nullptr, 0, ids) == 2);
+        CHECK(index.select(BitmapQuery::parse("paris"), nullptr, 0, ids) == 0);
+        CHECK(ids.empty());
+    }
+
+    SUBCASE("Pages are in id order from the cursor, and the count covers every page")
+    {
+        string after = "lab_001";
+        CHECK(index.select(BitmapQuery::parse("!cambridge"), &after, 2, ids) == 3);
+        CHECK(ids == vector<string>{"lab_002", "lab_003"});
+        after = ids.back();
+        CHECK(index.select(BitmapQuery::parse("!cambridge"), &after, 2, ids) == 3);
+        CHECK(ids == vector<string>{"lab_004"});
+    }
+
+    SUBCASE("Changed ids move between bitmaps, and numbers of removed ids are reused")
+    {
+        index.add("lab_004", "denver");
+        index.remove("lab_001");
+        index.add("lab_000", "cambridge");
+        CHECK(index.size() == 4);
+        CHECK(index.select(BitmapQuery::parse("denver"), nullptr, 0, ids) == 2);
+        CHECK(ids == vector<string>{"lab_002", "lab_004"});
+        CHECK(index.select(BitmapQuery::parse("cambridge"), nullptr, 0, ids) == 1);
+        CHECK(ids == vector<string>{"lab_000"});
+        CHECK(index.select(BitmapQuery(), nullptr, 0, ids) == 4);
+        CHECK(ids == vector<string>{"lab_000", "lab_002", "lab_003", "lab_004"});
+
+        index.clear();
+        CHECK(index.size() == 0);
+        CHECK(index.select(BitmapQuery(), nullptr, 0, ids) == 0);
+    }
+}
+
+TEST_CASE("Filtering the objects of a repository by an attribute.")
+{
+    Repository<Equipment> equipmentsRepository;
+    for (int i = 1; i <= 9; i++)
+        equipmentsRepository.put("equip_00" + to_string(i), makeEquipment("equip_00" + to_string(i), i % 3 != 0));
+    function<string(const Equipment&)> availability = [](const Equipment& equipment) { return equipment.isAvailable() ? "true" : "false"; };
+    BitmapQuery available{{"true"}, {}};
+
+    // Collects the ids a filter page visits, and the count of every match.
+    auto visitedIds = [&](const string& query, size_t& total)
+    {
+        PageRequest page;
+        REQUIRE(page.parse(crow::query_string(query)));
+        vector<string> ids;
+        total = scanAttribute<Equipment>(equipmentsRepository, "available", availability, available, page, [&ids](const string& id, const Equipment&) { ids.push_back(id); });
+        return ids;
+    };
+
+    size_t scannedTotal = 0;
+    vector<string> scanned = visitedIds("?limit=2&cursor=" + PageRequest::makeCursor("id", SortedId{SortKey(), "equip_002"}), scannedTotal);
+    equipmentsRepository.addIndex(attributeIndexName("available"), make_shared<AttributeIndex<Equipment>>(availability));
+
+    // One more than the limit is visited, to know there is a next page.
+    size_t total = 0;
+    CHECK(visitedIds("?limit=2&cursor=" + PageRequest::makeCursor("id", SortedId{SortKey(), "equip_002"}), total) == scanned);
+    CHECK(scanned == vector<string>{"equip_004", "equip_005", "equip_007"});
+    CHECK(total == scannedTotal);
+    CHECK(total == 6);
+
+    // Changes reach the bitmaps.
+    equipmentsRepository.put("equip_003", makeEquipment("equip_003", true));
+    equipmentsRepository.erase("equip_001");
+    CHECK(visitedIds("", total) == vector<string>{"equip_002", "equip_003", "equip_004", "equip_005", "equip_007", "equip_008"});
+    CHECK(total == 6);
+}
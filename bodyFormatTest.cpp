@@ -0,0 +1,181 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <string>
+#include "BodyFormat.h"
+
+using namespace std;
+using namespace crow;
+
+// Writes bytes as lowercase hex, to compare them with the encodings in the specifications.
+static string toHex(const string& bytes)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    string hex;
+    for (unsigned char c : bytes)
+    {
+        hex.push_back(hexDigits[c >> 4]);
+        hex.push_back(hexDigits[c & 0xf]);
+    }
+    return hex;
+}
+
+// Reads bytes from hex.
+static string fromHex(const string& hex)
+{
+    string bytes;
+    for (size_t i = 0; i < hex.size(); i += 2)
+        bytes.push_back(static_cast<char>(stoi(hex.substr(i, 2), nullptr, 16)));
+    return bytes;
+}
+
+TEST_CASE("Translating JSON to MessagePack and CBOR and back.")
+{
+    string json = R"({"a":1,"b":[true,null],"c":-2,"d":1.5,"e":"x"})";
+    string messagePack;
+    string cbor;
+    REQUIRE(encodeJsonBody(json, BodyFormat::MessagePack, messagePack));
+    REQUIRE(encodeJsonBody(json, BodyFormat::Cbor, cbor));
+
+    // Check the results: the bytes of the specifications, and the same JSON read back.
+    CHECK(toHex(messagePack) == "85a16101a16292c3c0a163fea164cb3ff8000000000000a165a178");
+    CHECK(toHex(cbor) == "a5616101616282f5f66163216164fb3ff800000000000061656178");
+    for (BodyFormat format : {BodyFormat::MessagePack, BodyFormat::Cbor})
+    {
+        string encoded;
+        string decoded;
+        REQUIRE(encodeJsonBody(json, format, encoded));
+        CHECK(decodeToJsonBody(encoded, format, decoded));
+        CHECK(decoded == json);
+    }
+
+    // Lengths and integers take the fewest bytes that hold them.
+    string bytes;
+    REQUIRE(encodeJsonBody(R"([200,-200,70000,")" + string(40, 'x') + R"("])", BodyFormat::MessagePack, bytes));
+    CHECK(toHex(bytes) == "94ccc8d1ff38ce00011170d928" + toHex(string(40, 'x')));
+    bytes.clear();
+    REQUIRE(encodeJsonBody(R"([200,-200,70000,")" + string(40, 'x') + R"("])", BodyFormat::Cbor, bytes));
+    CHECK(toHex(bytes) == "8418c838c71a000111707828" + toHex(string(40, 'x')));
+
+    // Escapes are undone, surrogate pairs included, and written again as JSON reads back.
+    bytes.clear();
+    REQUIRE(encodeJsonBody(R"(" \u00e9\n\ud83d\ude00")", BodyFormat::Cbor, bytes));
+    CHECK(toHex(bytes) == "6820c3a90af09f9880");
+    string decoded;
+    REQUIRE(decodeToJsonBody(bytes, BodyFormat::Cbor, decoded));
+    CHECK(decoded == "\" \xc3\xa9\\n\xf0\x9f\x98\x80\"");
+}
+
+TEST_CASE("Refusing bodies that are not valid.")
+{
+    string out;
+    for (string json : {R"({"a":})", "[1,]", "1 2", R"("open)", "[tru]", R"({"a" 1})", "-"})
+    {
+        CAPTURE(json);
+        CHECK_FALSE(encodeJsonBody(json, BodyFormat::MessagePack, out));
+        CHECK(out.empty());
+    }
+
+    // Truncated values, keys that are not strings, byte strings and bodies nested too deep.
+    string json;
+    CHECK_FALSE(decodeToJsonBody(fromHex("92c3"), BodyFormat::MessagePack, json));
+    CHECK_FALSE(decodeToJsonBody(fromHex("810102"), BodyFormat::MessagePack, json));
+    CHECK_FALSE(decodeToJsonBody(fromHex("c403616263"), BodyFormat::MessagePack, json));
+    CHECK_FALSE(decodeToJsonBody(fromHex("a10102"), BodyFormat::Cbor, json));
+    CHECK_FALSE(decodeToJsonBody(fromHex("4100"), BodyFormat::Cbor, json));
+    CHECK_FALSE(decodeToJsonBody(fromHex("dd7fffffff"), BodyFormat::MessagePack, json));
+    CHECK_FALSE(decodeToJsonBody(string(100, '\x91') + '\x01', BodyFormat::MessagePack, json));
+    CHECK_FALSE(decodeToJsonBody(fromHex("0101"), BodyFormat::Cbor, json));
+    CHECK(json.empty());
+
+    // Other encodings a client may pick are read: indefinite lengths, half floats and tags.
+    CHECK(decodeToJsonBody(fromHex("bf6161f93c00ff"), BodyFormat::Cbor, json));
+    CHECK(json == R"({"a":1.0})");
+    json.clear();
+    CHECK(decodeToJsonBody(fromHex("c11a514b67b0"), BodyFormat::Cbor, json));
+    CHECK(json == "1363896240");
+}
+
+TEST_CASE("Negotiating the format and translating bodies around the handlers.")
+{
+    CHECK(acceptedBodyFormat("") == BodyFormat::Json);
+    CHECK(acceptedBodyFormat("application/msgpack") == BodyFormat::MessagePack);
+    CHECK(acceptedBodyFormat("application/cbor") == BodyFormat::Cbor);
+    CHECK(acceptedBodyFormat("*/*") == BodyFormat::Json);
+    CHECK(acceptedBodyFormat("text/html") == BodyFormat::Json);
+    CHECK(acceptedBodyFormat("application/json, application/msgpack;q=0.5") == BodyFormat::Json);
+    CHECK(acceptedBodyFormat("application/msgpack;q=0.5, application/cbor") == BodyFormat::Cbor);
+    CHECK(acceptedBodyFormat("application/json;q=0.1, Application/X-MsgPack") == BodyFormat::MessagePack);
+    CHECK(contentBodyFormat("application/cbor; charset=binary") == BodyFormat::Cbor);
+    CHECK(contentBodyFormat("application/json") == BodyFormat::Json);
+
+    BinaryBodies middleware;
+    SUBCASE("A MessagePack request body reaches the handler as JSON")
+    {
+        request req;
+        response res;
+        BinaryBodies::context ctx;
+        req.add_header("Content-Type", "application/msgpack");
+        req.body = fromHex("81a56c61624964a76c61625f303031");
+        middleware.before_handle(req, res, ctx);
+        CHECK(req.body == R"({"labId":"lab_001"})");
+        CHECK(req.get_header_value("Content-Type") == "application/json");
+        CHECK_FALSE(res.is_completed());
+
+        request invalid;
+        invalid.add_header("Content-Type", "application/cbor");
+        invalid.body = fromHex("a1");
+        middleware.before_handle(invalid, res, ctx);
+        CHECK(res.code == 400);
+        CHECK(res.is_completed());
+    }
+
+    SUBCASE("Responses and their tags are in the format the client accepts")
+    {
+        request req;
+        BinaryBodies::context ctx;
+        req.add_header("Accept", "application/cbor");
+        req.add_header("If-None-Match", "\"0123456789abcdef-cbor\"");
+        req.add_header("If-Match", "\"0123456789abcdef-msgpack\"");
+        response res;
+        middleware.before_handle(req, res, ctx);
+        CHECK(ctx.responseFormat == BodyFormat::Cbor);
+        CHECK(req.get_header_value("If-None-Match") == "\"0123456789abcdef\"");
+        CHECK(req.get_header_value("If-Match") == "\"0123456789abcdef\"");
+
+        res.body = R"({"labId":"lab_001"})";
+        res.set_header("ETag", "\"0123456789abcdef\"");
+        middleware.after_handle(req, res, ctx);
+        CHECK(toHex(res.body) == "a1656c61624964676c61625f303031");
+        CHECK(res.get_header_value("Content-Type") == "application/cbor");
+        CHECK(res.get_header_value("ETag") == "\"0123456789abcdef-cbor\"");
+        CHECK(res.get_header_value("Vary") == "Accept");
+
+        response notModified(304);
+        notModified.set_header("ETag", "\"0123456789abcdef\"");
+        middleware.after_handle(req, notModified, ctx);
+        CHECK(notModified.get_header_value("ETag") == "\"0123456789abcdef-cbor\"");
+
+        response exported(string(R"({"labId":"lab_001"})") + "\n");
+        exported.set_header("Content-Type", "application/x-ndjson");
+        middleware.after_handle(req, exported, ctx);
+        CHECK(exported.body == "{\"labId\":\"lab_001\"}\n");
+
+        response notFound(404, "Lab Not Found");
+        middleware.after_handle(req, notFound, ctx);
+        CHECK(notFound.body == "Lab Not Found");
+    }
+
+    SUBCASE("A JSON client's tags of binary copies don't match")
+    {
+        request req;
+        BinaryBodies::context ctx;
+        req.add_header("If-None-Match", "\"0123456789abcdef-cbor\"");
+        response res;
+        middleware.before_handle(req, res, ctx);
+        CHECK(req.get_header_value("If-None-Match") == "\"0123456789abcdef-cbor\"");
+
+        res.body = R"({"labId":"lab_001"})";
+        middleware.after_handle(req, res, ctx);
+        CHECK(res.body == R"({"labId":"lab_001"})");
+    }
+}
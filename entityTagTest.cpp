@@ -0,0 +1,75 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <string>
+#include "EntityTag.h"
+
+using namespace std;
+using namespace crow;
+
+TEST_CASE("Tagging responses.") 
+{
+    string body = R"({"labId":"lab_001"})";
+    string entityTag = makeEntityTag(body);
+
+    // Check the results: tags are quoted, follow the content and the collection version.
+    CHECK(entityTag.size() == 18);
+    CHECK(entityTag.front() == '"');
+    CHECK(entityTag.back() == '"');
+    CHECK(entityTag == makeEntityTag(body));
+    CHECK(entityTag != makeEntityTag(R"({"labId":"lab_002"})"));
+    CHECK(makeVersionTag(3, "/api/labs") == makeVersionTag(3, "/api/labs"));
+    CHECK(makeVersionTag(3, "/api/labs") != makeVersionTag(4, "/api/labs"));
+    CHECK(makeVersionTag(3, "/api/labs") != makeVersionTag(3, "/api/labs?sort=name"));
+}
+
+TEST_CASE("Matching tag lists from request headers.") 
+{
+    string entityTag = "\"0123456789abcdef\"";
+    CHECK(entityTagListMatches(entityTag, entityTag, false));
+    CHECK(entityTagListMatches("\"other\" ,  " + entityTag + " ", entityTag, false));
+    CHECK(entityTagListMatches("*", entityTag, false));
+    CHECK(entityTagListMatches("W/" + entityTag, entityTag, true));
+    CHECK_FALSE(entityTagListMatches("W/" + entityTag, entityTag, false));
+    CHECK_FALSE(entityTagListMatches("\"other\"", entityTag, true));
+    CHECK_FALSE(entityTagListMatches("", entityTag, true));
+}
+
+TEST_CASE("Answering conditional requests.") 
+{
+    string body = R"({"labId":"lab_001"})";
+    string entityTag = makeEntityTag(body);
+    request req;
+
+    SUBCASE("200: a request without validators gets the tagged body")
+    {
+        response res = withEntityTag(req, response(body));
+        CHECK(res.code == 200);
+        CHECK(res.body == body);
+        CHECK(res.get_header_value("ETag") == entityTag);
+        CHECK(ifMatchHolds(req, [] { return string("never read"); }));
+    }
+
+    SUBCASE("304: the client has the current body")
+    {
+        req.headers.insert({"If-None-Match", entityTag});
+        response res = withEntityTag(req, response(body));
+        CHECK(res.code == 304);
+        CHECK(res.body.empty());
+        CHECK(res.get_header_value("ETag") == entityTag);
+    }
+
+    SUBCASE("Errors are not tagged")
+    {
+        req.headers.insert({"If-None-Match", "*"});
+        response res = withEntityTag(req, response(404, "Lab Not Found"));
+        CHECK(res.code == 404);
+        CHECK(res.get_header_value("ETag").empty());
+    }
+
+    SUBCASE("If-Match holds only for the current body")
+    {
+        req.headers.insert({"If-Match", entityTag});
+        CHECK(ifMatchHolds(req, [&body] { return body; }));
+        CHECK_FALSE(ifMatchHolds(req, [] { return string(R"({"labId":"lab_002"})"); }));
+    }
+}
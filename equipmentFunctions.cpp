@@ -7,132 +7,194 @@
 
 #include "Equipment.h"
 #include <stdexcept>
-#include <regex>
 #include "toLowerHelper.h"
+#include "WriteAheadLog.h"
+#include "ChangeTracker.h"
+#include "Repository.h"
+#include "EntityTag.h"
+#include "JsonWriter.h"
+#include "Pagination.h"
+#include "SearchPattern.h"
+#include "TrigramIndex.h"
+#include "FullTextIndex.h"
+#include "SortedIndex.h"
+#include "BitmapIndex.h"
 
 using namespace std;
 using namespace crow;
 
-extern map<string, Equipment> equipmentsMap;
+extern Repository<Equipment> equipmentsRepository;
+extern WriteAheadLog writeAheadLog;
+extern ChangeTracker changeTracker;
 
 /**
  * @brief Searches experiments by name or description.
  *
  * @param searchString A string to search for in titles and descriptions of experiments.
+ * @param page The page of the matching equipments to send, in id order.
  * @return JSON response containing matching experiments.
  */
-response searchEquipments(string searchString)
+response searchEquipments(string searchString, const PageRequest& page)
 {
-    vector<Equipment> found;
-    for(pair<string, Equipment> keyValuePair : equipmentsMap)
-    {
-        string target1 = keyValuePair.second.getName();
-        string target2 = keyValuePair.second.getDescription();
-        regex pattern(searchString, regex_constants::icase);
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
 
-        if (regex_search(target1, pattern) || regex_search(target2, pattern))
-            found.push_back(keyValuePair.second);
-    }
+    shared_ptr<const SearchPattern> pattern = compileSearchPattern(searchString);
+    if (!pattern)
+        return response(400, "Invalid search");
+
+    // Literal patterns only check the equipments whose indexed names and descriptions may hold them.
+    PageCollector<Equipment> found(page);
+    scanMatches<Equipment>(equipmentsRepository, {"name", "description"}, *pattern,
+        [&pattern](const Equipment& equipment) { return pattern->matches(equipment.getName()) || pattern->matches(equipment.getDescription()); },
+        [&found](const string& id, const Equipment& equipment) { found.add(id, equipment); });
 
-    if (found.size() == 0)
+    if (found.empty() && !page.hasCursor())
         return response(404, "Not Found");
 
-    // Create a new JSON write value to write to the file
-    json::wvalue jsonWriteValue;
+    return found.respond();
+}
 
-    int index = 0;
-    for (Equipment equipment : found)
-    {
-        jsonWriteValue[index] = equipment.convertToJson();
-        index++;
-    }
+// The text equipments are ranked by: the name and the description.
+string equipmentText(const Equipment& equipment)
+{
+    return equipment.getName() + "\n" + equipment.getDescription();
+}
 
-    return response(jsonWriteValue.dump());
+/**
+ * @brief Ranks equipments by how well their names and descriptions answer a query.
+ *
+ * @param query The words to look for.
+ * @param page The page of the best equipments to send, best first.
+ * @return JSON response containing the best equipments.
+ */
+response rankEquipments(string query, const PageRequest& page)
+{
+    return rankedPageResponse<Equipment>(equipmentsRepository, "text", equipmentText, query, page);
 }
 
-// Comparator to sort pairs according to id.
-struct
+/**
+ * @brief Indexes the names and descriptions of equipments: their trigrams for
+ * searchEquipments and their words for rankEquipments.
+ */
+void addEquipmentSearchIndexes()
 {
-    bool operator()(pair<string, Equipment>& a, pair<string, Equipment>& b) 
-    { 
-        return a.second.getId() < b.second.getId(); 
-    } 
-} comparatorId;
+    equipmentsRepository.addIndex("name", make_shared<TextIndex<Equipment>>([](const Equipment& equipment) { return equipment.getName(); }));
+    equipmentsRepository.addIndex("description", make_shared<TextIndex<Equipment>>([](const Equipment& equipment) { return equipment.getDescription(); }));
+    equipmentsRepository.addIndex("text", make_shared<RankedTextIndex<Equipment>>(equipmentText));
+}
 
-// Comparator to sort pairs according to name.
+// Sort key of an equipment's name.
 struct
 {
-    bool operator()(pair<string, Equipment>& a, pair<string, Equipment>& b) 
+    SortKey operator()(const Equipment& equipment) const
     { 
-        return a.second.getName() < b.second.getName(); 
+        return SortKey{0, equipment.getName()}; 
     } 
-} comparatorName;
+} sortKeyName;
 
 /**
- * @brief Handles the GET request that includes the sort parameter for sorting users
+ * @brief Finds the key equipments are sorted by in the order a sort parameter names.
+ *
+ * @param order The sort parameter, replaced by the name of the order in lower case.
+ * @param sortKey Receives the key, or null for the id order.
+ * @return True if the order is known, false otherwise.
+ */
+bool findEquipmentSortKey(string& order, function<SortKey(const Equipment&)>& sortKey)
+{
+    order = toLower(order);
+    sortKey = nullptr;
+
+    if (order == "id")
+        sortKey = nullptr;
+    else if (order == "name")
+        sortKey = sortKeyName;
+    else   
+        return false;
+    return true;
+}
+
+/**
+ * @brief Sorts equipments by a key string
+ * 
+ * Equipments with the same key are sorted by id. Each order is walked from its sorted
+ * index, or sorted once per version of the equipments without one, so each page only
+ * costs finding where it starts.
  * 
  * @param sortString a string indicating the sorting criterion
- * @return a response object containing a JSON array of sorted T objects. 
- *         If an unsupported sortString is provided, returns the T in their original order.
+ * @param page The page of the sorted equipments to send.
+ * @return a response object containing the page of sorted equipments as a JSON array,
+ *         or 400 if the sortString isn't supported or the cursor is from another order.
 */
-response sortEquipments(string sortString) 
+response sortEquipments(string sortString, const PageRequest& page) 
 {
-    vector<pair<string, Equipment>> equipmentsToSort;
+    string order = sortString;
+    function<SortKey(const Equipment&)> sortKey;
+    if (!findEquipmentSortKey(order, sortKey))
+        return response(400, "Invalid sort request");
 
-    for (pair<string, Equipment> keyValuePair : equipmentsMap) 
-        equipmentsToSort.push_back(keyValuePair);
+    if (!page.fits(order))
+        return response(400, "Invalid cursor");
 
-    if (toLower(sortString) == "id")
-        sort(equipmentsToSort.begin(), equipmentsToSort.end(), comparatorId);
-    else if (toLower(sortString) == "name")
-        sort(equipmentsToSort.begin(), equipmentsToSort.end(), comparatorName); 
-    else   
-        return response(400, "Invalid sort request");
+    return sortedResponse(equipmentsRepository, order, sortKey, page);
+}
 
-    // Create a new JSON write value use to write to the file.
-    json::wvalue jsonWriteValue;
-    
-    // For each Equipment in the vector, convert the T to JSON and add to the write value.
-    int index = 0;
-    for (pair<string, Equipment> keyValuePair : equipmentsToSort)
+/**
+ * @brief Keeps the equipments sorted in every order sortEquipments offers.
+ */
+void addEquipmentSortIndexes()
+{
+    for (string order : {"id", "name"})
     {
-        jsonWriteValue[index] = keyValuePair.second.convertToJson();
-        index++;
+        function<SortKey(const Equipment&)> sortKey;
+        findEquipmentSortKey(order, sortKey);
+        equipmentsRepository.addIndex(sortedIndexName(order), make_shared<SortedIndex<Equipment>>(sortKey));
     }
+}
 
-    return response(jsonWriteValue.dump());
+// The attribute equipments are filtered by availability with: "true" or "false".
+string equipmentAvailability(const Equipment& equipment)
+{
+    return equipment.isAvailable() ? "true" : "false";
 }
 
 /**
  * @brief Filters equipments that are available / unavailable
  * 
+ * The equipments and their count come from the bitmap of the availability when there is one.
+ * 
  * @param bool A string representing the availability information to filter by.
- * @return A list of all equipment that matches to the given availability status 
+ * @param page The page of the matching equipments to send, in id order.
+ * @return A list of all equipment that matches to the given availability status, with the
+ * number of them in the X-Total-Count header
  */
-response filterEquipments(bool available)
+response filterEquipments(bool available, const PageRequest& page)
 {
-    vector<Equipment> found;
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
+
+    PageCollector<Equipment> found(page);
 
-    for (pair<string, Equipment> keyValuePair : equipmentsMap)
+    BitmapQuery query{{available ? "true" : "false"}, {}};
+    size_t total = scanAttribute<Equipment>(equipmentsRepository, "available", equipmentAvailability, query, page, [&found](const string& id, const Equipment& equipment)
     {
-        if (keyValuePair.second.isAvailable() == available)
-            found.push_back(keyValuePair.second);
-    }
+        found.add(id, equipment);
+    });
 
-    if (found.size() == 0)
+    if (found.empty() && !page.hasCursor())
         return response(404, "Not Found");
 
-    // Create a new JSON write value
-    json::wvalue jsonWriteValue;
-
-    int index = 0;
-    for (Equipment equipment : found)
-    {
-        jsonWriteValue[index] = equipment.convertToJson();
-        index++;
-    }
+    response res = found.respond();
+    res.set_header("X-Total-Count", to_string(total));
+    return res;
+}
 
-    return response(jsonWriteValue.dump());
+/**
+ * @brief Keeps the ids of available and unavailable equipments as bitmaps for filterEquipments.
+ */
+void addEquipmentFilterIndexes()
+{
+    equipmentsRepository.addIndex(attributeIndexName("available"), make_shared<AttributeIndex<Equipment>>(equipmentAvailability));
 }
 
 /**
@@ -166,55 +228,104 @@ response createEquipment(request req)
     // Create a new Equipment.
     Equipment equipment{readValueJson};
 
-    // Add the new Equipment to the map.
-    equipmentsMap[equipment.getId()] = equipment;
+    // Hold off snapshots while the repository and the log are being changed.
+    shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+    // Refuse the change if the write-ahead log can no longer record it.
+    // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+    if (writeAheadLog.hasFailed())
+        return response(503, "Write-ahead log unavailable");
+
+    // Keep other requests from changing an Equipment with the same id until this one is logged and stored.
+    unique_lock<mutex> equipmentLock = equipmentsRepository.lockObject(equipment.getId());
+
+    // Record the new Equipment in the write-ahead log, then change the repository.
+    string equipmentJson = toJsonString(equipment);
+    try
+    {
+        writeAheadLog.append({"equipments", LogOperation::Put, equipment.getId(), equipmentJson});
+    }
+    catch (runtime_error& exception)
+    {
+        // The log couldn't record the change, so it isn't made, and later changes are refused.
+        return response(503, "Write-ahead log unavailable");
+    }
+
+    // Add the new Equipment to the repository.
+    equipmentsRepository.put(equipment.getId(), equipment);
+    changeTracker.markChanged("equipments", equipment.getId());
 
     // Return the create Equipment as a JSON string.
     // 201 Created: The request succeeded, and a new Equipment was created as a result.
     // This is typically the response sent after POST requests, or some PUT requests.
-    return response(201, equipment.convertToJson().dump());
+    return response(201, equipmentJson);
 }
 
 /**
  * @brief Read a specific Equipment.
  * 
  * This method retrieves a Equipment identified by a unique ID.
+ * With fields, only the requested fields are sent.
  * 
+ * @param req The HTTP request object.
  * @param id The unique identifier of the Equipment.
  * @return res The HTTP response object.
  */
-response readEquipment(string id) 
+response readEquipment(request req, string id) 
 {
-    try 
+    // With fields, serialize only the requested fields instead of sending the kept JSON.
+    FieldMask fields;
+    if (!fields.parse(req.url_params.get("fields")))
+        return response(400, "Invalid fields");
+    if (!fields.isEmpty())
     {
-        // Get the Equipment from the Equipment map.
-        Equipment equipment = equipmentsMap.at(id);
+        Equipment equipment;
+        if (!equipmentsRepository.get(id, equipment))
+            return response(404, "Equipment Not Found");
+        return response(toJsonString(equipment, &fields));
+    }
 
-        // Return the Equipment as a JSON string.
-        return response(equipment.convertToJson().dump());
-    } 
-    catch (out_of_range& exception) 
+    // Get the Equipment as JSON from the repository, which keeps it serialized between changes.
+    string equipmentJson;
+    if (!equipmentsRepository.getJson(id, equipmentJson))
     {
-        // If the Equipment was not found in the map return a 404 not found error.
+        // If the Equipment was not found in the repository return a 404 not found error.
         // 404 Not Found: The server cannot find the requested Equipment.
         return response(404, "Equipment Not Found");
     }
+
+    // Return the Equipment as a JSON string.
+    return response(equipmentJson);
 }
 
 /**
  * @brief Read all Equipments.
  * 
  * This method retrieves a Equipment identified by a unique ID.
+ * With limit, only that many equipments are sent, and cursor picks up where the previous
+ * page ended.
  * 
  * @return res The HTTP response object.
  */
 response readAllEquipments(request req) 
 {
+    PageRequest page;
+    if (!page.parse(req.url_params))
+        return response(400, "Invalid limit or cursor");
+
+    FieldMask fields;
+    if (!fields.parse(req.url_params.get("fields")))
+        return response(400, "Invalid fields");
+    page.setFields(fields);
+
+    if (req.url_params.get("q"))
+        return rankEquipments(req.url_params.get("q"), page);
+
     if (req.url_params.get("search"))
-        return searchEquipments(req.url_params.get("search"));
+        return searchEquipments(req.url_params.get("search"), page);
 
     if (req.url_params.get("sort"))
-        return sortEquipments(req.url_params.get("sort"));
+        return sortEquipments(req.url_params.get("sort"), page);
 
     if (req.url_params.get("isavailable"))
     {
@@ -222,23 +333,22 @@ response readAllEquipments(request req)
         if (string(req.url_params.get("isavailable")) == "TRUE" || string(req.url_params.get("isavailable")) == "true")
             available = true;
         
-        return filterEquipments(available);
+        return filterEquipments(available, page);
     }
 
-    // Create a new JSON write value use to write to the file.
-    json::wvalue jsonWriteValue;
-    
-    // For each Equipment in the map, convert the Equipment to JSON and add to the write value.
-    int index = 0;
-    for (pair<string, Equipment> keyValuePair : equipmentsMap)
+    // A page of every Equipment, in id order, or every Equipment with only the requested fields.
+    if (page.isPaged() || !page.getFields().isEmpty())
     {
-        // first: gives you access to the first item in the pair.
-        // second: gives you access to the second item in the pair.
-        jsonWriteValue[index] = keyValuePair.second.convertToJson();
-        index++;
+        if (!page.fits("id"))
+            return response(400, "Invalid cursor");
+        return sortedResponse<Equipment>(equipmentsRepository, "id", nullptr, page);
     }
 
-    return response(jsonWriteValue.dump());
+    // Get every Equipment as one JSON list, which the repository keeps until the next change.
+    string equipmentsJson;
+    equipmentsRepository.getAllJson(equipmentsJson);
+
+    return response(equipmentsJson);
 }
 
 /**
@@ -265,8 +375,30 @@ void updateEquipment(request req, response& res, string id)
 
     try 
     {
-        // Get the Equipment from the Equipment map.
-        Equipment equipment = equipmentsMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+        {
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+
+        // Get the Equipment from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> equipmentLock = equipmentsRepository.lockObject(id);
+        Equipment equipment = equipmentsRepository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older Equipment.
+        // 412 Precondition Failed: the Equipment changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; equipmentsRepository.getJson(id, current); return current; }))
+        {
+            res.code = 412;
+            res.end("Precondition Failed");
+            return;
+        }
 
         // Convert the request body to JSON.
         json::rvalue readValueJson = json::load(req.body);
@@ -281,18 +413,34 @@ void updateEquipment(request req, response& res, string id)
 
         // Update the Equipment.
         equipment.updateFromJson(readValueJson);
-        equipmentsMap[id] = equipment;
+
+        // Record the updated Equipment in the write-ahead log, then change the repository.
+        string equipmentJson = toJsonString(equipment);
+        try
+        {
+            writeAheadLog.append({"equipments", LogOperation::Put, id, equipmentJson});
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+        equipmentsRepository.put(id, equipment);
+        changeTracker.markChanged("equipments", id);
 
         // Return the updated Equipment as a JSON string.
         // 200 OK: The request succeeded.
         res.code = 200;
         res.set_header("Content-Type", "application/json");
-        res.write(equipment.convertToJson().dump());
+        res.set_header("ETag", makeEntityTag(equipmentJson));
+        res.write(equipmentJson);
         res.end();
     } 
     catch (out_of_range& exception) 
     {
-        // If the Equipment was not found in the map return a 404 not found error.
+        // If the Equipment was not found in the repository return a 404 not found error.
         res.code = 404;
         res.end("Equipment Not Found");
     }
@@ -317,18 +465,44 @@ response deleteEquipment(request req, string id)
         
     try 
     {
-        // Get the Equipment from the Equipment map.
-        Equipment equipment = equipmentsMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+            return response(503, "Write-ahead log unavailable");
+
+        // Get the Equipment from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> equipmentLock = equipmentsRepository.lockObject(id);
+        Equipment equipment = equipmentsRepository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older Equipment.
+        // 412 Precondition Failed: the Equipment changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; equipmentsRepository.getJson(id, current); return current; }))
+            return response(412, "Precondition Failed");
+
+        // Record the deletion in the write-ahead log, then change the repository.
+        try
+        {
+            writeAheadLog.append({"equipments", LogOperation::Delete, id, ""});
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            return response(503, "Write-ahead log unavailable");
+        }
 
-        // Remove the Equipment from the Equipment map.
-        equipmentsMap.erase(id);
+        // Remove the Equipment from the repository.
+        equipmentsRepository.erase(id);
+        changeTracker.markDeleted("equipments", id);
 
         // Return a successful code 204 which means success but no content to return.
         return response(204);
     } 
     catch (out_of_range& exception) 
     {
-        // If the Equipment was not found in the map return a 404 not found error.
+        // If the Equipment was not found in the repository return a 404 not found error.
         return response(404, "Equipment Not Found");
     }
 }
@@ -4,15 +4,20 @@
 #include <crow.h>
 #include <map>
 #include <string>
+#include "Pagination.h"
 
 // Functions used to handle POST, GET, PUT, and DELETE requests for the Equipment resource.
 crow::response createEquipment(crow::request req);
-crow::response readEquipment(std::string id);
+crow::response readEquipment(crow::request req, std::string id);
 crow::response readAllEquipments(crow::request req);
 void updateEquipment(crow::request req, crow::response& res, std::string id); 
 crow::response deleteEquipment(crow::request req, std::string id);
-crow::response searchEquipments(std::string searchString);
-crow::response filterEquipments(bool available);
-crow::response sortEquipments(std::string sortString);
+crow::response searchEquipments(std::string searchString, const PageRequest& page = PageRequest());
+crow::response rankEquipments(std::string query, const PageRequest& page = PageRequest());
+void addEquipmentSearchIndexes();
+crow::response filterEquipments(bool available, const PageRequest& page = PageRequest());
+void addEquipmentFilterIndexes();
+crow::response sortEquipments(std::string sortString, const PageRequest& page = PageRequest());
+void addEquipmentSortIndexes();
 
 #endif // EQUIPMENT_FUNCTIONS_H 
\ No newline at end of file
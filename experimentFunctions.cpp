@@ -8,271 +8,310 @@
 
 #include "Experiment.h"
 #include <stdexcept>
-#include <regex>
 #include "toLowerHelper.h"
+#include "WriteAheadLog.h"
+#include "ChangeTracker.h"
+#include "Repository.h"
+#include "EntityTag.h"
+#include "JsonWriter.h"
+#include "Pagination.h"
+#include "SearchPattern.h"
+#include "TrigramIndex.h"
+#include "FullTextIndex.h"
+#include "SortedIndex.h"
+#include "BitmapIndex.h"
 
 using namespace std;
 using namespace crow;
 
-extern map<string, Experiment> experimentsMap;
+extern Repository<Experiment> experimentsRepository;
+extern WriteAheadLog writeAheadLog;
+extern ChangeTracker changeTracker;
 
 /**
  * @brief Searches experiments by title or description.
  *
  * @param searchString A string to search for in titles and descriptions of experiments.
+ * @param page The page of the matching experiments to send, in id order.
  * @return JSON response containing matching experiments.
  */
-response searchExperiments(string searchString)
+response searchExperiments(string searchString, const PageRequest& page)
 {
-    vector<Experiment> found;
-    for(pair<string, Experiment> keyValuePair : experimentsMap)
-    {
-        string target1 = keyValuePair.second.getTitle();
-        string target2 = keyValuePair.second.getDescription();
-        regex pattern(searchString, regex_constants::icase);
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
 
-        if (regex_search(target1, pattern) || regex_search(target2, pattern))
-            found.push_back(keyValuePair.second);
-    }
+    // The pattern is compiled once for the whole scan, or taken from the cache.
+    shared_ptr<const SearchPattern> pattern = compileSearchPattern(searchString);
+    if (!pattern)
+        return response(400, "Invalid search");
 
-    if (found.size() == 0)
+    // Literal patterns only check the experiments whose indexed titles and descriptions may hold them.
+    PageCollector<Experiment> found(page);
+    scanMatches<Experiment>(experimentsRepository, {"title", "description"}, *pattern,
+        [&pattern](const Experiment& experiment) { return pattern->matches(experiment.getTitle()) || pattern->matches(experiment.getDescription()); },
+        [&found](const string& id, const Experiment& experiment) { found.add(id, experiment); });
+
+    if (found.empty() && !page.hasCursor())
         return response(404, "Not Found");
 
-    // Create a new JSON write value to write to the file
-    json::wvalue jsonWriteValue;
+    return found.respond();
+}
 
-    int index = 0;
-    for (Experiment experiment : found)
-    {
-        jsonWriteValue[index] = experiment.convertToJson();
-        index++;
-    }
+// The text experiments are ranked by: the title and the description.
+string experimentText(const Experiment& experiment)
+{
+    return experiment.getTitle() + "\n" + experiment.getDescription();
+}
 
-    return response(jsonWriteValue.dump());
+/**
+ * @brief Ranks experiments by how well their titles and descriptions answer a query.
+ *
+ * @param query The words to look for.
+ * @param page The page of the best experiments to send, best first.
+ * @return JSON response containing the best experiments.
+ */
+response rankExperiments(string query, const PageRequest& page)
+{
+    return rankedPageResponse<Experiment>(experimentsRepository, "text", experimentText, query, page);
+}
+
+/**
+ * @brief Indexes the titles and descriptions of experiments: their trigrams, which
+ * searchExperiments matches, and their words, which rankExperiments ranks.
+ */
+void addExperimentSearchIndexes()
+{
+    experimentsRepository.addIndex("title", make_shared<TextIndex<Experiment>>([](const Experiment& experiment) { return experiment.getTitle(); }));
+    experimentsRepository.addIndex("description", make_shared<TextIndex<Experiment>>([](const Experiment& experiment) { return experiment.getDescription(); }));
+    experimentsRepository.addIndex("text", make_shared<RankedTextIndex<Experiment>>(experimentText));
 }
 
 
-// Comparator to sort pairs according to id.
+// Sort key of an experiment's cost.
 struct
 {
-    bool operator()(pair<string, Experiment>& a, pair<string, Experiment>& b) 
+    SortKey operator()(const Experiment& experiment) const
     { 
-        return a.second.getId() < b.second.getId(); 
+        return SortKey{experiment.getCost(), ""}; 
     } 
-} comparatorId;
+} sortKeyCost;
 
-// Comparator to sort pairs according to cost.
+// Sort key of an experiment's start time.
 struct
 {
-    bool operator()(pair<string, Experiment>& a, pair<string, Experiment>& b) 
+    SortKey operator()(const Experiment& experiment) const
     { 
-        return a.second.getCost() < b.second.getCost(); 
+        return SortKey{0, experiment.getStartTime()}; 
     } 
-} comparatorCost;
+} sortKeyStartTime;
 
-// Comparator to sort pairs according to start time.
+// Sort key of an experiment's end time.
 struct
 {
-    bool operator()(pair<string, Experiment>& a, pair<string, Experiment>& b) 
+    SortKey operator()(const Experiment& experiment) const
     { 
-        return a.second.getStartTime() < b.second.getStartTime(); 
+        return SortKey{0, experiment.getEndTime()}; 
     } 
-} comparatorStartTime;
+} sortKeyEndTime;
 
-// Comparator to sort pairs according to end time.
+// Sort key of an experiment's number of users.
 struct
 {
-    bool operator()(pair<string, Experiment>& a, pair<string, Experiment>& b) 
+    SortKey operator()(const Experiment& experiment) const
     { 
-        return a.second.getEndTime() < b.second.getEndTime(); 
+        return SortKey{static_cast<double>(experiment.getUserIds().size()), ""}; 
     } 
-} comparatorEndTime;
+} sortKeyNumUsers;
 
-// Comparator to sort pairs according to number of users.
+// Sort key of an experiment's number of equipments.
 struct
 {
-    bool operator()(pair<string, Experiment>& a, pair<string, Experiment>& b) 
+    SortKey operator()(const Experiment& experiment) const
     { 
-        return a.second.getUserIds().size() < b.second.getUserIds().size(); 
+        return SortKey{static_cast<double>(experiment.getEquipmentIds().size()), ""}; 
     } 
-} comparatorNumUsers;
+} sortKeyNumEquipments;
 
-// Comparator to sort pairs according to number of equipments.
+// Sort key of an experiment's number of citations.
 struct
 {
-    bool operator()(pair<string, Experiment>& a, pair<string, Experiment>& b) 
+    SortKey operator()(const Experiment& experiment) const
     { 
-        return a.second.getEquipmentIds().size() < b.second.getEquipmentIds().size(); 
+        return SortKey{static_cast<double>(experiment.getResearchOutput().getNumCitations()), ""}; 
     } 
-} comparatorNumEquipments;
+} sortKeyNumCitations;
 
-// Comparator to sort pairs according to number of citations.
+// Sort key of an experiment's number of publications.
 struct
 {
-    bool operator()(pair<string, Experiment>& a, pair<string, Experiment>& b) 
+    SortKey operator()(const Experiment& experiment) const
     { 
-        return a.second.getResearchOutput().getNumCitations() < b.second.getResearchOutput().getNumCitations(); 
+        return SortKey{static_cast<double>(experiment.getResearchOutput().getPublishedIn().size()), ""}; 
     } 
-} comparatorNumCitations;
+} sortKeyNumPublications;
 
-// Comparator to sort pairs according to number of publications.
-struct
+/**
+ * @brief Finds the order a sort parameter names and the key experiments are sorted by in it.
+ *
+ * @param order The sort parameter, replaced by the name of the order, e.g. "users" by "numusers".
+ * @param sortKey Receives the key, or null for the id order.
+ * @return True if the order is known, false otherwise.
+ */
+bool findExperimentSortKey(string& order, function<SortKey(const Experiment&)>& sortKey)
 {
-    bool operator()(pair<string, Experiment>& a, pair<string, Experiment>& b) 
-    { 
-        return a.second.getResearchOutput().getPublishedIn().size() < b.second.getResearchOutput().getPublishedIn().size(); 
-    } 
-} comparatorNumPublications;
+    string sortString = order;
+    order = toLower(sortString);
+    sortKey = nullptr;
+
+    if (sortString == "id")
+        order = "id";
+    else if (order == "cost")
+        sortKey = sortKeyCost;
+    else if (order == "starttime")
+        sortKey = sortKeyStartTime;
+    else if (order == "endtime")
+        sortKey = sortKeyEndTime;
+    else if (order == "numusers" || order == "users")
+    {
+        order = "numusers";
+        sortKey = sortKeyNumUsers;
+    }
+    else if (order == "numequipments" || order == "equipments")
+    {
+        order = "numequipments";
+        sortKey = sortKeyNumEquipments;
+    }
+    else if (order == "numcitations" || order == "citations")
+    {
+        order = "numcitations";
+        sortKey = sortKeyNumCitations;
+    }
+    else if (order == "numpublications" || order == "publications")
+    {
+        order = "numpublications";
+        sortKey = sortKeyNumPublications;
+    }
+    else
+        return false;
+    return true;
+}
 
 /**
- * @brief Handles the GET request that includes the sort parameter for sorting users
+ * @brief Sorts experiments by a key string
+ * 
+ * Experiments with the same key are sorted by id. Each order is walked from its sorted
+ * index, or sorted once per version of the experiments without one, so each page only
+ * costs finding where it starts.
  * 
  * @param sortString a string indicating the sorting criterion
- * @return a response object containing a JSON array of sorted T objects. 
- *         If an unsupported sortString is provided, returns the T in their original order.
+ * @param page The page of the sorted experiments to send.
+ * @return a response object containing the page of sorted experiments as a JSON array,
+ *         or 400 if the sortString isn't supported or the cursor is from another order.
 */
-response sortExperiments(string sortString) 
+response sortExperiments(string sortString, const PageRequest& page) 
 {
-    vector<pair<string, Experiment>> experimentsToSort;
+    string order = sortString;
+    function<SortKey(const Experiment&)> sortKey;
+    if (!findExperimentSortKey(order, sortKey))
+        return response(400, "Invalid sort request");
 
-    for (pair<string, Experiment> keyValuePair : experimentsMap) 
-        experimentsToSort.push_back(keyValuePair);
+    if (!page.fits(order))
+        return response(400, "Invalid cursor");
 
-    if (sortString == "id")
-        sort(experimentsToSort.begin(), experimentsToSort.end(), comparatorId); 
-    else if (toLower(sortString) == "cost")
-        sort(experimentsToSort.begin(), experimentsToSort.end(), comparatorCost); 
-    else if (toLower(sortString) == "starttime")
-        sort(experimentsToSort.begin(), experimentsToSort.end(), comparatorStartTime); 
-    else if (toLower(sortString) == "endtime")
-        sort(experimentsToSort.begin(), experimentsToSort.end(), comparatorEndTime); 
-    else if (toLower(sortString) == "numusers" || toLower(sortString) == "users")
-        sort(experimentsToSort.begin(), experimentsToSort.end(), comparatorNumUsers); 
-    else if (toLower(sortString) == "numequipments" || toLower(sortString) == "equipments")
-        sort(experimentsToSort.begin(), experimentsToSort.end(), comparatorNumEquipments); 
-    else if (toLower(sortString) == "numcitations" || toLower(sortString) == "citations")
-        sort(experimentsToSort.begin(), experimentsToSort.end(), comparatorNumCitations); 
-    else if (toLower(sortString) == "numpublications" || toLower(sortString) == "publications")
-        sort(experimentsToSort.begin(), experimentsToSort.end(), comparatorNumPublications); 
-    else
-        return response(400, "Invalid sort request");
+    return sortedResponse(experimentsRepository, order, sortKey, page);
+}
 
-    // Create a new JSON write value use to write to the file.
-    json::wvalue jsonWriteValue;
-    
-    // For each Experiment in the vector, convert the T to JSON and add to the write value.
-    int index = 0;
-    for (pair<string, Experiment> keyValuePair : experimentsToSort)
+/**
+ * @brief Keeps the experiments sorted in every order sortExperiments offers.
+ */
+void addExperimentSortIndexes()
+{
+    for (string order : {"id", "cost", "starttime", "endtime", "numusers", "numequipments", "numcitations", "numpublications"})
     {
-        jsonWriteValue[index] = keyValuePair.second.convertToJson();
-        index++;
+        function<SortKey(const Experiment&)> sortKey;
+        findExperimentSortKey(order, sortKey);
+        experimentsRepository.addIndex(sortedIndexName(order), make_shared<SortedIndex<Experiment>>(sortKey));
     }
-
-    return response(jsonWriteValue.dump());
 }
 
 /**
- * @brief Filters labs that has a given minimum amount of budget of a given type
+ * @brief Filters experiments whose citations, publications or cost are in a range
  * 
- * @param type A string representing the type of budget information to filter by.
- * There are two valid such types: citations, publications
- * @param number A float representing the minimum amount when filtering experiments
- * @return A list of all labs that has a given minimum amount of budget of a given type
+ * The experiments come from a walk of the range in the sorted index of the type when there
+ * is one.
+ * 
+ * @param type A string representing the number to filter by.
+ * There are three valid such types: citations, publications, cost
+ * @param min The lowest number of the experiments to find
+ * @param max The highest number of the experiments to find
+ * @param page The page of the matching experiments to send, in id order.
+ * @return A list of all experiments whose number of the given type is from min to max
  */
-response filterExperiments(string type, float number)
+response filterExperiments(string type, double min, double max, const PageRequest& page)
 {
-    if (toLower(type) != "citations" && toLower(type) != "publications")
+    string order = type;
+    function<SortKey(const Experiment&)> sortKey;
+    if (!findExperimentSortKey(order, sortKey) || (order != "numcitations" && order != "numpublications" && order != "cost"))
         return response(400, "Invalid filter type");
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
 
-    vector<Experiment> found;
+    PageCollector<Experiment> found(page);
 
-    for (pair<string, Experiment> keyValuePair : experimentsMap)
+    scanRange<Experiment>(experimentsRepository, order, sortKey, min, max, page, [&found](const string& id, const Experiment& experiment)
     {
-        ResearchOutput output = keyValuePair.second.getResearchOutput();
-        if (toLower(type) == "citations" && output.getNumCitations() >= number)
-            found.push_back(keyValuePair.second);
-        else if (toLower(type) == "publications" && output.getPublishedIn().size() >= number)
-            found.push_back(keyValuePair.second);
-    }
+        found.add(id, experiment);
+    });
 
-    if (found.size() == 0)
+    if (found.empty() && !page.hasCursor())
         return response(404, "Not Found");
 
-    // Create a new JSON write value
-    json::wvalue jsonWriteValue;
-
-    int index = 0;
-    for (Experiment experiment : found)
-    {
-        jsonWriteValue[index] = experiment.convertToJson();
-        index++;
-    }
+    return found.respond();
+}
 
-    return response(jsonWriteValue.dump());
+// The attribute experiments are filtered by approval with: "true" or "false".
+string experimentApproval(const Experiment& experiment)
+{
+    return experiment.isApproved() ? "true" : "false";
 }
 
 /**
  * @brief Filters experiments that are approved / not approved
  * 
+ * The experiments and their count come from the bitmap of the approval status when there is one.
+ * 
  * @param bool A string representing the approval status information to filter by.
- * @return A list of all experiments that matches to the given approval status status 
+ * @param page The page of the matching experiments to send, in id order.
+ * @return A list of all experiments that matches to the given approval status status, with
+ * the number of them in the X-Total-Count header
  */
-response filterExperiments(bool approvalStatus)
+response filterExperiments(bool approvalStatus, const PageRequest& page)
 {
-    vector<Experiment> found;
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
+
+    PageCollector<Experiment> found(page);
 
-    for (pair<string, Experiment> keyValuePair : experimentsMap)
+    BitmapQuery query{{approvalStatus ? "true" : "false"}, {}};
+    size_t total = scanAttribute<Experiment>(experimentsRepository, "approvalstatus", experimentApproval, query, page, [&found](const string& id, const Experiment& experiment)
     {
-        if (keyValuePair.second.isApproved() == approvalStatus)
-            found.push_back(keyValuePair.second);
-    }
+        found.add(id, experiment);
+    });
 
-    if (found.size() == 0)
+    if (found.empty() && !page.hasCursor())
         return response(404, "Not Found");
 
-    // Create a new JSON write value
-    json::wvalue jsonWriteValue;
-
-    int index = 0;
-    for (Experiment experiment : found)
-    {
-        jsonWriteValue[index] = experiment.convertToJson();
-        index++;
-    }
-
-    return response(jsonWriteValue.dump());
+    response res = found.respond();
+    res.set_header("X-Total-Count", to_string(total));
+    return res;
 }
 
 /**
- * @brief Filters equipments that are expensive than at least some cost
- * 
- * @param cost A float representing the minimum cost to filter by.
- * @return A list of all experiments that are expensive than at least the given cost 
+ * @brief Keeps the ids of approved and unapproved experiments as bitmaps for filterExperiments.
  */
-response filterExperiments(float cost)
+void addExperimentFilterIndexes()
 {
-    vector<Experiment> found;
-
-    for (pair<string, Experiment> keyValuePair : experimentsMap)
-    {
-        if (keyValuePair.second.getCost() >= cost)
-            found.push_back(keyValuePair.second);
-    }
-
-    if (found.size() == 0)
-        return response(404, "Not Found");
-
-    // Create a new JSON write value
-    json::wvalue jsonWriteValue;
-
-    int index = 0;
-    for (Experiment experiment : found)
-    {
-        jsonWriteValue[index] = experiment.convertToJson();
-        index++;
-    }
-
-    return response(jsonWriteValue.dump());
+    experimentsRepository.addIndex(attributeIndexName("approvalstatus"), make_shared<AttributeIndex<Experiment>>(experimentApproval));
 }
 
 /**
@@ -306,80 +345,131 @@ response createExperiment(request req)
     // Create a new Experiment.
     Experiment experiment{readValueJson};
 
-    // Add the new Experiment to the map.
-    experimentsMap[experiment.getId()] = experiment;
+    // Hold off snapshots while the repository and the log are being changed.
+    shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+    // Refuse the change if the write-ahead log can no longer record it.
+    // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+    if (writeAheadLog.hasFailed())
+        return response(503, "Write-ahead log unavailable");
+
+    // Keep other requests from changing an Experiment with the same id until this one is logged and stored.
+    unique_lock<mutex> experimentLock = experimentsRepository.lockObject(experiment.getId());
+
+    // Record the new Experiment in the write-ahead log, then change the repository.
+    string experimentJson = toJsonString(experiment);
+    try
+    {
+        writeAheadLog.append({"experiments", LogOperation::Put, experiment.getId(), experimentJson});
+    }
+    catch (runtime_error& exception)
+    {
+        // The log couldn't record the change, so it isn't made, and later changes are refused.
+        return response(503, "Write-ahead log unavailable");
+    }
+
+    // Add the new Experiment to the repository.
+    experimentsRepository.put(experiment.getId(), experiment);
+    changeTracker.markChanged("experiments", experiment.getId());
 
     // Return the create Experiment as a JSON string.
     // 201 Created: The request succeeded, and a new Experiment was created as a result.
     // This is typically the response sent after POST requests, or some PUT requests.
-    return response(201, experiment.convertToJson().dump());
+    return response(201, experimentJson);
 }
 
 /**
  * @brief Read a specific Experiment.
  * 
  * This method retrieves a Experiment identified by a unique ID.
+ * With fields, only the requested fields are sent.
  * 
+ * @param req The HTTP request object.
  * @param id The unique identifier of the Experiment.
  * @return res The HTTP response object.
  */
 response readExperiment(request req, string id) 
 {
-    try 
+    // With fields, serialize only the requested fields instead of sending the kept JSON.
+    FieldMask fields;
+    if (!fields.parse(req.url_params.get("fields")))
+        return response(400, "Invalid fields");
+    if (!fields.isEmpty())
     {
-        // Get the Experiment from the Experiment map.
-        Experiment experiment = experimentsMap.at(id);
-    
-        // Return the Experiment as a JSON string.
-        return response(experiment.convertToJson().dump());
-    } 
-    catch (out_of_range& exception) 
+        Experiment experiment;
+        if (!experimentsRepository.get(id, experiment))
+            return response(404, "Experiment Not Found");
+        return response(toJsonString(experiment, &fields));
+    }
+
+    // Get the Experiment as JSON from the repository, which keeps it serialized between changes.
+    string experimentJson;
+    if (!experimentsRepository.getJson(id, experimentJson))
     {
-        // If the Experiment was not found in the map return a 404 not found error.
+        // If the Experiment was not found in the repository return a 404 not found error.
         // 404 Not Found: The server cannot find the requested Experiment.
         return response(404, "Experiment Not Found");
     }
+
+    // Return the Experiment as a JSON string.
+    return response(experimentJson);
 }
 
 /**
  * @brief Read all Experiments.
  * 
  * This method retrieves a Experiment identified by a unique ID.
+ * With limit, only that many experiments are sent, and cursor picks up where the previous
+ * page ended.
  * 
  * @return res The HTTP response object.
  */
 response readAllExperiments(request req) 
 {
+    PageRequest page;
+    if (!page.parse(req.url_params))
+        return response(400, "Invalid limit or cursor");
+
+    FieldMask fields;
+    if (!fields.parse(req.url_params.get("fields")))
+        return response(400, "Invalid fields");
+    page.setFields(fields);
+
+    if (req.url_params.get("q"))
+        return rankExperiments(req.url_params.get("q"), page);
+
     if (req.url_params.get("search"))
-        return searchExperiments(req.url_params.get("search"));
+        return searchExperiments(req.url_params.get("search"), page);
 
     if (req.url_params.get("sort"))
-        return sortExperiments(req.url_params.get("sort"));
+        return sortExperiments(req.url_params.get("sort"), page);
 
-    if (req.url_params.get("number") && req.url_params.get("type"))
+    if (req.url_params.get("type") && (req.url_params.get("number") || req.url_params.get("min") || req.url_params.get("max")))
     {
+        double min, max;
         try 
         {
-            float number = stof(req.url_params.get("number"));
-            return filterExperiments(req.url_params.get("type"), number);
-        } catch (invalid_argument& exception)
+            readRange(req.url_params, "number", min, max);
+        } catch (logic_error& exception)
         {
-            cerr << "Can't convert the number to float type. Invalid argument!" << endl;
-            return response(400, "Invalid cost");
+            cerr << "Can't convert the number to float type. Invalid argument or out of range!" << endl;
+            return response(400, "Invalid number");
         }
+        return filterExperiments(req.url_params.get("type"), min, max, page);
     }
 
     if (req.url_params.get("cost"))
     {
+        double min, max;
         try 
         {
-            float cost = stof(req.url_params.get("cost"));
-            return filterExperiments(cost);
-        } catch (invalid_argument& exception)
+            readRange(req.url_params, "cost", min, max);
+        } catch (logic_error& exception)
         {
-            cerr << "Can't convert the cost to float type. Invalid argument!" << endl;
+            cerr << "Can't convert the cost to float type. Invalid argument or out of range!" << endl;
             return response(400, "Invalid request");
         }
+        return filterExperiments("cost", min, max, page);
     }
 
     if (req.url_params.get("isapproved"))
@@ -388,23 +478,22 @@ response readAllExperiments(request req)
         if (string(req.url_params.get("isapproved")) == "TRUE" || string(req.url_params.get("isapproved")) == "true")
             approved = true;
         
-        return filterExperiments(approved);
+        return filterExperiments(approved, page);
     }
 
-    // Create a new JSON write value use to write to the file.
-    json::wvalue jsonWriteValue;
-    
-    // For each Experiment in the map, convert the Experiment to JSON and add to the write value.
-    int index = 0;
-    for (pair<string, Experiment> keyValuePair : experimentsMap)
+    // A page of every Experiment, in id order, or every Experiment with only the requested fields.
+    if (page.isPaged() || !page.getFields().isEmpty())
     {
-        // first: gives you access to the first item in the pair.
-        // second: gives you access to the second item in the pair.
-        jsonWriteValue[index] = keyValuePair.second.convertToJson();
-        index++;
+        if (!page.fits("id"))
+            return response(400, "Invalid cursor");
+        return sortedResponse<Experiment>(experimentsRepository, "id", nullptr, page);
     }
 
-    return response(jsonWriteValue.dump());
+    // Get every Experiment as one JSON list, which the repository keeps until the next change.
+    string experimentsJson;
+    experimentsRepository.getAllJson(experimentsJson);
+
+    return response(experimentsJson);
 }
 
 /**
@@ -431,8 +520,30 @@ void updateExperiment(request req, response& res, string id)
 
     try 
     {
-        // Get the Experiment from the Experiment map.
-        Experiment experiment = experimentsMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+        {
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+
+        // Get the Experiment from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> experimentLock = experimentsRepository.lockObject(id);
+        Experiment experiment = experimentsRepository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older Experiment.
+        // 412 Precondition Failed: the Experiment changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; experimentsRepository.getJson(id, current); return current; }))
+        {
+            res.code = 412;
+            res.end("Precondition Failed");
+            return;
+        }
 
         // Convert the request body to JSON.
         json::rvalue readValueJson = json::load(req.body);
@@ -447,18 +558,34 @@ void updateExperiment(request req, response& res, string id)
 
         // Update the Experiment.
         experiment.updateFromJson(readValueJson);
-        experimentsMap[id] = experiment;
+
+        // Record the updated Experiment in the write-ahead log, then change the repository.
+        string experimentJson = toJsonString(experiment);
+        try
+        {
+            writeAheadLog.append({"experiments", LogOperation::Put, id, experimentJson});
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+        experimentsRepository.put(id, experiment);
+        changeTracker.markChanged("experiments", id);
 
         // Return the updated Experiment as a JSON string.
         // 200 OK: The request succeeded.
         res.code = 200;
         res.set_header("Content-Type", "application/json");
-        res.write(experiment.convertToJson().dump());
+        res.set_header("ETag", makeEntityTag(experimentJson));
+        res.write(experimentJson);
         res.end();
     } 
     catch (out_of_range& exception) 
     {
-        // If the Experiment was not found in the map return a 404 not found error.
+        // If the Experiment was not found in the repository return a 404 not found error.
         res.code = 404;
         res.end("Experiment Not Found");
     }
@@ -483,18 +610,44 @@ response deleteExperiment(request req, string id)
 
     try 
     {
-        // Get the Experiment from the Experiment map.
-        Experiment experiment = experimentsMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+            return response(503, "Write-ahead log unavailable");
+
+        // Get the Experiment from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> experimentLock = experimentsRepository.lockObject(id);
+        Experiment experiment = experimentsRepository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older Experiment.
+        // 412 Precondition Failed: the Experiment changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; experimentsRepository.getJson(id, current); return current; }))
+            return response(412, "Precondition Failed");
+
+        // Record the deletion in the write-ahead log, then change the repository.
+        try
+        {
+            writeAheadLog.append({"experiments", LogOperation::Delete, id, ""});
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            return response(503, "Write-ahead log unavailable");
+        }
 
-        // Remove the Experiment from the Experiment map.
-        experimentsMap.erase(id);
+        // Remove the Experiment from the repository.
+        experimentsRepository.erase(id);
+        changeTracker.markDeleted("experiments", id);
 
         // Return a successful code 204 which means success but no content to return.
         return response(204);
     } 
     catch (out_of_range& exception) 
     {
-        // If the Experiment was not found in the map return a 404 not found error.
+        // If the Experiment was not found in the repository return a 404 not found error.
         return response(404, "Experiment Not Found");
     }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <crow.h>
 #include <map>
 #include <string>
+#include "Pagination.h"
 
 // Functions used to handle POST, GET, PUT, and DELETE requests for the Experiment resource.
 crow::response createExperiment(crow::request req);
@@ -11,10 +12,13 @@ crow::response readExperiment(crow::request req, std::string id);
 crow::response readAllExperiments(crow::request req);
 void updateExperiment(crow::request req, crow::response& res, std::string id); 
 crow::response deleteExperiment(crow::request req, std::string id);
-crow::response searchExperiments(std::string searchString);
-crow::response filterExperiments(std::string type, float amount);
-crow::response filterExperiments(bool approvalStatus);
-crow::response filterExperiments(float cost);
-crow::response sortExperiments(std::string sortString);
+crow::response searchExperiments(std::string searchString, const PageRequest& page = PageRequest());
+crow::response rankExperiments(std::string query, const PageRequest& page = PageRequest());
+void addExperimentSearchIndexes();
+crow::response filterExperiments(std::string type, double min, double max, const PageRequest& page = PageRequest());
+crow::response filterExperiments(bool approvalStatus, const PageRequest& page = PageRequest());
+void addExperimentFilterIndexes();
+crow::response sortExperiments(std::string sortString, const PageRequest& page = PageRequest());
+void addExperimentSortIndexes();
 
 #endif // EXPERIMENT_FUNCTIONS_H 
\ No newline at end of file
@@ -10,17 +10,26 @@
 #include <doctest.h>
 #include "experimentFunctions.h"
 #include "Experiment.h"
+#include "WriteAheadLog.h"
+#include "ChangeTracker.h"
+#include "Repository.h"
+#include "EntityTag.h"
+#include <csignal>
+#include <cstdio>
+#include <sys/resource.h>
 // #include "http_request.h"
 
 using namespace std;
 using namespace crow;
 
-map<string, Experiment> experimentsMap;
+Repository<Experiment> experimentsRepository;
+WriteAheadLog writeAheadLog; // Opened only to make it fail, so the handlers under test do not log.
+ChangeTracker changeTracker;
 
 TEST_CASE("Post: Creating a new Experiment resource") 
 {
-    // Setup resource map to be empty before the test
-    experimentsMap.clear();
+    // Setup resource repository to be empty before the test
+    experimentsRepository.clear();
     request req;
 
     SUBCASE("401: authetication failed")
@@ -43,6 +52,40 @@ TEST_CASE("Post: Creating a new Experiment resource")
         CHECK("Invalid JSON" == res.body); // Validate the reponse body
     }
 
+    SUBCASE("503: the write-ahead log can't record the Experiment")
+    {
+        // Setup a log that can't grow, so the first append fails
+        string logFilename = "experimentFunctionsTest.wal";
+        remove(logFilename.c_str());
+        REQUIRE(writeAheadLog.open(logFilename, WriteAheadLog::Durability::None));
+        struct rlimit previous;
+        getrlimit(RLIMIT_FSIZE, &previous);
+        struct rlimit limited = previous;
+        limited.rlim_cur = 16;
+        signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limited);
+        req.headers.insert({"Authorization", "PHYS17"});
+        req.body = R"({"equipmentIds":[],"userIds":[],"approvalStatus":true,"cost":1500.0,"researchOutput":{"publishedOn":[],"publishedIn":[],"numCitations":0},"endTime":"2025-10-12_17:00","startTime":"2024-10-10_09:00","description":"","title":"Shape formation","experimentId":"exp_001"})";
+
+        // Perform the action: the failing append, then one after it
+        response first = createExperiment(req);
+        response second = createExperiment(req);
+        setrlimit(RLIMIT_FSIZE, &previous);
+        signal(SIGXFSZ, SIG_DFL);
+
+        // Check the results: both are refused and nothing is stored
+        CHECK(first.code == 503);
+        CHECK(first.body == "Write-ahead log unavailable");
+        CHECK(second.code == 503);
+        CHECK(experimentsRepository.size() == 0);
+
+        // Leave the log closed and no longer failed for the other tests
+        writeAheadLog.close();
+        REQUIRE(writeAheadLog.open(logFilename, WriteAheadLog::Durability::None));
+        writeAheadLog.close();
+        remove(logFilename.c_str());
+    }
+
     SUBCASE("201: created successfully")
     {
         // Setup request object
@@ -56,10 +99,11 @@ TEST_CASE("Post: Creating a new Experiment resource")
         string id1 = "exp_001";
         CHECK(res.code == 201); // Check that the response code is 201 Created
         CHECK(res.body == req.body); // Validate the reponse body
-        CHECK(experimentsMap.size() == 1); // Ensure the resource was added to the map
-        CHECK(experimentsMap.at(id1).getId() == id1); // Validate the resource content
-        // CHECK(experimentsMap.at(id1).getGenre() == "Rock"); // Validate the resource content
+        CHECK(experimentsRepository.size() == 1); // Ensure the resource was added to the repository
+        CHECK(experimentsRepository.at(id1).getId() == id1); // Validate the resource content
+        // CHECK(experimentsRepository.at(id1).getGenre() == "Rock"); // Validate the resource content
     }
+
 }
 
 TEST_CASE("Read: Reading a list of experiment resources / a single experiment resource")
@@ -89,7 +133,7 @@ TEST_CASE("Read: Reading a list of experiment resources / a single experiment re
     {
         string id4 = "exp_004";
         response res = readExperiment(req, id4);
-        CHECK(res.body == experimentsMap.at(id4).convertToJson().dump());
+        CHECK(res.body == experimentsRepository.at(id4).convertToJson().dump());
         CHECK(res.code == 200);
     }
 
@@ -110,6 +154,12 @@ TEST_CASE("Read: Reading a list of experiment resources / a single experiment re
         string expectedResult = R"([{"equipmentIds":["equip_001","equip_002"],"userIds":["std_001","prof_001"],"approvalStatus":true,"cost":1500.0,"researchOutput":{"publishedOn":["2024-10-29","2025-04-17"],"publishedIn":["Multi-agent robotics journal","Jorunal of Robotics"],"numCitations":4980},"endTime":"2025-10-12_17:00","startTime":"2024-10-10_09:00","description":"An experiment to form a triangle with a group of three robots","title":"Shape formation in multi-agent robotics","experimentId":"exp_001"},{"experimentId":"exp_002","title":"Double Slit Experiment","description":"A recreation of the famous double-slit experiment in Quantum Mechanics Lab","startTime":"","endTime":"","researchOutput":{"numCitations":0,"publishedIn":[],"publishedOn":[]},"cost":3000.0,"approvalStatus":false,"userIds":["std_002","std_003","prof_002"],"equipmentIds":["equip_005"]},{"equipmentIds":["equip_006","equip_007"],"userIds":["std_003","std_004","prof_003","prof_004"],"approvalStatus":true,"cost":2000.0,"researchOutput":{"publishedOn":["2025-02-10","2025-06-05"],"publishedIn":["Journal of Material Science","Mechanical Engineering Research"],"numCitations":1250},"endTime":"2025-01-15_16:00","startTime":"2024-12-15_10:00","description":"An experiment to study stress-strain behavior of metals under load","title":"Stress Analysis of Metallic Materials","experimentId":"exp_003"}])";
         CHECK(res.body == expectedResult);
         CHECK(res.code == 200);
+
+        // A regex finds the same experiments, and a pattern that is not a regex is refused.
+        req.url_params = query_string("?search=exp.riment");
+        CHECK(readAllExperiments(req).code == 200);
+        req.url_params = query_string("?search=[a-");
+        CHECK(readAllExperiments(req).code == 400);
     }
 
     // Covers readAllExperiments and sortExperiments(string sortString)
@@ -132,8 +182,8 @@ TEST_CASE("Read: Reading a list of experiment resources / a single experiment re
         CHECK(res.code == 200);
     }
 
-    // Covers readAllExperiments and filterExperiments(std::string type, float amount)
-    SUBCASE("Reading all experiments filtered by sortString (using filterExperiments(std::string type, float amount))")
+    // Covers readAllExperiments and filterExperiments(std::string type, double min, double max)
+    SUBCASE("Reading all experiments filtered by sortString (using filterExperiments(std::string type, double min, double max))")
     {
         req.url_params = query_string("?type=citations&number=2000");
         response res = readAllExperiments(req);
@@ -142,8 +192,8 @@ TEST_CASE("Read: Reading a list of experiment resources / a single experiment re
         CHECK(res.code == 200);
     }
 
-    // Covers readAllExperiments and filterExperiments(float cost)
-    SUBCASE("Reading all experiments filtered by sort string (using filterExperiments(float cost))")
+    // Covers readAllExperiments and filterExperiments(std::string type, double min, double max)
+    SUBCASE("Reading all experiments filtered by sort string (using filterExperiments(std::string type, double min, double max))")
     {
         req.url_params = query_string("?cost=2000");
         response res = readAllExperiments(req);
@@ -152,13 +202,196 @@ TEST_CASE("Read: Reading a list of experiment resources / a single experiment re
         CHECK(res.code == 200);
     }
 
-    // Covers readAllExperiments and filterExperiments(float cost)
-    SUBCASE("Reading all experiments filtered by an invalid sort string returns 400 (using filterExperiments(float cost))")
+    // Covers readAllExperiments and filterExperiments(std::string type, double min, double max)
+    SUBCASE("Reading all experiments filtered by an invalid sort string returns 400 (using filterExperiments(std::string type, double min, double max))")
     {
         req.url_params = query_string("?cost=invalid");
         response res = readAllExperiments(req);
         CHECK(res.code == 400);
     }
+
+    // The ids of the experiments in a list response, in order.
+    auto listedIds = [](const response& res)
+    {
+        vector<string> ids;
+        json::rvalue list = json::load(res.body);
+        for (size_t i = 0; i < list.size(); i++)
+            ids.push_back(list[i]["experimentId"].s());
+        return ids;
+    };
+
+    // Covers readAllExperiments with limit and cursor
+    SUBCASE("Reading all experiments a page at a time")
+    {
+        req.url_params = query_string("?limit=3");
+        response first = readAllExperiments(req);
+        string cursor = first.get_header_value("X-Next-Cursor");
+        req.url_params = query_string("?limit=3&cursor=" + cursor);
+        response second = readAllExperiments(req);
+
+        // Check the results: pages follow the ids, and only pages with more after them have a cursor.
+        CHECK(listedIds(first) == vector<string>{"exp_001", "exp_002", "exp_003"});
+        CHECK_FALSE(cursor.empty());
+        CHECK(listedIds(second) == vector<string>{"exp_004"});
+        CHECK(second.get_header_value("X-Next-Cursor").empty());
+    }
+
+    // Covers sortExperiments with limit and cursor
+    SUBCASE("Reading experiments sorted by cost a page at a time")
+    {
+        req.url_params = query_string("?sort=cost&limit=2");
+        response first = readAllExperiments(req);
+
+        // A cheaper experiment added after the first page doesn't move the pages after it.
+        Experiment cheap = experimentsRepository.at("exp_001");
+        cheap.setId("exp_005");
+        cheap.setCost(1000);
+        experimentsRepository.put("exp_005", cheap);
+        req.url_params = query_string("?sort=cost&limit=2&cursor=" + first.get_header_value("X-Next-Cursor"));
+        response second = readAllExperiments(req);
+        experimentsRepository.erase("exp_005");
+
+        // Check the results
+        CHECK(listedIds(first) == vector<string>{"exp_001", "exp_004"});
+        CHECK(listedIds(second) == vector<string>{"exp_003", "exp_002"});
+        CHECK(second.get_header_value("X-Next-Cursor").empty());
+    }
+
+    // Covers filterExperiments(bool approvalStatus) with limit and cursor
+    SUBCASE("Reading approved experiments a page at a time")
+    {
+        req.url_params = query_string("?isapproved=true&limit=2");
+        response first = readAllExperiments(req);
+        req.url_params = query_string("?isapproved=true&limit=2&cursor=" + first.get_header_value("X-Next-Cursor"));
+        response second = readAllExperiments(req);
+
+        // Check the results
+        CHECK(listedIds(first) == vector<string>{"exp_001", "exp_003"});
+        CHECK(listedIds(second) == vector<string>{"exp_004"});
+    }
+
+    // Covers readAllExperiments and rankExperiments
+    SUBCASE("Reading the experiments that best answer a query (using rankExperiments)")
+    {
+        req.url_params = query_string("?q=double+slit+experiment");
+        response ranked = readAllExperiments(req);
+        CHECK(ranked.code == 200);
+        CHECK(listedIds(ranked).front() == "exp_002");
+        CHECK(listedIds(ranked).size() == 3);
+
+        // Pages of the index follow the ranking of the scan they replace.
+        req.url_params = query_string("?q=experiment&limit=2");
+        vector<string> unindexed = listedIds(readAllExperiments(req));
+        addExperimentSearchIndexes();
+        response first = readAllExperiments(req);
+        req.url_params = query_string("?q=experiment&limit=2&cursor=" + first.get_header_value("X-Next-Cursor"));
+        response second = readAllExperiments(req);
+        CHECK(listedIds(first) == unindexed);
+        CHECK(listedIds(first).front() == "exp_002");
+        CHECK(listedIds(second).size() == 1);
+        CHECK(second.get_header_value("X-Next-Cursor").empty());
+
+        // A query without words, or with the cursor of another list, is refused.
+        req.url_params = query_string("?q=--");
+        CHECK(readAllExperiments(req).code == 400);
+        req.url_params = query_string("?q=robots&cursor=" + first.get_header_value("X-Next-Cursor"));
+        CHECK(readAllExperiments(req).code == 400);
+        req.url_params = query_string("?sort=cost&cursor=" + first.get_header_value("X-Next-Cursor"));
+        CHECK(readAllExperiments(req).code == 400);
+    }
+
+    // Covers filterExperiments(std::string type, double min, double max) with min and max
+    SUBCASE("Reading experiments with citations or a cost in a range")
+    {
+        // The range walks of the sorted indexes find what the scan they replace finds.
+        req.url_params = query_string("?type=citations&min=900&max=1300");
+        vector<string> unindexed = listedIds(readAllExperiments(req));
+        addExperimentSortIndexes();
+        CHECK(listedIds(readAllExperiments(req)) == unindexed);
+        CHECK(unindexed == vector<string>{"exp_003", "exp_004"});
+
+        req.url_params = query_string("?cost=1800&max=2000&limit=1");
+        response first = readAllExperiments(req);
+        req.url_params = query_string("?cost=1800&max=2000&limit=1&cursor=" + first.get_header_value("X-Next-Cursor"));
+        response second = readAllExperiments(req);
+        CHECK(listedIds(first) == vector<string>{"exp_003"});
+        CHECK(listedIds(second) == vector<string>{"exp_004"});
+        CHECK(second.get_header_value("X-Next-Cursor").empty());
+
+        req.url_params = query_string("?type=publications&max=1");
+        CHECK(listedIds(readAllExperiments(req)) == vector<string>{"exp_002"});
+        req.url_params = query_string("?type=cost&min=5000");
+        CHECK(readAllExperiments(req).code == 404);
+        req.url_params = query_string("?type=starttime&min=0");
+        CHECK(readAllExperiments(req).code == 400);
+        req.url_params = query_string("?type=cost&max=nan");
+        CHECK(readAllExperiments(req).code == 400);
+
+        // Bounds too large for a float are refused rather than failing the request.
+        req.url_params = query_string("?type=citations&max=1e39");
+        response tooLarge = readAllExperiments(req);
+        CHECK(tooLarge.code == 400);
+        CHECK(tooLarge.body == "Invalid number");
+        req.url_params = query_string("?cost=1e39");
+        CHECK(readAllExperiments(req).code == 400);
+    }
+
+    // Covers filterExperiments(bool approvalStatus) with the bitmaps of the approval status
+    SUBCASE("Counting approved experiments")
+    {
+        req.url_params = query_string("?isapproved=true&limit=2");
+        response unindexed = readAllExperiments(req);
+        addExperimentFilterIndexes();
+        response first = readAllExperiments(req);
+        CHECK(first.body == unindexed.body);
+        CHECK(first.get_header_value("X-Next-Cursor") == unindexed.get_header_value("X-Next-Cursor"));
+        CHECK(unindexed.get_header_value("X-Total-Count") == "3");
+        CHECK(first.get_header_value("X-Total-Count") == "3");
+
+        req.url_params = query_string("?isapproved=false");
+        CHECK(listedIds(readAllExperiments(req)) == vector<string>{"exp_002"});
+    }
+
+    // Covers readAllExperiments with invalid limits and cursors
+    SUBCASE("Reading pages with an invalid limit or cursor returns 400")
+    {
+        req.url_params = query_string("?sort=cost&limit=1");
+        string costCursor = readAllExperiments(req).get_header_value("X-Next-Cursor");
+
+        for (string query : vector<string>{"?limit=0", "?limit=ten", "?cursor=xyz", "?sort=starttime&cursor=" + costCursor, "?cursor=" + costCursor})
+        {
+            CAPTURE(query);
+            req.url_params = query_string(query);
+            CHECK(readAllExperiments(req).code == 400);
+        }
+    }
+
+    // Covers readExperiment and readAllExperiments with fields
+    SUBCASE("Reading only the requested fields")
+    {
+        req.url_params = query_string("?fields=title,cost");
+        CHECK(readExperiment(req, "exp_004").body == R"({"cost":1800.0,"title":"Fluid Flow in Pipe Networks"})");
+
+        req.url_params = query_string("?sort=cost&limit=2&fields=experimentId,researchOutput.numCitations");
+        response sorted = readAllExperiments(req);
+        CHECK(sorted.body == R"([{"researchOutput":{"numCitations":4980},"experimentId":"exp_001"},{"researchOutput":{"numCitations":980},"experimentId":"exp_004"}])");
+        CHECK_FALSE(sorted.get_header_value("X-Next-Cursor").empty());
+
+        req.url_params = query_string("?isapproved=false&fields=experimentId");
+        CHECK(readAllExperiments(req).body == R"([{"experimentId":"exp_002"}])");
+
+        req.url_params = query_string("?fields=experimentId");
+        CHECK(readAllExperiments(req).body == R"([{"experimentId":"exp_001"},{"experimentId":"exp_002"},{"experimentId":"exp_003"},{"experimentId":"exp_004"}])");
+
+        // Check the results: fields that are not a list of names are rejected.
+        for (string query : vector<string>{"?fields=", "?fields=title,", "?fields=researchOutput..numCitations", "?fields=.title", "?fields=ti%20tle"})
+        {
+            CAPTURE(query);
+            req.url_params = query_string(query);
+            CHECK(readAllExperiments(req).code == 400);
+            CHECK(readExperiment(req, "exp_004").code == 400);
+        }
+    }
 }
 
 TEST_CASE("Update: change an existing lab")
@@ -202,6 +435,27 @@ TEST_CASE("Update: change an existing lab")
         CHECK(res.code == 200);
         CHECK(readExperiment(req, id1).body == newExperiment1);
     }
+
+    SUBCASE("412: the Experiment changed since the client read it")
+    {
+        request conditional = req;
+        conditional.headers.insert({"If-Match", "\"0000000000000000\""});
+        conditional.body = readExperiment(req, id1).body;
+        response res;
+        updateExperiment(conditional, res, id1);
+        CHECK(res.code == 412);
+    }
+
+    SUBCASE("200: If-Match names the current Experiment")
+    {
+        request conditional = req;
+        conditional.body = readExperiment(req, id1).body;
+        conditional.headers.insert({"If-Match", makeEntityTag(conditional.body)});
+        response res;
+        updateExperiment(conditional, res, id1);
+        CHECK(res.code == 200);
+        CHECK(res.get_header_value("ETag") == makeEntityTag(res.body));
+    }
 }
 
 TEST_CASE("Delete: delete an existing lab")
@@ -224,11 +478,20 @@ TEST_CASE("Delete: delete an existing lab")
         CHECK(res.code == 404);
     }
 
+    SUBCASE("412: the Experiment changed since the client read it")
+    {
+        request conditional = req;
+        conditional.headers.insert({"If-Match", "\"0000000000000000\""});
+        response res = deleteExperiment(conditional, id1);
+        CHECK(res.code == 412);
+        CHECK(experimentsRepository.contains(id1));
+    }
+
     SUBCASE("204: successfully deleted")
     {
         response res = deleteExperiment(req, id1);
 
         CHECK(res.code == 204);
-        CHECK(experimentsMap.size() == 3);
+        CHECK(experimentsRepository.size() == 3);
     }
 }
\ No newline at end of file
@@ -2,7 +2,19 @@
 #include <doctest.h>
 #include "FileHandlingTemplate.h"
 #include "Equipment.h"
+#include "Administrator.h"
+#include "BinarySnapshot.h"
+#include "ThreadPool.h"
+#include "Repository.h"
+#include <cstdio>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+// The labs administrators manage.
+Repository<Lab> labsRepository;
 
 TEST_CASE("Saving to a file and loading from a file.") 
 {
@@ -29,4 +41,414 @@ TEST_CASE("Saving to a file and loading from a file.")
     CHECK(EquipmentsMap.at("2").getName() == EquipmentsMapLoaded.at(id2).getName());
     CHECK(EquipmentsMap.at("2").getDescription() == EquipmentsMapLoaded.at(id2).getDescription());
     CHECK(EquipmentsMap.at("2").isAvailable() == EquipmentsMapLoaded.at(id2).isAvailable());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Loading a truncated file keeps every complete record.") 
+{
+    // Write a file that was cut off in the middle of its second record.
+    ofstream file("fileHandlingTemplateTest.json");
+    file << R"([{"equipmentId":"equip_001","name":"Muon Detector","description":"A \"quoted\" [bracketed] {braced} description","available":true},{"equipmentId":"equip_002","name":"Cloud)";
+    file.close();
+
+    // Perform the action
+    map<string, Equipment> EquipmentsMapLoaded = loadFromFile<Equipment>("fileHandlingTemplateTest.json");
+
+    // Check the results
+    CHECK(EquipmentsMapLoaded.size() == 1);
+    CHECK(EquipmentsMapLoaded.at("equip_001").getDescription() == R"(A "quoted" [bracketed] {braced} description)");
+}
+
+TEST_CASE("Saving to a binary snapshot and loading it back.") 
+{
+    // Load resources to save.
+    map<string, Equipment> EquipmentsMap;
+    EquipmentsMap["equip_002"] = Equipment{json::load(R"({"equipmentId":"equip_002","name":"Cloud Chamber","description":"Visualizes the paths of charged particles","available":false})")};
+    EquipmentsMap["equip_001"] = Equipment{json::load(R"({"equipmentId":"equip_001","name":"Muon Detector","description":"","available":true})")};
+
+    // Perform the action
+    REQUIRE(saveToBinarySnapshot<Equipment>(EquipmentsMap, "fileHandlingTemplateTest.lfb", "equipments"));
+    map<string, Equipment> EquipmentsMapLoaded;
+    REQUIRE(loadFromBinarySnapshot<Equipment>("fileHandlingTemplateTest.lfb", "equipments", EquipmentsMapLoaded));
+
+    // Check the results
+    CHECK(EquipmentsMapLoaded.size() == 2);
+    CHECK(EquipmentsMapLoaded.at("equip_002").getName() == "Cloud Chamber");
+    CHECK(EquipmentsMapLoaded.at("equip_002").getDescription() == "Visualizes the paths of charged particles");
+    CHECK(EquipmentsMapLoaded.at("equip_002").isAvailable() == false);
+    CHECK(EquipmentsMapLoaded.at("equip_001").getDescription() == "");
+    CHECK(EquipmentsMapLoaded.at("equip_001").isAvailable() == true);
+
+    SUBCASE("Records can be found by id without loading the collection")
+    {
+        BinarySnapshotFile snapshot;
+        REQUIRE(snapshot.open("fileHandlingTemplateTest.lfb", "equipments"));
+        CHECK(snapshot.size() == 2);
+        CHECK(snapshot.find("equip_001") == 0);
+        CHECK(snapshot.find("equip_002") == 1);
+        CHECK(snapshot.find("equip_003") == -1);
+    }
+
+    SUBCASE("A snapshot of another collection is rejected")
+    {
+        map<string, Equipment> other;
+        CHECK_FALSE(loadFromBinarySnapshot<Equipment>("fileHandlingTemplateTest.lfb", "labs", other));
+    }
+
+    remove("fileHandlingTemplateTest.lfb");
+}
+
+TEST_CASE("Loading a file in parallel chunks.") 
+{
+    // Write more records than fit in one chunk, with a later record replacing an earlier one.
+    ofstream file("fileHandlingTemplateTest.json");
+    file << "[";
+    for (int i = 0; i < 10; i++)
+        file << R"({"equipmentId":"equip_)" << i << R"(","name":"Detector )" << i << R"(","description":"","available":true},)";
+    file << R"({"equipmentId":"equip_3","name":"Replaced","description":"","available":false}])";
+    file.close();
+
+    // Perform the action
+    ThreadPool pool(3);
+    map<string, Equipment> EquipmentsMapLoaded = loadFromFileInParallel<Equipment>("fileHandlingTemplateTest.json", pool, 4);
+
+    // Check the results
+    CHECK(EquipmentsMapLoaded.size() == 10);
+    CHECK(EquipmentsMapLoaded.at("equip_0").getName() == "Detector 0");
+    CHECK(EquipmentsMapLoaded.at("equip_9").getName() == "Detector 9");
+    CHECK(EquipmentsMapLoaded.at("equip_3").getName() == "Replaced");
+    CHECK(EquipmentsMapLoaded.at("equip_3").isAvailable() == false);
+}
+
+TEST_CASE("Keeping a collection in each repository backend.") 
+{
+    for (string backendName : {"versioned", "sharded", "map", "hash", "log"})
+    {
+        CAPTURE(backendName);
+
+        // Load resources into the backend, out of id order.
+        Repository<Equipment> EquipmentsRepository;
+        EquipmentsRepository.setBackend(makeRepositoryBackend<Equipment>(backendName, "fileHandlingTemplateTest"));
+        map<string, Equipment> EquipmentsMap;
+        EquipmentsMap["equip_002"] = Equipment{json::load(R"({"equipmentId":"equip_002","name":"Cloud Chamber","description":"","available":false})")};
+        EquipmentsMap["equip_001"] = Equipment{json::load(R"({"equipmentId":"equip_001","name":"Muon Detector","description":"","available":true})")};
+        EquipmentsRepository.assign(std::move(EquipmentsMap));
+        CHECK(EquipmentsRepository.getBackendName() == backendName);
+
+        // Perform the actions
+        Equipment replaced = EquipmentsRepository.at("equip_002");
+        replaced.setName("Bubble Chamber");
+        EquipmentsRepository.put("equip_002", replaced);
+        EquipmentsRepository.put("equip_000", Equipment{json::load(R"({"equipmentId":"equip_000","name":"Spark Chamber","description":"","available":true})")});
+        CHECK(EquipmentsRepository.erase("equip_001"));
+        CHECK_FALSE(EquipmentsRepository.erase("equip_001"));
+
+        // Check the results
+        CHECK(EquipmentsRepository.size() == 2);
+        CHECK(EquipmentsRepository.at("equip_002").getName() == "Bubble Chamber");
+        CHECK_FALSE(EquipmentsRepository.contains("equip_001"));
+        CHECK_THROWS_AS(EquipmentsRepository.at("equip_001"), out_of_range);
+
+        vector<string> ids;
+        EquipmentsRepository.scan([&](const string& id, const Equipment&) { ids.push_back(id); });
+        CHECK(ids == vector<string>{"equip_000", "equip_002"});
+
+        EquipmentsRepository.clear();
+        CHECK(EquipmentsRepository.size() == 0);
+    }
+}
+
+TEST_CASE("Compacting the log structured backend.") 
+{
+    LogStructuredBackend<Equipment> backend("fileHandlingTemplateTest.store");
+    Equipment equipment{json::load(R"({"equipmentId":"equip_001","name":"Muon Detector","description":"","available":true})")};
+    for (int i = 0; i < 5; i++)
+        backend.put("equip_001", equipment);
+    CHECK(backend.getGarbageBytes() == backend.getFileBytes() * 4 / 5);
+
+    // Perform the action
+    backend.compact();
+
+    // Check the results
+    CHECK(backend.getGarbageBytes() == 0);
+    Equipment loaded;
+    REQUIRE(backend.get("equip_001", loaded));
+    CHECK(loaded.getName() == "Muon Detector");
+}
+
+TEST_CASE("Changing a repository from several threads.") 
+{
+    for (string backendName : {"versioned", "sharded"})
+    {
+        CAPTURE(backendName);
+        Repository<Equipment> EquipmentsRepository;
+        EquipmentsRepository.setBackend(makeRepositoryBackend<Equipment>(backendName, "fileHandlingTemplateTest"));
+        Equipment equipment{json::load(R"({"equipmentId":"equip_000","name":"Detector","description":"","available":true})")};
+
+        // Perform the action: every thread adds its own equipment and reads and lists the others.
+        atomic<int> missing(0);
+        vector<thread> threads;
+        for (int t = 0; t < 8; t++)
+        {
+            threads.emplace_back([&, t]
+            {
+                for (int i = 0; i < 200; i++)
+                {
+                    string id = "equip_" + to_string(t) + "_" + to_string(i);
+                    EquipmentsRepository.put(id, equipment);
+                    if (!EquipmentsRepository.contains(id))
+                        missing++;
+                    if (i % 50 == 0)
+                        EquipmentsRepository.scan([](const string&, const Equipment&) {});
+                    if (i % 2 == 1)
+                        EquipmentsRepository.erase(id);
+                }
+            });
+        }
+        for (thread& worker : threads)
+            worker.join();
+
+        // Check the results
+        CHECK(missing == 0);
+        CHECK(EquipmentsRepository.getBackendName() == backendName);
+        CHECK(EquipmentsRepository.size() == 8 * 100);
+        CHECK(EquipmentsRepository.contains("equip_7_198"));
+        CHECK_FALSE(EquipmentsRepository.contains("equip_7_199"));
+    }
+}
+
+TEST_CASE("Locking every object of a batch at once.") 
+{
+    Repository<Equipment> EquipmentsRepository;
+    vector<string> ids;
+    for (int i = 0; i < 1000; i++)
+        ids.push_back("equip_" + to_string(i));
+    ids.push_back("equip_0");
+
+    // Ids that share a lock take it once, so a batch never waits for itself.
+    vector<unique_lock<mutex>> locks = EquipmentsRepository.lockObjects(ids);
+    CHECK(locks.size() <= 64);
+
+    // Another request can't change an object of the batch until the batch is done.
+    atomic<bool> locked(false);
+    thread other([&] { unique_lock<mutex> lock = EquipmentsRepository.lockObject("equip_7"); locked = true; });
+    this_thread::sleep_for(chrono::milliseconds(20));
+    CHECK_FALSE(locked);
+    locks.clear();
+    other.join();
+    CHECK(locked);
+}
+
+TEST_CASE("Reading one version of a repository while it changes.") 
+{
+    Repository<Equipment> EquipmentsRepository;
+    Equipment equipment{json::load(R"({"equipmentId":"equip_000","name":"Detector","description":"","available":true})")};
+    EquipmentsRepository.put("equip_000", equipment);
+    EquipmentsRepository.put("equip_001", equipment);
+
+    // Perform the action: change the repository from inside a scan.
+    vector<string> ids;
+    EquipmentsRepository.scan([&](const string& id, const Equipment&)
+    {
+        ids.push_back(id);
+        EquipmentsRepository.erase("equip_001");
+        EquipmentsRepository.put("equip_002", equipment);
+    });
+
+    // Check the results: the scan saw the version it started with.
+    CHECK(EquipmentsRepository.getBackendName() == "versioned");
+    CHECK(ids == vector<string>{"equip_000", "equip_001"});
+    CHECK(EquipmentsRepository.size() == 2);
+    CHECK_FALSE(EquipmentsRepository.contains("equip_001"));
+}
+
+TEST_CASE("Serving the JSON of an object until it changes.") 
+{
+    for (bool cacheSerialized : {true, false})
+    {
+        CAPTURE(cacheSerialized);
+        Repository<Equipment> EquipmentsRepository;
+        EquipmentsRepository.setCacheSerialized(cacheSerialized);
+        Equipment equipment{json::load(R"({"equipmentId":"equip_001","name":"Muon Detector","description":"","available":true})")};
+        EquipmentsRepository.put("equip_001", equipment);
+
+        string first;
+        string second;
+        REQUIRE(EquipmentsRepository.getJson("equip_001", first));
+        REQUIRE(EquipmentsRepository.getJson("equip_001", second));
+        CHECK(first == equipment.convertToJson().dump());
+        CHECK(second == first);
+
+        // Perform the actions
+        equipment.setName("Cloud Chamber");
+        EquipmentsRepository.put("equip_001", equipment);
+        string changed;
+        REQUIRE(EquipmentsRepository.getJson("equip_001", changed));
+        EquipmentsRepository.erase("equip_001");
+
+        // Check the results: the JSON of the replaced object was dropped with it.
+        CHECK(changed == equipment.convertToJson().dump());
+        CHECK(changed != first);
+        CHECK_FALSE(EquipmentsRepository.getJson("equip_001", changed));
+    }
+}
+
+TEST_CASE("Serving the JSON of the whole collection until it changes.") 
+{
+    for (string backendName : {"versioned", "map"})
+    {
+        CAPTURE(backendName);
+        Repository<Equipment> EquipmentsRepository;
+        EquipmentsRepository.setBackend(makeRepositoryBackend<Equipment>(backendName, "fileHandlingTemplateTest"));
+        string empty;
+        EquipmentsRepository.getAllJson(empty);
+        CHECK(empty == json::wvalue().dump());
+
+        Equipment first{json::load(R"({"equipmentId":"equip_001","name":"Muon Detector","description":"","available":true})")};
+        Equipment second{json::load(R"({"equipmentId":"equip_002","name":"Cloud Chamber","description":"","available":false})")};
+        EquipmentsRepository.put("equip_002", second);
+        EquipmentsRepository.put("equip_001", first);
+        uint64_t version = EquipmentsRepository.getVersion();
+
+        // Perform the actions
+        string both;
+        string cached;
+        EquipmentsRepository.getAllJson(both);
+        EquipmentsRepository.getAllJson(cached);
+        EquipmentsRepository.erase("equip_001");
+        string changed;
+        EquipmentsRepository.getAllJson(changed);
+
+        // Check the results: the list is the one crow would dump, and it follows the change.
+        json::wvalue expected;
+        expected[0] = first.convertToJson();
+        expected[1] = second.convertToJson();
+        CHECK(both == expected.dump());
+        CHECK(cached == both);
+        json::wvalue expectedChanged;
+        expectedChanged[0] = second.convertToJson();
+        CHECK(changed == expectedChanged.dump());
+        CHECK(EquipmentsRepository.getVersion() == version + 1);
+    }
+}
+
+TEST_CASE("Writing the JSON of the whole collection in pieces.") 
+{
+    for (string backendName : {"versioned", "map"})
+    {
+        CAPTURE(backendName);
+        Repository<Equipment> EquipmentsRepository;
+        EquipmentsRepository.setBackend(makeRepositoryBackend<Equipment>(backendName, "fileHandlingTemplateTest"));
+        vector<string> pieces;
+        function<void(const string&)> collect = [&pieces](const string& piece) { pieces.push_back(piece); };
+        EquipmentsRepository.writeAllJson(collect, 1);
+        CHECK(pieces == vector<string>{"null"});
+
+        for (int i = 0; i < 3; i++)
+        {
+            string id = "equip_00" + to_string(i);
+            EquipmentsRepository.put(id, Equipment{json::load(R"({"equipmentId":")" + id + R"(","name":"Muon Detector","description":"","available":true})")});
+        }
+
+        // Perform the actions
+        pieces.clear();
+        EquipmentsRepository.writeAllJson(collect, 1);
+        string joined;
+        for (const string& piece : pieces)
+            joined += piece;
+        pieces.clear();
+        EquipmentsRepository.writeAllJson(collect, 1 << 20);
+
+        // Check the results: one piece per object with small pieces, one piece for the whole
+        // list with large ones, and the same list getAllJson gives either way.
+        string all;
+        EquipmentsRepository.getAllJson(all);
+        CHECK(joined == all);
+        CHECK(pieces == vector<string>{all});
+    }
+}
+
+TEST_CASE("Exporting and importing newline-delimited JSON.") 
+{
+    Repository<Equipment> EquipmentsRepository;
+    EquipmentsRepository.setBackend(makeRepositoryBackend<Equipment>("versioned", "fileHandlingTemplateTest"));
+    WriteAheadLog log;
+    string logFilename = "fileHandlingTemplateTest.wal";
+    remove(logFilename.c_str());
+    REQUIRE(log.open(logFilename, WriteAheadLog::Durability::None));
+    ChangeTracker tracker;
+
+    // Perform the action: two good lines in a batch, two bad ones, a blank one and a good one
+    // in a batch of its own.
+    string body = R"({"equipmentId":"equip_001","name":"Muon Detector","description":"","available":true})" "\n"
+        R"({"equipmentId":"equip_002","name":"Cloud Chamber","description":"","available":false})" "\r\n"
+        R"({"equipmentId":"equip_003",)" "\n"
+        "[1,2]\n"
+        "\n"
+        R"({"equipmentId":"equip_004","name":"Geiger Counter","description":"","available":true})";
+    ImportReport report = importFromNdjson<Equipment>(body, EquipmentsRepository, "equipments", log, tracker, 2);
+    log.close();
+
+    // Check the results: the good lines are stored, logged and tracked, the bad ones reported.
+    CHECK(report.imported == 3);
+    CHECK(report.failed == 2);
+    REQUIRE(report.errors.size() == 2);
+    CHECK(report.errors[0] == pair<size_t, string>{3, "Invalid JSON"});
+    CHECK(report.errors[1].first == 4);
+    CHECK(EquipmentsRepository.size() == 3);
+    CHECK(WriteAheadLog::readAll(logFilename).size() == 3);
+    CHECK(tracker.getChangeCount() == 3);
+
+    // Exporting writes the same objects back, one line each, in id order.
+    string exported;
+    EquipmentsRepository.writeAllNdjson([&exported](const string& piece) { exported += piece; }, 1);
+    string expected;
+    for (string id : {"equip_001", "equip_002", "equip_004"})
+    {
+        string objectJson;
+        REQUIRE(EquipmentsRepository.getJson(id, objectJson));
+        expected += objectJson + "\n";
+    }
+    CHECK(exported == expected);
+
+    Repository<Equipment> reimported;
+    ImportReport again = importFromNdjson<Equipment>(exported, reimported, "equipments", log, tracker, 1000);
+    CHECK(again.imported == 3);
+    CHECK(again.failed == 0);
+    string original;
+    string copy;
+    EquipmentsRepository.getJson("equip_002", original);
+    reimported.getJson("equip_002", copy);
+    CHECK(copy == original);
+
+    // An administrator brings the lab it manages, logged ahead of it in its batch. A line whose
+    // labManaged isn't a whole lab is skipped.
+    remove(logFilename.c_str());
+    REQUIRE(log.open(logFilename, WriteAheadLog::Durability::None));
+    Repository<Administrator> AdministratorsRepository;
+    string administrators = R"({"userName":"Ann","userId":"admin_9","labManaged":{"userIds":[],"equipmentIds":[],"budget":{"remainingAmount":35000.0,"spentAmount":15000.0,"totalAmount":50000.0},"capacity":"20","location":"Jepson Hall","name":"Robotics Lab","labAdminId":"admin_9","experimentIds":[],"labId":"lab_009"}})" "\n"
+        R"({"userName":"Bob","userId":"admin_8","labManaged":{"labId":"lab_404"}})";
+    ImportReport administratorsReport = importFromNdjson<Administrator>(administrators, AdministratorsRepository, "administrators", log, tracker, 1000);
+    log.close();
+    CHECK(administratorsReport.imported == 1);
+    CHECK(administratorsReport.failed == 1);
+    vector<LogRecord> logged = WriteAheadLog::readAll(logFilename);
+    REQUIRE(logged.size() == 2);
+    CHECK(logged[0].collection == "labs");
+    CHECK(logged[1].collection == "administrators");
+
+    // Replaying the records gives the administrator back with its lab.
+    labsRepository.clear();
+    Repository<Administrator> replayed;
+    replayLogRecord(labsRepository, logged[0]);
+    replayLogRecord(replayed, logged[1]);
+    Administrator administrator;
+    REQUIRE(replayed.get("admin_9", administrator));
+    CHECK(administrator.getLabManagedId() == "lab_009");
+    Lab lab;
+    REQUIRE(labsRepository.get("lab_009", lab));
+    CHECK(lab.getName() == "Robotics Lab");
+    string administratorJson;
+    replayed.getJson("admin_9", administratorJson);
+    CHECK(administratorJson.find(R"("labManaged":{"userIds":[])") != string::npos);
+    remove(logFilename.c_str());
+}
@@ -0,0 +1,174 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FullTextIndex.h"
+#include "Equipment.h"
+
+using namespace std;
+
+// The ids of ranked results, best first.
+static vector<string> rankedIds(const vector<RankedId>& ranked)
+{
+    vector<string> ids;
+    for (const RankedId& result : ranked)
+        ids.push_back(result.id);
+    return ids;
+}
+
+TEST_CASE("Ranking texts by BM25.")
+{
+    CHECK(FullTextIndex::words("Multi-agent Robotics, 2024!") == vector<string>{"multi", "agent", "robotics", "2024"});
+    CHECK(FullTextIndex::words(" -- ").empty());
+
+    FullTextIndex index;
+    index.add("exp_001", "Shape formation in multi-agent robotics");
+    index.add("exp_002", "Double slit experiment, a famous experiment");
+    index.add("exp_003", "Stress analysis of metals under load in an experiment");
+    index.add("exp_004", "Fluid flow in pipe networks");
+    CHECK(index.size() == 4);
+    CHECK(index.memoryBytes() > 0);
+
+    SUBCASE("Scores follow the BM25 formula")
+    {
+        vector<RankedId> ranked = index.rank("robotics", 10);
+        REQUIRE(ranked.size() == 1);
+        CHECK(ranked[0].id == "exp_001");
+
+        // One of four texts holds the word once; the texts have 6, 6, 9 and 5 words.
+        double idf = log(1 + (4 - 1 + 0.5) / (1 + 0.5));
+        double norm = FullTextIndex::k1 * (1 - FullTextIndex::b + FullTextIndex::b * 6 / (26 / 4.0));
+        CHECK(fabs(ranked[0].score - idf * (FullTextIndex::k1 + 1) / (1 + norm)) < 1e-9);
+    }
+
+    SUBCASE("Texts holding a word more often or in fewer words rank first")
+    {
+        CHECK(rankedIds(index.rank("experiment", 10)) == vector<string>{"exp_002", "exp_003"});
+        CHECK(rankedIds(index.rank("EXPERIMENT in robotics", 10)).front() == "exp_001");
+        CHECK(rankedIds(index.rank("experiment experiment", 10)) == rankedIds(index.rank("experiment", 10)));
+        CHECK(index.rank("quark", 10).empty());
+        CHECK(index.rank("experiment", 0).empty());
+    }
+
+    SUBCASE("Texts with the same score are in id order, a page at a time")
+    {
+        index.add("exp_005", "Fluid flow in pipe networks");
+        vector<RankedId> first = index.rank("pipe", 1);
+        REQUIRE(first.size() == 1);
+        CHECK(first[0].id == "exp_004");
+        CHECK(rankedIds(index.rank("pipe", 1, &first[0])) == vector<string>{"exp_005"});
+        CHECK(index.rank("pipe", 1, &index.rank("pipe", 2)[1]).empty());
+    }
+
+    SUBCASE("Replaced and removed texts no longer count")
+    {
+        index.add("exp_002", "Double slit");
+        index.remove("exp_003");
+        CHECK(index.size() == 3);
+        CHECK(index.rank("experiment", 10).empty());
+
+        vector<RankedId> ranked = index.rank("slit", 10);
+        REQUIRE(ranked.size() == 1);
+        double idf = log(1 + (3 - 1 + 0.5) / (1 + 0.5));
+        double norm = FullTextIndex::k1 * (1 - FullTextIndex::b + FullTextIndex::b * 2 / (13 / 3.0));
+        CHECK(fabs(ranked[0].score - idf * (FullTextIndex::k1 + 1) / (1 + norm)) < 1e-9);
+
+        index.clear();
+        CHECK(index.rank("slit", 10).empty());
+    }
+
+    SUBCASE("Posting lists are compacted once most of their numbers are removed")
+    {
+        for (int round = 0; round < 2000; round++)
+            index.add("exp_004", "Fluid flow in pipe networks, run " + to_string(round));
+        CHECK(index.size() == 4);
+        CHECK(rankedIds(index.rank("1999", 10)) == vector<string>{"exp_004"});
+        CHECK(index.rank("1998", 10).empty());
+        CHECK(rankedIds(index.rank("experiment", 10)) == vector<string>{"exp_002", "exp_003"});
+    }
+}
+
+TEST_CASE("Keeping only the best texts gives the ranking of every text.")
+{
+    // Texts of a few words from a small vocabulary, so words are shared by many texts.
+    vector<string> vocabulary = {"robot", "laser", "fluid", "metal", "quantum", "pipe", "load", "shape", "slit", "sample", "flow", "beam"};
+    FullTextIndex index;
+    uint32_t seed = 17;
+    for (int i = 0; i < 2000; i++)
+    {
+        string text;
+        int length = 3 + i % 9;
+        for (int word = 0; word < length; word++)
+        {
+            seed = seed * 1103515245 + 12345;
+            text += vocabulary[(seed >> 16) % vocabulary.size()] + " ";
+        }
+        index.add("exp_" + to_string(10000 + i), text);
+    }
+
+    for (string query : {"robot", "quantum slit", "fluid flow pipe", "beam laser metal load shape"})
+    {
+        CAPTURE(query);
+        vector<RankedId> everyText = index.rank(query, 2000);
+        vector<RankedId> best = index.rank(query, 10);
+        REQUIRE(best.size() == 10);
+        for (size_t i = 0; i < best.size(); i++)
+        {
+            CHECK(best[i].id == everyText[i].id);
+            CHECK(best[i].score == everyText[i].score);
+        }
+
+        // Reading the ranking a page at a time gives it whole.
+        vector<RankedId> paged = index.rank(query, 7);
+        while (paged.size() < everyText.size())
+        {
+            vector<RankedId> page = index.rank(query, 7, &paged.back());
+            REQUIRE_FALSE(page.empty());
+            paged.insert(paged.end(), page.begin(), page.end());
+        }
+        CHECK(rankedIds(paged) == rankedIds(everyText));
+    }
+}
+
+TEST_CASE("Responding with the objects of a repository that best answer a query.")
+{
+    Repository<Equipment> equipmentsRepository;
+    map<string, Equipment> equipmentsMap;
+    equipmentsMap["equip_001"] = Equipment{crow::json::load(R"({"equipmentId":"equip_001","name":"Muon Detector","description":"Counts cosmic muons","available":true})")};
+    equipmentsMap["equip_002"] = Equipment{crow::json::load(R"({"equipmentId":"equip_002","name":"Cloud Chamber","description":"Shows the tracks of muons and other particles","available":false})")};
+    equipmentsMap["equip_003"] = Equipment{crow::json::load(R"({"equipmentId":"equip_003","name":"Oscilloscope","description":"","available":true})")};
+    equipmentsRepository.assign(std::move(equipmentsMap));
+
+    function<string(const Equipment&)> text = [](const Equipment& equipment) { return equipment.getName() + "\n" + equipment.getDescription(); };
+    PageRequest page;
+    REQUIRE(page.parse(crow::query_string("?limit=1")));
+
+    // The same pages come from the index and from indexing the collection for the request.
+    crow::response unindexed = rankedPageResponse<Equipment>(equipmentsRepository, "text", text, "muons", page);
+    equipmentsRepository.addIndex("text", make_shared<RankedTextIndex<Equipment>>(text));
+    crow::response first = rankedPageResponse<Equipment>(equipmentsRepository, "text", text, "muons", page);
+    CHECK(first.code == 200);
+    CHECK(first.body == unindexed.body);
+    CHECK(first.body.find("\"equip_001\"") != string::npos);
+    CHECK_FALSE(first.get_header_value("X-Next-Cursor").empty());
+
+    PageRequest next;
+    REQUIRE(next.parse(crow::query_string("?limit=1&cursor=" + first.get_header_value("X-Next-Cursor"))));
+    crow::response second = rankedPageResponse<Equipment>(equipmentsRepository, "text", text, "muons", next);
+    CHECK(second.body.find("\"equip_002\"") != string::npos);
+    CHECK(second.get_header_value("X-Next-Cursor").empty());
+
+    // Changes to the repository reach the index.
+    equipmentsRepository.erase("equip_001");
+    CHECK(rankedPageResponse<Equipment>(equipmentsRepository, "text", text, "muons", page).body.find("\"equip_002\"") != string::npos);
+
+    CHECK(rankedPageResponse<Equipment>(equipmentsRepository, "text", text, "?!", page).code == 400);
+
+    // A cursor only continues the query it came from, however the query is written.
+    CHECK(FullTextIndex::rankOrder("Muons!") == FullTextIndex::rankOrder("muons"));
+    CHECK(FullTextIndex::rankOrder("muons") != FullTextIndex::rankOrder("muon"));
+    CHECK(rankedPageResponse<Equipment>(equipmentsRepository, "text", text, "MUONS", next).code == 200);
+    CHECK(rankedPageResponse<Equipment>(equipmentsRepository, "text", text, "chamber", next).code == 400);
+}
@@ -0,0 +1,100 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <string>
+#include <cmath>
+#include "FieldMask.h"
+#include "JsonWriter.h"
+#include "Experiment.h"
+#include "Lab.h"
+
+using namespace std;
+
+TEST_CASE("Writing objects the way crow dumps them.")
+{
+    string experimentJson = R"({"equipmentIds":["equip_001","equip_002"],"userIds":["std_001","prof_001"],"approvalStatus":true,"cost":1500.0,"researchOutput":{"publishedOn":["2024-10-29","2025-04-17"],"publishedIn":["Multi-agent robotics journal","Jorunal of Robotics"],"numCitations":4980},"endTime":"2025-10-12_17:00","startTime":"2024-10-10_09:00","description":"An experiment to form a triangle with a group of three robots","title":"Shape formation in multi-agent robotics","experimentId":"exp_001"})";
+    string labJson = R"({"userIds":["std_001","prof_001"],"equipmentIds":["equip_001","equip_002","equip_003"],"budget":{"remainingAmount":35000.0,"spentAmount":15000.0,"totalAmount":50000.0},"capacity":"20","location":"Jepson Hall, Room G14","name":"Robotics and Mechatronics Lab","labAdminId":"admin_001","experimentIds":["exp_001"],"labId":"lab_001"})";
+
+    // Check the results: the same keys in the same order, with the same number formats.
+    CHECK(toJsonString(Experiment(crow::json::load(experimentJson))) == experimentJson);
+    CHECK(toJsonString(Lab(crow::json::load(labJson))) == labJson);
+
+    // Objects share one buffer inside a list.
+    string body;
+    JsonWriter writer(body);
+    writer.beginList();
+    writer.rawValue(R"({"labId":"lab_001"})");
+    writer.beginObject();
+    writer.member("labId", string("lab_002"));
+    writer.member("ids", vector<string>());
+    writer.endObject();
+    writer.endList();
+    CHECK(body == R"([{"labId":"lab_001"},{"labId":"lab_002","ids":[]}])");
+}
+
+TEST_CASE("Writing only the fields a mask selects.")
+{
+    Lab lab(crow::json::load(R"({"userIds":["std_001"],"equipmentIds":[],"budget":{"remainingAmount":35000.0,"spentAmount":15000.0,"totalAmount":50000.0},"capacity":"20","location":"Jepson Hall","name":"Robotics Lab","labAdminId":"admin_001","experimentIds":[],"labId":"lab_001"})"));
+    FieldMask fields;
+
+    // Nested paths select members of nested objects.
+    REQUIRE(fields.parse("labId,budget.remainingAmount"));
+    CHECK(toJsonString(lab, &fields) == R"({"budget":{"remainingAmount":35000.0},"labId":"lab_001"})");
+
+    // A member named whole stays whole, whichever comes first.
+    REQUIRE(fields.parse("budget.spentAmount,budget"));
+    CHECK(toJsonString(lab, &fields) == R"({"budget":{"remainingAmount":35000.0,"spentAmount":15000.0,"totalAmount":50000.0}})");
+    REQUIRE(fields.parse("budget,budget.spentAmount"));
+    CHECK(toJsonString(lab, &fields) == R"({"budget":{"remainingAmount":35000.0,"spentAmount":15000.0,"totalAmount":50000.0}})");
+
+    // Every object of a list gets the mask, and paths into values that are not objects write them whole.
+    REQUIRE(fields.parse("name,userIds.first,unknown"));
+    string body;
+    JsonWriter writer(body, &fields);
+    writer.beginList();
+    lab.writeJson(writer);
+    lab.writeJson(writer);
+    writer.endList();
+    CHECK(body == R"([{"userIds":["std_001"],"name":"Robotics Lab"},{"userIds":["std_001"],"name":"Robotics Lab"}])");
+
+    // Without the parameter, or with an empty mask, every field is written.
+    REQUIRE(fields.parse(nullptr));
+    CHECK(fields.isEmpty());
+    CHECK(toJsonString(lab, &fields) == toJsonString(lab));
+
+    // Check the results: only comma separated names and paths are accepted.
+    CHECK_FALSE(fields.parse(""));
+    CHECK_FALSE(fields.parse("labId,"));
+    CHECK_FALSE(fields.parse("budget..spentAmount"));
+    CHECK_FALSE(fields.parse("budget."));
+    CHECK_FALSE(fields.parse("lab Id"));
+    CHECK_FALSE(fields.parse(string(FieldMask::maxLength + 1, 'a').c_str()));
+}
+
+TEST_CASE("Writing an empty list.")
+{
+    string body;
+    JsonWriter writer(body);
+    writer.beginList();
+    writer.endList();
+    CHECK(body == "null");
+}
+
+TEST_CASE("Escaping strings and formatting numbers.")
+{
+    string escaped;
+    JsonWriter::appendEscaped("a\"b\\c\nd\te\x01", escaped);
+    CHECK(escaped == R"(a\"b\\c\nd\te\u0001)");
+
+    string number;
+    JsonWriter::appendNumber(1500, number);
+    CHECK(number == "1500.0");
+    number.clear();
+    JsonWriter::appendNumber(0.25, number);
+    CHECK(number == "0.25");
+    number.clear();
+    JsonWriter::appendNumber(-3.1234567, number);
+    CHECK(number == "-3.123457");
+    number.clear();
+    JsonWriter::appendNumber(NAN, number);
+    CHECK(number == "null");
+}
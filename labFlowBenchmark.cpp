@@ -0,0 +1,1278 @@
+/**
+ * @file labFlowBenchmark.cpp
+ * @brief Benchmarks for the LabFlow API storage and request paths.
+ *
+ * Run every benchmark with ./labFlowBenchmark, or a single one by name,
+ * e.g. ./labFlowBenchmark wal
+ */
+
+#include <crow.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BinarySnapshot.h"
+#include "BitmapIndex.h"
+#include "BodyFormat.h"
+#include "ChangeTracker.h"
+#include "Experiment.h"
+#include "FieldMask.h"
+#include "FileHandlingTemplate.h"
+#include "FullTextIndex.h"
+#include "JsonWriter.h"
+#include "ListSpool.h"
+#include "Pagination.h"
+#include "Repository.h"
+#include "SearchPattern.h"
+#include "SortedIndex.h"
+#include "Snapshotter.h"
+#include "ThreadPool.h"
+#include "TrigramIndex.h"
+#include "WriteAheadLog.h"
+
+using namespace std;
+using namespace crow;
+
+/**
+ * @brief Measures the wall clock time of a piece of work.
+ *
+ * @param work The work to time.
+ * @return The elapsed time in seconds.
+ */
+double timeSeconds(function<void()> work)
+{
+    auto start = chrono::steady_clock::now();
+    work();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Runs a piece of work in a child process and measures it.
+ *
+ * Running each measurement in its own process keeps the peak memory of one from
+ * hiding the peak memory of the next.
+ *
+ * @param work The work to measure.
+ * @return The elapsed seconds and the peak resident memory in megabytes.
+ */
+pair<double, double> measureInChild(function<void()> work)
+{
+    auto start = chrono::steady_clock::now();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        work();
+        _exit(0);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    wait4(child, &status, 0, &usage);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return {seconds, usage.ru_maxrss / 1024.0};
+}
+
+/**
+ * @brief Writes a JSON array of generated experiments, the largest of the resource files.
+ *
+ * @param filename The file to write.
+ * @param count The number of experiments.
+ */
+void writeExperimentsFile(string filename, int count)
+{
+    ofstream file(filename);
+    file << "[";
+    for (int i = 0; i < count; i++)
+    {
+        file << (i ? "," : "") << R"({"experimentId":"exp_)" << i << R"(","title":"Generated experiment )" << i
+             << R"(","description":"Measuring the response of sample )" << i << R"( under a controlled load in the robotics lab",)"
+             << R"("startTime":"2024-10-10_09:00","endTime":"2025-10-12_17:00","cost":)" << (i % 5000) + 0.5
+             << R"(,"approvalStatus":)" << (i % 3 ? "true" : "false")
+             << R"(,"userIds":["std_001","prof_001"],"equipmentIds":["equip_001","equip_002"],)"
+             << R"("researchOutput":{"numCitations":)" << i % 1000 << R"(,"publishedIn":["Journal of Robotics"],"publishedOn":["2025-04-17"]}})";
+    }
+    file << "]";
+}
+
+/**
+ * @brief Loads experiments the way loadFromFile did before it streamed: the whole file is
+ * read into a string and parsed into one JSON document before any object is built.
+ *
+ * @param filename The file to load.
+ * @return A map containing the loaded experiments.
+ */
+map<string, Experiment> loadFromFileWithDocument(string filename)
+{
+    map<string, Experiment> data;
+    ifstream file(filename);
+    ostringstream stringStreamJson;
+    stringStreamJson << file.rdbuf();
+    json::rvalue jsonReadValue = json::load(stringStreamJson.str());
+    for (json::rvalue item : jsonReadValue)
+    {
+        Experiment object{item};
+        data[object.getId()] = object;
+    }
+    return data;
+}
+
+/**
+ * @brief Compares startup load time and peak memory of the whole-document loader and the
+ * streaming loader on generated experiments files.
+ */
+void benchmarkLoader()
+{
+    string filename = "labFlowBenchmarkExperiments.json";
+
+    cout << "== Loading experiments.json" << endl;
+    printf("%-10s %10s %12s %14s\n", "loader", "records", "seconds", "peak RSS (MB)");
+
+    for (int count : {10000, 100000, 1000000})
+    {
+        writeExperimentsFile(filename, count);
+
+        pair<double, double> document = measureInChild([&] { loadFromFileWithDocument(filename); });
+        printf("%-10s %10d %12.3f %14.1f\n", "document", count, document.first, document.second);
+
+        pair<double, double> streaming = measureInChild([&] { loadFromFile<Experiment>(filename); });
+        printf("%-10s %10d %12.3f %14.1f\n", "streaming", count, streaming.first, streaming.second);
+    }
+
+    remove(filename.c_str());
+}
+
+/**
+ * @brief Compares startup load time and peak memory of the JSON files and the binary
+ * snapshots on generated experiments files.
+ */
+void benchmarkBinarySnapshot()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    string snapshotFilename = "labFlowBenchmarkExperiments.lfb";
+
+    cout << "== Loading experiments from JSON and from a binary snapshot" << endl;
+    printf("%-10s %10s %12s %14s\n", "format", "records", "seconds", "peak RSS (MB)");
+
+    for (int count : {10000, 100000, 1000000})
+    {
+        writeExperimentsFile(jsonFilename, count);
+        saveToBinarySnapshot<Experiment>(loadFromFile<Experiment>(jsonFilename), snapshotFilename, "experiments");
+
+        pair<double, double> json = measureInChild([&] { loadFromFile<Experiment>(jsonFilename); });
+        printf("%-10s %10d %12.3f %14.1f\n", "json", count, json.first, json.second);
+
+        pair<double, double> binary = measureInChild([&]
+        {
+            map<string, Experiment> data;
+            loadFromBinarySnapshot<Experiment>(snapshotFilename, "experiments", data);
+        });
+        printf("%-10s %10d %12.3f %14.1f\n", "binary", count, binary.first, binary.second);
+
+        pair<double, double> lookup = measureInChild([&]
+        {
+            BinarySnapshotFile snapshot;
+            snapshot.open(snapshotFilename, "experiments");
+            snapshot.find("exp_" + to_string(count / 2));
+        });
+        printf("%-10s %10d %12.3f %14.1f\n", "mmap+find", count, lookup.first, lookup.second);
+    }
+
+    remove(jsonFilename.c_str());
+    remove(snapshotFilename.c_str());
+}
+
+/**
+ * @brief Measures how loading generated experiments files scales with the number of threads
+ * that parse chunks of them.
+ */
+void benchmarkParallelLoader()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    string snapshotFilename = "labFlowBenchmarkExperiments.lfb";
+    int count = 1000000;
+
+    writeExperimentsFile(jsonFilename, count);
+    saveToBinarySnapshot<Experiment>(loadFromFile<Experiment>(jsonFilename), snapshotFilename, "experiments");
+
+    cout << "== Loading " << count << " experiments in parallel" << endl;
+    printf("%-8s %8s %12s\n", "format", "threads", "seconds");
+
+    double jsonSeconds = measureInChild([&] { loadFromFile<Experiment>(jsonFilename); }).first;
+    printf("%-8s %8s %12.3f\n", "json", "serial", jsonSeconds);
+
+    for (int threadCount : {1, 2, 4, 8, 16})
+    {
+        double seconds = measureInChild([&]
+        {
+            ThreadPool pool(threadCount);
+            loadFromFileInParallel<Experiment>(jsonFilename, pool, 4096);
+        }).first;
+        printf("%-8s %8d %12.3f\n", "json", threadCount, seconds);
+    }
+
+    for (int threadCount : {1, 2, 4, 8, 16})
+    {
+        double seconds = measureInChild([&]
+        {
+            ThreadPool pool(threadCount);
+            map<string, Experiment> data;
+            loadFromBinarySnapshotInParallel<Experiment>(snapshotFilename, "experiments", data, pool, 16384);
+        }).first;
+        printf("%-8s %8d %12.3f\n", "binary", threadCount, seconds);
+    }
+
+    remove(jsonFilename.c_str());
+    remove(snapshotFilename.c_str());
+}
+
+/**
+ * @brief Measures flush latency against collection size at a fixed number of changes per
+ * flush, saving the whole collection versus saving only the changed experiments.
+ */
+void benchmarkDeltaPersistence()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    string snapshotFilename = "labFlowBenchmarkExperiments.lfb";
+    string logFilename = "labFlowBenchmark.wal";
+    string segmentPrefix = "labFlowBenchmark.delta";
+    int changesPerFlush = 1000;
+    int flushes = 5;
+
+    cout << "== Flushing " << changesPerFlush << " changed experiments" << endl;
+    printf("%-8s %10s %14s\n", "mode", "records", "flush (ms)");
+
+    for (int count : {10000, 100000, 1000000})
+    {
+        writeExperimentsFile(jsonFilename, count);
+        Repository<Experiment> experiments;
+        experiments.assign(loadFromFile<Experiment>(jsonFilename));
+
+        remove(logFilename.c_str());
+        WriteAheadLog log;
+        log.open(logFilename, WriteAheadLog::Durability::None);
+        ChangeTracker tracker;
+
+        // Change a different spread of experiments before every flush.
+        auto changeExperiments = [&](int flush)
+        {
+            for (int i = 0; i < changesPerFlush; i++)
+                tracker.markChanged("experiments", "exp_" + to_string((i * 7919 + flush * 104729) % count));
+        };
+
+        Snapshotter full(log, [&] { return saveToFile<Experiment>(experiments, jsonFilename) && saveToBinarySnapshot<Experiment>(experiments, snapshotFilename, "experiments"); }, {});
+        double fullSeconds = 0;
+        for (int flush = 0; flush < flushes; flush++)
+        {
+            changeExperiments(flush);
+            fullSeconds += timeSeconds([&] { full.snapshotNow(); });
+        }
+        printf("%-8s %10d %14.2f\n", "full", count, fullSeconds * 1000 / flushes);
+
+        Snapshotter delta(log, [] { return true; }, {});
+        delta.enableDeltas(tracker, [&](const ChangeSet& changes)
+        {
+            vector<LogRecord> records;
+            collectChanges<Experiment>(experiments, "experiments", changes.at("experiments"), records);
+            return records;
+        }, segmentPrefix, flushes);
+        double deltaSeconds = 0;
+        for (int flush = 0; flush < flushes; flush++)
+        {
+            changeExperiments(flush);
+            deltaSeconds += timeSeconds([&] { delta.snapshotNow(); });
+        }
+        printf("%-8s %10d %14.2f\n", "delta", count, deltaSeconds * 1000 / flushes);
+
+        delta.discardDeltaSegments();
+        log.close();
+    }
+
+    remove(jsonFilename.c_str());
+    remove(snapshotFilename.c_str());
+    remove(logFilename.c_str());
+    remove(WriteAheadLog::rotatedFilename(logFilename).c_str());
+}
+
+/**
+ * @brief Runs the same workload against each repository backend: random reads, updates
+ * of existing experiments and full scans in id order.
+ *
+ * Each backend runs in its own process so its peak memory can be compared.
+ */
+void benchmarkRepositoryBackends()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 100000;
+    int operations = 100000;
+    int scans = 5;
+
+    writeExperimentsFile(jsonFilename, count);
+
+    cout << "== Repository backends with " << count << " experiments" << endl;
+    printf("%-6s %12s %12s %12s %12s\n", "backend", "gets/sec", "puts/sec", "scan (ms)", "peak (MB)");
+
+    for (string backendName : {"versioned", "sharded", "map", "hash", "log"})
+    {
+        fflush(stdout);
+        pair<double, double> measurement = measureInChild([&]
+        {
+            Repository<Experiment> experiments;
+            experiments.setBackend(makeRepositoryBackend<Experiment>(backendName, "labFlowBenchmarkExperiments"));
+            experiments.assign(loadFromFile<Experiment>(jsonFilename));
+
+            // The same pseudo-random ids for every backend.
+            vector<string> ids;
+            for (int i = 0; i < operations; i++)
+                ids.push_back("exp_" + to_string((i * 7919LL) % count));
+
+            size_t found = 0;
+            double getSeconds = timeSeconds([&]
+            {
+                Experiment experiment;
+                for (const string& id : ids)
+                    found += experiments.get(id, experiment);
+            });
+
+            Experiment changed = experiments.at(ids.front());
+            double putSeconds = timeSeconds([&]
+            {
+                for (const string& id : ids)
+                    experiments.put(id, changed);
+            });
+
+            size_t visited = 0;
+            double scanSeconds = timeSeconds([&]
+            {
+                for (int i = 0; i < scans; i++)
+                    experiments.scan([&](const string&, const Experiment&) { visited++; });
+            });
+
+            printf("%-6s %12.0f %12.0f %12.2f ", backendName.c_str(), operations / getSeconds, operations / putSeconds,
+                scanSeconds * 1000 / scans);
+            fflush(stdout);
+        });
+        printf("%12.1f\n", measurement.second);
+    }
+
+    remove(jsonFilename.c_str());
+}
+
+/**
+ * @brief Measures read and write throughput of a shared repository as the number of threads
+ * grows, for the versioned and sharded backends and for a std::map behind one reader-writer lock.
+ */
+void benchmarkContention()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 10000;
+    int operationsPerThread = 20000;
+
+    writeExperimentsFile(jsonFilename, count);
+    map<string, Experiment> experiments = loadFromFile<Experiment>(jsonFilename);
+    remove(jsonFilename.c_str());
+
+    cout << "== Repository contention with " << count << " experiments" << endl;
+    printf("%-8s %-6s %8s %14s\n", "backend", "mix", "threads", "ops/sec");
+
+    // Percentage of operations that are reads.
+    vector<pair<string, int>> mixes = {{"read", 100}, {"90/10", 90}, {"write", 0}};
+
+    for (string backendName : {"versioned", "sharded", "map"})
+    {
+        for (pair<string, int> mix : mixes)
+        {
+            for (int threadCount : {1, 2, 4, 8, 16, 32})
+            {
+                Repository<Experiment> repository;
+                repository.setBackend(makeRepositoryBackend<Experiment>(backendName, "labFlowBenchmarkExperiments"));
+                repository.assign(map<string, Experiment>(experiments));
+
+                double seconds = timeSeconds([&]
+                {
+                    vector<thread> threads;
+                    for (int t = 0; t < threadCount; t++)
+                    {
+                        threads.emplace_back([&, t]
+                        {
+                            Experiment experiment;
+                            for (int i = 0; i < operationsPerThread; i++)
+                            {
+                                string id = "exp_" + to_string((i * 7919LL + t * 104729LL) % count);
+                                if (i % 100 < mix.second)
+                                    repository.get(id, experiment);
+                                else
+                                    repository.put(id, experiment);
+                            }
+                        });
+                    }
+                    for (thread& worker : threads)
+                        worker.join();
+                });
+
+                printf("%-8s %-6s %8d %14.0f\n", backendName.c_str(), mix.first.c_str(), threadCount,
+                    threadCount * operationsPerThread / seconds);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Measures GET latency percentiles while one thread writes as fast as it can, for
+ * each concurrent backend.
+ */
+void benchmarkReadLatency()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 10000;
+    int readerCount = 4;
+    int readsPerThread = 50000;
+
+    writeExperimentsFile(jsonFilename, count);
+    map<string, Experiment> experiments = loadFromFile<Experiment>(jsonFilename);
+    remove(jsonFilename.c_str());
+
+    cout << "== GET latency under a write storm with " << count << " experiments and " << readerCount << " readers" << endl;
+    printf("%-10s %10s %10s %10s %10s %12s\n", "backend", "p50 (us)", "p99 (us)", "p99.9 (us)", "max (us)", "writes/sec");
+
+    for (string backendName : {"versioned", "sharded", "map"})
+    {
+        Repository<Experiment> repository;
+        repository.setBackend(makeRepositoryBackend<Experiment>(backendName, "labFlowBenchmarkExperiments"));
+        repository.assign(map<string, Experiment>(experiments));
+
+        atomic<bool> reading(true);
+        long writes = 0;
+        double writeSeconds = 0;
+        thread writer([&]
+        {
+            Experiment changed = repository.at("exp_0");
+            writeSeconds = timeSeconds([&]
+            {
+                while (reading.load())
+                    repository.put("exp_" + to_string((writes++ * 7919LL) % count), changed);
+            });
+        });
+
+        vector<vector<double>> latencies(readerCount);
+        vector<thread> readers;
+        for (int t = 0; t < readerCount; t++)
+        {
+            readers.emplace_back([&, t]
+            {
+                Experiment experiment;
+                latencies[t].reserve(readsPerThread);
+                for (int i = 0; i < readsPerThread; i++)
+                {
+                    string id = "exp_" + to_string((i * 104729LL + t) % count);
+                    latencies[t].push_back(timeSeconds([&] { repository.get(id, experiment); }) * 1e6);
+                }
+            });
+        }
+        for (thread& reader : readers)
+            reader.join();
+        reading = false;
+        writer.join();
+
+        vector<double> all;
+        for (vector<double>& threadLatencies : latencies)
+            all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+        sort(all.begin(), all.end());
+
+        printf("%-10s %10.2f %10.2f %10.2f %10.2f %12.0f\n", backendName.c_str(), all[all.size() / 2], all[all.size() * 99 / 100],
+            all[all.size() * 999 / 1000], all.back(), writes / writeSeconds);
+    }
+}
+
+/**
+ * @brief Measures single experiment GETs, serialized to JSON the way the handler answers
+ * them, with and without the JSON kept by the versioned backend, for several read/write mixes.
+ */
+void benchmarkSerializedCache()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 10000;
+    int operations = 200000;
+
+    writeExperimentsFile(jsonFilename, count);
+    map<string, Experiment> experiments = loadFromFile<Experiment>(jsonFilename);
+    remove(jsonFilename.c_str());
+
+    vector<pair<string, int>> mixes = {{"100/0", 100}, {"95/5", 95}, {"50/50", 50}};
+
+    cout << "== Single GETs with and without the JSON cache, " << count << " experiments" << endl;
+    printf("%-8s %-6s %12s %12s\n", "cache", "mix", "ops/sec", "GET (us)");
+
+    for (bool cacheSerialized : {false, true})
+    {
+        for (pair<string, int> mix : mixes)
+        {
+            Repository<Experiment> repository;
+            repository.setCacheSerialized(cacheSerialized);
+            repository.assign(map<string, Experiment>(experiments));
+
+            // Warm the cache the way a running server would have.
+            string json;
+            for (int i = 0; i < count; i++)
+                repository.getJson("exp_" + to_string(i), json);
+
+            Experiment changed = repository.at("exp_0");
+            long gets = 0;
+            double getSeconds = 0;
+            double seconds = timeSeconds([&]
+            {
+                for (int i = 0; i < operations; i++)
+                {
+                    string id = "exp_" + to_string((i * 7919LL) % count);
+                    if (i % 100 < mix.second)
+                    {
+                        getSeconds += timeSeconds([&] { repository.getJson(id, json); });
+                        gets++;
+                    }
+                    else
+                        repository.put(id, changed);
+                }
+            });
+
+            printf("%-8s %-6s %12.0f %12.2f\n", cacheSerialized ? "on" : "off", mix.first.c_str(), operations / seconds,
+                getSeconds / gets * 1e6);
+        }
+    }
+}
+
+/**
+ * @brief Measures list GETs of the whole experiment collection with and without the list
+ * the repository keeps between changes, for several rates of writes between polls.
+ */
+void benchmarkCollectionCache()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 20000;
+    int polls = 50;
+
+    writeExperimentsFile(jsonFilename, count);
+    map<string, Experiment> experiments = loadFromFile<Experiment>(jsonFilename);
+    remove(jsonFilename.c_str());
+
+    vector<pair<string, int>> writeRates = {{"none", 0}, {"1/10", 10}, {"1/1", 1}};
+
+    cout << "== List GETs of " << count << " experiments with and without the list cache" << endl;
+    printf("%-8s %-8s %12s %12s\n", "cache", "writes", "GET (ms)", "polls/sec");
+
+    for (bool cacheSerialized : {false, true})
+    {
+        for (pair<string, int> writeRate : writeRates)
+        {
+            Repository<Experiment> repository;
+            repository.setCacheSerialized(cacheSerialized);
+            repository.assign(map<string, Experiment>(experiments));
+
+            Experiment changed = repository.at("exp_0");
+            string json;
+            repository.getAllJson(json);
+            double getSeconds = 0;
+            for (int i = 0; i < polls; i++)
+            {
+                if (writeRate.second != 0 && i % writeRate.second == 0)
+                    repository.put("exp_" + to_string((i * 7919LL) % count), changed);
+                getSeconds += timeSeconds([&] { repository.getAllJson(json); });
+            }
+
+            printf("%-8s %-8s %12.3f %12.0f\n", cacheSerialized ? "on" : "off", writeRate.first.c_str(), getSeconds / polls * 1e3,
+                polls / getSeconds);
+        }
+    }
+}
+
+/**
+ * @brief Measures serializing a list of experiments by building a crow::json::wvalue tree
+ * and dumping it, against writing the JSON straight into one reused buffer.
+ */
+void benchmarkJsonWriter()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 100000;
+    int rounds = 5;
+
+    writeExperimentsFile(jsonFilename, count);
+    map<string, Experiment> experiments = loadFromFile<Experiment>(jsonFilename);
+    remove(jsonFilename.c_str());
+
+    cout << "== Serializing " << count << " experiments as one list" << endl;
+    printf("%-8s %12s %12s\n", "path", "list (ms)", "MB/sec");
+
+    size_t bytes = 0;
+    double wvalueSeconds = 0;
+    for (int i = 0; i < rounds; i++)
+        wvalueSeconds += timeSeconds([&] {
+            crow::json::wvalue jsonList;
+            int index = 0;
+            for (const pair<const string, Experiment>& experiment : experiments)
+                jsonList[index++] = experiment.second.convertToJson();
+            bytes = jsonList.dump().size();
+        });
+    printf("%-8s %12.3f %12.1f\n", "wvalue", wvalueSeconds / rounds * 1e3, bytes * rounds / wvalueSeconds / 1e6);
+
+    string body;
+    double writerSeconds = 0;
+    for (int i = 0; i < rounds; i++)
+        writerSeconds += timeSeconds([&] {
+            body.clear();
+            JsonWriter writer(body);
+            writer.beginList();
+            for (const pair<const string, Experiment>& experiment : experiments)
+                experiment.second.writeJson(writer);
+            writer.endList();
+        });
+    printf("%-8s %12.3f %12.1f\n", "writer", writerSeconds / rounds * 1e3, body.size() * rounds / writerSeconds / 1e6);
+}
+
+/**
+ * @brief Measures list GETs of a large experiment collection sent from a copy of the list in
+ * every response against sent from a spool file, and the memory each response holds.
+ */
+void benchmarkListSpool()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 100000;
+    int polls = 20;
+
+    writeExperimentsFile(jsonFilename, count);
+    Repository<Experiment> repository;
+    repository.assign(loadFromFile<Experiment>(jsonFilename));
+    remove(jsonFilename.c_str());
+
+    cout << "== List GETs of " << count << " experiments from memory and from a spool file" << endl;
+    printf("%-8s %12s %12s %16s\n", "path", "first (ms)", "GET (ms)", "held (bytes)");
+
+    string json;
+    double firstSeconds = timeSeconds([&] { repository.getAllJson(json); });
+    double getSeconds = 0;
+    for (int i = 0; i < polls; i++)
+        getSeconds += timeSeconds([&] { json.clear(); repository.getAllJson(json); });
+    printf("%-8s %12.3f %12.3f %16zu\n", "memory", firstSeconds * 1e3, getSeconds / polls * 1e3, json.size());
+
+    ListSpool spool("labFlowBenchmark.list", 1048576);
+    function<void(const function<void(const string&)>&)> writeList = [&repository](const function<void(const string&)>& write) {
+        repository.writeAllJson(write, ListSpool::chunkBytes);
+    };
+    crow::response res;
+    firstSeconds = timeSeconds([&] { res = spool.respond("experiments", repository.getVersion(), writeList); });
+    getSeconds = 0;
+    for (int i = 0; i < polls; i++)
+        getSeconds += timeSeconds([&] { res = spool.respond("experiments", repository.getVersion(), writeList); });
+    printf("%-8s %12.3f %12.3f %16zu\n", "spool", firstSeconds * 1e3, getSeconds / polls * 1e3, ListSpool::chunkBytes);
+}
+
+/**
+ * @brief Measures a GET of experiments sorted by cost: sorting and sending the whole
+ * collection, against sending one page of the sorted list kept between changes.
+ */
+void benchmarkPagination()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 100000;
+    int polls = 20;
+    size_t limit = 50;
+
+    writeExperimentsFile(jsonFilename, count);
+    Repository<Experiment> repository;
+    repository.assign(loadFromFile<Experiment>(jsonFilename));
+    remove(jsonFilename.c_str());
+
+    cout << "== GETs of " << count << " experiments sorted by cost, whole or " << limit << " at a time" << endl;
+    printf("%-8s %12s %12s\n", "path", "GET (ms)", "bytes");
+
+    size_t bytes = 0;
+    double wholeSeconds = 0;
+    for (int i = 0; i < polls; i++)
+        wholeSeconds += timeSeconds([&] {
+            vector<pair<string, Experiment>> sorted = repository.snapshot();
+            sort(sorted.begin(), sorted.end(), [](const pair<string, Experiment>& a, const pair<string, Experiment>& b) { return a.second.getCost() < b.second.getCost(); });
+            string body;
+            JsonWriter writer(body);
+            writer.beginList();
+            for (const pair<string, Experiment>& keyValuePair : sorted)
+                keyValuePair.second.writeJson(writer);
+            writer.endList();
+            bytes = body.size();
+        });
+    printf("%-8s %12.3f %12zu\n", "whole", wholeSeconds / polls * 1e3, bytes);
+
+    // Walk the pages from the middle of the list on, following each page's cursor.
+    function<SortKey(const Experiment&)> sortKey = [](const Experiment& experiment) { return SortKey{experiment.getCost(), ""}; };
+    shared_ptr<const vector<SortedId>> sorted = repository.getSorted("cost", sortKey);
+    string cursor = PageRequest::makeCursor("cost", (*sorted)[sorted->size() / 2]);
+    double pageSeconds = 0;
+    for (int i = 0; i < polls; i++)
+        pageSeconds += timeSeconds([&] {
+            PageRequest page;
+            page.parse(crow::query_string("?limit=" + to_string(limit) + "&cursor=" + cursor));
+            crow::response res = sortedPageResponse(repository, "cost", *repository.getSorted("cost", sortKey), page);
+            cursor = res.get_header_value("X-Next-Cursor");
+            bytes = res.body.size();
+        });
+    printf("%-8s %12.3f %12zu\n", "page", pageSeconds / polls * 1e3, bytes);
+}
+
+/**
+ * @brief Measures writing a list of every experiment whole against writing only the fields a
+ * list view needs, through the same path as a GET with fields.
+ */
+void benchmarkFieldMask()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 100000;
+    int rounds = 5;
+
+    writeExperimentsFile(jsonFilename, count);
+    Repository<Experiment> repository;
+    repository.assign(loadFromFile<Experiment>(jsonFilename));
+    remove(jsonFilename.c_str());
+
+    cout << "== Writing " << count << " experiments whole and with fields=experimentId,title,approvalStatus" << endl;
+    printf("%-8s %12s %12s\n", "path", "list (ms)", "bytes");
+
+    size_t bytes = 0;
+    double wholeSeconds = 0;
+    for (int i = 0; i < rounds; i++)
+        wholeSeconds += timeSeconds([&] {
+            string body;
+            JsonWriter writer(body);
+            writer.beginList();
+            repository.scan([&writer](const string& id, const Experiment& experiment) { experiment.writeJson(writer); });
+            writer.endList();
+            bytes = body.size();
+        });
+    printf("%-8s %12.3f %12zu\n", "whole", wholeSeconds / rounds * 1e3, bytes);
+
+    PageRequest page;
+    FieldMask fields;
+    fields.parse("experimentId,title,approvalStatus");
+    page.setFields(fields);
+    double fieldsSeconds = 0;
+    for (int i = 0; i < rounds; i++)
+        fieldsSeconds += timeSeconds([&] {
+            crow::response res = sortedPageResponse(repository, "id", *repository.getSorted("id", nullptr), page);
+            bytes = res.body.size();
+        });
+    printf("%-8s %12.3f %12zu\n", "fields", fieldsSeconds / rounds * 1e3, bytes);
+}
+
+/**
+ * @brief Measures sending a list of experiments as JSON against translating that JSON to
+ * MessagePack and CBOR, and the size of each body.
+ */
+void benchmarkBodyFormats()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 100000;
+    int rounds = 5;
+
+    writeExperimentsFile(jsonFilename, count);
+    map<string, Experiment> experiments = loadFromFile<Experiment>(jsonFilename);
+    remove(jsonFilename.c_str());
+
+    cout << "== Encoding " << count << " experiments as one list in each body format" << endl;
+    printf("%-8s %12s %12s\n", "format", "encode (ms)", "bytes");
+
+    string json;
+    double jsonSeconds = 0;
+    for (int i = 0; i < rounds; i++)
+        jsonSeconds += timeSeconds([&] {
+            json.clear();
+            JsonWriter writer(json);
+            writer.beginList();
+            for (const pair<const string, Experiment>& experiment : experiments)
+                experiment.second.writeJson(writer);
+            writer.endList();
+        });
+    printf("%-8s %12.3f %12zu\n", "json", jsonSeconds / rounds * 1e3, json.size());
+
+    // Binary bodies are translated from the JSON, which a list GET usually has cached.
+    vector<pair<string, BodyFormat>> formats = {{"msgpack", BodyFormat::MessagePack}, {"cbor", BodyFormat::Cbor}};
+    for (pair<string, BodyFormat>& format : formats)
+    {
+        string encoded;
+        double encodeSeconds = 0;
+        for (int i = 0; i < rounds; i++)
+            encodeSeconds += timeSeconds([&] {
+                encoded.clear();
+                encodeJsonBody(json, format.second, encoded);
+            });
+        printf("%-8s %12.3f %12zu\n", format.first.c_str(), encodeSeconds / rounds * 1e3, encoded.size());
+    }
+}
+
+/**
+ * @brief Measures importing experiments one create at a time against one NDJSON import,
+ * with the default group commit log.
+ *
+ * A create parses, stores and logs one experiment and waits for its fsync; an import does
+ * the same for a batch at a time.
+ */
+void benchmarkImport()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    string logFilename = "labFlowBenchmark.wal";
+    int count = 5000;
+
+    writeExperimentsFile(jsonFilename, count);
+    map<string, Experiment> experiments = loadFromFile<Experiment>(jsonFilename);
+    remove(jsonFilename.c_str());
+
+    vector<string> lines;
+    string body;
+    for (const pair<const string, Experiment>& experiment : experiments)
+    {
+        lines.push_back(toJsonString(experiment.second));
+        body += lines.back() + "\n";
+    }
+
+    cout << "== Importing " << count << " experiments" << endl;
+    printf("%-10s %12s %10s\n", "method", "time (ms)", "fsyncs");
+
+    auto run = [&](const char* method, function<void(Repository<Experiment>&, WriteAheadLog&, ChangeTracker&)> import) {
+        remove(logFilename.c_str());
+        Repository<Experiment> repository;
+        WriteAheadLog log;
+        ChangeTracker tracker;
+        log.open(logFilename, WriteAheadLog::Durability::GroupCommit);
+        double seconds = timeSeconds([&] { import(repository, log, tracker); });
+        printf("%-10s %12.3f %10llu\n", method, seconds * 1e3, (unsigned long long)log.getSyncCount());
+        log.close();
+    };
+
+    run("creates", [&lines](Repository<Experiment>& repository, WriteAheadLog& log, ChangeTracker& tracker) {
+        for (const string& line : lines)
+        {
+            json::rvalue readValueJson = json::load(line);
+            Experiment experiment{readValueJson};
+            shared_lock<shared_mutex> mutationLock = log.lockForMutation();
+            repository.put(experiment.getId(), experiment);
+            log.append({"experiments", LogOperation::Put, experiment.getId(), toJsonString(experiment)});
+            tracker.markChanged("experiments", experiment.getId());
+        }
+    });
+    run("import", [&body](Repository<Experiment>& repository, WriteAheadLog& log, ChangeTracker& tracker) {
+        importFromNdjson<Experiment>(body, repository, "experiments", log, tracker, 1000);
+    });
+
+    remove(logFilename.c_str());
+}
+
+/**
+ * @brief Measures searching experiments by title and description, compiling the regex for
+ * every experiment as the search handlers did, against compiling the pattern once through
+ * the cache, for a literal pattern and a regex.
+ */
+void benchmarkSearchPattern()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    vector<pair<string, string>> patterns = {{"literal", "experiment 4242"}, {"regex", "experiment 42.2$"}};
+
+    cout << "== Searching experiments by title and description" << endl;
+    printf("%-8s %10s %14s %12s %8s\n", "pattern", "objects", "per object (ms)", "cached (ms)", "found");
+
+    for (int count : {1000, 10000, 100000})
+    {
+        writeExperimentsFile(jsonFilename, count);
+        Repository<Experiment> repository;
+        repository.assign(loadFromFile<Experiment>(jsonFilename));
+        remove(jsonFilename.c_str());
+
+        for (pair<string, string>& pattern : patterns)
+        {
+            size_t found = 0;
+            double perObjectSeconds = timeSeconds([&] {
+                repository.scan([&](const string& id, const Experiment& experiment) {
+                    regex compiled(pattern.second, regex_constants::icase);
+                    if (regex_search(experiment.getTitle(), compiled) || regex_search(experiment.getDescription(), compiled))
+                        found++;
+                });
+            });
+
+            size_t cachedFound = 0;
+            double cachedSeconds = timeSeconds([&] {
+                shared_ptr<const SearchPattern> compiled = compileSearchPattern(pattern.second);
+                repository.scan([&](const string& id, const Experiment& experiment) {
+                    if (compiled->matches(experiment.getTitle()) || compiled->matches(experiment.getDescription()))
+                        cachedFound++;
+                });
+            });
+
+            printf("%-8s %10d %14.3f %12.3f %8zu\n", pattern.first.c_str(), count, perObjectSeconds * 1e3, cachedSeconds * 1e3,
+                found == cachedFound ? found : 0);
+        }
+    }
+}
+
+/**
+ * @brief Measures searching experiments for a literal by scanning every experiment against
+ * checking only the candidates of trigram indexes of the title and description, with the
+ * memory the indexes take.
+ */
+void benchmarkTrigramIndex()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    vector<pair<string, string>> literals = {{"rare", "experiment 4242"}, {"common", "robotics"}};
+
+    cout << "== Searching experiments with trigram indexes" << endl;
+    printf("%-8s %10s %10s %12s %8s %12s\n", "literal", "objects", "scan (ms)", "index (ms)", "found", "index (MB)");
+
+    for (int count : {1000, 10000, 100000})
+    {
+        writeExperimentsFile(jsonFilename, count);
+        map<string, Experiment> experiments = loadFromFile<Experiment>(jsonFilename);
+        remove(jsonFilename.c_str());
+
+        Repository<Experiment> repository;
+        repository.assign(map<string, Experiment>(experiments));
+        Repository<Experiment> indexed;
+        indexed.addIndex("title", make_shared<TextIndex<Experiment>>([](const Experiment& experiment) { return experiment.getTitle(); }));
+        indexed.addIndex("description", make_shared<TextIndex<Experiment>>([](const Experiment& experiment) { return experiment.getDescription(); }));
+        indexed.assign(std::move(experiments));
+
+        for (pair<string, string>& literal : literals)
+        {
+            SearchPattern pattern(literal.second);
+            auto matches = [&pattern](const Experiment& experiment) { return pattern.matches(experiment.getTitle()) || pattern.matches(experiment.getDescription()); };
+
+            size_t scanned = 0;
+            double scanSeconds = timeSeconds([&] {
+                scanMatches<Experiment>(repository, {"title", "description"}, pattern, matches, [&scanned](const string&, const Experiment&) { scanned++; });
+            });
+
+            size_t found = 0;
+            double indexSeconds = timeSeconds([&] {
+                scanMatches<Experiment>(indexed, {"title", "description"}, pattern, matches, [&found](const string&, const Experiment&) { found++; });
+            });
+
+            printf("%-8s %10d %10.3f %12.3f %8zu %12.1f\n", literal.first.c_str(), count, scanSeconds * 1e3, indexSeconds * 1e3,
+                found == scanned ? found : 0, indexed.getIndexBytes() / 1048576.0);
+        }
+    }
+}
+
+/**
+ * @brief Measures ranked searches of texts of experiment size: the top 10 kept in a bounded
+ * heap with MaxScore pruning, against ranking every text holding a query word, for a rare
+ * word, a common word and several words, with the time to build the index and its memory.
+ */
+void benchmarkRankedSearch()
+{
+    // Words are drawn from a vocabulary with a skewed distribution, the way words of titles
+    // and descriptions are: a few are in most texts and most are in a few.
+    vector<string> vocabulary;
+    for (int i = 0; i < 20000; i++)
+        vocabulary.push_back("w" + to_string(i));
+    vector<pair<string, string>> queries = {{"rare", "w15000"}, {"common", "w1"}, {"mixed", "w1 w40 w900 w15000"}};
+
+    cout << "== Ranked search with BM25" << endl;
+    printf("%-8s %10s %10s %12s %12s %8s %12s\n", "query", "texts", "build (s)", "top 10 (ms)", "all (ms)", "matches", "index (MB)");
+
+    for (int count : {10000, 100000, 1000000})
+    {
+        FullTextIndex index;
+        uint32_t seed = 42;
+        double buildSeconds = timeSeconds([&] {
+            for (int i = 0; i < count; i++)
+            {
+                string text = "Generated experiment " + to_string(i);
+                for (int word = 0; word < 12; word++)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    double uniform = ((seed >> 8) & 0xffff) / 65536.0;
+                    text += " " + vocabulary[static_cast<size_t>(vocabulary.size() * uniform * uniform * uniform)];
+                }
+                index.add("exp_" + to_string(i), text);
+            }
+        });
+
+        for (pair<string, string>& query : queries)
+        {
+            vector<RankedId> best;
+            double topSeconds = timeSeconds([&] {
+                for (int run = 0; run < 10; run++)
+                    best = index.rank(query.second, 10);
+            }) / 10;
+
+            vector<RankedId> every;
+            double allSeconds = timeSeconds([&] { every = index.rank(query.second, count); });
+
+            bool same = best.size() == min<size_t>(10, every.size());
+            for (size_t i = 0; same && i < best.size(); i++)
+                same = best[i].id == every[i].id;
+            printf("%-8s %10d %10.2f %12.3f %12.3f %8zu %12.1f\n", query.first.c_str(), count, buildSeconds, topSeconds * 1e3, allSeconds * 1e3,
+                same ? every.size() : 0, index.memoryBytes() / 1048576.0);
+        }
+    }
+}
+
+/**
+ * @brief Measures a page of experiments sorted by cost after each write, sorted again from
+ * the whole collection against walked from a maintained SortedIndex.
+ *
+ * Every write changes the version of the repository, so the sorted list getSorted caches is
+ * thrown away and the next GET sorts every experiment again.
+ */
+void benchmarkSortedIndex()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int writes = 20;
+    size_t limit = 50;
+    function<SortKey(const Experiment&)> sortKey = [](const Experiment& experiment) { return SortKey{experiment.getCost(), ""}; };
+
+    cout << "== GETs of experiments sorted by cost, each after a write" << endl;
+    printf("%-8s %10s %12s %12s %12s\n", "path", "count", "page (ms)", "whole (ms)", "index (MB)");
+
+    for (int count : {1000, 10000, 100000})
+    {
+        writeExperimentsFile(jsonFilename, count);
+        Repository<Experiment> repository;
+        repository.assign(loadFromFile<Experiment>(jsonFilename));
+        remove(jsonFilename.c_str());
+        Experiment changed;
+        repository.get("exp_0", changed);
+
+        // Each GET follows a write, and asks for a page from the middle of the list or the whole list.
+        auto measure = [&](size_t pageLimit) {
+            double seconds = 0;
+            for (int i = 0; i < writes; i++)
+            {
+                changed.setCost(i * 7919 % count);
+                repository.put(changed.getId(), changed);
+                seconds += timeSeconds([&] {
+                    PageRequest page;
+                    string cursor = PageRequest::makeCursor("cost", SortedId{SortKey{count / 2.0, ""}, ""});
+                    page.parse(crow::query_string(pageLimit > 0 ? "?limit=" + to_string(pageLimit) + "&cursor=" + cursor : ""));
+                    sortedResponse(repository, "cost", sortKey, page);
+                });
+            }
+            return seconds / writes;
+        };
+
+        double pageSeconds = measure(limit);
+        double wholeSeconds = measure(0);
+        printf("%-8s %10d %12.3f %12.3f %12s\n", "sort", count, pageSeconds * 1e3, wholeSeconds * 1e3, "-");
+
+        shared_ptr<SortedIndex<Experiment>> index = make_shared<SortedIndex<Experiment>>(sortKey);
+        repository.addIndex(sortedIndexName("cost"), index);
+        pageSeconds = measure(limit);
+        wholeSeconds = measure(0);
+        printf("%-8s %10d %12.3f %12.3f %12.1f\n", "index", count, pageSeconds * 1e3, wholeSeconds * 1e3, index->memoryBytes() / 1048576.0);
+    }
+}
+
+/**
+ * @brief Measures filtering experiments by a cost range, checking every experiment against
+ * walking the range in the SortedIndex of the cost order.
+ */
+void benchmarkRangeFilter()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int count = 100000;
+    int polls = 20;
+    function<SortKey(const Experiment&)> sortKey = [](const Experiment& experiment) { return SortKey{experiment.getCost(), ""}; };
+
+    writeExperimentsFile(jsonFilename, count);
+    Repository<Experiment> repository;
+    repository.assign(loadFromFile<Experiment>(jsonFilename));
+    remove(jsonFilename.c_str());
+
+    // Costs are spread evenly from 0 to 5000.
+    vector<pair<string, pair<double, double>>> ranges = {{"0.1%", {1000, 1005}}, {"10%", {1000, 1500}}, {"50%", {2500, 5000}}};
+
+    cout << "== Filters of " << count << " experiments by a cost range" << endl;
+    printf("%-8s %-6s %12s %12s %10s\n", "path", "range", "page (ms)", "whole (ms)", "matches");
+
+    for (string path : {"scan", "index"})
+    {
+        if (path == "index")
+            repository.addIndex(sortedIndexName("cost"), make_shared<SortedIndex<Experiment>>(sortKey));
+
+        for (pair<string, pair<double, double>>& range : ranges)
+        {
+            size_t matches = 0;
+            auto measure = [&](const string& query) {
+                PageRequest page;
+                page.parse(crow::query_string(query));
+                return timeSeconds([&] {
+                    for (int i = 0; i < polls; i++)
+                    {
+                        PageCollector<Experiment> found(page);
+                        matches = 0;
+                        scanRange<Experiment>(repository, "cost", sortKey, range.second.first, range.second.second, page, [&](const string& id, const Experiment& experiment) {
+                            found.add(id, experiment);
+                            matches++;
+                        });
+                        found.respond();
+                    }
+                }) / polls;
+            };
+
+            double pageSeconds = measure("?limit=50");
+            double wholeSeconds = measure("");
+            printf("%-8s %-6s %12.3f %12.3f %10zu\n", path.c_str(), range.first.c_str(), pageSeconds * 1e3, wholeSeconds * 1e3, matches);
+        }
+    }
+}
+
+/**
+ * @brief Measures a page of experiments filtered by approval status, with the count of every
+ * match, checking every experiment against reading the bitmaps of the approval status.
+ */
+void benchmarkBitmapFilter()
+{
+    string jsonFilename = "labFlowBenchmarkExperiments.json";
+    int polls = 20;
+    size_t limit = 50;
+    function<string(const Experiment&)> approval = [](const Experiment& experiment) { return experiment.isApproved() ? "true" : "false"; };
+    vector<pair<string, BitmapQuery>> queries = {{"true", BitmapQuery{{"true"}, {}}}, {"false", BitmapQuery{{"false"}, {}}}};
+
+    cout << "== Pages of " << limit << " experiments filtered by approval status, with their count" << endl;
+    printf("%-8s %-6s %10s %12s %10s %12s\n", "path", "value", "count", "page (ms)", "matches", "index (MB)");
+
+    for (int count : {10000, 100000, 1000000})
+    {
+        writeExperimentsFile(jsonFilename, count);
+        Repository<Experiment> repository;
+        repository.assign(loadFromFile<Experiment>(jsonFilename));
+        remove(jsonFilename.c_str());
+
+        // Each page starts from the middle of the ids, as a client paging through would.
+        PageRequest page;
+        page.parse(crow::query_string("?limit=" + to_string(limit) + "&cursor=" + PageRequest::makeCursor("id", SortedId{SortKey(), "exp_5"})));
+
+        shared_ptr<AttributeIndex<Experiment>> index;
+        for (string path : {"scan", "bitmap"})
+        {
+            if (path == "bitmap")
+            {
+                index = make_shared<AttributeIndex<Experiment>>(approval);
+                repository.addIndex(attributeIndexName("approvalstatus"), index);
+            }
+
+            for (pair<string, BitmapQuery>& query : queries)
+            {
+                size_t total = 0;
+                double seconds = timeSeconds([&] {
+                    for (int i = 0; i < polls; i++)
+                    {
+                        PageCollector<Experiment> found(page);
+                        total = scanAttribute<Experiment>(repository, "approvalstatus", approval, query.second, page, [&found](const string& id, const Experiment& experiment) { found.add(id, experiment); });
+                        found.respond();
+                    }
+                }) / polls;
+                if (index)
+                    printf("%-8s %-6s %10d %12.3f %10zu %12.1f\n", path.c_str(), query.first.c_str(), count, seconds * 1e3, total, index->memoryBytes() / 1048576.0);
+                else
+                    printf("%-8s %-6s %10d %12.3f %10zu %12s\n", path.c_str(), query.first.c_str(), count, seconds * 1e3, total, "-");
+            }
+        }
+    }
+}
+
+/**
+ * @brief Measures write-ahead log appends per second at each durability level.
+ *
+ * Every thread appends experiment-sized records as fast as it can, the way concurrent
+ * handlers would. With group commit, concurrent appends share fsync calls.
+ */
+void benchmarkWriteAheadLog()
+{
+    string filename = "labFlowBenchmark.wal";
+    string payload(400, 'x');
+
+    vector<pair<string, WriteAheadLog::Durability>> durabilities = {
+        {"none", WriteAheadLog::Durability::None},
+        {"group", WriteAheadLog::Durability::GroupCommit},
+        {"sync", WriteAheadLog::Durability::Sync}};
+
+    cout << "== Write-ahead log appends" << endl;
+    printf("%-8s %8s %10s %12s %10s\n", "level", "threads", "records", "writes/sec", "fsyncs");
+
+    for (pair<string, WriteAheadLog::Durability> durability : durabilities)
+    {
+        for (int threadCount : {1, 8, 32})
+        {
+            remove(filename.c_str());
+            WriteAheadLog log;
+            log.open(filename, durability.second);
+
+            int recordsPerThread = durability.second == WriteAheadLog::Durability::Sync ? 200 : 2000;
+            double seconds = timeSeconds([&]
+            {
+                vector<thread> threads;
+                for (int t = 0; t < threadCount; t++)
+                {
+                    threads.emplace_back([&, t]
+                    {
+                        for (int i = 0; i < recordsPerThread; i++)
+                            log.append({"experiments", LogOperation::Put, "exp_" + to_string(t) + "_" + to_string(i), payload});
+                    });
+                }
+                for (thread& worker : threads)
+                    worker.join();
+            });
+
+            int records = threadCount * recordsPerThread;
+            printf("%-8s %8d %10d %12.0f %10llu\n", durability.first.c_str(), threadCount, records,
+                records / seconds, (unsigned long long)log.getSyncCount());
+            log.close();
+        }
+    }
+
+    remove(filename.c_str());
+}
+
+/**
+ * @brief Runs the benchmarks named on the command line, or all of them.
+ */
+int main(int argc, char* argv[])
+{
+    map<string, function<void()>> benchmarks = {
+        {"wal", benchmarkWriteAheadLog},
+        {"loader", benchmarkLoader},
+        {"snapshot", benchmarkBinarySnapshot},
+        {"parallel", benchmarkParallelLoader},
+        {"delta", benchmarkDeltaPersistence},
+        {"repository", benchmarkRepositoryBackends},
+        {"contention", benchmarkContention},
+        {"latency", benchmarkReadLatency},
+        {"cache", benchmarkSerializedCache},
+        {"list", benchmarkCollectionCache},
+        {"json", benchmarkJsonWriter},
+        {"spool", benchmarkListSpool},
+        {"page", benchmarkPagination},
+        {"fields", benchmarkFieldMask},
+        {"binary", benchmarkBodyFormats},
+        {"import", benchmarkImport},
+        {"search", benchmarkSearchPattern},
+        {"trigram", benchmarkTrigramIndex},
+        {"rank", benchmarkRankedSearch},
+        {"sort", benchmarkSortedIndex},
+        {"range", benchmarkRangeFilter},
+        {"bitmap", benchmarkBitmapFilter}};
+
+    for (pair<const string, function<void()>>& benchmark : benchmarks)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++)
+            selected = selected || benchmark.first == argv[i];
+
+        if (selected)
+            benchmark.second();
+    }
+}
@@ -7,197 +7,267 @@
 
 #include "Lab.h"
 #include <stdexcept>
-#include <regex>
 #include "toLowerHelper.h"
+#include "WriteAheadLog.h"
+#include "ChangeTracker.h"
+#include "Repository.h"
+#include "EntityTag.h"
+#include "JsonWriter.h"
+#include "Pagination.h"
+#include "SearchPattern.h"
+#include "TrigramIndex.h"
+#include "SortedIndex.h"
+#include "BitmapIndex.h"
 
 using namespace std;
 using namespace crow;
 
-extern map<string, Lab> labsMap;
+extern Repository<Lab> labsRepository;
+extern WriteAheadLog writeAheadLog;
+extern ChangeTracker changeTracker;
 
 /**
  * @brief Searches labs with names or locations matching to the input
  * 
  * @param searchString Target string to match with names and locations of labs
+ * @param page The page of the matching labs to send, in id order.
  * @return All the labs of which names and locations matching searchString in json
  */
-response searchLabs(string searchString)
+response searchLabs(string searchString, const PageRequest& page)
 {
-    vector<Lab> found;
-    for(pair<string, Lab> keyValuePair : labsMap)
-    {
-        string target1 = keyValuePair.second.getName();
-        string target2 = keyValuePair.second.getLocation();
-        regex pattern(searchString, regex_constants::icase);
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
 
-        if (regex_search(target1, pattern) || regex_search(target2, pattern))
-            found.push_back(keyValuePair.second);
-    }
+    shared_ptr<const SearchPattern> pattern = compileSearchPattern(searchString);
+    if (!pattern)
+        return response(400, "Invalid search");
 
-    if (found.size() == 0)
-        return response(404, "Not Found");
+    // Literal patterns only check the labs whose indexed names and locations may hold them.
+    PageCollector<Lab> found(page);
+    scanMatches<Lab>(labsRepository, {"name", "location"}, *pattern,
+        [&pattern](const Lab& lab) { return pattern->matches(lab.getName()) || pattern->matches(lab.getLocation()); },
+        [&found](const string& id, const Lab& lab) { found.add(id, lab); });
 
-    // Create a new JSON write value to write to the file
-    json::wvalue jsonWriteValue;
+    if (found.empty() && !page.hasCursor())
+        return response(404, "Not Found");
 
-    int index = 0;
-    for (Lab resource : found)
-    {
-        jsonWriteValue[index] = resource.convertToJson();
-        index++;
-    }
+    return found.respond();
+}
 
-    return response(jsonWriteValue.dump());
+/**
+ * @brief Indexes the trigrams of the names and locations of labs, the fields searchLabs matches.
+ */
+void addLabSearchIndexes()
+{
+    labsRepository.addIndex("name", make_shared<TextIndex<Lab>>([](const Lab& lab) { return lab.getName(); }));
+    labsRepository.addIndex("location", make_shared<TextIndex<Lab>>([](const Lab& lab) { return lab.getLocation(); }));
 }
 
-// Comparator to sort pairs according to name.
+// Sort key of a lab's name.
 struct
 {
-    bool operator()(pair<string, Lab>& a, pair<string, Lab>& b) 
+    SortKey operator()(const Lab& lab) const
     { 
-        return a.second.getName() < b.second.getName(); 
+        return SortKey{0, lab.getName()}; 
     } 
-} comparatorName;
+} sortKeyName;
 
-// Comparator to sort pairs according to id.
+// Sort key of a lab's total budget.
 struct
 {
-    bool operator()(pair<string, Lab>& a, pair<string, Lab>& b) 
+    SortKey operator()(const Lab& lab) const
     { 
-        return a.second.getId() < b.second.getId(); 
+        return SortKey{lab.getBudget().getTotalAmount(), ""}; 
     } 
-} comparatorId;
+} sortKeyTotalAmount;
 
-// Comparator to sort pairs according to total budget.
+// Sort key of a lab's remaining budget.
 struct
 {
-    bool operator()(pair<string, Lab>& a, pair<string, Lab>& b) 
+    SortKey operator()(const Lab& lab) const
     { 
-        return a.second.getBudget().getTotalAmount() < b.second.getBudget().getTotalAmount(); 
+        return SortKey{lab.getBudget().getRemainingAmount(), ""}; 
     } 
-} comparatorTotalAmount;
+} sortKeyRemainingAmount;
 
-// Comparator to sort pairs according to remaining budget.
+// Sort key of a lab's spent budget.
 struct
 {
-    bool operator()(pair<string, Lab>& a, pair<string, Lab>& b) 
+    SortKey operator()(const Lab& lab) const
     { 
-        return a.second.getBudget().getRemainingAmount() < b.second.getBudget().getRemainingAmount(); 
+        return SortKey{lab.getBudget().getSpentAmount(), ""}; 
     } 
-} comparatorRemainingAmount;
+} sortKeySpentAmount;
 
-// Comparator to sort pairs according to spent budget.
+// Sort key of a lab's number of experiments conducted.
 struct
 {
-    bool operator()(pair<string, Lab>& a, pair<string, Lab>& b) 
+    SortKey operator()(const Lab& lab) const
     { 
-        return a.second.getBudget().getSpentAmount() < b.second.getBudget().getSpentAmount(); 
+        return SortKey{static_cast<double>(lab.getExperimentIds().size()), ""}; 
     } 
-} comparatorSpentAmount;
+} sortKeyNumExperiments;
 
-// Comparator to sort pairs according to number of experiments conducted.
+// Sort key of a lab's number of equipments.
 struct
 {
-    bool operator()(pair<string, Lab>& a, pair<string, Lab>& b) 
+    SortKey operator()(const Lab& lab) const
     { 
-        return a.second.getExperimentIds().size() < b.second.getExperimentIds().size(); 
+        return SortKey{static_cast<double>(lab.getEquipmentIds().size()), ""}; 
     } 
-} comparatorNumExperiments;
+} sortKeyNumEquipments;
 
-// Comparator to sort pairs according to number of equipments.
-struct
+/**
+ * @brief Finds the key labs are sorted by in the order a sort parameter names.
+ *
+ * @param order The sort parameter, replaced by the name of the order in lower case.
+ * @param sortKey Receives the key, or null for the id order.
+ * @return True if the order is known, false otherwise.
+ */
+bool findLabSortKey(string& order, function<SortKey(const Lab&)>& sortKey)
 {
-    bool operator()(pair<string, Lab>& a, pair<string, Lab>& b) 
-    { 
-        return a.second.getEquipmentIds().size() < b.second.getEquipmentIds().size(); 
-    } 
-} comparatorNumEquipments;
+    order = toLower(order);
+    sortKey = nullptr;
+
+    if (order == "name")
+        sortKey = sortKeyName;
+    else if (order == "id")
+        sortKey = nullptr;
+    else if (order == "totalamount")
+        sortKey = sortKeyTotalAmount;
+    else if (order == "remainingamount")
+        sortKey = sortKeyRemainingAmount;
+    else if (order == "spentamount")
+        sortKey = sortKeySpentAmount;
+    else if (order == "numexperiments")
+        sortKey = sortKeyNumExperiments;
+    else if (order == "numequipments")
+        sortKey = sortKeyNumEquipments;
+    else
+        return false;
+    return true;
+}
 
 /**
  * @brief Sorts labs by a key string
  * 
+ * Labs with the same key are sorted by id. Each order is walked from its sorted index, or
+ * sorted once per version of the labs without one, so each page only costs finding where
+ * it starts.
+ * 
  * @param sortString a string indicating the sorting criterion
- * @return a response object containing a JSON array of sorted T objects. 
- * If an unsupported sortString is provided, returns the T in their original order.
+ * @param page The page of the sorted labs to send.
+ * @return a response object containing the page of sorted labs as a JSON array,
+ * or 400 if the sortString isn't supported or the cursor is from another order.
 */
-response sortLabs(string sortString) 
+response sortLabs(string sortString, const PageRequest& page) 
 {
-    vector<pair<string, Lab>> labsToSort;
-
-    for (pair<string, Lab> keyValuePair : labsMap) 
-        labsToSort.push_back(keyValuePair);
-
-    if (toLower(sortString) == "name")
-        sort(labsToSort.begin(), labsToSort.end(), comparatorName); 
-    else if (toLower(sortString) == "id")
-        sort(labsToSort.begin(), labsToSort.end(), comparatorId); 
-    else if (toLower(sortString) == "totalamount")
-        sort(labsToSort.begin(), labsToSort.end(), comparatorTotalAmount); 
-    else if (toLower(sortString) == "remainingamount")
-        sort(labsToSort.begin(), labsToSort.end(), comparatorRemainingAmount); 
-    else if (toLower(sortString) == "spentamount")
-        sort(labsToSort.begin(), labsToSort.end(), comparatorSpentAmount); 
-    else if (toLower(sortString) == "numexperiments")
-        sort(labsToSort.begin(), labsToSort.end(), comparatorNumExperiments); 
-    else if (toLower(sortString) == "numequipments")
-        sort(labsToSort.begin(), labsToSort.end(), comparatorNumEquipments); 
-    else
+    string order = sortString;
+    function<SortKey(const Lab&)> sortKey;
+    if (!findLabSortKey(order, sortKey))
         return response(400, "Invalid sort request");
 
-    // Create a new JSON write value use to write to the file.
-    json::wvalue jsonWriteValue;
-    
-    // For each Lab in the vector, convert the T to JSON and add to the write value.
-    int index = 0;
-    for (pair<string, Lab> keyValuePair : labsToSort)
+    if (!page.fits(order))
+        return response(400, "Invalid cursor");
+
+    return sortedResponse(labsRepository, order, sortKey, page);
+}
+
+/**
+ * @brief Keeps the labs sorted in every order sortLabs offers.
+ */
+void addLabSortIndexes()
+{
+    for (string order : {"id", "name", "totalamount", "remainingamount", "spentamount", "numexperiments", "numequipments"})
     {
-        jsonWriteValue[index] = keyValuePair.second.convertToJson();
-        index++;
+        function<SortKey(const Lab&)> sortKey;
+        findLabSortKey(order, sortKey);
+        labsRepository.addIndex(sortedIndexName(order), make_shared<SortedIndex<Lab>>(sortKey));
     }
-
-    return response(jsonWriteValue.dump());
 }
 
 /**
- * @brief Filters labs that has a given minimum amount of budget of a given type
+ * @brief Filters labs whose budget has an amount of a given type in a range
+ * 
+ * The labs come from a walk of the range in the sorted index of the type when there is one.
  * 
  * @param type A string representing the type of budget information to filter by.
  * There are three valid such types: totalamount, remaniningamount, spentamount
- * @param amount A float representing the minimum budget when filtering labs
- * @return A list of all labs that has a given minimum amount of budget of a given type
+ * @param min The lowest amount of the labs to find
+ * @param max The highest amount of the labs to find
+ * @param page The page of the matching labs to send, in id order.
+ * @return A list of all labs whose budget has an amount of the given type from min to max
  */
-response filterLabs(string type, float amount)
+response filterLabs(string type, double min, double max, const PageRequest& page)
 {
-    if (toLower(type) != "totalamount" && toLower(type) != "remainingamount" && toLower(type) != "spentamount")
+    string order = type;
+    function<SortKey(const Lab&)> sortKey;
+    if (!findLabSortKey(order, sortKey) || (order != "totalamount" && order != "remainingamount" && order != "spentamount"))
         return response(400, "Invalid filter request");
 
-    vector<Lab> found;
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
+
+    PageCollector<Lab> found(page);
 
-    for (pair<string, Lab> keyValuePair : labsMap)
+    scanRange<Lab>(labsRepository, order, sortKey, min, max, page, [&found](const string& id, const Lab& lab)
     {
-        Budget budget = keyValuePair.second.getBudget();
-        if (toLower(type) == "totalamount" && budget.getTotalAmount() >= amount)
-            found.push_back(keyValuePair.second);
-        else if (toLower(type) == "remainingamount" && budget.getRemainingAmount() >= amount)
-            found.push_back(keyValuePair.second);
-        else if (toLower(type) == "spentamount" && budget.getSpentAmount() >= amount)
-            found.push_back(keyValuePair.second);
-    }
+        found.add(id, lab);
+    });
 
-    if (found.size() == 0)
+    if (found.empty() && !page.hasCursor())
         return response(404, "Not Found");
 
-    // Create a new JSON write value
-    json::wvalue jsonWriteValue;
+    return found.respond();
+}
+
+// The attribute labs are filtered by location with, without case.
+string labLocation(const Lab& lab)
+{
+    return toLower(lab.getLocation());
+}
 
-    int index = 0;
-    for (Lab lab : found)
+/**
+ * @brief Filters labs by their location
+ * 
+ * The labs and their count come from the bitmaps of the locations when there are some.
+ * 
+ * @param locations A comma separated list of locations, compared without case. A location
+ * starting with ! is excluded, e.g. "!Boston" finds the labs that are not in Boston.
+ * @param page The page of the matching labs to send, in id order.
+ * @return A list of all labs in any of the locations and none of the excluded ones, with
+ * the number of them in the X-Total-Count header
+ */
+response filterLabsByLocation(string locations, const PageRequest& page)
+{
+    BitmapQuery query = BitmapQuery::parse(toLower(locations));
+    if (query.anyOf.empty() && query.noneOf.empty())
+        return response(400, "Invalid location");
+
+    if (!page.fits("id"))
+        return response(400, "Invalid cursor");
+
+    PageCollector<Lab> found(page);
+
+    size_t total = scanAttribute<Lab>(labsRepository, "location", labLocation, query, page, [&found](const string& id, const Lab& lab)
     {
-        jsonWriteValue[index] = lab.convertToJson();
-        index++;
-    }
+        found.add(id, lab);
+    });
 
-    return response(jsonWriteValue.dump());
+    if (found.empty() && !page.hasCursor())
+        return response(404, "Not Found");
+
+    response res = found.respond();
+    res.set_header("X-Total-Count", to_string(total));
+    return res;
+}
+
+/**
+ * @brief Keeps the ids of the labs in each location as a bitmap for filterLabsByLocation.
+ */
+void addLabFilterIndexes()
+{
+    labsRepository.addIndex(attributeIndexName("location"), make_shared<AttributeIndex<Lab>>(labLocation));
 }
 
 /**
@@ -233,40 +303,75 @@ response createLab(request req)
     // Create a new Lab.
     Lab lab{readValueJson};
 
-    // Add the new Lab to the map.
-    labsMap[lab.getId()] = lab;
+    // Hold off snapshots while the repository and the log are being changed.
+    shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+    // Refuse the change if the write-ahead log can no longer record it.
+    // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+    if (writeAheadLog.hasFailed())
+        return response(503, "Write-ahead log unavailable");
+
+    // Keep other requests from changing a Lab with the same id until this one is logged and stored.
+    unique_lock<mutex> labLock = labsRepository.lockObject(lab.getId());
+
+    // Record the new Lab in the write-ahead log, then change the repository.
+    string labJson = toJsonString(lab);
+    try
+    {
+        writeAheadLog.append({"labs", LogOperation::Put, lab.getId(), labJson});
+    }
+    catch (runtime_error& exception)
+    {
+        // The log couldn't record the change, so it isn't made, and later changes are refused.
+        return response(503, "Write-ahead log unavailable");
+    }
+
+    // Add the new Lab to the repository.
+    labsRepository.put(lab.getId(), lab);
+    changeTracker.markChanged("labs", lab.getId());
 
     // Return the create Lab as a JSON string.
     // 201 Created: The request succeeded, and a new Lab was created as a result.
     // This is typically the response sent after POST requests, or some PUT requests.
-    return response(201, lab.convertToJson().dump());
+    return response(201, labJson);
 }
 
 /**
  * @brief Read a specific Lab.
  * 
  * This method retrieves a Lab identified by a unique ID.
+ * With fields, only the requested fields are sent.
  * 
+ * @param req The HTTP request object.
  * @param id The unique identifier of the Lab.
  * @return The HTTP response object containing the lab of the unique ID.
  * 404 Not Found when the requested lab cannot be find
  */
-response readLab(string id) 
+response readLab(request req, string id) 
 {
-    try 
+    // With fields, serialize only the requested fields instead of sending the kept JSON.
+    FieldMask fields;
+    if (!fields.parse(req.url_params.get("fields")))
+        return response(400, "Invalid fields");
+    if (!fields.isEmpty())
     {
-        // Get the Lab from the Lab map.
-        Lab lab = labsMap.at(id);
+        Lab lab;
+        if (!labsRepository.get(id, lab))
+            return response(404, "Lab Not Found");
+        return response(toJsonString(lab, &fields));
+    }
 
-        // Return the Lab as a JSON string.
-        return response(lab.convertToJson().dump());
-    } 
-    catch (out_of_range& exception) 
+    // Get the Lab as JSON from the repository, which keeps it serialized between changes.
+    string labJson;
+    if (!labsRepository.getJson(id, labJson))
     {
-        // If the Lab was not found in the map return a 404 not found error.
+        // If the Lab was not found in the repository return a 404 not found error.
         // 404 Not Found: The server cannot find the requested Lab.
         return response(404, "Lab Not Found");
     }
+
+    // Return the Lab as a JSON string.
+    return response(labJson);
 }
 
 /**
@@ -274,47 +379,61 @@ response readLab(string id)
  * This method retrieves a Lab identified by a unique ID.
  * 
  * @param req The HTTP request object with a requested operation specified
- * There are three valid operations that a user can request: search, sort, filter
+ * There are four valid operations that a user can request: search, sort, filter, location
  * 1. search: searches labs with a given target name or location
  * 2. sort: sorts labs with a given target criterion
- * 3. filter: filters labs with a given minimum amount and a type of budget
+ * 3. filter: filters labs with an amount of a type of budget from min (or amount) to max
+ * 4. location: filters labs in any of a list of locations
+ * With limit, only that many labs are sent, and cursor picks up where the previous page ended.
  * @return The HTTP response object containing all labs that applies
  */
 response readAllLabs(request req) 
 {
+    PageRequest page;
+    if (!page.parse(req.url_params))
+        return response(400, "Invalid limit or cursor");
+
+    FieldMask fields;
+    if (!fields.parse(req.url_params.get("fields")))
+        return response(400, "Invalid fields");
+    page.setFields(fields);
+
     if (req.url_params.get("search"))
-        return searchLabs(req.url_params.get("search"));
+        return searchLabs(req.url_params.get("search"), page);
 
     if (req.url_params.get("sort"))
-        return sortLabs(req.url_params.get("sort"));
+        return sortLabs(req.url_params.get("sort"), page);
+
+    if (req.url_params.get("location"))
+        return filterLabsByLocation(req.url_params.get("location"), page);
 
-    if (req.url_params.get("amount") && req.url_params.get("type"))
+    if (req.url_params.get("type") && (req.url_params.get("amount") || req.url_params.get("min") || req.url_params.get("max")))
     {
+        double min, max;
         try 
         {
-            float amount = stof(req.url_params.get("amount"));
-            return filterLabs(req.url_params.get("type"), amount);
-        } catch (invalid_argument& exception)
+            readRange(req.url_params, "amount", min, max);
+        } catch (logic_error& exception)
         {
-            cerr << "Can't convert the amount to float type. Invalid argument!" << endl;
+            cerr << "Can't convert the amount to float type. Invalid argument or out of range!" << endl;
             return response(400, "Invalid request");
         }
+        return filterLabs(req.url_params.get("type"), min, max, page);
     }
 
-    // Create a new JSON write value use to write to the file.
-    json::wvalue jsonWriteValue;
-    
-    // For each Lab in the map, convert the Lab to JSON and add to the write value.
-    int index = 0;
-    for (pair<string, Lab> keyValuePair : labsMap)
+    // A page of every Lab, in id order, or every Lab with only the requested fields.
+    if (page.isPaged() || !page.getFields().isEmpty())
     {
-        // first: gives you access to the first item in the pair.
-        // second: gives you access to the second item in the pair.
-        jsonWriteValue[index] = keyValuePair.second.convertToJson();
-        index++;
+        if (!page.fits("id"))
+            return response(400, "Invalid cursor");
+        return sortedResponse<Lab>(labsRepository, "id", nullptr, page);
     }
 
-    return response(jsonWriteValue.dump());
+    // Get every Lab as one JSON list, which the repository keeps until the next change.
+    string labsJson;
+    labsRepository.getAllJson(labsJson);
+
+    return response(labsJson);
 }
 
 /**
@@ -340,8 +459,30 @@ void updateLab(request req, response& res, string id)
     
     try 
     {
-        // Get the Lab from the Lab map.
-        Lab lab = labsMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+        {
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+
+        // Get the Lab from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> labLock = labsRepository.lockObject(id);
+        Lab lab = labsRepository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older Lab.
+        // 412 Precondition Failed: the Lab changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; labsRepository.getJson(id, current); return current; }))
+        {
+            res.code = 412;
+            res.end("Precondition Failed");
+            return;
+        }
 
         // Convert the request body to JSON.
         json::rvalue readValueJson = json::load(req.body);
@@ -356,18 +497,34 @@ void updateLab(request req, response& res, string id)
 
         // Update the Lab.
         lab.updateFromJson(readValueJson);
-        labsMap[id] = lab;
+
+        // Record the updated Lab in the write-ahead log, then change the repository.
+        string labJson = toJsonString(lab);
+        try
+        {
+            writeAheadLog.append({"labs", LogOperation::Put, id, labJson});
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            res.code = 503;
+            res.end("Write-ahead log unavailable");
+            return;
+        }
+        labsRepository.put(id, lab);
+        changeTracker.markChanged("labs", id);
 
         // Return the updated Lab as a JSON string.
         // 200 OK: The request succeeded.
         res.code = 200;
         res.set_header("Content-Type", "application/json");
-        res.write(lab.convertToJson().dump());
+        res.set_header("ETag", makeEntityTag(labJson));
+        res.write(labJson);
         res.end();
     } 
     catch (out_of_range& exception) 
     {
-        // If the Lab was not found in the map return a 404 not found error.
+        // If the Lab was not found in the repository return a 404 not found error.
         res.code = 404;
         res.end("Lab Not Found");
     }
@@ -393,18 +550,44 @@ response deleteLab(request req, string id)
 
     try 
     {
-        // Get the Lab from the Lab map.
-        Lab lab = labsMap.at(id);
+        // Hold off snapshots while the repository and the log are being changed.
+        shared_lock<shared_mutex> mutationLock = writeAheadLog.lockForMutation();
+
+        // Refuse the change if the write-ahead log can no longer record it.
+        // 503 Service Unavailable: changes can't be made durable until the log is reopened.
+        if (writeAheadLog.hasFailed())
+            return response(503, "Write-ahead log unavailable");
+
+        // Get the Lab from the repository, keeping other requests from changing it meanwhile.
+        unique_lock<mutex> labLock = labsRepository.lockObject(id);
+        Lab lab = labsRepository.at(id);
+
+        // Refuse the change if the client sent If-Match with the tag of an older Lab.
+        // 412 Precondition Failed: the Lab changed since the client read it.
+        if (!ifMatchHolds(req, [&id] { string current; labsRepository.getJson(id, current); return current; }))
+            return response(412, "Precondition Failed");
+
+        // Record the deletion in the write-ahead log, then change the repository.
+        try
+        {
+            writeAheadLog.append({"labs", LogOperation::Delete, id, ""});
+        }
+        catch (runtime_error& exception)
+        {
+            // The log couldn't record the change, so it isn't made, and later changes are refused.
+            return response(503, "Write-ahead log unavailable");
+        }
 
-        // Remove the Lab from the Lab map.
-        labsMap.erase(id);
+        // Remove the Lab from the repository.
+        labsRepository.erase(id);
+        changeTracker.markDeleted("labs", id);
 
         // Return a successful code 204 which means success but no content to return.
         return response(204);
     } 
     catch (out_of_range& exception) 
     {
-        // If the Lab was not found in the map return a 404 not found error.
+        // If the Lab was not found in the repository return a 404 not found error.
         return response(404, "Lab Not Found");
     }
 }
@@ -4,16 +4,21 @@
 #include <crow.h>
 #include <map>
 #include <string>
+#include "Pagination.h"
 
 // Functions used to handle POST, GET, PUT, and DELETE requests for the Lab resource.
 crow::response createLab(crow::request req);
-crow::response readLab(std::string id);
+crow::response readLab(crow::request req, std::string id);
 crow::response readAllLabs(crow::request req);
 void updateLab(crow::request req, crow::response& res, std::string id); 
 crow::response deleteLab(crow::request req, std::string id);
-crow::response searchLabs(std::string searchString);
-crow::response filterLabs(std::string type, float amount);
-crow::response sortLabs(std::string sortString);
+crow::response searchLabs(std::string searchString, const PageRequest& page = PageRequest());
+void addLabSearchIndexes();
+crow::response filterLabs(std::string type, double min, double max, const PageRequest& page = PageRequest());
+crow::response filterLabsByLocation(std::string locations, const PageRequest& page = PageRequest());
+void addLabFilterIndexes();
+crow::response sortLabs(std::string sortString, const PageRequest& page = PageRequest());
+void addLabSortIndexes();
 
 #endif // LAB_FUNCTIONS_H 
 
@@ -0,0 +1,140 @@
+/**
+ * @file labflowConvert.cpp
+ * @brief Converts resource collections between JSON files and binary snapshots.
+ *
+ * Usage: labflow-convert <input> <output> [collection]
+ *
+ * The direction follows the file extensions: .json to .lfb imports a JSON array into a
+ * binary snapshot, .lfb to .json exports a binary snapshot as a JSON array. The collection
+ * defaults to the name of the input file, e.g. experiments.json holds "experiments".
+ * Administrators refer to their labs, so labs.json or labs.lfb must sit next to an
+ * administrators file that is converted.
+ */
+
+#include <crow.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include "Professor.h"
+#include "Administrator.h"
+#include "Student.h"
+#include "Lab.h"
+#include "Equipment.h"
+#include "Experiment.h"
+#include "FileHandlingTemplate.h"
+#include "Repository.h"
+
+using namespace std;
+
+// Administrators look up the labs they manage here.
+Repository<Lab> labsRepository;
+
+/**
+ * @brief Gets the extension of a file name.
+ *
+ * @param filename The file name.
+ * @return The extension without the dot, or an empty string.
+ */
+string extensionOf(string filename)
+{
+    size_t dot = filename.find_last_of('.');
+    size_t slash = filename.find_last_of('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash))
+        return "";
+    return filename.substr(dot + 1);
+}
+
+/**
+ * @brief Gets a file name without its directory and extension.
+ *
+ * @param filename The file name.
+ * @return The bare name, e.g. "experiments" for "data/experiments.json".
+ */
+string stemOf(string filename)
+{
+    size_t slash = filename.find_last_of('/');
+    string name = slash == string::npos ? filename : filename.substr(slash + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
+
+/**
+ * @brief Converts one collection file to the other format.
+ *
+ * @tparam T The type of the objects in the collection.
+ * @param input The file to read.
+ * @param output The file to write.
+ * @param collection The name of the collection.
+ * @return True if the output was written, false otherwise.
+ */
+template <typename T>
+bool convert(string input, string output, string collection)
+{
+    map<string, T> data;
+    if (extensionOf(input) == "lfb")
+    {
+        if (!loadFromBinarySnapshot<T>(input, collection, data))
+        {
+            cerr << input << " is not a binary snapshot of " << collection << "." << endl;
+            return false;
+        }
+    }
+    else
+    {
+        data = loadFromFile<T>(input);
+    }
+
+    bool saved = extensionOf(output) == "lfb" ? saveToBinarySnapshot<T>(data, output, collection) : saveToFile<T>(data, output);
+    if (saved)
+        cout << "Converted " << data.size() << " " << collection << " from " << input << " to " << output << "." << endl;
+    return saved;
+}
+
+/**
+ * @brief Entry point for the conversion tool.
+ *
+ * @return int Exit status, 0 if the output was written.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || argc > 4)
+    {
+        cerr << "Usage: labflow-convert <input> <output> [collection]" << endl;
+        return 2;
+    }
+
+    string input = argv[1];
+    string output = argv[2];
+    string collection = argc == 4 ? argv[3] : stemOf(input);
+
+    if ((extensionOf(input) != "json" && extensionOf(input) != "lfb") || (extensionOf(output) != "json" && extensionOf(output) != "lfb"))
+    {
+        cerr << "Files must end in .json or .lfb." << endl;
+        return 2;
+    }
+
+    // Administrators need the labs they manage to be loaded first.
+    if (collection == "administrators")
+    {
+        size_t slash = input.find_last_of('/');
+        string directory = slash == string::npos ? "" : input.substr(0, slash + 1);
+        labsRepository.assign(loadCollection<Lab>(directory + "labs"));
+    }
+
+    bool converted = false;
+    if (collection == "professors")
+        converted = convert<Professor>(input, output, collection);
+    else if (collection == "students")
+        converted = convert<Student>(input, output, collection);
+    else if (collection == "administrators")
+        converted = convert<Administrator>(input, output, collection);
+    else if (collection == "labs")
+        converted = convert<Lab>(input, output, collection);
+    else if (collection == "equipments")
+        converted = convert<Equipment>(input, output, collection);
+    else if (collection == "experiments")
+        converted = convert<Experiment>(input, output, collection);
+    else
+        cerr << "Unknown collection " << collection << "." << endl;
+
+    return converted ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "ListSpool.h"
+
+using namespace std;
+using namespace crow;
+
+// Reads a whole file, or returns an empty string if it doesn't exist.
+static string readFile(const string& filename)
+{
+    ifstream file(filename, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+TEST_CASE("Sending lists from memory or from spool files.") 
+{
+    int builds = 0;
+    vector<string> pieces = {"[{\"id\":1}", ",{\"id\":2}", ",{\"id\":3}]"};
+    function<void(const function<void(const string&)>&)> writeList = [&](const function<void(const string&)>& write)
+    {
+        builds++;
+        for (const string& piece : pieces)
+            write(piece);
+    };
+
+    SUBCASE("A short list is kept in memory")
+    {
+        ListSpool spool("listSpoolTest.list", 1024);
+        response first = spool.respond("numbers", 1, writeList);
+        response second = spool.respond("numbers", 1, writeList);
+
+        // Check the results: the list is built once and sent from memory.
+        CHECK(first.body == R"([{"id":1},{"id":2},{"id":3}])");
+        CHECK(second.body == first.body);
+        CHECK(first.file_info.path.empty());
+        CHECK(builds == 1);
+        CHECK(ListSpool::listSpoolFiles("listSpoolTest.list").empty());
+    }
+
+    SUBCASE("A long list is sent from a spool file until the collection changes")
+    {
+        {
+            ListSpool spool("listSpoolTest.list", 12);
+            response first = spool.respond("numbers", 1, writeList);
+            response again = spool.respond("numbers", 1, writeList);
+
+            // Check the results: the list is written to one file shared by both reads.
+            CHECK(first.file_info.path == "listSpoolTest.list.numbers.1.json");
+            CHECK(readFile("listSpoolTest.list.numbers.1.json") == R"([{"id":1},{"id":2},{"id":3}])");
+            CHECK(again.file_info.path == first.file_info.path);
+            CHECK(builds == 1);
+
+            // A newer version gets a new file. The one before it stays for responses still
+            // being sent from it, until it is replaced in turn.
+            pieces = {"[{\"id\":1}", ",{\"id\":3}]"};
+            response changed = spool.respond("numbers", 2, writeList);
+            CHECK(changed.file_info.path == "listSpoolTest.list.numbers.2.json");
+            CHECK(readFile(changed.file_info.path) == R"([{"id":1},{"id":3}])");
+            CHECK(ListSpool::listSpoolFiles("listSpoolTest.list").size() == 2);
+
+            pieces = {"null"};
+            response emptied = spool.respond("numbers", 3, writeList);
+            CHECK(emptied.body == "null");
+            CHECK(emptied.file_info.path.empty());
+            CHECK(readFile("listSpoolTest.list.numbers.1.json").empty());
+            CHECK(ListSpool::listSpoolFiles("listSpoolTest.list").size() == 1);
+            CHECK(builds == 3);
+        }
+
+        // The spool files go with the spool.
+        CHECK(ListSpool::listSpoolFiles("listSpoolTest.list").empty());
+    }
+
+    SUBCASE("Spool files left by a previous server are removed")
+    {
+        ofstream("listSpoolTest.list.numbers.7.json") << "[]";
+        ofstream("listSpoolTest.list.numbers.8.json.tmp") << "[";
+        ofstream("listSpoolTest.list.conf") << "kept";
+        CHECK(ListSpool::listSpoolFiles("listSpoolTest.list").size() == 2);
+
+        ListSpool spool("listSpoolTest.list", 1024);
+        CHECK(ListSpool::listSpoolFiles("listSpoolTest.list").empty());
+        CHECK(readFile("listSpoolTest.list.conf") == "kept");
+        remove("listSpoolTest.list.conf");
+    }
+}
@@ -11,16 +11,23 @@
 #include "Equipment.h"
 #include "Experiment.h"
 #include "FileHandlingTemplate.h"
+#include "Repository.h"
+#include "WriteAheadLog.h"
+#include "ChangeTracker.h"
 
 using namespace std;
 using namespace crow;
 
-// Initialize resource maps from files
-map<string, Professor> professorsMap = loadFromFile<Professor>("professors.json");
-map<string, Student> studentsMap = loadFromFile<Student>("students.json");
-map<string, Lab> labsMap = loadFromFile<Lab>("labs.json");
-map<string, Administrator> administratorsMap = loadFromFile<Administrator>("administrators.json");
-map<string, Experiment> experimentsMap = loadFromFile<Experiment>("experiments.json");
-map<string, Equipment> equipmentsMap = loadFromFile<Equipment>("equipments.json");
+// Resource repositories, filled by loadAllResources() in main(). Users live in
+// GenericUserAPI<T>::repository.
+Repository<Lab> labsRepository;
+Repository<Experiment> experimentsRepository;
+Repository<Equipment> equipmentsRepository;
+
+// Log of every change made since the resource files were last saved
+WriteAheadLog writeAheadLog;
+
+// Ids of the resources changed since the collections were last flushed
+ChangeTracker changeTracker;
 
 #endif
\ No newline at end of file
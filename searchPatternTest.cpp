@@ -0,0 +1,66 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <memory>
+#include <string>
+#include "SearchPattern.h"
+
+using namespace std;
+
+TEST_CASE("Matching search patterns.")
+{
+    SUBCASE("Patterns without metacharacters are matched as substrings, ignoring case")
+    {
+        SearchPattern literal("RoBoT");
+        CHECK(literal.isLiteral());
+        CHECK(literal.matches("Shape formation in multi-agent robotics"));
+        CHECK(literal.matches("ROBOT"));
+        CHECK_FALSE(literal.matches("robo"));
+        CHECK_FALSE(literal.matches("A recreation of the double-slit experiment"));
+        CHECK(SearchPattern("").matches(""));
+        CHECK(SearchPattern("multi-agent robotics").matches("Shape formation in Multi-Agent Robotics"));
+        CHECK(SearchPattern("aab").matches("aaab"));
+    }
+
+    SUBCASE("Other patterns are regexes and match as they did before")
+    {
+        for (string pattern : {"^shape", "pipe.networks", "fluid|stress", "rob(ot)?ics$", "l[ao]b"})
+        {
+            CAPTURE(pattern);
+            SearchPattern compiled(pattern);
+            CHECK_FALSE(compiled.isLiteral());
+            for (string text : {"Shape formation in multi-agent robotics", "Fluid Flow in Pipe Networks", "Stress Analysis", "Quantum Lab"})
+            {
+                CAPTURE(text);
+                CHECK(compiled.matches(text) == regex_search(text, regex(pattern, regex_constants::icase)));
+            }
+        }
+        CHECK_THROWS_AS(SearchPattern("(unclosed"), regex_error);
+    }
+}
+
+TEST_CASE("Keeping the patterns used last.")
+{
+    SearchPatternCache cache(2);
+    shared_ptr<const SearchPattern> first = cache.get("robot");
+    REQUIRE(first);
+    CHECK(cache.get("robot") == first);
+    CHECK(cache.getHitCount() == 1);
+    CHECK(cache.getMissCount() == 1);
+
+    // Perform the actions: "robot" is used again before "laser", so "laser" is dropped when
+    // a third pattern comes.
+    cache.get("laser");
+    cache.get("robot");
+    cache.get("^fluid");
+
+    // Check the results
+    CHECK(cache.size() == 2);
+    CHECK(cache.get("robot") == first);
+    uint64_t misses = cache.getMissCount();
+    cache.get("laser");
+    CHECK(cache.getMissCount() == misses + 1);
+
+    // Invalid patterns are refused and not kept.
+    CHECK_FALSE(cache.get("[a-"));
+    CHECK(cache.size() == 2);
+}
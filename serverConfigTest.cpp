@@ -0,0 +1,140 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <string>
+#include <vector>
+#include "ServerConfig.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+TEST_CASE("Reading the server settings.") 
+{
+    ServerConfig config;
+    CHECK(config.getPort() == 17177);
+    CHECK(config.getSource("port") == "default");
+    CHECK(config.getWorkerThreads() > config.getCpuThreads() + config.getCpuQueue());
+
+    SUBCASE("A config file sets values and skips invalid lines")
+    {
+        ofstream file("serverConfigTest.conf");
+        file << "# LabFlow settings\n";
+        file << "port = 8080\n";
+        file << "worker_threads=12  # more than the default\n";
+        file << "cpu_affinity = 0-1,3\n";
+        file << "durability = SYNC\n";
+        file << "keep_alive_seconds = 0\n";
+        file << "unknown = 1\n";
+        file << "not a setting\n";
+        file.close();
+
+        REQUIRE(config.loadFromFile("serverConfigTest.conf"));
+        CHECK(config.getPort() == 8080);
+        CHECK(config.getSource("port") == "serverConfigTest.conf");
+        CHECK(config.getWorkerThreads() == 12);
+        CHECK(config.getCpuAffinity() == "0-1,3");
+        CHECK(config.getDurability() == "sync");
+        CHECK(config.getKeepAliveSeconds() == 5);
+        CHECK(config.getSource("keep_alive_seconds") == "default");
+        remove("serverConfigTest.conf");
+    }
+
+    SUBCASE("A missing config file keeps the defaults")
+    {
+        CHECK_FALSE(config.loadFromFile("serverConfigTest.missing"));
+        CHECK(config.getPort() == 17177);
+    }
+
+    SUBCASE("Environment variables override the config file")
+    {
+        REQUIRE(config.set("max_body_bytes", "1024", "serverConfigTest.conf"));
+        setenv("LABFLOW_MAX_BODY_BYTES", "2048", 1);
+        setenv("LABFLOW_PERSISTENCE", "sometimes", 1);
+        config.loadFromEnvironment();
+        unsetenv("LABFLOW_MAX_BODY_BYTES");
+        unsetenv("LABFLOW_PERSISTENCE");
+
+        CHECK(config.getMaxBodyBytes() == 2048);
+        CHECK(config.getSource("max_body_bytes") == "LABFLOW_MAX_BODY_BYTES");
+        CHECK(config.getPersistence() == "delta");
+    }
+
+    SUBCASE("Values out of range are refused")
+    {
+        CHECK_FALSE(config.set("port", "70000", "test"));
+        CHECK_FALSE(config.set("cpu_threads", "0", "test"));
+        CHECK_FALSE(config.set("cpu_threads", "-2", "test"));
+        CHECK_FALSE(config.set("merge_every", "12x", "test"));
+        CHECK_FALSE(config.set("search_index", "sometimes", "test"));
+        CHECK(config.set("search_index", "OFF", "test"));
+        CHECK(config.getSearchIndex() == "off");
+        CHECK(config.getSortIndex() == "on");
+        CHECK(config.set("bitmap_index", "off", "test"));
+        CHECK(config.getBitmapIndex() == "off");
+        CHECK(config.set("snapshot_seconds", "0", "test"));
+        CHECK(config.getSnapshotSeconds() == 0);
+    }
+}
+
+TEST_CASE("Parsing CPU lists.") 
+{
+    vector<int> cpus;
+    CHECK(ServerConfig::parseCpuList("", cpus));
+    CHECK(cpus.empty());
+    CHECK(ServerConfig::parseCpuList("0-2, 5", cpus));
+    CHECK(cpus == vector<int>{0, 1, 2, 5});
+    CHECK_FALSE(ServerConfig::parseCpuList("3-1", cpus));
+    CHECK_FALSE(ServerConfig::parseCpuList("a", cpus));
+    CHECK_FALSE(ServerConfig::parseCpuList("1,,2", cpus));
+}
+
+TEST_CASE("Limiting the size of request bodies.") 
+{
+    RequestLimits limits;
+    limits.maxBodyBytes = 4;
+    limits.maxImportBytes = 8;
+    RequestLimits::context ctx;
+
+    // Perform the actions: the same body sent to a create route and to an import route.
+    crow::request create;
+    create.url = "/api/labs";
+    create.body = "{\"a\":1}";
+    crow::response createResponse;
+    limits.before_handle(create, createResponse, ctx);
+
+    crow::request importRequest;
+    importRequest.url = "/api/labs/import";
+    importRequest.body = create.body;
+    crow::response importResponse;
+    limits.before_handle(importRequest, importResponse, ctx);
+
+    // Check the results
+    CHECK(createResponse.code == 413);
+    CHECK(createResponse.is_completed());
+    CHECK_FALSE(importResponse.is_completed());
+}
+
+TEST_CASE("Refusing tasks once the pool is full.") 
+{
+    ThreadPool pool(1, 2);
+    promise<void> release;
+    shared_future<void> released = release.get_future().share();
+
+    // Perform the action: hold the only thread so the tasks stay pending.
+    future<void> first;
+    future<void> second;
+    future<void> third;
+    REQUIRE(pool.trySubmit([released] { released.wait(); }, first));
+    REQUIRE(pool.trySubmit([released] { released.wait(); }, second));
+    bool refused = !pool.trySubmit([] {}, third);
+    release.set_value();
+    first.get();
+    second.get();
+
+    // Check the results
+    CHECK(refused);
+    CHECK(pool.getRejectedCount() == 1);
+}
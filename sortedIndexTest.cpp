@@ -0,0 +1,168 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SortedIndex.h"
+#include "Equipment.h"
+
+using namespace std;
+
+// The ids of a page of sorted ids.
+static vector<string> pageIds(const vector<SortedId>& sorted)
+{
+    vector<string> ids;
+    for (const SortedId& entry : sorted)
+        ids.push_back(entry.id);
+    return ids;
+}
+
+// Makes an equipment with a name.
+static Equipment makeEquipment(const string& id, const string& name)
+{
+    Equipment equipment;
+    equipment.setId(id);
+    equipment.setName(name);
+    return equipment;
+}
+
+TEST_CASE("Keeping the objects of a repository sorted.")
+{
+    Repository<Equipment> equipmentsRepository;
+    function<SortKey(const Equipment&)> sortKeyName = [](const Equipment& equipment) { return SortKey{0, equipment.getName()}; };
+    shared_ptr<SortedIndex<Equipment>> byName = make_shared<SortedIndex<Equipment>>(sortKeyName);
+    shared_ptr<SortedIndex<Equipment>> byId = make_shared<SortedIndex<Equipment>>(nullptr);
+
+    equipmentsRepository.put("equip_003", makeEquipment("equip_003", "Oscilloscope"));
+    equipmentsRepository.put("equip_001", makeEquipment("equip_001", "Muon Detector"));
+    equipmentsRepository.addIndex(sortedIndexName("name"), byName);
+    equipmentsRepository.addIndex(sortedIndexName("id"), byId);
+    equipmentsRepository.put("equip_002", makeEquipment("equip_002", "Cloud Chamber"));
+    equipmentsRepository.put("equip_004", makeEquipment("equip_004", "Muon Detector"));
+    CHECK(byName->size() == 4);
+    CHECK(byName->memoryBytes() > 0);
+
+    SUBCASE("Ids are in key order, then id order, from any position")
+    {
+        CHECK(pageIds(byName->page(nullptr, 0)) == vector<string>{"equip_002", "equip_001", "equip_004", "equip_003"});
+        CHECK(pageIds(byId->page(nullptr, 0)) == vector<string>{"equip_001", "equip_002", "equip_003", "equip_004"});
+        CHECK(pageIds(byName->page(nullptr, 2)) == vector<string>{"equip_002", "equip_001"});
+
+        SortedId after{SortKey{0, "Muon Detector"}, "equip_001"};
+        CHECK(pageIds(byName->page(&after, 0)) == vector<string>{"equip_004", "equip_003"});
+        after = SortedId{SortKey{0, "N"}, ""};
+        CHECK(pageIds(byName->page(&after, 1)) == vector<string>{"equip_003"});
+    }
+
+    SUBCASE("Changed objects move and removed objects leave")
+    {
+        equipmentsRepository.put("equip_003", makeEquipment("equip_003", "Analog Oscilloscope"));
+        equipmentsRepository.erase("equip_001");
+        CHECK(pageIds(byName->page(nullptr, 0)) == vector<string>{"equip_003", "equip_002", "equip_004"});
+        CHECK(pageIds(byId->page(nullptr, 0)) == vector<string>{"equip_002", "equip_003", "equip_004"});
+
+        equipmentsRepository.clear();
+        CHECK(byName->size() == 0);
+        CHECK(byName->page(nullptr, 0).empty());
+    }
+
+    SUBCASE("Pages walked from the index are the pages of the sorted list")
+    {
+        PageRequest page;
+        REQUIRE(page.parse(crow::query_string("?limit=3")));
+        crow::response first = sortedResponse(equipmentsRepository, "name", sortKeyName, page);
+        crow::response sorted = sortedPageResponse(equipmentsRepository, "name", *equipmentsRepository.getSorted("name", sortKeyName), page);
+        CHECK(first.body == sorted.body);
+        CHECK(first.get_header_value("X-Next-Cursor") == sorted.get_header_value("X-Next-Cursor"));
+
+        // An object added before the cursor doesn't move the next page.
+        equipmentsRepository.put("equip_000", makeEquipment("equip_000", "Beam Splitter"));
+        PageRequest next;
+        REQUIRE(next.parse(crow::query_string("?limit=3&cursor=" + first.get_header_value("X-Next-Cursor"))));
+        crow::response second = sortedResponse(equipmentsRepository, "name", sortKeyName, next);
+        CHECK(second.body.find("\"equip_003\"") != string::npos);
+        CHECK(second.body.find("\"equip_000\"") == string::npos);
+        CHECK(second.get_header_value("X-Next-Cursor").empty());
+    }
+
+    SUBCASE("A page is filled past objects removed after their ids were fetched")
+    {
+        // The fetch hands out an id that is no longer in the repository.
+        vector<SortedId> stale = byId->page(nullptr, 0);
+        stale.insert(stale.begin() + 1, SortedId{SortKey(), "equip_001a"});
+        SortedFetch fetch = [&stale](const SortedId* after, size_t count) {
+            vector<SortedId>::const_iterator next = after ? upper_bound(stale.begin(), stale.end(), *after) : stale.begin();
+            size_t available = stale.end() - next;
+            return vector<SortedId>(next, next + (count == 0 ? available : min(count, available)));
+        };
+
+        PageRequest page;
+        REQUIRE(page.parse(crow::query_string("?limit=2")));
+        crow::response res = sortedPageResponse<Equipment>(equipmentsRepository, "id", fetch, page);
+        CHECK(res.body.find("\"equip_001\"") != string::npos);
+        CHECK(res.body.find("\"equip_002\"") != string::npos);
+        CHECK_FALSE(res.get_header_value("X-Next-Cursor").empty());
+    }
+}
+
+TEST_CASE("Finding the objects of a repository with a key in a range.")
+{
+    Repository<Equipment> equipmentsRepository;
+    function<SortKey(const Equipment&)> sortKeyNameLength = [](const Equipment& equipment) { return SortKey{static_cast<double>(equipment.getName().size()), ""}; };
+    for (int i = 1; i <= 9; i++)
+        equipmentsRepository.put("equip_00" + to_string(i), makeEquipment("equip_00" + to_string(i), string(10 - i, 'x')));
+
+    // Collects the ids a filter page visits.
+    auto visitedIds = [&](double min, double max, const string& query)
+    {
+        PageRequest page;
+        REQUIRE(page.parse(crow::query_string(query)));
+        vector<string> ids;
+        scanRange<Equipment>(equipmentsRepository, "namelength", sortKeyNameLength, min, max, page, [&ids](const string& id, const Equipment&) { ids.push_back(id); });
+        return ids;
+    };
+
+    vector<string> scanned = visitedIds(3, 5, "");
+    vector<string> scannedPage = visitedIds(1, 9, "?limit=2&cursor=" + PageRequest::makeCursor("id", SortedId{SortKey(), "equip_004"}));
+    shared_ptr<SortedIndex<Equipment>> index = make_shared<SortedIndex<Equipment>>(sortKeyNameLength);
+    equipmentsRepository.addIndex(sortedIndexName("namelength"), index);
+
+    SUBCASE("A range walk finds the keys from min to max, in key order")
+    {
+        CHECK(index->range(3, 5) == vector<string>{"equip_007", "equip_006", "equip_005"});
+        CHECK(index->range(8.5, numeric_limits<double>::infinity()) == vector<string>{"equip_001"});
+        CHECK(index->range(-numeric_limits<double>::infinity(), 0).empty());
+        CHECK(index->range(5, 3).empty());
+    }
+
+    SUBCASE("Pages of a range are in id order, as the scan they replace")
+    {
+        CHECK(visitedIds(3, 5, "") == scanned);
+        CHECK(scanned == vector<string>{"equip_005", "equip_006", "equip_007"});
+
+        // One more than the limit is visited, to know there is a next page.
+        CHECK(visitedIds(1, 9, "?limit=2&cursor=" + PageRequest::makeCursor("id", SortedId{SortKey(), "equip_004"})) == scannedPage);
+        CHECK(scannedPage == vector<string>{"equip_005", "equip_006", "equip_007"});
+
+        // An object that left the range since the last change is no longer found.
+        equipmentsRepository.put("equip_006", makeEquipment("equip_006", "x"));
+        CHECK(visitedIds(3, 5, "") == vector<string>{"equip_005", "equip_007"});
+    }
+
+    SUBCASE("Bounds come from min and max, or from the older lower bound parameter")
+    {
+        double min = 0, max = 0;
+        readRange(crow::query_string("?amount=2.5"), "amount", min, max);
+        CHECK(min == 2.5);
+        CHECK(max == numeric_limits<double>::infinity());
+        readRange(crow::query_string("?amount=2.5&min=1&max=4"), "amount", min, max);
+        CHECK(min == 1);
+        CHECK(max == 4);
+        readRange(crow::query_string("?max=4"), "amount", min, max);
+        CHECK(min == -numeric_limits<double>::infinity());
+        CHECK_THROWS_AS(readRange(crow::query_string("?min=many"), "amount", min, max), invalid_argument);
+        CHECK_THROWS_AS(readRange(crow::query_string("?max=nan"), "amount", min, max), invalid_argument);
+        CHECK_THROWS_AS(readRange(crow::query_string("?max=1e39"), "amount", min, max), out_of_range);
+    }
+}
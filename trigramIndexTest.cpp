@@ -0,0 +1,161 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "TrigramIndex.h"
+#include "Equipment.h"
+
+using namespace std;
+
+TEST_CASE("Finding the candidates of a literal in a trigram index.")
+{
+    TrigramIndex index;
+    index.add("equip_003", "Shape formation in multi-agent robotics");
+    index.add("equip_001", "Fluid Flow in Pipe Networks");
+    index.add("equip_002", "Muon Detector");
+    CHECK(index.size() == 3);
+    CHECK(index.memoryBytes() > 0);
+
+    SUBCASE("Texts holding every trigram of the literal are offered, in id order, ignoring case")
+    {
+        vector<string> ids;
+        REQUIRE(index.candidates("ROBOT", ids));
+        CHECK(ids == vector<string>{"equip_003"});
+
+        ids.clear();
+        REQUIRE(index.candidates("in ", ids));
+        CHECK(ids == vector<string>{"equip_001", "equip_003"});
+
+        ids.clear();
+        REQUIRE(index.candidates("quark", ids));
+        CHECK(ids.empty());
+
+        // Literals shorter than a trigram can't be narrowed down.
+        CHECK_FALSE(index.candidates("mu", ids));
+
+        // Nor can literals more texts hold than the caller would check one by one.
+        CHECK_FALSE(index.candidates("in ", ids, 1));
+    }
+
+    SUBCASE("Replaced and removed texts are no longer offered")
+    {
+        index.add("equip_002", "Cloud Chamber");
+        index.remove("equip_001");
+        CHECK(index.size() == 2);
+
+        vector<string> ids;
+        REQUIRE(index.candidates("muon", ids));
+        CHECK(ids.empty());
+        REQUIRE(index.candidates("chamber", ids));
+        CHECK(ids == vector<string>{"equip_002"});
+        ids.clear();
+        REQUIRE(index.candidates("pipe", ids));
+        CHECK(ids.empty());
+    }
+
+    SUBCASE("Posting lists are compacted once most of their numbers are removed")
+    {
+        size_t before = index.memoryBytes();
+        for (int round = 0; round < 2000; round++)
+            index.add("equip_001", "Fluid Flow in Pipe Networks " + to_string(round));
+        CHECK(index.size() == 3);
+        CHECK(index.memoryBytes() < 100 * before);
+
+        vector<string> ids;
+        REQUIRE(index.candidates("networks 1999", ids));
+        CHECK(ids == vector<string>{"equip_001"});
+        ids.clear();
+        REQUIRE(index.candidates("networks 1998", ids));
+        CHECK(ids.empty());
+        ids.clear();
+        REQUIRE(index.candidates("detector", ids));
+        CHECK(ids == vector<string>{"equip_002"});
+    }
+
+    SUBCASE("A cleared index offers nothing")
+    {
+        index.clear();
+        vector<string> ids;
+        CHECK(index.size() == 0);
+        REQUIRE(index.candidates("robot", ids));
+        CHECK(ids.empty());
+    }
+}
+
+TEST_CASE("Searching a repository through its text indexes.")
+{
+    Repository<Equipment> equipmentsRepository;
+    map<string, Equipment> equipmentsMap;
+    equipmentsMap["equip_001"] = Equipment{crow::json::load(R"({"equipmentId":"equip_001","name":"Muon Detector","description":"Counts cosmic muons","available":true})")};
+    equipmentsMap["equip_002"] = Equipment{crow::json::load(R"({"equipmentId":"equip_002","name":"Cloud Chamber","description":"Shows the tracks of muons","available":false})")};
+    equipmentsMap["equip_003"] = Equipment{crow::json::load(R"({"equipmentId":"equip_003","name":"Oscilloscope","description":"","available":true})")};
+    equipmentsRepository.assign(std::move(equipmentsMap));
+
+    equipmentsRepository.addIndex("name", make_shared<TextIndex<Equipment>>([](const Equipment& equipment) { return equipment.getName(); }));
+    equipmentsRepository.addIndex("description", make_shared<TextIndex<Equipment>>([](const Equipment& equipment) { return equipment.getDescription(); }));
+    CHECK(equipmentsRepository.getIndexBytes() > 0);
+
+    // Search both fields and collect the ids in the order they are visited.
+    auto search = [&equipmentsRepository](const string& text)
+    {
+        SearchPattern pattern(text);
+        vector<string> found;
+        scanMatches<Equipment>(equipmentsRepository, {"name", "description"}, pattern,
+            [&pattern](const Equipment& equipment) { return pattern.matches(equipment.getName()) || pattern.matches(equipment.getDescription()); },
+            [&found](const string& id, const Equipment&) { found.push_back(id); });
+        return found;
+    };
+
+    CHECK(search("muon") == vector<string>{"equip_001", "equip_002"});
+    CHECK(search("chamber") == vector<string>{"equip_002"});
+    CHECK(search("^osc") == vector<string>{"equip_003"});
+    CHECK(search("o").size() == 3);
+
+    SUBCASE("Changes to the repository reach its indexes")
+    {
+        Equipment renamed = equipmentsRepository.at("equip_003");
+        renamed.setName("Muon Telescope");
+        equipmentsRepository.put("equip_003", renamed);
+        equipmentsRepository.erase("equip_002");
+        CHECK(search("muon") == vector<string>{"equip_001", "equip_003"});
+        CHECK(search("oscillo").empty());
+
+        vector<string> ids;
+        REQUIRE(equipmentsRepository.getIndex<TextIndex<Equipment>>("name")->getTrigrams().candidates("muon", ids));
+        CHECK(ids == vector<string>{"equip_001", "equip_003"});
+
+        equipmentsRepository.clear();
+        CHECK(search("muon").empty());
+    }
+
+    SUBCASE("Only the candidates are checked when they are few")
+    {
+        for (int i = 4; i < 40; i++)
+        {
+            Equipment equipment = equipmentsRepository.at("equip_003");
+            equipment.setId("equip_0" + to_string(i));
+            equipmentsRepository.put(equipment.getId(), equipment);
+        }
+
+        SearchPattern pattern("muon");
+        size_t checked = 0;
+        scanMatches<Equipment>(equipmentsRepository, {"name", "description"}, pattern,
+            [&pattern, &checked](const Equipment& equipment) { checked++; return pattern.matches(equipment.getName()) || pattern.matches(equipment.getDescription()); },
+            [](const string&, const Equipment&) {});
+        CHECK(checked == 2);
+        CHECK(search("oscillo").size() == 37);
+    }
+
+    SUBCASE("A repository without the indexes is scanned")
+    {
+        Repository<Equipment> unindexed;
+        unindexed.put("equip_001", equipmentsRepository.at("equip_001"));
+        SearchPattern pattern("detector");
+        size_t visited = 0;
+        scanMatches<Equipment>(unindexed, {"name"}, pattern,
+            [&pattern](const Equipment& equipment) { return pattern.matches(equipment.getName()); },
+            [&visited](const string&, const Equipment&) { visited++; });
+        CHECK(visited == 1);
+    }
+}
@@ -0,0 +1,214 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <sys/resource.h>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "WriteAheadLog.h"
+#include "ChangeTracker.h"
+
+using namespace std;
+
+TEST_CASE("Appending to the write-ahead log and reading it back.") 
+{
+    string filename = "writeAheadLogTest.wal";
+    remove(filename.c_str());
+
+    SUBCASE("Records are read back in order at every durability level")
+    {
+        for (WriteAheadLog::Durability durability : {WriteAheadLog::Durability::None, WriteAheadLog::Durability::GroupCommit, WriteAheadLog::Durability::Sync})
+        {
+            remove(filename.c_str());
+
+            WriteAheadLog log;
+            REQUIRE(log.open(filename, durability));
+            log.append({"equipments", LogOperation::Put, "equip_001", R"({"equipmentId":"equip_001","available":true})"});
+            log.append({"equipments", LogOperation::Delete, "equip_001", ""});
+            log.close();
+
+            vector<LogRecord> records = WriteAheadLog::readAll(filename);
+            REQUIRE(records.size() == 2);
+            CHECK(records[0].collection == "equipments");
+            CHECK(records[0].operation == LogOperation::Put);
+            CHECK(records[0].id == "equip_001");
+            CHECK(records[0].payload == R"({"equipmentId":"equip_001","available":true})");
+            CHECK(records[1].operation == LogOperation::Delete);
+            CHECK(records[1].payload == "");
+        }
+    }
+
+    SUBCASE("A torn record at the end of the log is ignored and cut off on open")
+    {
+        WriteAheadLog log;
+        REQUIRE(log.open(filename, WriteAheadLog::Durability::Sync));
+        log.append({"labs", LogOperation::Put, "lab_001", "{}"});
+        log.close();
+
+        // Simulate a crash in the middle of writing a second record.
+        ofstream file(filename, ios::binary | ios::app);
+        file.write("\x20\x00\x00\x00\x01\x02\x03\x04garbage", 15);
+        file.close();
+        CHECK(WriteAheadLog::readAll(filename).size() == 1);
+
+        REQUIRE(log.open(filename, WriteAheadLog::Durability::Sync));
+        log.append({"labs", LogOperation::Delete, "lab_001", ""});
+        log.close();
+
+        vector<LogRecord> records = WriteAheadLog::readAll(filename);
+        REQUIRE(records.size() == 2);
+        CHECK(records[1].operation == LogOperation::Delete);
+    }
+
+    SUBCASE("A batch of records is made durable by one fsync")
+    {
+        WriteAheadLog log;
+        REQUIRE(log.open(filename, WriteAheadLog::Durability::Sync));
+        vector<LogRecord> batch;
+        for (string id : {"lab_001", "lab_002", "lab_003"})
+            batch.push_back({"labs", LogOperation::Put, id, "{}"});
+        log.append(batch);
+        CHECK(log.getAppendCount() == 3);
+        CHECK(log.getSyncCount() == 1);
+        log.close();
+
+        vector<LogRecord> records = WriteAheadLog::readAll(filename);
+        REQUIRE(records.size() == 3);
+        CHECK(records[0].id == "lab_001");
+        CHECK(records[2].id == "lab_003");
+    }
+
+    SUBCASE("A checkpoint empties the log")
+    {
+        WriteAheadLog log;
+        REQUIRE(log.open(filename, WriteAheadLog::Durability::GroupCommit));
+        log.append({"labs", LogOperation::Put, "lab_001", "{}"});
+        log.checkpoint();
+        log.close();
+
+        CHECK(WriteAheadLog::readAll(filename).empty());
+    }
+
+    SUBCASE("Rotated records are read before newer ones until they are discarded")
+    {
+        WriteAheadLog log;
+        REQUIRE(log.open(filename, WriteAheadLog::Durability::GroupCommit));
+        log.append({"labs", LogOperation::Put, "lab_001", "{}"});
+        REQUIRE(log.rotate());
+        log.append({"labs", LogOperation::Put, "lab_002", "{}"});
+        REQUIRE(log.rotate());
+        log.append({"labs", LogOperation::Put, "lab_003", "{}"});
+
+        vector<LogRecord> records = WriteAheadLog::readAll(filename);
+        REQUIRE(records.size() == 3);
+        CHECK(records[0].id == "lab_001");
+        CHECK(records[1].id == "lab_002");
+        CHECK(records[2].id == "lab_003");
+
+        log.discardRotated();
+        log.close();
+
+        records = WriteAheadLog::readAll(filename);
+        REQUIRE(records.size() == 1);
+        CHECK(records[0].id == "lab_003");
+    }
+
+    SUBCASE("A log that failed to write takes no more records until it is opened again")
+    {
+        WriteAheadLog log;
+        REQUIRE(log.open(filename, WriteAheadLog::Durability::None));
+        log.append({"labs", LogOperation::Put, "lab_001", "{}"});
+        CHECK_FALSE(log.hasFailed());
+
+        // Let the file grow no further, so the next record is torn.
+        struct rlimit previous;
+        getrlimit(RLIMIT_FSIZE, &previous);
+        struct rlimit limited = previous;
+        limited.rlim_cur = 4096;
+        signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limited);
+        CHECK_THROWS_AS(log.append({"labs", LogOperation::Put, "lab_002", string(8192, 'x')}), runtime_error);
+        setrlimit(RLIMIT_FSIZE, &previous);
+        signal(SIGXFSZ, SIG_DFL);
+
+        CHECK(log.hasFailed());
+        CHECK_THROWS_AS(log.append({"labs", LogOperation::Put, "lab_003", "{}"}), runtime_error);
+        log.close();
+
+        REQUIRE(log.open(filename, WriteAheadLog::Durability::None));
+        CHECK_FALSE(log.hasFailed());
+        log.append({"labs", LogOperation::Put, "lab_004", "{}"});
+        log.close();
+        vector<LogRecord> records = WriteAheadLog::readAll(filename);
+        REQUIRE(records.size() == 2);
+        CHECK(records[0].id == "lab_001");
+        CHECK(records[1].id == "lab_004");
+    }
+
+    SUBCASE("Appending to a log that is not open does nothing")
+    {
+        WriteAheadLog log;
+        log.append({"labs", LogOperation::Put, "lab_001", "{}"});
+        CHECK(log.getAppendCount() == 0);
+    }
+
+    remove(filename.c_str());
+    remove(WriteAheadLog::rotatedFilename(filename).c_str());
+}
+
+TEST_CASE("Writing a delta segment and reading it back.") 
+{
+    string filename = "writeAheadLogTest.delta.1";
+    remove(filename.c_str());
+
+    REQUIRE(WriteAheadLog::writeSegment(filename, {{"labs", LogOperation::Put, "lab_001", "{}"}, {"labs", LogOperation::Delete, "lab_002", ""}}));
+
+    vector<LogRecord> records = WriteAheadLog::readSegment(filename);
+    REQUIRE(records.size() == 2);
+    CHECK(records[0].id == "lab_001");
+    CHECK(records[0].operation == LogOperation::Put);
+    CHECK(records[1].id == "lab_002");
+    CHECK(records[1].operation == LogOperation::Delete);
+
+    // A missing segment reads as empty.
+    remove(filename.c_str());
+    CHECK(WriteAheadLog::readSegment(filename).empty());
+}
+
+TEST_CASE("Tracking the resources changed since the last flush.") 
+{
+    ChangeTracker tracker;
+
+    SUBCASE("The last change to an id wins")
+    {
+        tracker.markChanged("labs", "lab_001");
+        tracker.markDeleted("labs", "lab_001");
+        tracker.markDeleted("labs", "lab_002");
+        tracker.markChanged("labs", "lab_002");
+        tracker.markChanged("labs", "lab_002");
+        CHECK(tracker.getChangeCount() == 2);
+
+        ChangeSet changes = tracker.takeChanges();
+        CHECK(changes["labs"].deleted.count("lab_001") == 1);
+        CHECK(changes["labs"].changed.count("lab_001") == 0);
+        CHECK(changes["labs"].changed.count("lab_002") == 1);
+        CHECK(tracker.getChangeCount() == 0);
+    }
+
+    SUBCASE("Restored changes do not override newer ones")
+    {
+        tracker.markChanged("equipments", "equip_001");
+        tracker.markChanged("equipments", "equip_002");
+        ChangeSet failed = tracker.takeChanges();
+
+        tracker.markDeleted("equipments", "equip_001");
+        tracker.restoreChanges(failed);
+
+        ChangeSet changes = tracker.takeChanges();
+        CHECK(changes["equipments"].deleted.count("equip_001") == 1);
+        CHECK(changes["equipments"].changed.count("equip_001") == 0);
+        CHECK(changes["equipments"].changed.count("equip_002") == 1);
+    }
+}